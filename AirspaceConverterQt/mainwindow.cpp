@@ -262,6 +262,7 @@ void MainWindow::on_loadAirspaceFolderButton_clicked() {
 
 void MainWindow::on_unloadAirspacesButton_clicked() {
     converter->UnloadAirspaces();
+    if (converter->GetNumOfWaypoints() == 0) InternedString::ClearPool(); // nothing loaded anymore: the strings of the previous conversions can go
     logMessage("Unloaded input airspaces.");
     endBusy();
 }
@@ -305,6 +306,7 @@ void MainWindow::on_loadWaypointsFolderButton_clicked() {
 
 void MainWindow::on_unloadWaypointsButton_clicked() {
     converter->UnloadWaypoints();
+    if (converter->GetNumOfAirspaces() == 0) InternedString::ClearPool(); // nothing loaded anymore: the strings of the previous conversions can go
     logMessage("Unloaded input waypoints.");
     endBusy();
 }
@@ -0,0 +1,481 @@
+//============================================================================
+// AirspaceConverter
+// Since       : 14/6/2016
+// Author      : Alberto Realis-Luc <alberto.realisluc@gmail.com>
+// Web         : https://www.alus.it/AirspaceConverter
+// Repository  : https://github.com/alus-it/AirspaceConverter.git
+// Copyright   : (C) 2016-2021 Alberto Realis-Luc
+// License     : GNU GPL v3
+//
+// This source file is part of AirspaceConverter project
+//============================================================================
+
+#include "ACB.h"
+#include "AirspaceConverter.h"
+#include "Airspace.h"
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cassert>
+#include <limits>
+#include <boost/format.hpp>
+
+const uint16_t ACB::VERSION_MAJOR = 1;
+const uint16_t ACB::VERSION_MINOR = 0;
+const size_t ACB::HEADER_SIZE = 72;
+const size_t ACB::AIRSPACE_SIZE = 64;
+const size_t ACB::FREQUENCY_SIZE = 8;
+const size_t ACB::POINT_SIZE = 8;
+const size_t ACB::NODE_SIZE = 24;
+const size_t ACB::LEAF_SIZE = 4;
+const uint32_t ACB::LEAF_FLAG = 0x80000000;
+
+namespace {
+
+const char MAGIC[4] = { 'A', 'C', 'B', '\0' };
+const size_t NODE_CAPACITY = 16;
+const double FIXED_SCALE = 1e7; // coordinates in 1e-7 degrees
+
+inline void Put8(const uint8_t value, std::string& data) {
+	data += (char)value;
+}
+
+inline void Put16(const uint16_t value, std::string& data) {
+	data += (char)(value & 0xFF);
+	data += (char)(value >> 8);
+}
+
+inline void Put32(const uint32_t value, std::string& data) {
+	data += (char)(value & 0xFF);
+	data += (char)((value >> 8) & 0xFF);
+	data += (char)((value >> 16) & 0xFF);
+	data += (char)(value >> 24);
+}
+
+inline uint16_t Get16(const char* data) {
+	return (uint16_t)((uint8_t)data[0] | ((uint8_t)data[1] << 8));
+}
+
+inline uint32_t Get32(const char* data) {
+	return (uint32_t)(uint8_t)data[0] | ((uint32_t)(uint8_t)data[1] << 8) | ((uint32_t)(uint8_t)data[2] << 16) | ((uint32_t)(uint8_t)data[3] << 24);
+}
+
+} // namespace
+
+ACB::ACB(std::multimap<int, Airspace>& airspacesMap) :
+	airspaces(airspacesMap),
+	numOfAirspaces(0),
+	numOfFrequencies(0),
+	numOfPoints(0),
+	numOfNodes(0),
+	stringsSize(0),
+	airspacesOffset(0),
+	frequenciesOffset(0),
+	pointsOffset(0),
+	nodesOffset(0),
+	leavesOffset(0),
+	stringsOffset(0) {
+}
+
+bool ACB::Write(const std::string& filename) {
+	if (airspaces.empty()) {
+		AirspaceConverter::LogMessage("ACB output: no airspaces, nothing to write");
+		return false;
+	}
+
+	// The airspaces with their bounding boxes are the items to be indexed
+	std::vector<const Airspace*> toWrite;
+	std::vector<Node> items;
+	toWrite.reserve(airspaces.size());
+	items.reserve(airspaces.size());
+	for (const std::pair<const int, Airspace>& pair : airspaces) {
+		const Airspace& a = pair.second;
+		if (a.GetNumberOfPoints() < 3) continue;
+		Node item;
+		item.box.minLat = item.box.minLon = std::numeric_limits<int32_t>::max();
+		item.box.maxLat = item.box.maxLon = std::numeric_limits<int32_t>::min();
+		for (const Geometry::LatLon& p : a.GetPoints()) {
+			const int32_t lat = ToFixed(p.Lat()), lon = ToFixed(p.Lon());
+			item.box.minLat = std::min(item.box.minLat, lat);
+			item.box.minLon = std::min(item.box.minLon, lon);
+			item.box.maxLat = std::max(item.box.maxLat, lat);
+			item.box.maxLon = std::max(item.box.maxLon, lon);
+		}
+		item.first = (uint32_t)toWrite.size();
+		item.count = 1;
+		items.push_back(item);
+		toWrite.push_back(&a);
+	}
+	if (items.empty()) {
+		AirspaceConverter::LogMessage("ACB output: no airspaces with points, nothing to write");
+		return false;
+	}
+
+	// Build the R-tree bottom up, the airspaces remain in their order: the items are sorted as the leaves
+	std::vector<Box> boxes;
+	boxes.reserve(items.size());
+	for (const Node& item : items) boxes.push_back(item.box);
+	std::vector<std::vector<Node>> levels(1);
+	PackSortTileRecursive(items, levels.back());
+	for (Node& leaf : levels.back()) leaf.count |= LEAF_FLAG;
+	while (levels.back().size() > 1) {
+		std::vector<Node> parents;
+		PackSortTileRecursive(levels.back(), parents);
+		levels.push_back(std::move(parents));
+	}
+
+	// Airspaces, frequencies and points
+	std::string airspacesData, frequenciesData, pointsData, strings(1, '\0');
+	std::map<std::string, uint32_t> stringsIndex;
+	const auto putString = [&](const std::string& text, std::string& data) {
+		uint32_t offset = 0;
+		if (!text.empty()) {
+			const std::map<std::string, uint32_t>::const_iterator it = stringsIndex.find(text);
+			if (it == stringsIndex.end()) {
+				offset = (uint32_t)strings.size();
+				strings.append(text.c_str(), text.size() + 1);
+				stringsIndex.insert(std::make_pair(text, offset));
+			} else offset = it->second;
+		}
+		Put32(offset, data);
+	};
+	uint32_t frequencies = 0, points = 0;
+	Box bounds = boxes.front();
+	for (size_t index = 0; index < toWrite.size(); index++) {
+		const Airspace& a = *toWrite[index];
+		const Box& box = boxes[index];
+
+		// Points rounded to the file resolution, without the ones becoming equal to the previous
+		const uint32_t firstPoint = points;
+		int64_t previous = -1;
+		for (const Geometry::LatLon& p : a.GetPoints()) {
+			const int32_t lat = ToFixed(p.Lat()), lon = ToFixed(p.Lon());
+			const int64_t current = ((int64_t)(uint32_t)lat << 32) | (uint32_t)lon;
+			if (current == previous) continue;
+			Put32((uint32_t)lat, pointsData);
+			Put32((uint32_t)lon, pointsData);
+			previous = current;
+			points++;
+		}
+
+		putString(a.GetName(), airspacesData);
+		Put32(firstPoint, airspacesData);
+		Put32(points - firstPoint, airspacesData);
+		Put32(frequencies, airspacesData);
+		Put16((uint16_t)a.GetNumberOfRadioFrequencies(), airspacesData);
+		Put8((uint8_t)a.GetType(), airspacesData);
+		Put8((uint8_t)a.GetClass(), airspacesData);
+		Put16((uint16_t)(a.HasTransponderCode() ? std::stoi(a.GetTransponderCode(), 0, 8) : -1), airspacesData);
+		Put16(0, airspacesData);
+		PutAltitude(a.GetTopAltitude(), airspacesData);
+		PutAltitude(a.GetBaseAltitude(), airspacesData);
+		PutBox(box, airspacesData);
+		for (size_t i = 0; i < a.GetNumberOfRadioFrequencies(); i++) {
+			Put32((uint32_t)a.GetRadioFrequencyAt(i).first, frequenciesData);
+			putString(a.GetRadioFrequencyAt(i).second.Get(), frequenciesData);
+		}
+		frequencies += (uint32_t)a.GetNumberOfRadioFrequencies();
+		bounds.minLat = std::min(bounds.minLat, box.minLat);
+		bounds.minLon = std::min(bounds.minLon, box.minLon);
+		bounds.maxLat = std::max(bounds.maxLat, box.maxLat);
+		bounds.maxLon = std::max(bounds.maxLon, box.maxLon);
+	}
+
+	// Index nodes: from the root down to the leaves, so the children of each level follow
+	std::string nodesData;
+	uint32_t nodes = 0;
+	for (size_t level = levels.size(); level-- > 0;) {
+		const uint32_t childrenStart = nodes + (uint32_t)levels[level].size();
+		for (const Node& node : levels[level]) {
+			PutBox(node.box, nodesData);
+			Put32(level > 0 ? childrenStart + node.first : node.first, nodesData);
+			Put32(node.count, nodesData);
+		}
+		nodes += (uint32_t)levels[level].size();
+	}
+	std::string leavesData;
+	for (const Node& item : items) Put32(item.first, leavesData);
+
+	// Header and sections
+	std::string data;
+	data.reserve(HEADER_SIZE + airspacesData.size() + frequenciesData.size() + pointsData.size() + nodesData.size() + leavesData.size() + strings.size() + 40);
+	data.append(MAGIC, sizeof(MAGIC));
+	Put16(VERSION_MAJOR, data);
+	Put16(VERSION_MINOR, data);
+	Put32((uint32_t)items.size(), data);
+	Put32(frequencies, data);
+	Put32(points, data);
+	Put32(nodes, data);
+	Put32((uint32_t)strings.size(), data);
+	uint32_t offset = (uint32_t)HEADER_SIZE;
+	for (const std::string* section : { &airspacesData, &frequenciesData, &pointsData, &nodesData, &leavesData, &strings }) {
+		Put32(offset, data);
+		offset += (uint32_t)((section->size() + 7) & ~(size_t)7);
+	}
+	PutBox(bounds, data);
+	Put32(0, data);
+	assert(data.size() == HEADER_SIZE);
+	for (const std::string* section : { &airspacesData, &frequenciesData, &pointsData, &nodesData, &leavesData, &strings }) {
+		data += *section;
+		Align(data);
+	}
+	if (data.size() > std::numeric_limits<uint32_t>::max()) {
+		AirspaceConverter::LogError("Too many airspaces for the ACB format.");
+		return false;
+	}
+
+	std::ofstream output(filename, std::ios::out | std::ios::trunc | std::ios::binary);
+	if (!output.is_open() || output.bad()) {
+		AirspaceConverter::LogError("Unable to open output file: " + filename);
+		return false;
+	}
+	AirspaceConverter::LogMessage("Writing ACB output file: " + filename);
+	if (!output.write(data.data(), data.size())) {
+		AirspaceConverter::LogError("Failed to write ACB output file: " + filename);
+		return false;
+	}
+	return true;
+}
+
+void ACB::PackSortTileRecursive(std::vector<Node>& items, std::vector<Node>& parents) {
+	// Sort in vertical slices by longitude, then each slice by latitude, then group the consecutive items
+	const auto centerLon = [](const Node& n) { return (int64_t)n.box.minLon + n.box.maxLon; };
+	const auto centerLat = [](const Node& n) { return (int64_t)n.box.minLat + n.box.maxLat; };
+	const size_t numOfParents = (items.size() + NODE_CAPACITY - 1) / NODE_CAPACITY;
+	const size_t numOfSlices = (size_t)std::ceil(std::sqrt((double)numOfParents));
+	const size_t sliceSize = numOfSlices * NODE_CAPACITY;
+	std::stable_sort(items.begin(), items.end(), [&](const Node& a, const Node& b) { return centerLon(a) < centerLon(b); });
+	for (size_t begin = 0; begin < items.size(); begin += sliceSize) {
+		const std::vector<Node>::iterator end = items.begin() + std::min(items.size(), begin + sliceSize);
+		std::stable_sort(items.begin() + begin, end, [&](const Node& a, const Node& b) { return centerLat(a) < centerLat(b); });
+	}
+	parents.clear();
+	parents.reserve(numOfParents);
+	for (size_t begin = 0; begin < items.size(); begin += NODE_CAPACITY) {
+		Node parent;
+		parent.box = items[begin].box;
+		parent.first = (uint32_t)begin;
+		parent.count = (uint32_t)(std::min(items.size(), begin + NODE_CAPACITY) - begin);
+		for (size_t i = begin + 1; i < begin + parent.count; i++) {
+			parent.box.minLat = std::min(parent.box.minLat, items[i].box.minLat);
+			parent.box.minLon = std::min(parent.box.minLon, items[i].box.minLon);
+			parent.box.maxLat = std::max(parent.box.maxLat, items[i].box.maxLat);
+			parent.box.maxLon = std::max(parent.box.maxLon, items[i].box.maxLon);
+		}
+		parents.push_back(parent);
+	}
+}
+
+void ACB::PutAltitude(const Altitude& altitude, std::string& data) {
+	const float meters = (float)altitude.GetAltMt();
+	uint32_t metersBits;
+	std::memcpy(&metersBits, &meters, sizeof(metersBits));
+	Put32((uint32_t)altitude.GetAltFt(), data);
+	Put32(metersBits, data);
+	Put16((uint16_t)altitude.GetFlightLevel(), data);
+	Put8((uint8_t)((altitude.IsAMSL() ? 1 : 0) | (altitude.IsUnlimited() ? 2 : 0)), data);
+	Put8(0, data);
+}
+
+void ACB::PutBox(const Box& box, std::string& data) {
+	Put32((uint32_t)box.minLat, data);
+	Put32((uint32_t)box.minLon, data);
+	Put32((uint32_t)box.maxLat, data);
+	Put32((uint32_t)box.maxLon, data);
+}
+
+void ACB::Align(std::string& data) {
+	data.append((8 - data.size() % 8) % 8, '\0');
+}
+
+ACB::Box ACB::ReadBox(const char* data) {
+	const Box box = { (int32_t)Get32(data), (int32_t)Get32(data + 4), (int32_t)Get32(data + 8), (int32_t)Get32(data + 12) };
+	return box;
+}
+
+int32_t ACB::ToFixed(const double degrees) {
+	return (int32_t)std::lround(degrees * FIXED_SCALE);
+}
+
+bool ACB::Open(const std::string& filename) {
+	file.clear();
+	numOfAirspaces = 0;
+	std::ifstream input(filename, std::ios::in | std::ios::binary);
+	if (!input.is_open() || input.bad()) {
+		AirspaceConverter::LogError("Unable to open ACB input file: " + filename);
+		return false;
+	}
+	input.seekg(0, std::ios::end);
+	const std::streamoff size = input.tellg();
+	input.seekg(0, std::ios::beg);
+	if (size < (std::streamoff)HEADER_SIZE || size > (std::streamoff)std::numeric_limits<uint32_t>::max()) {
+		AirspaceConverter::LogError("Not a valid ACB file: " + filename);
+		return false;
+	}
+	file.resize((size_t)size);
+	if (!input.read(file.data(), size)) {
+		AirspaceConverter::LogError("Unable to read ACB input file: " + filename);
+		file.clear();
+		return false;
+	}
+
+	// Verify the header
+	const char* header = file.data();
+	if (std::memcmp(header, MAGIC, sizeof(MAGIC)) != 0) {
+		AirspaceConverter::LogError("Not a valid ACB file: " + filename);
+		file.clear();
+		return false;
+	}
+	if (Get16(header + 4) != VERSION_MAJOR) {
+		AirspaceConverter::LogError(boost::str(boost::format("Unsupported ACB file version %1d.%2d: %3s") %Get16(header + 4) %Get16(header + 6) %filename));
+		file.clear();
+		return false;
+	}
+	numOfAirspaces = Get32(header + 8);
+	numOfFrequencies = Get32(header + 12);
+	numOfPoints = Get32(header + 16);
+	numOfNodes = Get32(header + 20);
+	stringsSize = Get32(header + 24);
+	airspacesOffset = Get32(header + 28);
+	frequenciesOffset = Get32(header + 32);
+	pointsOffset = Get32(header + 36);
+	nodesOffset = Get32(header + 40);
+	leavesOffset = Get32(header + 44);
+	stringsOffset = Get32(header + 48);
+
+	// All the sections must be in the file and the strings table must be terminated
+	const uint64_t fileSize = file.size();
+	if ((uint64_t)airspacesOffset + (uint64_t)numOfAirspaces * AIRSPACE_SIZE > fileSize ||
+		(uint64_t)frequenciesOffset + (uint64_t)numOfFrequencies * FREQUENCY_SIZE > fileSize ||
+		(uint64_t)pointsOffset + (uint64_t)numOfPoints * POINT_SIZE > fileSize ||
+		(uint64_t)nodesOffset + (uint64_t)numOfNodes * NODE_SIZE > fileSize ||
+		(uint64_t)leavesOffset + (uint64_t)numOfAirspaces * LEAF_SIZE > fileSize ||
+		(uint64_t)stringsOffset + stringsSize > fileSize ||
+		stringsSize == 0 || file[stringsOffset + stringsSize - 1] != '\0' || (numOfAirspaces > 0 && numOfNodes == 0)) {
+		AirspaceConverter::LogError("Corrupted ACB file: " + filename);
+		file.clear();
+		numOfAirspaces = 0;
+		return false;
+	}
+	return true;
+}
+
+bool ACB::Read(const std::string& filename) {
+	if (!Open(filename)) return false;
+	size_t skipped = 0;
+	for (size_t i = 0; i < numOfAirspaces; i++) {
+		Airspace airspace;
+		if (!GetAirspace(i, airspace)) skipped++;
+		else if (airspaceHandler) airspaceHandler(airspace);
+		else airspaces.insert(std::pair<int, Airspace>(airspace.GetType(), std::move(airspace)));
+	}
+	if (skipped > 0) AirspaceConverter::LogWarning(boost::str(boost::format("skipped %1d invalid airspace(s) in ACB file: %2s") %skipped %filename));
+	std::vector<char>().swap(file);
+	numOfAirspaces = 0;
+	return true;
+}
+
+bool ACB::GetAirspace(const size_t index, Airspace& airspace) const {
+	if (index >= numOfAirspaces) return false;
+	const char* record = file.data() + airspacesOffset + index * AIRSPACE_SIZE;
+	const uint32_t firstPoint = Get32(record + 4), points = Get32(record + 8);
+	const uint32_t firstFrequency = Get32(record + 12), frequencies = Get16(record + 16);
+	const uint8_t type = (uint8_t)record[18], airspaceClass = (uint8_t)record[19];
+	if ((uint64_t)firstPoint + points > numOfPoints || (uint64_t)firstFrequency + frequencies > numOfFrequencies || type > Airspace::UNDEFINED || airspaceClass > Airspace::UNDEFINED) return false;
+	const char* name = GetString(Get32(record));
+	if (name == nullptr) return false;
+
+	airspace.SetType((Airspace::Type)type);
+	if (airspaceClass <= Airspace::CLASSG) airspace.SetClass((Airspace::Type)airspaceClass);
+	airspace.SetName(name);
+	const int16_t transponder = (int16_t)Get16(record + 20);
+	if (transponder >= 0) {
+		static const char digits[] = "01234567";
+		const char code[5] = { digits[(transponder >> 9) & 7], digits[(transponder >> 6) & 7], digits[(transponder >> 3) & 7], digits[transponder & 7], '\0' };
+		if (!airspace.SetTransponderCode(code)) return false;
+	}
+	Altitude top, base;
+	if (!ReadAltitude(record + 24, top) || !ReadAltitude(record + 36, base)) return false;
+	airspace.SetTopAltitude(top);
+	airspace.SetBaseAltitude(base);
+	for (uint32_t i = firstFrequency; i < firstFrequency + frequencies; i++) {
+		const char* frequency = file.data() + frequenciesOffset + i * FREQUENCY_SIZE;
+		const char* description = GetString(Get32(frequency + 4));
+		if ((int32_t)Get32(frequency) <= 0 || description == nullptr) return false;
+		airspace.AddRadioFrequency((int)Get32(frequency), InternedString(description));
+	}
+	std::vector<Geometry::LatLon> latLons;
+	latLons.reserve(points);
+	for (uint32_t i = firstPoint; i < firstPoint + points; i++) {
+		const char* point = file.data() + pointsOffset + i * POINT_SIZE;
+		const double lat = (int32_t)Get32(point) / FIXED_SCALE, lon = (int32_t)Get32(point + 4) / FIXED_SCALE;
+		if (!Geometry::LatLon::IsValidLat(lat) || !Geometry::LatLon::IsValidLon(lon)) return false;
+		latLons.push_back(Geometry::LatLon(lat, lon));
+	}
+	airspace.SetPoints(std::move(latLons)); // exactly as written
+	return airspace.ClosePoints();
+}
+
+bool ACB::ReadAltitude(const char* data, Altitude& altitude) const {
+	const int32_t feet = (int32_t)Get32(data);
+	const uint32_t metersBits = Get32(data + 4);
+	float meters;
+	std::memcpy(&meters, &metersBits, sizeof(meters));
+	const int16_t flightLevel = (int16_t)Get16(data + 8);
+	const uint8_t flags = (uint8_t)data[10];
+	if (!std::isfinite(meters) || flightLevel < 0) return false;
+	const bool isAMSL = (flags & 1) != 0;
+	if (flags & 2) altitude.SetUnlimited();
+	else if (flightLevel > 0) altitude.SetFlightLevel(flightLevel);
+	else if (meters == (float)(feet * Altitude::FEET2METER)) altitude.SetAltFt(feet, isAMSL); // it was defined in feet
+	else altitude.SetAltMt(meters, isAMSL);
+	return true;
+}
+
+const char* ACB::GetString(const uint32_t offset) const {
+	return offset < stringsSize ? file.data() + stringsOffset + offset : nullptr;
+}
+
+void ACB::FindAirspacesAt(const double lat, const double lon, std::vector<size_t>& found) const {
+	found.clear();
+	if (numOfAirspaces == 0 || !Geometry::LatLon::IsValidLat(lat) || !Geometry::LatLon::IsValidLon(lon)) return;
+	const int32_t fixedLat = ToFixed(lat), fixedLon = ToFixed(lon);
+	std::vector<uint32_t> stack(1, 0); // start from the root
+	while (!stack.empty()) {
+		const uint32_t index = stack.back();
+		stack.pop_back();
+		if (index >= numOfNodes) continue; // corrupted
+		const char* node = file.data() + nodesOffset + index * NODE_SIZE;
+		const Box box = ReadBox(node);
+		if (fixedLat < box.minLat || fixedLat > box.maxLat || fixedLon < box.minLon || fixedLon > box.maxLon) continue;
+		const uint32_t first = Get32(node + 16), count = Get32(node + 20);
+		if (count & LEAF_FLAG) {
+			for (uint32_t i = first; i < first + (count & ~LEAF_FLAG) && i < numOfAirspaces; i++) {
+				const uint32_t airspaceIndex = Get32(file.data() + leavesOffset + i * LEAF_SIZE);
+				if (airspaceIndex < numOfAirspaces && IsInside(airspaceIndex, fixedLat, fixedLon)) found.push_back(airspaceIndex);
+			}
+		} else for (uint32_t i = 0; i < count && stack.size() < numOfNodes; i++) stack.push_back(first + i);
+	}
+	std::sort(found.begin(), found.end());
+}
+
+bool ACB::IsInside(const uint32_t airspaceIndex, const int32_t lat, const int32_t lon) const {
+	const char* record = file.data() + airspacesOffset + airspaceIndex * AIRSPACE_SIZE;
+	const Box box = ReadBox(record + 48);
+	if (lat < box.minLat || lat > box.maxLat || lon < box.minLon || lon > box.maxLon) return false;
+	const uint32_t firstPoint = Get32(record + 4), points = Get32(record + 8);
+	if (points < 3 || (uint64_t)firstPoint + points > numOfPoints) return false;
+
+	// Crossing number on the closed polygon
+	bool inside = false;
+	const char* p = file.data() + pointsOffset + firstPoint * POINT_SIZE;
+	int64_t prevLat = (int32_t)Get32(p + (points - 1) * POINT_SIZE), prevLon = (int32_t)Get32(p + (points - 1) * POINT_SIZE + 4);
+	for (uint32_t i = 0; i < points; i++, p += POINT_SIZE) {
+		const int64_t curLat = (int32_t)Get32(p), curLon = (int32_t)Get32(p + 4);
+		if ((curLat > lat) != (prevLat > lat) && ((lon - curLon) * (prevLat - curLat) < (prevLon - curLon) * (lat - curLat)) == (prevLat > curLat)) inside = !inside;
+		prevLat = curLat;
+		prevLon = curLon;
+	}
+	return inside;
+}
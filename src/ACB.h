@@ -0,0 +1,90 @@
+//============================================================================
+// AirspaceConverter
+// Since       : 14/6/2016
+// Author      : Alberto Realis-Luc <alberto.realisluc@gmail.com>
+// Web         : https://www.alus.it/AirspaceConverter
+// Repository  : https://github.com/alus-it/AirspaceConverter.git
+// Copyright   : (C) 2016-2021 Alberto Realis-Luc
+// License     : GNU GPL v3
+//
+// This source file is part of AirspaceConverter project
+//============================================================================
+
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+#include <functional>
+
+class Altitude;
+class Airspace;
+
+// ACB: compact binary airspace format, made to be memory mapped and queried directly by devices without parsing.
+// All the values are little-endian, the sections start at offsets multiple of 8 and their records have fixed size:
+//
+// Header (72 bytes):
+//   0 char[4] magic "ACB\0"       4 uint16 major version      6 uint16 minor version
+//   8 uint32 number of airspaces  12 uint32 number of frequencies  16 uint32 number of points
+//  20 uint32 number of index nodes  24 uint32 size of the strings table
+//  28 uint32 offsets of: airspaces, frequencies, points, index nodes, index leaves and strings table
+//  52 int32 bounding box of all the airspaces: min lat, min lon, max lat, max lon   68 uint32 padding
+// Airspace (64 bytes):
+//   0 uint32 name   4 uint32 first point   8 uint32 number of points   12 uint32 first frequency
+//  16 uint16 number of frequencies   18 uint8 category   19 uint8 class   20 int16 transponder code (-1 if none)
+//  24 top altitude, 36 base altitude (12 bytes each):
+//      int32 feet, float32 meters, int16 flight level (0 if none), uint8 flags (1: AMSL, 2: unlimited), uint8 padding
+//  48 int32 bounding box: min lat, min lon, max lat, max lon
+// Frequency (8 bytes): uint32 frequency [Hz], uint32 description
+// Point (8 bytes): int32 latitude, int32 longitude; the polygons are closed: the last point is equal to the first
+// Index node (24 bytes): int32 bounding box, uint32 first child, uint32 number of children
+//   R-tree packed with Sort-Tile-Recursive, the root is the first node; if the highest bit of the number of children
+//   is set the node is a leaf and its children are in the index leaves
+// Index leaf (4 bytes): uint32 airspace, one for each airspace; the airspaces keep the original order
+// Strings: UTF-8 NUL terminated, referenced by offset in the table, offset 0 is always the empty string
+// Coordinates are in 1e-7 degrees.
+class ACB {
+public:
+	ACB(std::multimap<int, Airspace>& airspacesMap);
+	~ACB() {}
+	bool Write(const std::string& filename);
+	bool Read(const std::string& filename);
+	inline void StreamAirspaces(const std::function<void(Airspace&)>& handler) { airspaceHandler = handler; } // pass each airspace read to the handler instead of storing it
+
+	// Direct access to the loaded file, without making all the airspaces
+	bool Open(const std::string& filename);
+	inline size_t GetNumOfAirspaces() const { return numOfAirspaces; }
+	bool GetAirspace(const size_t index, Airspace& airspace) const;
+	void FindAirspacesAt(const double lat, const double lon, std::vector<size_t>& found) const; // index of the airspaces containing the point
+
+	static const uint16_t VERSION_MAJOR, VERSION_MINOR;
+
+private:
+	struct Box {
+		int32_t minLat, minLon, maxLat, maxLon;
+	};
+
+	struct Node {
+		Box box;
+		uint32_t first, count;
+	};
+
+	static void PackSortTileRecursive(std::vector<Node>& items, std::vector<Node>& parents);
+	static void PutAltitude(const Altitude& altitude, std::string& data);
+	static void PutBox(const Box& box, std::string& data);
+	static void Align(std::string& data);
+	static Box ReadBox(const char* data);
+	static int32_t ToFixed(const double degrees);
+	bool ReadAltitude(const char* data, Altitude& altitude) const;
+	const char* GetString(const uint32_t offset) const;
+	bool IsInside(const uint32_t airspaceIndex, const int32_t lat, const int32_t lon) const;
+
+	static const size_t HEADER_SIZE, AIRSPACE_SIZE, FREQUENCY_SIZE, POINT_SIZE, NODE_SIZE, LEAF_SIZE;
+	static const uint32_t LEAF_FLAG;
+
+	std::multimap<int, Airspace>& airspaces;
+	std::function<void(Airspace&)> airspaceHandler;
+	std::vector<char> file; // content of the opened file
+	uint32_t numOfAirspaces, numOfFrequencies, numOfPoints, numOfNodes, stringsSize;
+	uint32_t airspacesOffset, frequenciesOffset, pointsOffset, nodesOffset, leavesOffset, stringsOffset;
+};
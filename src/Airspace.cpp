@@ -14,17 +14,38 @@
 #include <algorithm>
 #include <cassert>
 #include <iomanip>
-#include <boost/version.hpp>
-#ifdef _WIN32
-#pragma warning( push )
-#pragma warning( disable : 4127 )
-#include <boost/geometry/formulas/differential_quantities.hpp>
-#include <boost/geometry/formulas/meridian_inverse.hpp>
-#pragma warning( pop )
-#endif
-#include <boost/geometry.hpp>
-#include <boost/geometry/geometries/polygon.hpp>
-#include <boost/geometry/geometries/adapted/boost_tuple.hpp>
+#include <cmath>
+#include <sstream>
+
+namespace {
+
+// WGS84 ellipsoid
+const double WGS84_A = 6378.137; // [Km]
+const double WGS84_B = 6356.7523142451793; // [Km]
+const double WGS84_F = (WGS84_A - WGS84_B) / WGS84_A;
+const double WGS84_E2 = WGS84_F * (2 - WGS84_F);
+const double WGS84_E = std::sqrt(WGS84_E2);
+
+// Function q of the authalic latitude: beta = asin(q(phi) / q(pi/2))
+inline double AuthalicQ(const double sinLat) {
+	const double eSinLat = WGS84_E * sinLat;
+	return (1 - WGS84_E2) * (sinLat / (1 - eSinLat * eSinLat) + std::atanh(eSinLat) / WGS84_E);
+}
+
+const double AUTHALIC_QP = AuthalicQ(1);
+const double AUTHALIC_R2 = WGS84_A * WGS84_A * AUTHALIC_QP / 2; // [Km2] square of the radius of the sphere with the same surface
+
+// Andoyer-Lambert distance on the ellipsoid, the same formula used by default by boost geometry
+inline double AndoyerDistance(const double sinLat1, const double cosLat1, const double sinLat2, const double cosLat2, const double dLon) {
+	const double cosD = std::max(-1.0, std::min(1.0, sinLat1 * sinLat2 + cosLat1 * cosLat2 * std::cos(dLon)));
+	const double d = std::acos(cosD), threeSinD = 3 * std::sin(d);
+	const double K = (sinLat1 - sinLat2) * (sinLat1 - sinLat2), L = (sinLat1 + sinLat2) * (sinLat1 + sinLat2);
+	const double H = cosD >= 1 ? 0 : (d + threeSinD) / (1 - cosD);
+	const double G = cosD <= -1 ? 0 : (d - threeSinD) / (1 + cosD);
+	return WGS84_A * (d - WGS84_F / 4 * (H * K + G * L));
+}
+
+} // namespace
 
 const double Altitude::FEET2METER = 0.3048; // 1 Ft = 0.3048 m
 const double Altitude::K1 = 0.190263;
@@ -168,47 +189,50 @@ const std::string Airspace::CATEGORY_NAMES[] = {
 	"UNDEFINED" //UNDEFINED
 };
 
+const std::vector<std::pair<int,InternedString>> Airspace::NO_FREQUENCIES;
+
 Airspace::Airspace(Type category)
 	: type(category)
-	, airspaceClass(category >= CLASSA && category <= CLASSG ? category : UNDEFINED)
-	, transponderCode(-1) {
+	, airspaceClass(category >= CLASSA && category <= CLASSG ? category : UNDEFINED) {
 }
 
 Airspace::Airspace(const Airspace& orig) // Copy constructor
-	: top(orig.top)
+	: points(orig.points)
+	, top(orig.top)
 	, base(orig.base)
-	, geometries(orig.geometries)
-	, points(orig.points)
 	, type(orig.type)
 	, airspaceClass(orig.airspaceClass)
 	, name(orig.name)
-	, radioFrequencies(orig.radioFrequencies)
-	, transponderCode(orig.transponderCode) {
+	, details(orig.details ? new Details(*orig.details) : nullptr) {
+	geometries.reserve(orig.geometries.size());
+	for (const Geometry* g : orig.geometries) geometries.push_back(g->Clone()); // each airspace owns its geometries
 }
 
 Airspace::Airspace(Airspace&& orig) // Move constructor
-	: top(std::move(orig.top))
+	: points(std::move(orig.points))
+	, top(std::move(orig.top))
 	, base(std::move(orig.base))
-	, geometries(std::move(orig.geometries))
-	, points(std::move(orig.points))
 	, type(std::move(orig.type))
 	, airspaceClass(std::move(orig.airspaceClass))
 	, name(std::move(orig.name))
-	, radioFrequencies(std::move(orig.radioFrequencies))
-	, transponderCode(std::move(orig.transponderCode)) {
+	, geometries(std::move(orig.geometries))
+	, details(std::move(orig.details)) {
 	orig.type = UNDEFINED;
+	orig.name = InternedString(); // a moved handle is just copied
 }
 
 Airspace& Airspace::operator=(const Airspace& other) {
+	if (this == &other) return *this;
 	top = other.top;
 	base = other.base;
-	geometries = other.geometries;
+	ClearGeometries();
+	geometries.reserve(other.geometries.size());
+	for (const Geometry* g : other.geometries) geometries.push_back(g->Clone());
 	points = other.points;
 	type = other.type;
 	airspaceClass = other.airspaceClass;
 	name = other.name;
-	radioFrequencies = other.radioFrequencies;
-	transponderCode = other.transponderCode;
+	details.reset(other.details ? new Details(*other.details) : nullptr);
 	return *this;
 }
 
@@ -235,9 +259,9 @@ void Airspace::SetClass(const Type& airspClass) {
 	if (type <= CLASSG && type != airspClass) type = airspClass;
 }
 
-void Airspace::AddRadioFrequency(const int frequencyHz, const std::string& description) {
+void Airspace::AddRadioFrequency(const int frequencyHz, const InternedString& description) {
 	assert(frequencyHz > 0);
-	radioFrequencies.push_back(std::make_pair(frequencyHz,description)); // here we expect alredy validated airband radio frequencies
+	GetDetails().radioFrequencies.push_back(std::make_pair(frequencyHz,description)); // here we expect alredy validated airband radio frequencies
 }
 
 bool Airspace::SetTransponderCode(const std::string& code) {
@@ -246,21 +270,28 @@ bool Airspace::SetTransponderCode(const std::string& code) {
 		if (c < '0' || c > '7') return false;
 	}
 	try {
-		transponderCode = (short)std::stoi(code, 0, 8);
+		const short transponderCode = (short)std::stoi(code, 0, 8);
+		GetDetails().transponderCode = transponderCode;
 		return true;
 	} catch ( ... ) {}
 	return false;
 }
 
+Airspace::Details& Airspace::GetDetails() {
+	if (!details) details.reset(new Details());
+	return *details;
+}
+
 std::string Airspace::GetTransponderCode() const {
 	std::ostringstream ss;
-	ss << std::setw(4) << std::setfill('0') << std::oct << transponderCode;
+	ss << std::setw(4) << std::setfill('0') << std::oct << (details ? details->transponderCode : -1);
 	return ss.str();
 }
 
 bool Airspace::GuessClassFromName() {
 	if (type != CTR && type != TMA && type != UNDEFINED) return false;
-	if (name.empty()) return false;
+	if (name.IsEmpty()) return false;
+	std::string name(this->name.Get()); // work on a copy, the interned one is immutable
 	Type foundClass = UNDEFINED;
 	const static std::vector<std::string> keywords = {
 		"Airspace class",
@@ -316,10 +347,12 @@ bool Airspace::GuessClassFromName() {
 	// Remove the eventual dash
 	if (name.length() >=3 && name.compare(name.length() - 3, 3, " - ") == 0) name.erase(name.length() - 3, 3);
 
+	this->name = name;
 	return true;
 }
 
 bool Airspace::NameStartsWithIdent(const std::string& ident) {
+	const std::string& name(this->name.Get());
 	if(name.length() < 4 || ident.length() < 4) return false;
 	return(ident.find(name.substr(0,4)) != std::string::npos);
 }
@@ -327,10 +360,9 @@ bool Airspace::NameStartsWithIdent(const std::string& ident) {
 void Airspace::Clear() {
 	type = UNDEFINED;
 	airspaceClass = UNDEFINED;
-	name.clear();
+	name = InternedString();
 	ClearPoints();
-	radioFrequencies.clear();
-	transponderCode = -1;
+	details.reset();
 }
 
 void Airspace::ClearPoints() {
@@ -410,6 +442,27 @@ void Airspace::RemoveTooCloseConsecutivePoints() {
 	}
 }
 
+bool Airspace::RepairSelfIntersections() {
+	size_t first, second;
+	if (!FindSelfIntersection(first, second)) return true;
+	ClearGeometries(); // the points will not follow anymore the original arcs and circles
+	for (size_t attempts = 2 * points.size(); attempts > 0; attempts--) {
+		const size_t numOfSegments = points.size() - 1;
+		if (second == first + 1) points.erase(points.begin() + second); // consecutive segments going back on the same line: remove the vertex in common
+		else if (first == 0 && second == numOfSegments - 1) { // same but on the closing vertex
+			points.pop_back();
+			points.erase(points.begin());
+			points.push_back(points.front());
+		} else if (points[second] == points[first] || points[second] == points[first + 1]) points.erase(points.begin() + second); // touching on a repeated vertex: remove it
+		else if (points[second + 1] == points[first] || points[second + 1] == points[first + 1]) points.erase(points.begin() + (second + 1 < numOfSegments ? second + 1 : first + 1));
+		else std::reverse(points.begin() + first + 1, points.begin() + second + 1); // uncross the two segments reversing the points between them
+		points.erase(std::unique(points.begin(), points.end()), points.end()); // removing a vertex may leave two equal points consecutive
+		if (points.size() < 4) return false;
+		if (!FindSelfIntersection(first, second)) return true;
+	}
+	return false;
+}
+
 bool Airspace::ClosePoints() {
 	// Here we expect at least 3 points
 	if(points.size() < 3) return false;
@@ -536,34 +589,60 @@ bool Airspace::IsWithinLimits(const Geometry::Limits& limits) const {
 	return pointWhithinLimitsFound;
 }
 
-void Airspace::CalculateSurface(double& area, double& perimeter) const {
-#if BOOST_VERSION >= 106700 // Spheroidal
-	// Create geographic polygon
-	boost::geometry::model::polygon<boost::geometry::model::point<double, 2, boost::geometry::cs::geographic<boost::geometry::degree> > > polygon;
-	for (const Geometry::LatLon& point : points) boost::geometry::append(polygon, boost::make_tuple(point.Lon(), point.Lat()));
-
-	// Geographic strategy with WGS84 spheroid (spheroid sizes in Km)
-	static const boost::geometry::strategy::area::geographic<> wgs84(boost::geometry::srs::spheroid<double>(6378.137, 6356.7523142451793));
-
-	// Geographic strategy with Vincenty algorithm
-	//static const boost::geometry::strategy::area::geographic<boost::geometry::model::point<double, 2, boost::geometry::cs::geographic<boost::geometry::degree >>, boost::geometry::formula::vincenty_inverse> vincenty;
-
-	area = std::fabs(boost::geometry::area(polygon, wgs84)); // [Km2]
-	perimeter = boost::geometry::perimeter(polygon) / 1000; // [Km]
-
-#else // Spherical
-	// Create spherical polygon
-	boost::geometry::model::polygon<boost::geometry::model::point<float, 2, boost::geometry::cs::spherical_equatorial<boost::geometry::degree> > > polygon;
-	for (const Geometry::LatLon& point : points) boost::geometry::append(polygon, boost::make_tuple(point.Lon(), point.Lat()));
-	
-	static const double earthRadiusKm = 6371.0088;
-	static const double squareEarthRadiusKm = pow(earthRadiusKm,2);
-
-	// Spherical strategy with mean Earth radius in Km
-	//static const boost::geometry::strategy::area::spherical<> sphericalStrategy(earthRadiusKm);
+bool Airspace::ClipToLimits(const Geometry::Limits& limits) {
+	if (std::all_of(points.begin(), points.end(), [&limits](const Geometry::LatLon& p) { return limits.IsPositionWithinLimits(p); })) return !points.empty(); // nothing to cut
+	std::vector<Geometry::LatLon> clipped(points);
+	if (!limits.ClipPolygon(clipped)) return false;
+	SetPoints(std::move(clipped)); // the arcs and circles are not valid anymore
+	return ClosePoints();
+}
+
+bool Airspace::IsPositionInside(const Geometry::LatLon& position) const {
+	if (geometries.empty()) return Geometry::IsInsidePolygon(points, position);
+
+	// Crossing number on the edges between the geometries and on the chords of the arcs, then each arc adds or removes its circular segment
+	bool inside = false;
+	const Geometry::LatLon* previous = &geometries.back()->GetEndVertex();
+	for (const Geometry* g : geometries) {
+		if (g->IsClosed()) return geometries.size() == 1 ? g->IsInsideCurve(position) : Geometry::IsInsidePolygon(points, position);
+		const Geometry::LatLon& start = g->GetStartVertex();
+		const Geometry::LatLon& end = g->GetEndVertex();
+		if (Geometry::IsCrossingRay(*previous, start, position)) inside = !inside;
+		if (Geometry::IsCrossingRay(start, end, position)) inside = !inside;
+		if (g->IsInsideCurve(position)) inside = !inside;
+		previous = &end;
+	}
+	return inside;
+}
 
-	//area = std::fabs(boost::geometry::area(polygon, sphericalStrategy));
-	area = std::fabs(boost::geometry::area(polygon)) * squareEarthRadiusKm; // [Km2]
-	perimeter = (double)boost::geometry::perimeter(polygon) * earthRadiusKm; // [Km]
-#endif
+void Airspace::CalculateSurface(double& area, double& perimeter) const {
+	// Area as spherical excess of the polygon on the authalic sphere, so with the same surface of the WGS84 ellipsoid
+	// Perimeter as sum of the distances on the ellipsoid with the Andoyer-Lambert formula
+	area = 0;
+	perimeter = 0;
+	if (points.size() < 2) return;
+	double excess = 0;
+	double prevLat = points.back().Lat() * Geometry::DEG2RAD, prevLon = points.back().Lon() * Geometry::DEG2RAD;
+	double prevSinLat = std::sin(prevLat), prevCosLat = std::cos(prevLat);
+	double prevTanHalfBeta = std::tan(std::asin(AuthalicQ(prevSinLat) / AUTHALIC_QP) / 2);
+	for (const Geometry::LatLon& point : points) {
+		const double lat = point.Lat() * Geometry::DEG2RAD, lon = point.Lon() * Geometry::DEG2RAD;
+		const double sinLat = std::sin(lat), cosLat = std::cos(lat);
+		const double tanHalfBeta = std::tan(std::asin(AuthalicQ(sinLat) / AUTHALIC_QP) / 2);
+		double dLon = lon - prevLon;
+		if (dLon > Geometry::PI) dLon -= Geometry::TWO_PI;
+		else if (dLon < -Geometry::PI) dLon += Geometry::TWO_PI;
+
+		// Excess of the triangle made by the edge with the pole
+		excess += 2 * std::atan2(std::tan(dLon / 2) * (prevTanHalfBeta + tanHalfBeta), 1 + prevTanHalfBeta * tanHalfBeta);
+
+		// Length of the edge, the closing one is zero if the polygon is already closed
+		if (lat != prevLat || lon != prevLon) perimeter += AndoyerDistance(prevSinLat, prevCosLat, sinLat, cosLat, dLon);
+		prevLat = lat;
+		prevLon = lon;
+		prevSinLat = sinLat;
+		prevCosLat = cosLat;
+		prevTanHalfBeta = tanHalfBeta;
+	}
+	area = std::fabs(excess) * AUTHALIC_R2; // [Km2]
 }
@@ -13,11 +13,13 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <memory>
 #include "Geometry.h"
+#include "InternedString.h"
 
 class Altitude {
 public:
-	Altitude() : refIsMsl(false), fl(0), altFt(0), altMt(0), isUnlimited(false) {}
+	Altitude() : altMt(0), fl(0), altFt(0), refIsMsl(false), isUnlimited(false) {}
 	//Altitude(const int feet, const bool isAMSL) : refIsMsl(isAMSL), fl(0), altFt(feet), altMt(feet * FEET2METER), isUnlimited(false) {}
 	//Altitude(const double meters, const bool isAMSL) : refIsMsl(isAMSL), fl(0), altFt((int)(meters / FEET2METER)), altMt(meters), isUnlimited(false) {}
 	//Altitude(const int FL);
@@ -30,6 +32,7 @@ public:
 	inline bool IsAMSL() const { return refIsMsl; }
 	inline bool IsAGL() const { return !refIsMsl; }
 	inline bool IsFL() const { return fl != 0; }
+	inline int GetFlightLevel() const { return fl; }
 	inline bool IsUnlimited() const { return isUnlimited; }
 	inline int GetAltFt() const { return altFt; }
 	inline double GetAltMt() const { return altMt; }
@@ -52,10 +55,10 @@ private:
 	static double StaticPressureToQNHaltitude(const double ps);
 	static double QNEaltitudeToQNHaltitude(const double ps);
 
-	bool refIsMsl;
+	double altMt; // Alt in meters
 	int fl; // Flight level
 	int altFt; // Alt in feet
-	double altMt; // Alt in meters
+	bool refIsMsl; // the flags at the end to avoid padding
 	bool isUnlimited;
 	static const double K1, K2, QNE;
 	static double QNH;
@@ -91,7 +94,7 @@ public:
 		UNDEFINED // also the last one
 	} Type;
 
-	Airspace() : type(UNDEFINED), airspaceClass(UNDEFINED), transponderCode(-1) {}
+	Airspace() : type(UNDEFINED), airspaceClass(UNDEFINED) {}
 	Airspace(Type category);
 	Airspace(const Airspace& orig);
 	Airspace(Airspace&& orig);
@@ -109,7 +112,7 @@ public:
 	inline void SetBaseAltitude(const Altitude& alt) { base = alt; }
 	inline void SetName(const std::string& airspaceName) { name = airspaceName; }
 	bool SetTransponderCode(const std::string& code);
-	void AddRadioFrequency(const int frequencyHz, const std::string& description);
+	void AddRadioFrequency(const int frequencyHz, const InternedString& description);
 	void Clear(); // Clear name, type, points and geometries
 	void ClearPoints(); // Clear points and geometries
 	void ClearGeometries(); // Clear geometries only
@@ -119,15 +122,19 @@ public:
 	bool ClosePoints();
 	bool ArePointsValid() const;
 	void RemoveTooCloseConsecutivePoints();
+	inline bool FindSelfIntersection(size_t& first, size_t& second) const { return Geometry::FindSelfIntersection(points, first, second); } // indexes of the first points of the two segments
+	bool RepairSelfIntersections();
 	bool Undiscretize();
 	bool IsWithinLimits(const Geometry::Limits& limits) const;
+	bool ClipToLimits(const Geometry::Limits& limits); // false if nothing remains
 	inline void CutPointsFrom(Airspace& orig) { points = std::move(orig.points); }
+	inline void SetPoints(std::vector<Geometry::LatLon>&& newPoints) { ClearGeometries(); points = std::move(newPoints); } // points only, as read
 	inline const Type& GetType() const { return type; }
 	inline const Type& GetClass() const { return airspaceClass; }
 	inline const std::string& GetCategoryName() const { return CategoryName(type); }
 	inline const Altitude& GetTopAltitude() const { return top; }
 	inline const Altitude& GetBaseAltitude() const { return base; }
-	inline const std::string& GetName() const { return name; }
+	inline const std::string& GetName() const { return name.Get(); }
 	inline size_t GetNumberOfGeometries() const { return geometries.size(); }
 	inline const Geometry* GetGeometryAt(size_t i) { return i < geometries.size() ? geometries.at(i) : nullptr; }
 	inline const std::vector<Geometry::LatLon>& GetPoints() const { return points; }
@@ -140,25 +147,34 @@ public:
 	inline bool IsAGLtopped() const { return top.IsAGL(); }
 	inline bool IsAMSLtopped() const { return top.IsAMSL(); }
 	inline bool IsVisibleByDefault() const { return CategoryVisibleByDefault(type); }
-	inline size_t GetNumberOfRadioFrequencies() const { return radioFrequencies.size(); }
-	inline const std::pair<int, std::string>& GetRadioFrequencyAt(size_t pos) const { return radioFrequencies.at(pos); }
+	inline size_t GetNumberOfRadioFrequencies() const { return details ? details->radioFrequencies.size() : 0; }
+	inline const std::pair<int, InternedString>& GetRadioFrequencyAt(size_t pos) const { return (details ? details->radioFrequencies : NO_FREQUENCIES).at(pos); }
 	std::string GetTransponderCode() const;
-	inline bool HasTransponderCode() const { return transponderCode >= 0; }
+	inline bool HasTransponderCode() const { return details && details->transponderCode >= 0; }
 	void CalculateSurface(double& areaKm2, double& perimeterKm) const;
+	bool IsPositionInside(const Geometry::LatLon& position) const; // only horizontally, with the exact curves when the geometries are available
 
 private:
 	bool AddPointGeometryOnly(const Geometry::LatLon& point);
 	void EvaluateAndAddArc(std::vector<Geometry::LatLon*>& arcPoints, std::vector<std::pair<const double, const double>>& centerPoints, const bool& clockwise);
 	void EvaluateAndAddCircle(const std::vector<Geometry::LatLon*>& arcPoints, const std::vector<std::pair<const double, const double>>& centerPoints);
 
+	// Cold data, only few airspaces have it: allocated apart when needed to keep the airspaces small for the passes on their geometry
+	struct Details {
+		Details() : transponderCode(-1) {}
+		std::vector<std::pair<int,InternedString>> radioFrequencies; // Radio frequencies list values expressed in [Hz] and name/description
+		short transponderCode; // Transponder code mandated for this airspace 12 bits used (OCT:7777 = DEC:4095 = BIN:1111111111)
+	};
+	Details& GetDetails();
+
 	static const std::string CATEGORY_NAMES[];
 	static const bool CATEGORY_VISIBILITY[];
-	Altitude top, base;
-	std::vector<const Geometry*> geometries;
+	static const std::vector<std::pair<int,InternedString>> NO_FREQUENCIES;
 	std::vector<Geometry::LatLon> points;
+	Altitude top, base;
 	Type type;
 	Type airspaceClass; // This is to remember the class of a TMA or CTR where possible
-	std::string name;
-	std::vector<std::pair<int,std::string>> radioFrequencies; // Radio frequencies list values expressed in [Hz] and name/description
-	short transponderCode; // Transponder code mandated for this airspace 12 bits used (OCT:7777 = DEC:4095 = BIN:1111111111)
+	InternedString name; // just a handle, the text is in the pool of the interned strings
+	std::vector<const Geometry*> geometries;
+	std::unique_ptr<Details> details;
 };
@@ -20,6 +20,13 @@
 #include "OpenAIP.h"
 #include "Polish.h"
 #include "CSV.h"
+#include "GeoJSON.h"
+#include "ACB.h"
+#include "VectorTiles.h"
+#include "Conflicts.h"
+#include "Regions.h"
+#include "Parallel.h"
+#include "Keywords.h"
 #include <iostream>
 #include <locale>
 #include <sstream>
@@ -28,6 +35,11 @@
 #include <cmath>
 #include <map>
 #include <tuple>
+#include <algorithm>
+#include <mutex>
+#ifndef _WIN32
+#include <sys/wait.h>
+#endif
 #include <boost/filesystem.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/format.hpp>
@@ -73,13 +85,20 @@ const std::vector<std::string> AirspaceConverter::disclaimer = {
 
 std::vector<RasterMap*> AirspaceConverter::terrainMaps;
 double AirspaceConverter::defaultTerrainAltitudeMt = 20;
+const double AirspaceConverter::waypointsMergeToleranceMt = 500; // the same airfield may be placed on a different point of it by different sources
 
 const std::string AirspaceConverter::cGPSmapperCommand = Detect_cGPSmapperPath();
+std::string AirspaceConverter::cGPSmapperPipeCommand;
 
 
 AirspaceConverter::AirspaceConverter() :
 	conversionDone(false),
-	processLineStrings(false) {
+	processLineStrings(false),
+	mergeWaypoints(false),
+	clipAirspaces(false),
+	numOfJobs(0),
+	kmzTileSize(0),
+	polishLevelTolerances(Polish::DEFAULT_LEVEL_TOLERANCES) {
 }
 
 AirspaceConverter::~AirspaceConverter() {
@@ -99,6 +118,21 @@ void AirspaceConverter::DefaultLogError(const std::string& text) {
 	std::cerr << "ERROR: " << text << std::endl;
 }
 
+AirspaceConverter::SerializedLog::SerializedLog() :
+	message(LogMessage),
+	warning(LogWarning),
+	error(LogError) {
+	LogMessage = [this](const std::string& text) { std::lock_guard<std::mutex> lock(mutex); message(text); };
+	LogWarning = [this](const std::string& text) { std::lock_guard<std::mutex> lock(mutex); warning(text); };
+	LogError = [this](const std::string& text) { std::lock_guard<std::mutex> lock(mutex); error(text); };
+}
+
+AirspaceConverter::SerializedLog::~SerializedLog() {
+	LogMessage = message;
+	LogWarning = warning;
+	LogError = error;
+}
+
 const std::string AirspaceConverter::Detect_cGPSmapperPath() {
 #ifdef __linux__ // If on Linux...
 	if (boost::filesystem::exists("/usr/bin/cgpsmapper")) return "cgpsmapper"; // Check the default installation path then use the "cgpsmapper" command
@@ -119,15 +153,22 @@ bool AirspaceConverter::Default_cGPSmapper(const std::string& polishFile, const
 	//TODO: add arguments to create files also for other software like Garmin BaseCamp
 	const std::string cmd(boost::str(boost::format("%1s \"%2s\" -o \"%3s\"") %cGPSmapperCommand %polishFile %outputFile));
 	LogMessage("Executing: " + cmd);
-	if(system(cmd.c_str()) == EXIT_SUCCESS) {
+	int exitCode = system(cmd.c_str());
+	if(exitCode == EXIT_SUCCESS) {
 		std::remove(polishFile.c_str()); // Delete polish file
 		return true;
 	}
-
-	LogError("returned by cGPSmapper.");
+#ifndef _WIN32
+	exitCode = WIFEXITED(exitCode) ? WEXITSTATUS(exitCode) : -1; // -1 if terminated by a signal
+#endif
+	LogError(boost::str(boost::format("returned by cGPSmapper, exit code %1d, making: %2s") %exitCode %outputFile));
 	return false;
 }
 
+std::string AirspaceConverter::Make_cGPSmapperPipeCommand(const std::string& outputFile) {
+	return boost::str(boost::format("%1s \"%2s\"") %cGPSmapperPipeCommand %outputFile);
+}
+
 std::istream& AirspaceConverter::SafeGetline(std::istream& is, std::string& line, bool& isCRLF) {
 	line.clear();
 	std::istream::sentry se(is, true);
@@ -169,6 +210,9 @@ AirspaceConverter::OutputType AirspaceConverter::DetermineType(const std::string
 		else if (boost::iequals(outputExt, ".mp")) outputType = OutputType::Polish_Format;
 		else if (boost::iequals(outputExt, ".img")) outputType = OutputType::Garmin_Format;
 		else if (boost::iequals(outputExt, ".csv")) outputType = OutputType::CSV_Format;
+		else if (boost::iequals(outputExt, ".geojson") || boost::iequals(outputExt, ".json")) outputType = OutputType::GeoJSON_Format;
+		else if (GeoJSON::IsNewlineDelimited(filename)) outputType = OutputType::NDJSON_Format;
+		else if (boost::iequals(outputExt, ".acb")) outputType = OutputType::ACB_Format;
 		else outputType = OutputType::Unknown_Format;
 	}
 	return outputType;
@@ -196,6 +240,15 @@ bool AirspaceConverter::PutTypeExtension(const OutputType type, std::string& fil
 	case OutputType::Garmin_Format:
 		outputPath.replace_extension(".img");
 		break;
+	case OutputType::GeoJSON_Format:
+		outputPath.replace_extension(".geojson");
+		break;
+	case OutputType::NDJSON_Format:
+		outputPath.replace_extension(".ndjson");
+		break;
+	case OutputType::ACB_Format:
+		outputPath.replace_extension(".acb");
+		break;
 	default:
 		assert(false);
 		/* no break */
@@ -206,24 +259,62 @@ bool AirspaceConverter::PutTypeExtension(const OutputType type, std::string& fil
 	return true;
 }
 
+std::vector<std::string> AirspaceConverter::ListAirspaceFiles() const {
+	// The directories are replaced by the airspace files they contain
+	std::vector<std::string> inputFiles;
+	for (const std::string& inputFile : airspaceFiles) {
+		if (!boost::filesystem::is_directory(inputFile)) {
+			inputFiles.push_back(inputFile);
+			continue;
+		}
+		std::vector<std::string> directoryFiles;
+		for (boost::filesystem::directory_iterator itr(inputFile); itr != boost::filesystem::directory_iterator(); ++itr) {
+			const std::string ext(itr->path().extension().string());
+			if (boost::filesystem::is_regular_file(itr->status()) && (boost::iequals(ext, ".txt") || boost::iequals(ext, ".aip") || boost::iequals(ext, ".kmz") || boost::iequals(ext, ".kml") || boost::iequals(ext, ".acb")))
+				directoryFiles.push_back(itr->path().string());
+		}
+		if (directoryFiles.empty()) LogWarning("No airspace files found in directory: " + inputFile);
+		std::sort(directoryFiles.begin(), directoryFiles.end());
+		inputFiles.insert(inputFiles.end(), directoryFiles.begin(), directoryFiles.end());
+	}
+	return inputFiles;
+}
+
+bool AirspaceConverter::ReadAirspaceFile(const std::string& inputFile, const std::function<void(Airspace&)>& handler /* = nullptr */) {
+	const std::string ext(boost::filesystem::path(inputFile).extension().string());
+	if (boost::iequals(ext, ".txt")) {
+		OpenAir openAir(airspaces);
+		if (handler) openAir.StreamAirspaces(handler);
+		openAir.Read(inputFile);
+	} else if (boost::iequals(ext, ".aip")) {
+		OpenAIP openAIP(airspaces, waypoints);
+		if (handler) openAIP.StreamAirspaces(handler);
+		openAIP.ReadAirspaces(inputFile);
+	} else if (boost::iequals(ext, ".kmz") || boost::iequals(ext, ".kml")) {
+		KML kml(airspaces, waypoints);
+		if (handler) kml.StreamAirspaces(handler);
+		kml.ProcessLineStrings(processLineStrings);
+		if (boost::iequals(ext, ".kmz")) kml.ReadKMZ(inputFile);
+		else kml.ReadKML(inputFile);
+	} else if (boost::iequals(ext, ".acb")) {
+		ACB acb(airspaces);
+		if (handler) acb.StreamAirspaces(handler);
+		acb.Read(inputFile);
+	} else {
+		LogWarning("Unknown extension for airspace file: " + inputFile);
+		return false;
+	}
+	return true;
+}
+
 void AirspaceConverter::LoadAirspaces(const OutputType suggestedTypeForOutputFilename /* = OutputType::KMZ_Format */) {
 	if (airspaceFiles.empty()) return;
 	conversionDone = false;
-	OpenAir openAir(airspaces);
-	OpenAIP openAIP(airspaces, waypoints);
-	KML kml(airspaces, waypoints);
-	kml.ProcessLineStrings(processLineStrings);
 	const size_t initialAirspacesNumber = airspaces.size(); // Airspaces originally already loaded
-	for (const std::string& inputFile : airspaceFiles) {
-		const std::string ext(boost::filesystem::path(inputFile).extension().string());
-		if(boost::iequals(ext, ".txt")) openAir.Read(inputFile);
-		else if (boost::iequals(ext, ".aip")) openAIP.ReadAirspaces(inputFile);
-		else if (boost::iequals(ext, ".kmz")) kml.ReadKMZ(inputFile);
-		else if (boost::iequals(ext, ".kml")) kml.ReadKML(inputFile);
-		else {
-			LogWarning("Unknown extension for airspace file: " + inputFile);
-			continue;
-		}
+
+	const std::vector<std::string> inputFiles(ListAirspaceFiles());
+	for (const std::string& inputFile : inputFiles) {
+		if (!ReadAirspaceFile(inputFile)) continue;
 
 		// Set (suggest) the output file name if still not defined by the user
 		if (airspaces.size() > initialAirspacesNumber && outputFile.empty()) switch (suggestedTypeForOutputFilename) {
@@ -241,9 +332,18 @@ void AirspaceConverter::LoadAirspaces(const OutputType suggestedTypeForOutputFil
 				break;
 			case OutputType::Garmin_Format:
 				outputFile = boost::filesystem::path(inputFile).replace_extension(".img").string();
+				break;
+			case OutputType::GeoJSON_Format:
+				outputFile = boost::filesystem::path(inputFile).replace_extension(".geojson").string();
+				break;
+			case OutputType::NDJSON_Format:
+				outputFile = boost::filesystem::path(inputFile).replace_extension(".ndjson").string();
+				break;
+			case OutputType::ACB_Format:
+				outputFile = boost::filesystem::path(inputFile).replace_extension(".acb").string();
 		}
 	}
-	LogMessage(boost::str(boost::format("Read %1d airspace definition(s) from %2d file(s).") %(airspaces.size() - initialAirspacesNumber) %airspaceFiles.size()));
+	LogMessage(boost::str(boost::format("Read %1d airspace definition(s) from %2d file(s).") %(airspaces.size() - initialAirspacesNumber) %inputFiles.size()));
 	airspaceFiles.clear();
 }
 
@@ -259,7 +359,10 @@ void AirspaceConverter::LoadTerrainRasterMaps() {
 	int counter = 0;
 	for (const std::string& demFile : terrainRasterMapFiles) if (AddTerrainMap(demFile)) counter++;
 	terrainRasterMapFiles.clear();
-	if (counter > 0) LogMessage(boost::str(boost::format("Read successfully %1d terrain raster map file(s).") % counter));
+	if (counter > 0) {
+		LogMessage(boost::str(boost::format("Read successfully %1d terrain raster map file(s).") % counter));
+		CorrectWaypointsAltitude(true); // in case waypoints were loaded before the maps
+	}
 }
 
 void AirspaceConverter::UnloadRasterMaps() {
@@ -271,11 +374,13 @@ void AirspaceConverter::LoadWaypoints() {
 	if (waypointFiles.empty()) return;
 	conversionDone = false;
 	int counter = 0;
-	const size_t wptCounter = waypoints.size();
+	const size_t wptCounter = waypoints.Size();
 	SeeYou cu(waypoints);
 	CSV csv(waypoints);
 	OpenAIP openAIP(airspaces, waypoints);
+	std::vector<WaypointSet::Mark> sources(1, WaypointSet::Mark()); // where each file starts, the waypoints already loaded are the first source
 	for (const std::string& inputFile : waypointFiles) {
+		sources.push_back(waypoints.GetMark());
 		bool readOk(false);
 		const std::string ext(boost::filesystem::path(inputFile).extension().string());
 		if(boost::iequals(ext, ".cup")) readOk = cu.Read(inputFile);
@@ -289,13 +394,19 @@ void AirspaceConverter::LoadWaypoints() {
 		if (readOk && outputFile.empty()) outputFile = boost::filesystem::path(inputFile).replace_extension(".kmz").string(); // Default output as KMZ
 	}
 	waypointFiles.clear();
-	if (counter > 0) LogMessage(boost::str(boost::format("Read successfully %1d waypoint(s) from %2d file(s).") % (waypoints.size() - wptCounter) %counter));
+	if (counter > 0) LogMessage(boost::str(boost::format("Read successfully %1d waypoint(s) from %2d file(s).") % (waypoints.Size() - wptCounter) %counter));
+	if (mergeWaypoints && counter > 0) {
+		const size_t merged = waypoints.MergeDuplicates(waypointsMergeToleranceMt, sources);
+		if (merged > 0) LogMessage(boost::str(boost::format("Merged %1d duplicated waypoint(s), remaining: %2d") %merged %waypoints.Size()));
+	}
+	CorrectWaypointsAltitude();
+	waypointIndex.Build(waypoints);
 }
 
 void AirspaceConverter::UnloadWaypoints() {
 	conversionDone = false;
-	for (const std::pair<const int, Waypoint*>& wpt : waypoints) delete wpt.second;
-	waypoints.clear();
+	waypointIndex.Clear();
+	waypoints.Clear();
 	if (airspaces.empty()) outputFile.clear();
 }
 
@@ -323,8 +434,8 @@ void AirspaceConverter::ClearTerrainMaps() {
 	terrainMaps.clear();
 }
 
-bool AirspaceConverter::GetTerrainAltitudeMt(const double& lat, const double& lon, double& alt) {
-	if (terrainMaps.empty()) return false; // no maps no party...
+const RasterMap* AirspaceConverter::FindTerrainMap(const double& lat, const double& lon) {
+	if (terrainMaps.empty()) return nullptr; // no maps no party...
 	const RasterMap* bestMap = terrainMaps.front();
 	if (terrainMaps.size() > 1)
 	{
@@ -337,7 +448,7 @@ bool AirspaceConverter::GetTerrainAltitudeMt(const double& lat, const double& lo
 				results.insert(std::pair<double, const RasterMap*>(stepSize, pTerreinMap)); // maps indexed on resolution
 			}
 		}
-		if (results.empty()) return false; // no results, the party is over ...
+		if (results.empty()) return nullptr; // no results, the party is over ...
 		if (results.size() == 1) bestMap = results.begin()->second; // only one, so that's easy
 		else {
 			double minLatDiff = 90; // to find a latitude difference more than 90 degrees should be quite challenging...
@@ -353,6 +464,12 @@ bool AirspaceConverter::GetTerrainAltitudeMt(const double& lat, const double& lo
 		}
 		assert(bestMap->PointIsInTerrainRange(lat, lon));
 	}
+	return bestMap;
+}
+
+bool AirspaceConverter::GetTerrainAltitudeMt(const double& lat, const double& lon, double& alt) {
+	const RasterMap* bestMap = FindTerrainMap(lat, lon);
+	if (bestMap == nullptr) return false;
 	short altMt;
 	if (bestMap->GetTerrainHeight(lat, lon, altMt)) {
 		alt = altMt;
@@ -361,52 +478,311 @@ bool AirspaceConverter::GetTerrainAltitudeMt(const double& lat, const double& lo
 	return false;
 }
 
+void AirspaceConverter::CorrectWaypointsAltitude(const bool newTerrainMaps /* = false */) {
+	if (terrainMaps.empty() || waypoints.IsEmpty()) return;
+
+	// Collect the waypoints to be verified: unknown and normal waypoints are skipped, they may be also not on the ground
+	// The ones already not found in the terrain maps are checked again only if other maps have been loaded meanwhile
+	struct ElevationJob {
+		Waypoint* waypoint;
+		const RasterMap* map;
+		double row; // position on the map, used only to sort the jobs
+		bool found;
+		short terrainAlt;
+	};
+	std::vector<ElevationJob> jobs;
+	for (int t = Waypoint::normal + 1; t < Waypoint::numOfWaypointTypes; t++) {
+		for (Waypoint& w : waypoints.GetBucket((Waypoint::WaypointType)t)) {
+			if (w.GetElevationStatus() == Waypoint::elevationVerified || (w.IsElevationUnverifiable() && !newTerrainMaps)) continue;
+			const ElevationJob job = { &w, FindTerrainMap(w.GetLatitude(), w.GetLongitude()), 0, false, 0 };
+			jobs.push_back(job);
+		}
+	}
+	if (jobs.empty()) return;
+
+	// Look up the terrain in map and row order, so consecutive lookups hit the same area of the same map
+	std::vector<size_t> order(jobs.size());
+	for (size_t i = 0; i < order.size(); i++) {
+		order[i] = i;
+		ElevationJob& job = jobs[i];
+		if (job.map != nullptr) job.row = std::floor((job.map->GetTop() - job.waypoint->GetLatitude()) / job.map->GetStepSize());
+	}
+	std::sort(order.begin(), order.end(), [&jobs](const size_t a, const size_t b) {
+		const ElevationJob& ja = jobs[a];
+		const ElevationJob& jb = jobs[b];
+		if (ja.map != jb.map) return ja.map < jb.map;
+		if (ja.row != jb.row) return ja.row < jb.row;
+		return ja.waypoint->GetLongitude() < jb.waypoint->GetLongitude();
+	});
+	Parallel::For(order.size(), [&jobs, &order](const size_t begin, const size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			ElevationJob& job = jobs[order[i]];
+			if (job.map != nullptr) job.found = job.map->GetTerrainHeight(job.waypoint->GetLatitude(), job.waypoint->GetLongitude(), job.terrainAlt);
+		}
+	}, 1024);
+
+	// Apply the corrections in the original order of the waypoints
+	for (const ElevationJob& job : jobs) {
+		Waypoint& w = *job.waypoint;
+		if (job.found) {
+			const double terrainAlt = job.terrainAlt;
+			if (w.GetElevationStatus() == Waypoint::elevationRead) {
+				const double delta = std::fabs(w.GetAltitude() - terrainAlt);
+				if (terrainAlt > 5 ? delta > 10 : delta > 15) { // Consider bigger threshold if delta > 5 m (maybe it was really intended AMSL)
+					LogWarning(boost::str(boost::format("waypoint %1s: detected altitude difference of: %2g m respect ground, using terrain altitude: %3g m") %w.GetName() %delta %terrainAlt));
+					w.SetAltitude((float)terrainAlt);
+				}
+			} else {
+				if (w.GetElevationStatus() == Waypoint::elevationBlank)
+					LogWarning(boost::str(boost::format("waypoint %1s: blank elevation, using terrain altitude: %2g m") %w.GetName() %terrainAlt));
+				else
+					LogWarning(boost::str(boost::format("waypoint %1s: invalid elevation, using terrain altitude: %2g m") %w.GetName() %terrainAlt));
+				w.SetAltitude((float)terrainAlt);
+			}
+			w.SetElevationStatus(Waypoint::elevationVerified);
+			w.SetElevationUnverifiable(false);
+		} else if (!w.IsElevationUnverifiable()) {
+			w.SetElevationUnverifiable();
+			if (w.GetElevationStatus() == Waypoint::elevationBlank)
+				LogWarning(boost::str(boost::format("waypoint %1s: blank elevation, waypoint out of loaded terrain maps: assuming AMSL") %w.GetName()));
+			else if (w.GetElevationStatus() == Waypoint::elevationInvalid)
+				LogWarning(boost::str(boost::format("waypoint %1s: invalid elevation, waypoint out of loaded terrain maps: assuming AMSL") %w.GetName()));
+		}
+	}
+}
+
 bool AirspaceConverter::Convert() {
 	assert(!outputFile.empty());
-	conversionDone = false;
-	switch (GetOutputType()) {
+	conversionDone = Write(outputFile, airspaces, waypoints);
+	return conversionDone;
+}
+
+bool AirspaceConverter::Write(const std::string& filename, std::multimap<int, Airspace>& airspacesToWrite, WaypointSet& waypointsToWrite) const {
+	bool written = false;
+	switch (DetermineType(filename)) {
 	case OutputType::KMZ_Format:
 		{
-			KML writer(airspaces, waypoints);
-			if (writer.Write(outputFile)) {
-				conversionDone = true;
+			KML writer(airspacesToWrite, waypointsToWrite);
+			writer.SetTileSize(kmzTileSize);
+			if (writer.Write(filename)) {
+				written = true;
 				if(terrainMaps.empty()) LogWarning("no raster terrain map loaded, used default terrain height for all applicable AGL points.");
 				else if(!writer.WereAllAGLaltitudesCovered()) LogWarning("not all AGL altitudes were under coverage of the loaded terrain map(s).");
 			}
 		}
 		break;
 	case OutputType::OpenAir_Format:
-
-		conversionDone = OpenAir(airspaces).Write(outputFile);
+		written = OpenAir(airspacesToWrite).Write(filename);
 		break;
 	case OutputType::SeeYou_Format:
-		conversionDone = SeeYou(waypoints).Write(outputFile);
+		written = SeeYou(waypointsToWrite).Write(filename);
 		break;
 	case OutputType::Polish_Format:
-		conversionDone = Polish().Write(outputFile, airspaces);
+		{
+			Polish writer;
+			writer.SetLevelTolerances(polishLevelTolerances);
+			written = writer.Write(filename, airspacesToWrite);
+		}
 		break;
 	case OutputType::Garmin_Format: // For Garmin IMG will be necessary to call cGPSmapper
 		{
-			// First make the Polish file
-			const std::string polishFile(boost::filesystem::path(outputFile).replace_extension(".mp").string());
+			Polish writer;
+			writer.SetLevelTolerances(polishLevelTolerances);
+
+			// Feed the Polish directly to the command reading it from the pipe, if set, while it is generated
+			if (!cGPSmapperPipeCommand.empty()) {
+				LogMessage("Invoking cGPSmapper to make: " + filename);
+				written = writer.Pipe(Make_cGPSmapperPipeCommand(filename), filename, airspacesToWrite);
+				break;
+			}
+
+			// Otherwise first make the Polish file
+			const std::string polishFile(boost::filesystem::path(filename).replace_extension(".mp").string());
 			LogMessage("Building Polish file: " + polishFile);
-			if(!Polish().Write(polishFile, airspaces)) break;
+			if(!writer.Write(polishFile, airspacesToWrite)) break;
 
 			// Then call cGPSmapper
-			conversionDone = cGPSmapper(polishFile, outputFile);
+			written = cGPSmapper(polishFile, filename);
 		}
 		break;
 	case OutputType::CSV_Format:
-		conversionDone = CSV(waypoints).Write(outputFile);
+		written = CSV(waypointsToWrite).Write(filename);
+		break;
+	case OutputType::GeoJSON_Format:
+	case OutputType::NDJSON_Format:
+		written = GeoJSON(airspacesToWrite, waypointsToWrite).Write(filename);
+		break;
+	case OutputType::ACB_Format:
+		written = ACB(airspacesToWrite).Write(filename);
 		break;
 	default:
 		LogError("Output file extension/type unknown.");
 		assert(false);
 		break;
 	}
+	return written;
+}
+
+bool AirspaceConverter::ConvertRegions(const std::string& regionsFile) {
+	conversionDone = false;
+	if (outputFile.empty()) {
+		LogError("No output file to name the files of the regions after.");
+		return false;
+	}
+	Regions regions;
+	if (!regions.Read(regionsFile)) return false;
+	regions.Assign(airspaces, waypoints, clipAirspaces);
+
+	// Each region in its own file: the name of the output file followed by the one of the region
+	const boost::filesystem::path output(outputFile);
+	const size_t numOfRegions = regions.GetNumOfRegions();
+	std::vector<std::string> files(numOfRegions);
+	for (size_t r = 0; r < numOfRegions; r++) files[r] = (output.parent_path() / (output.stem().string() + "_" + regions.GetRegion(r).name + output.extension().string())).string();
+
+	// The regions are jobs extracted and written in parallel, each one with its own copy of the airspaces: the next one starts as soon as one ends
+	std::vector<std::pair<size_t, size_t>> contents(numOfRegions); // number of airspaces and waypoints
+	std::vector<char> written(numOfRegions, 0);
+	std::vector<double> durations(numOfRegions, 0); // [ms]
+	const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+	{
+		SerializedLog serializedLog; // meanwhile the writers log from different threads
+		Parallel::Schedule(numOfRegions, [&](const size_t r) {
+			const std::chrono::steady_clock::time_point jobStart = std::chrono::steady_clock::now();
+			std::multimap<int, Airspace> regionAirspaces;
+			WaypointSet regionWaypoints;
+			regions.Extract(r, clipAirspaces, regionAirspaces, regionWaypoints);
+			contents[r] = std::make_pair(regionAirspaces.size(), regionWaypoints.Size());
+			if (!regionAirspaces.empty() || !regionWaypoints.IsEmpty()) written[r] = Write(files[r], regionAirspaces, regionWaypoints) ? 1 : 0;
+			durations[r] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - jobStart).count();
+		}, numOfJobs);
+	}
+	const double totalTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+	// Then the report, in the same order of the regions
+	size_t done = 0, failed = 0;
+	double sumOfDurations = 0;
+	for (size_t r = 0; r < numOfRegions; r++) {
+		const std::string& name = regions.GetRegion(r).name;
+		sumOfDurations += durations[r];
+		if (contents[r].first == 0 && contents[r].second == 0) LogWarning("region " + name + " is empty, nothing written");
+		else if (written[r]) {
+			LogMessage(boost::str(boost::format("Region %s: %d airspace(s) and %d waypoint(s) written in %.0f ms in: %s") %name %contents[r].first %contents[r].second %durations[r] %files[r]));
+			done++;
+		} else {
+			LogError(boost::str(boost::format("Unable to write region %s in: %s (after %.0f ms)") %name %files[r] %durations[r]));
+			failed++;
+		}
+	}
+	LogMessage(boost::str(boost::format("Regions: %d written in %.0f ms, up to %d at the same time, %.0f ms one after the other") %done
+		%totalTime %std::min(numOfRegions, (size_t)(numOfJobs > 0 ? numOfJobs : Parallel::GetNumOfThreads())) %sumOfDurations));
+	conversionDone = failed == 0;
+	return conversionDone;
+}
+
+bool AirspaceConverter::ConvertStreaming(const Geometry::Limits& limits /* = Geometry::Limits() */) {
+	const std::vector<std::string> inputFiles(ListAirspaceFiles());
+	if (inputFiles.empty()) {
+		LogError("No input airspace files to convert.");
+		return false;
+	}
+	if (outputFile.empty()) outputFile = boost::filesystem::path(inputFiles.front()).replace_extension(".kmz").string(); // Default output as KMZ
+	conversionDone = false;
+
+	// Prepare the writer: each airspace will be written as soon as it has been read, without keeping it
+	const OutputType outputType = GetOutputType();
+	OpenAir openAirWriter(airspaces);
+	Polish polishWriter;
+	polishWriter.SetLevelTolerances(polishLevelTolerances);
+	KML kmlWriter(airspaces, waypoints);
+	GeoJSON geoJSONwriter(airspaces, waypoints);
+	std::function<void(Airspace&)> write;
+	const std::string polishFile(outputType == OutputType::Garmin_Format ? boost::filesystem::path(outputFile).replace_extension(".mp").string() : outputFile);
+	switch (outputType) {
+	case OutputType::OpenAir_Format:
+		if (!openAirWriter.OpenOutput(outputFile)) return false;
+		write = [&openAirWriter](Airspace& airspace) { openAirWriter.WriteAirspace(airspace); };
+		break;
+	case OutputType::Garmin_Format:
+		if (!cGPSmapperPipeCommand.empty()) {
+			LogMessage("Invoking cGPSmapper to make: " + outputFile);
+			if (!polishWriter.OpenPipe(Make_cGPSmapperPipeCommand(outputFile), outputFile)) return false;
+			write = [&polishWriter](Airspace& airspace) { polishWriter.WriteAirspace(airspace); };
+			break;
+		}
+		LogMessage("Building Polish file: " + polishFile);
+		/* no break */
+	case OutputType::Polish_Format:
+		if (!polishWriter.OpenOutput(polishFile)) return false;
+		write = [&polishWriter](Airspace& airspace) { polishWriter.WriteAirspace(airspace); };
+		break;
+	case OutputType::KMZ_Format:
+		if (!kmlWriter.OpenOutput(outputFile)) return false;
+		write = [&kmlWriter](Airspace& airspace) { kmlWriter.WriteAirspace(airspace); };
+		break;
+	case OutputType::GeoJSON_Format:
+	case OutputType::NDJSON_Format:
+		if (!geoJSONwriter.OpenOutput(outputFile)) return false;
+		write = [&geoJSONwriter](Airspace& airspace) { geoJSONwriter.WriteAirspace(airspace); };
+		break;
+	default:
+		LogError("Streaming conversion possible only to KMZ, OpenAir, Polish, Garmin IMG or GeoJSON.");
+		return false;
+	}
+
+	// Pass each airspace from the readers to the writer, checking the limits if required
+	unsigned long written = 0, excluded = 0;
+	const std::function<void(Airspace&)> stream = [&](Airspace& airspace) {
+		if (limits.IsValid() && !(clipAirspaces ? airspace.ClipToLimits(limits) : airspace.IsWithinLimits(limits))) {
+			excluded++;
+			return;
+		}
+		write(airspace);
+		written++;
+	};
+	for (const std::string& inputFile : inputFiles) ReadAirspaceFile(inputFile, stream);
+	LogMessage(boost::str(boost::format("Converted %1d airspace definition(s) from %2d file(s).") %written %inputFiles.size()));
+	if (limits.IsValid()) LogMessage(boost::str(boost::format("Filtering airspaces... excluded: %1d") %excluded));
+	airspaceFiles.clear();
+
+	// Finalize the output
+	switch (outputType) {
+	case OutputType::OpenAir_Format:
+		conversionDone = openAirWriter.CloseOutput();
+		break;
+	case OutputType::Polish_Format:
+		conversionDone = polishWriter.CloseOutput();
+		break;
+	case OutputType::Garmin_Format:
+		conversionDone = polishWriter.CloseOutput() && (!cGPSmapperPipeCommand.empty() || cGPSmapper(polishFile, outputFile));
+		break;
+	case OutputType::KMZ_Format:
+		conversionDone = kmlWriter.CloseOutput();
+		if (conversionDone) {
+			if(terrainMaps.empty()) LogWarning("no raster terrain map loaded, used default terrain height for all applicable AGL points.");
+			else if(!kmlWriter.WereAllAGLaltitudesCovered()) LogWarning("not all AGL altitudes were under coverage of the loaded terrain map(s).");
+		}
+		break;
+	case OutputType::GeoJSON_Format:
+	case OutputType::NDJSON_Format:
+		conversionDone = geoJSONwriter.CloseOutput();
+		break;
+	default:
+		assert(false);
+		break;
+	}
 	return conversionDone;
 }
 
+bool AirspaceConverter::MakeVectorTiles(const std::string& directory, const int minZoom, const int maxZoom) {
+	assert(!directory.empty());
+	return VectorTiles(airspaces).Write(directory, minZoom, maxZoom);
+}
+
+bool AirspaceConverter::FindConflicts(const std::string& reportFile) {
+	assert(!reportFile.empty());
+	return Conflicts(airspaces).Write(reportFile);
+}
+
 bool AirspaceConverter::ConvertOpenAIPdir(const std::string openAIPdir) {
 	if (openAIPdir.empty()) return false;
 	const boost::filesystem::path openAIPpath(openAIPdir);
@@ -533,10 +909,11 @@ bool AirspaceConverter::ConvertOpenAIPdir(const std::string openAIPdir) {
 	return true;
 }
 
+// Grammar: [value] [unit] [reference] or FL value or GND, SFC, MSL, AMSL, UNLIM, UNLIMITED, UNL
+// where the value is an integer, the unit FT, F, M or MT (default feet) and the reference AMSL, MSL, ALT, AGL, AGND, ASFC, GND or SFC (default AMSL).
+// The tokens are runs of digits or of other characters, separated by spaces or '='; what follows the reference is ignored.
 bool AirspaceConverter::ParseAltitude(const std::string& text, const bool isTop, Airspace& airspace) {
-	if (text.empty()) return false;
-	const std::string::size_type l = text.length();
-	double value = 0;
+	int value = 0;
 	bool isFL = false;
 	bool isAMSL = true;
 	bool valueFound = false;
@@ -544,73 +921,74 @@ bool AirspaceConverter::ParseAltitude(const std::string& text, const bool isTop,
 	bool isInFeet = true;
 	bool unitFound = false;
 	bool isUnlimited = false;
-	std::string::size_type s = 0;
-	bool isNumber = isDigit(text.at(s));
-	for (std::string::size_type i = 1; i < l; i++) {
-		const char c = text.at(i);
-		const bool isLast = (i == l - 1);
-		const bool isSep = (c == ' ' || c == '=');
-		if (isDigit(c) != isNumber || isSep || isLast) {
-			const std::string str = isLast ? text.substr(s) : text.substr(s, i - s);
-			if (isNumber) {
-				if (!valueFound) {
-					try {
-						value = std::stod(str);
-					}
-					catch (...) {
-						return false;
-					}
-					valueFound = true;
+	const char* c = text.c_str();
+	const char* const end = c + text.length();
+	while (c < end && !(valueFound && typeFound && unitFound)) {
+		if (*c == ' ' || *c == '=') {
+			c++;
+			continue;
+		}
+		const char* const begin = c;
+		if (isDigit(*c)) { // Only one value is allowed
+			if (valueFound) return false;
+			long long number = 0;
+			for (; c < end && isDigit(*c); c++) if ((number = number * 10 + (*c - '0')) > 2147483647) return false;
+			value = (int)number;
+			valueFound = true;
+			continue;
+		}
+		while (c < end && !isDigit(*c) && *c != ' ' && *c != '=') c++;
+		if (typeFound) continue;
+		const Keywords::AltitudeKeyword keyword = Keywords::FindAltitudeKeyword(begin, c);
+		if (valueFound) {
+			switch (keyword) {
+			case Keywords::ABOVE_GROUND:
+			case Keywords::GROUND:
+				isAMSL = false;
+				typeFound = true;
+				break;
+			case Keywords::MEAN_SEA_LEVEL:
+			case Keywords::ALTITUDE:
+				typeFound = true;
+				break;
+			case Keywords::FEET:
+				unitFound = true;
+				break;
+			case Keywords::METERS:
+				if (!unitFound) {
+					isInFeet = false;
+					unitFound = true;
 				}
-				else return false;
-			} else {
-				if (!typeFound) {
-					if (valueFound) {
-						if (boost::iequals(str, "AGL") || boost::iequals(str, "AGND") || boost::iequals(str, "ASFC") || boost::iequals(str, "GND") || boost::iequals(str, "SFC")) {
-							isAMSL = false;
-							typeFound = true;
-						} else if (boost::iequals(str, "MSL") || boost::iequals(str, "AMSL") || boost::iequals(str, "ALT")) typeFound = true;
-						else if (!unitFound) {
-							if (boost::iequals(str, "FT") || boost::iequals(str, "F")) unitFound = true;
-							else if (boost::iequals(str, "M") || boost::iequals(str, "MT")) {
-								isInFeet = false;
-								unitFound = true;
-							}
-						}
-					} else {
-						if (boost::iequals(str, "FL")) {
-							isFL = true;
-							typeFound = true;
-						} else if (boost::iequals(str, "GND") || boost::iequals(str, "SFC")) {
-							isAMSL = false;
-							typeFound = true;
-							valueFound = true;
-							unitFound = true;
-						} else if (boost::iequals(str, "MSL") || boost::iequals(str, "AMSL")) {
-							typeFound = true;
-							valueFound = true;
-							unitFound = true;
-						} else if (boost::iequals(str, "UNLIM") || boost::iequals(str, "UNLIMITED") || boost::iequals(str, "UNL")) {
-							typeFound = true;
-							valueFound = true;
-							unitFound = true;
-							isUnlimited = true;
-						}
-					}
-				} else if (!unitFound && !typeFound) return false;
+				break;
+			default:
+				break;
+			}
+		} else {
+			switch (keyword) {
+			case Keywords::FLIGHT_LEVEL:
+				isFL = true;
+				typeFound = true;
+				break;
+			case Keywords::GROUND:
+				isAMSL = false;
+				typeFound = valueFound = unitFound = true;
+				break;
+			case Keywords::MEAN_SEA_LEVEL:
+				typeFound = valueFound = unitFound = true;
+				break;
+			case Keywords::UNLIMITED:
+				typeFound = valueFound = unitFound = isUnlimited = true;
+				break;
+			default:
+				break;
 			}
-			if (valueFound && typeFound && unitFound) break;
-			if (text.at(i) == ' ' || text.at(i) == '=') {
-				if (++i < l) isNumber = isDigit(text.at(i));
-			} else isNumber = !isNumber;
-			s = i;
 		}
 	}
 	if (!valueFound) return false;
 	Altitude alt;
 	if (isUnlimited) alt.SetUnlimited();
-	else if (isFL) alt.SetFlightLevel((int)value);
-	else if (isInFeet) alt.SetAltFt((int)value, isAMSL);
+	else if (isFL) alt.SetFlightLevel(value);
+	else if (isInFeet) alt.SetAltFt(value, isAMSL);
 	else alt.SetAltMt(value, isAMSL);
 	isTop ? airspace.SetTopAltitude(alt) : airspace.SetBaseAltitude(alt);
 	return true;
@@ -678,6 +1056,59 @@ bool AirspaceConverter::CheckNDBfrequency(const double& frequencykHz, int& frequ
 	return true;
 }
 
+unsigned long AirspaceConverter::ValidateAirspaces(const bool repair) {
+	enum Result : unsigned char { VALID, NOT_CLOSED, SELF_INTERSECTING, REPAIRED };
+	std::vector<std::multimap<int, Airspace>::iterator> toCheck;
+	toCheck.reserve(airspaces.size());
+	for (auto it = airspaces.begin(); it != airspaces.end(); ++it) toCheck.push_back(it);
+	std::vector<Result> results(toCheck.size(), VALID);
+	std::vector<std::pair<size_t, size_t>> crossings(toCheck.size());
+
+	// Each airspace is independent from the others, so they can be checked and repaired in parallel
+	Parallel::For(toCheck.size(), [&](const size_t begin, const size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			Airspace& airspace = toCheck[i]->second;
+			if (airspace.GetNumberOfPoints() < 4 || airspace.GetFirstPoint() != airspace.GetLastPoint()) {
+				results[i] = repair && airspace.ClosePoints() && airspace.RepairSelfIntersections() ? REPAIRED : NOT_CLOSED;
+				continue;
+			}
+			if (!airspace.FindSelfIntersection(crossings[i].first, crossings[i].second)) continue;
+			results[i] = repair && airspace.RepairSelfIntersections() ? REPAIRED : SELF_INTERSECTING;
+		}
+	}, 16);
+
+	// Then the report, in the same order of the airspaces
+	unsigned long invalid = 0, repaired = 0;
+	for (size_t i = 0; i < toCheck.size(); i++) {
+		if (results[i] == VALID) continue;
+		invalid++;
+		const Airspace& airspace = toCheck[i]->second;
+		switch (results[i]) {
+		case NOT_CLOSED:
+			LogError("airspace " + airspace.GetName() + " is not a closed polygon of at least 3 points");
+			break;
+		case SELF_INTERSECTING:
+			{
+				const Geometry::LatLon& point = airspace.GetPointAt(crossings[i].first);
+				LogError(boost::str(boost::format("airspace %s is self intersecting: its sides %d and %d cross, the first starting at %.6f %.6f")
+					%airspace.GetName() %(crossings[i].first + 1) %(crossings[i].second + 1) %point.Lat() %point.Lon()));
+			}
+			break;
+		case REPAIRED:
+			LogWarning("airspace " + airspace.GetName() + " was self intersecting or not closed: repaired");
+			repaired++;
+			break;
+		default:
+			assert(false);
+		}
+	}
+
+	// What was not possible to repair can't be written
+	if (repair) for (size_t i = 0; i < toCheck.size(); i++) if (results[i] == NOT_CLOSED || results[i] == SELF_INTERSECTING) airspaces.erase(toCheck[i]);
+	LogMessage(boost::str(boost::format("Validated %d airspace(s): %d invalid") %toCheck.size() %invalid) + (repair ? boost::str(boost::format(", %d repaired and %d removed.") %repaired %(invalid - repaired)) : "."));
+	return invalid;
+}
+
 bool AirspaceConverter::FilterOnLatLonLimits(const double& topLat, const double& bottomLat, const double& leftLon, const double& rightLon) {
 	// Check if it is necessary to filter
 	if (topLat == 90 && bottomLat == -90 && leftLon == -180 && rightLon == 180) return true;
@@ -691,7 +1122,17 @@ bool AirspaceConverter::FilterOnLatLonLimits(const double& topLat, const double&
 	// Filter airspace
 	if (!airspaces.empty()) {
 		const unsigned long origAirspaces(GetNumOfAirspaces());
-		for (std::multimap<int, Airspace>::iterator it = airspaces.begin(); it != airspaces.end(); ) {
+		if (clipAirspaces) {
+			// Cut each airspace on the limits in parallel, then remove the ones remained outside
+			std::vector<std::multimap<int, Airspace>::iterator> toClip;
+			toClip.reserve(airspaces.size());
+			for (auto it = airspaces.begin(); it != airspaces.end(); ++it) toClip.push_back(it);
+			std::vector<char> isInside(toClip.size(), 0);
+			Parallel::For(toClip.size(), [&](const size_t begin, const size_t end) {
+				for (size_t i = begin; i < end; i++) isInside[i] = toClip[i]->second.ClipToLimits(limits) ? 1 : 0;
+			}, 16);
+			for (size_t i = 0; i < toClip.size(); i++) if (!isInside[i]) airspaces.erase(toClip[i]);
+		} else for (std::multimap<int, Airspace>::iterator it = airspaces.begin(); it != airspaces.end(); ) {
 			if ((*it).second.IsWithinLimits(limits)) ++it;
 			else it = airspaces.erase(it);
 		}
@@ -699,16 +1140,10 @@ bool AirspaceConverter::FilterOnLatLonLimits(const double& topLat, const double&
 	}
 
 	// Filter waypoints
-	if (!waypoints.empty()) {
+	if (!waypoints.IsEmpty()) {
 		const unsigned long origWaypoints(GetNumOfWaypoints());
-		for (std::multimap<int, Waypoint*>::iterator it = waypoints.begin(); it != waypoints.end(); ) {
-			Waypoint* w = (*it).second;
-			if (limits.IsPositionWithinLimits(w->GetPosition())) ++it;
-			else {
-				it = waypoints.erase(it);
-				delete(w);
-			}
-		}
+		waypoints.RemoveIf([&limits](const Waypoint& w) { return !limits.IsPositionWithinLimits(w.GetPosition()); });
+		waypointIndex.Build(waypoints);
 		LogMessage(boost::str(boost::format("Filtering waypoints... excluded: %1d, remaining: %2d ") %(origWaypoints - GetNumOfWaypoints()) %GetNumOfWaypoints()));
 	}
 
@@ -730,3 +1165,15 @@ void AirspaceConverter::SetOpenAirCoodinatesInDecimalMinutes() {
 void AirspaceConverter::SetOpenAirCoodinatesInSeconds() {
 	OpenAir::SetCoordinateType(OpenAir::CoordinateType::DEG_MIN_SEC);
 }
+
+bool AirspaceConverter::SetPolishLevelTolerances(const std::vector<double>& tolerancesMt) {
+	if (!Polish::AreValidLevelTolerances(tolerancesMt)) return false;
+	polishLevelTolerances = tolerancesMt;
+	return true;
+}
+
+bool AirspaceConverter::SetKMZTileSize(const double degrees) {
+	if (!KML::IsValidTileSize(degrees)) return false;
+	kmzTileSize = degrees;
+	return true;
+}
@@ -21,9 +21,11 @@
 #include <vector>
 #include <map>
 #include <istream>
+#include <mutex>
+#include "Waypoint.h"
+#include "WaypointIndex.h"
 
 class Airspace;
-class Waypoint;
 class RasterMap;
 
 class AirspaceConverter {
@@ -35,6 +37,9 @@ public:
 		CSV_Format,
 		Polish_Format,
 		Garmin_Format,
+		GeoJSON_Format,
+		NDJSON_Format,
+		ACB_Format,
 		Unknown_Format
 	};
 
@@ -46,11 +51,22 @@ public:
 	static std::function<void(const std::string&)> LogError;
 	static std::function<bool(const std::string&, const std::string&)> cGPSmapper;
 
+	// While alive the log functions are called one at a time, for the readers and the writers logging from different threads
+	class SerializedLog {
+	public:
+		SerializedLog();
+		~SerializedLog();
+	private:
+		std::mutex mutex;
+		const std::function<void(const std::string&)> message, warning, error;
+	};
+
 	inline static void SetLogMessageFunction(std::function<void(const std::string&)> func) { LogMessage = func; }
 	inline static void SetLogWarningFunction(std::function<void(const std::string&)> func) { LogWarning = func; }
 	inline static void SetLogErrorFunction(std::function<void(const std::string&)> func) { LogError = func; }
 	inline static void Set_cGPSmapperFunction(std::function<bool(const std::string&, const std::string&)> func) { cGPSmapper = func; }
-	inline static bool Is_cGPSmapperAvailable() { return !cGPSmapperCommand.empty(); }
+	inline static void Set_cGPSmapperPipeCommand(const std::string& command) { cGPSmapperPipeCommand = command; } // reading the Polish from its standard input, followed by the IMG file; empty to pass cGPSmapper a temporary Polish file
+	inline static bool Is_cGPSmapperAvailable() { return !cGPSmapperCommand.empty() || !cGPSmapperPipeCommand.empty(); }
 	static double FrequencyMHz(const int& frequencyHz) { return 0.000001 * frequencyHz; }
 	static double FrequencykHz(const int& frequencyHz) { return 0.001 * frequencyHz; }
 	static std::istream& SafeGetline(std::istream& is, std::string& line, bool& isCRLF);
@@ -62,7 +78,7 @@ public:
 	static bool CheckAirbandFrequency(const double& frequencyMHz, int& frequencyHz);
 	static bool CheckVORfrequency(const double& frequencyMHz, int& frequencyHz);
 	static bool CheckNDBfrequency(const double& frequencykHz, int& frequencyHz);
-	inline void AddAirspaceFile(const std::string& inputFile) { airspaceFiles.push_back(inputFile); }
+	inline void AddAirspaceFile(const std::string& inputFile) { airspaceFiles.push_back(inputFile); } // or a directory with them
 	inline void AddWaypointFile(const std::string& waypointsFile) { waypointFiles.push_back(waypointsFile); }
 	inline void AddTerrainRasterMapFile(const std::string& rasterMapFile) { terrainRasterMapFiles.push_back(rasterMapFile); }
 	inline int GetNumberOfAirspaceFiles() const { return (int)airspaceFiles.size(); }
@@ -78,24 +94,36 @@ public:
 	static bool AddTerrainMap(const std::string& filename);
 	inline static int GetNumOfTerrainMaps() { return (int)terrainMaps.size(); }
 	static bool GetTerrainAltitudeMt(const double& lat, const double& lon, double& alt);
+	void CorrectWaypointsAltitude(const bool newTerrainMaps = false); // with new maps check again also the waypoints not found in the previous ones
 	static void ClearTerrainMaps();
 	inline static void SetDefaultTerrainAlt(const double& defaultAltMt) { defaultTerrainAltitudeMt = defaultAltMt; }
 	inline static double GetDefaultTerrainAlt() { return defaultTerrainAltitudeMt; }
 	bool Convert();
 	bool ConvertOpenAIPdir(const std::string openAIPdir);
+	bool ConvertStreaming(const Geometry::Limits& limits = Geometry::Limits());
+	bool MakeVectorTiles(const std::string& directory, const int minZoom, const int maxZoom);
+	bool FindConflicts(const std::string& reportFile);
+	bool ConvertRegions(const std::string& regionsFile); // each region in its own output file, named after the output file and the region
+	inline void SetNumOfJobs(const unsigned int jobs) { numOfJobs = jobs; } // regions written at the same time, each one may run its own cGPSmapper; 0 for one for each processor
 	inline bool IsConversionDone() const { return conversionDone; }
 	inline OutputType GetOutputType() const { return DetermineType(outputFile); }
 	inline bool SetOutputType(const OutputType type) { return PutTypeExtension(type, outputFile); }
 	inline void SetOutputFile(const std::string& outputFilename) { outputFile = outputFilename; }
 	inline std::string GetOutputFile() const { return outputFile; }
 	inline unsigned long GetNumOfAirspaces() const { return (unsigned long)airspaces.size(); }
-	inline unsigned long GetNumOfWaypoints() const { return (unsigned long)waypoints.size(); }
+	inline unsigned long GetNumOfWaypoints() const { return (unsigned long)waypoints.Size(); }
+	inline const WaypointIndex& GetWaypointIndex() const { return waypointIndex; }
+	unsigned long ValidateAirspaces(const bool repair); // report the invalid airspaces, if required repair them or remove them, returns how many were invalid
 	bool FilterOnLatLonLimits(const double& topLat, const double& bottomLat, const double& leftLon, const double& rightLon);
 	inline void ProcessTracksAsAirspaces(const bool treatTracksAsAirspaces = true) { processLineStrings = treatTracksAsAirspaces; }
+	inline void MergeDuplicatedWaypoints(const bool mergeDuplicates = true) { mergeWaypoints = mergeDuplicates; } // the same waypoint found in different files
+	inline void ClipAirspacesOnLimits(const bool clip = true) { clipAirspaces = clip; } // cut them instead of keeping the ones partially inside
 	static void DoNotCalculateArcsAndCirconferences(const bool doNotCalcArcs = true);
 	static void SetOpenAirCoodinatesAutomatic();
 	static void SetOpenAirCoodinatesInDecimalMinutes();
 	static void SetOpenAirCoodinatesInSeconds();
+	bool SetPolishLevelTolerances(const std::vector<double>& tolerancesMt); // of the simplified geometries for the higher levels, none for only Data0
+	bool SetKMZTileSize(const double degrees); // split the airspaces of the KMZ in tiles loaded only when visible, 0 for a single document
 
 	static const std::vector<std::string> disclaimer;
 	static const std::string basePath;
@@ -106,14 +134,27 @@ private:
 	static void DefaultLogWarning(const std::string& text);
 	static void DefaultLogError(const std::string& text);
 	static bool Default_cGPSmapper(const std::string& polishFile, const std::string& outputFile);
+	static std::string Make_cGPSmapperPipeCommand(const std::string& outputFile);
 	static const std::string Detect_cGPSmapperPath();
+	static const RasterMap* FindTerrainMap(const double& lat, const double& lon);
+	bool Write(const std::string& filename, std::multimap<int, Airspace>& airspacesToWrite, WaypointSet& waypointsToWrite) const; // with the output settings of this converter, also from more threads
+	std::vector<std::string> ListAirspaceFiles() const; // the input airspace files, with the directories replaced by the files they contain
+	bool ReadAirspaceFile(const std::string& inputFile, const std::function<void(Airspace&)>& handler = nullptr); // false if the extension is unknown; without handler the airspaces are stored
 
 	std::multimap<int, Airspace> airspaces;
-	std::multimap<int, Waypoint*> waypoints;
+	WaypointSet waypoints;
+	WaypointIndex waypointIndex; // spatial index on the waypoints above, to be rebuilt every time they change
 	static std::vector<RasterMap*> terrainMaps;
+	static std::string cGPSmapperPipeCommand;
 	static double defaultTerrainAltitudeMt;
+	static const double waypointsMergeToleranceMt;
 	std::string outputFile;
 	std::vector<std::string> airspaceFiles, terrainRasterMapFiles, waypointFiles;
 	bool conversionDone;
 	bool processLineStrings;
+	bool mergeWaypoints;
+	bool clipAirspaces;
+	unsigned int numOfJobs;
+	double kmzTileSize; // [deg]
+	std::vector<double> polishLevelTolerances; // [m]
 };
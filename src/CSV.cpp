@@ -26,148 +26,26 @@
 #include "CSV.h"
 #include "AirspaceConverter.h"
 #include "Waypoint.h"
-#include "Airfield.h"
 #include "Airspace.h"
 #include "Geometry.h"
+#include "Keywords.h"
+#include "NumberFormat.h"
 #include <fstream>
-#include <iomanip>
 #include <boost/algorithm/string.hpp>
 #include <boost/tokenizer.hpp>
 #include <boost/format.hpp>
 #include <cmath>
 #include <cassert>
 
-CSV::CSV(std::multimap<int,Waypoint*>& waypointsMap):
-	waypoints(waypointsMap) {
+CSV::CSV(WaypointSet& waypointsSet):
+	waypoints(waypointsSet) {
 }
 
 bool CSV::ParseStyle(const std::string& text, int& type) {
-	if (!text.empty()) try {
-		//Airport, Airstrip, Bookmark, DME, Helipad, NDB, TACAN, VOR, VORDME, VORTAC, VRP, Waypoint
-		//LNM2.4.5:Airport,Airstrip,Bookmark,Cabin,Closed,DME,Error,Flag,Helipad,Lighthouse,Location,Logbook,Marker,Mountain,NDB,Obstacle,POI,Pin,Seaport,TACAN,Unknown,VOR,VORDME,VORTAC,VRP,Waypoint
-		/* 0123456789
-			Airport,
-			Airstrip,
-			Bookmark,
-			Cabin,
-			Closed,
-			DME,
-			Error,
-			Flag,
-			Helipad,
-			Lighthouse,
-			Location,
-			Logbook,
-			Marker,
-			Mountain,
-			NDB,
-			Obstacle,
-			POI,
-			Pin,
-			Seaport,
-			TACAN,
-			Unknown,
-			VOR,
-			VORDME,
-			VORTAC,
-			VRP,
-			Waypoint*/
-		//Enum:        0,     1,             2,         3,          4,             5,         6,        7,      8,  9, 10,        11, 12,    13,    14,         15,    16,          17,                18
-		//Enum:UNDEFINED,Normal,Airfield grass,Outlanding,Glider site,Airfield solid,Mount pass,Mount top,Antenna,VOR,NDB,Cool tower,Dam,Tunnel,Bridge,Power plant,Castle,Intersection,
-		//Enum:unknown  ,normal,airfieldGrass ,outlanding,gliderSite ,airfieldSolid ,mtPass    ,mtTop    ,sender ,VOR,NDB,coolTower ,dam,tunnel,bridge,powerPlant ,castle,intersection,numOfWaypointTypes
-		switch(text[0]) {
-			case 'A': // Airport,Airstrip
-				switch(text[3]) {
-					case 'p': type=Waypoint::airfieldSolid; break;
-					case 's': type=Waypoint::airfieldGrass; break;
-					default:
-						AirspaceConverter::LogWarning("point with unknown type: " + text);
-						return false;
-				}
-				break;
-			case 'B': // Bookmark
-				type=Waypoint::unknown; break;
-			case 'C': // Cabin,Closed
-				switch(text[1]) {
-					case 'a': type=Waypoint::unknown; break;
-					case 'l': type=Waypoint::unknown; break;
-					default:
-						AirspaceConverter::LogWarning("point with unknown type: " + text);
-						return false;
-				}
-				break;
-			case 'D': // DME
-				type=Waypoint::unknown; break;
-			case 'E': // Error
-				type=Waypoint::unknown; break;
-			case 'F': // Flag
-				type=Waypoint::unknown; break;
-			case 'H': // Helipad
-				type=Waypoint::unknown; break;
-			case 'L': // Lighthouse,Location,Logbook
-				switch(text[3]) {
-					case 'h': type=Waypoint::unknown; break;
-					case 'a': type=Waypoint::unknown; break;
-					case 'b': type=Waypoint::unknown; break;
-					default:
-						AirspaceConverter::LogWarning("point with unknown type: " + text);
-						return false;
-				}
-				break;
-			case 'M': // Marker,Mountain
-				switch(text[1]) {
-					case 'a': type=Waypoint::unknown; break;
-					case 'o': type=Waypoint::unknown; break;
-					default:
-						AirspaceConverter::LogWarning("point with unknown type: " + text);
-						return false;
-				}
-				break;
-			case 'N': // NDB
-				type=Waypoint::NDB; break;
-			case 'O': // Obstacle
-				type=Waypoint::unknown; break;
-			case 'P': // POI,Pin
-				switch(text[1]) {
-					case 'O': type=Waypoint::unknown; break;
-					case 'i': type=Waypoint::unknown; break;
-					default:
-						AirspaceConverter::LogWarning("point with unknown type: " + text);
-						return false;
-				}
-				break;
-			case 'S': // Seaport
-				type=Waypoint::unknown; break;
-			case 'T': // TACAN
-				type=Waypoint::VOR; break;
-			case 'U': // Unknown
-				type=Waypoint::unknown; break;
-			case 'V': // VOR,VORDME,VORTAC,VRP
-				switch(text[1]) {
-					case 'O': 
-						switch(text[3]) {
-							case '\0': type=Waypoint::VOR; break;
-							case 'D': type=Waypoint::VOR; break;
-							case 'T': type=Waypoint::VOR; break;
-							default:
-								AirspaceConverter::LogWarning("point with unknown type: " + text);
-								return false;
-						}
-						break;
-					case 'R': type=Waypoint::intersection; break;
-					default:
-						AirspaceConverter::LogWarning("point with unknown type: " + text);
-						return false;
-				}
-				break;
-			case 'W': // Waypoint
-				type=Waypoint::castle; break;
-			default:
-				AirspaceConverter::LogWarning("point with unknown type: " + text);
-				return false;
-		} // switch
-		if (type >= Waypoint::unknown && type < Waypoint::numOfWaypointTypes) return true;
-	} catch(...) {}
+	// LNM2.4.5:Airport,Airstrip,Bookmark,Cabin,Closed,DME,Error,Flag,Helipad,Lighthouse,Location,Logbook,Marker,Mountain,NDB,Obstacle,POI,Pin,Seaport,TACAN,Unknown,VOR,VORDME,VORTAC,VRP,Waypoint
+	type = Keywords::FindCSVStyle(text);
+	if (type >= Waypoint::unknown && type < Waypoint::numOfWaypointTypes) return true;
+	if (!text.empty()) AirspaceConverter::LogWarning("point with unknown type: " + text);
 	type = Waypoint::unknown;
 	return false;
 }
@@ -377,8 +255,16 @@ bool CSV::Read(const std::string& fileName) {
 		}
 
 		// Elevation
-		if (!ParseAltitude(boost::trim_copy(*(++token)), altitude)) // check & fix: ParseAltitude()
-			AirspaceConverter::LogWarning(boost::str(boost::format("on line %1d: invalid elevation: %2s, assuming AMSL") %linecount %(*token)));
+		const std::string elevationText(boost::trim_copy(*(++token)));
+		Waypoint::ElevationStatus elevationStatus = Waypoint::elevationRead;
+		if (elevationText.empty()) {
+			altitude = 0;
+			elevationStatus = Waypoint::elevationBlank;
+		} else if (!ParseAltitude(elevationText, altitude)) { // check & fix: ParseAltitude()
+			elevationStatus = Waypoint::elevationInvalid;
+			if (AirspaceConverter::GetNumOfTerrainMaps() == 0)
+				AirspaceConverter::LogWarning(boost::str(boost::format("on line %1d: invalid elevation: %2s, assuming AMSL") %linecount %elevationText));
+		}
 
 		// If it's an airfield...
 		if(Waypoint::IsTypeAirfield((Waypoint::WaypointType)type)) { // check & fix: Waypoint.h:IsTypeAirfield()
@@ -411,17 +297,18 @@ bool CSV::Read(const std::string& fileName) {
 			assert(token != tokens.end());
 
 			// Build the airfield (for now without runway dir and length and radio freq)
-			Airfield* airfield = new Airfield(name, code, country, latitude, longitude, altitude, type, description);
+			Waypoint airfield(name, code, country, latitude, longitude, altitude, type, description);
 #if 0
 			if (altRadioFreq > 0) {
 				assert(radioFreq > 0);
 				if (altRadioFreq == radioFreq) AirspaceConverter::LogWarning(boost::str(boost::format("on line %1d: skipping repeated secondary radio frequency for airfield.") %linecount));
-				else airfield->SetOtherFrequency(altRadioFreq);
+				else airfield.SetOtherFrequency(altRadioFreq);
 			}
 #endif
+			airfield.SetElevationStatus(elevationStatus);
 
-			// Add it to the multimap
-			waypoints.insert(std::pair<int, Waypoint*>(type, (Waypoint*)airfield));
+			// Add it to the waypoints
+			waypoints.Add(std::move(airfield));
 
 		} else { // If it's NOT an airfield...
 			token++; // Skip Declination
@@ -446,14 +333,15 @@ bool CSV::Read(const std::string& fileName) {
 			assert(token != tokens.end());
 
 			// Build the waypoint
-			Waypoint* waypoint = new Waypoint(name, code, country, latitude, longitude, altitude, type, description);
+			Waypoint waypoint(name, code, country, latitude, longitude, altitude, type, description);
 
 #if 0
-			if (radioFreq > 0) waypoint->SetOtherFrequency(radioFreq);
+			if (radioFreq > 0) waypoint.SetOtherFrequency(radioFreq);
 #endif
+			waypoint.SetElevationStatus(elevationStatus);
 
-			// Add it to the multimap
-			waypoints.insert(std::pair<int, Waypoint*>(type, waypoint));
+			// Add it to the waypoints
+			waypoints.Add(std::move(waypoint));
 		}
 
 		// Make sure that at this point we already found a valid waypoint so the header is not anymore expected
@@ -465,7 +353,7 @@ bool CSV::Read(const std::string& fileName) {
 
 // Type,Name,Ident,Lat,Lon,Elev,Decl,Label,Desc,Country,Range,ModificationTime,SourceFile
 bool CSV::Write(const std::string& fileName) {
-	if (waypoints.empty()) {
+	if (waypoints.IsEmpty()) {
 		AirspaceConverter::LogMessage("CSV output: no waypoints, nothing to write");
 		return false;
 	}
@@ -480,10 +368,9 @@ bool CSV::Write(const std::string& fileName) {
 	// LNMv2.4.6 Write default CSV header on first line, and for compatibilty do not write any other comments
 	//file << "Type,Name,Ident,Lat,Lon,Elev,Decl,Label,Desc,Country,Range,ModificationTime,SourceFile\r\n";
 
-	// Go trough all waypoints
-	for (const std::pair<int,Waypoint*>& pair : waypoints) {
-		assert(pair.second != nullptr);
-		const Waypoint& w(*pair.second);
+	// Go trough all waypoints, each line is made in the same buffer
+	std::string line;
+	for (const Waypoint& w : waypoints) {
 
 		// Name is mandatory according to CSV specs
 		if (w.GetName().empty()) {
@@ -521,13 +408,13 @@ bool CSV::Write(const std::string& fileName) {
 				AirspaceConverter::LogWarning(boost::str(boost::format("skipping point with unknown type: %d") % style));
 				continue;
 		}
-		file << type << ',';
+		line.assign(type).append(1, ',');
 
 		// Long name, 'Name' in CSV spec
-		file << w.GetName() << ",";
+		line.append(w.GetName()).append(1, ',');
 
 		// Code "short name", 'Ident' in CSV spec
-		if (!w.GetCode().empty()) file << w.GetCode() << ',';
+		if (!w.GetCode().empty()) line.append(w.GetCode()).append(1, ',');
 
 		// Latitude, 'Lat' in CSV spec, expressed as real DD.MMMMMM
 		int deg, s=0;
@@ -543,8 +430,8 @@ bool CSV::Write(const std::string& fileName) {
 		if (ld==7 && fix==1) min=min-1./3000; // when MM.MM7 AND not an ARF
 		double degDec=s*(deg+min/60);
 		//printf("Lat:%f E=%c S=%d Deg=%d Min=%f ld:%d\n", degDec, e, s, deg, min, ld);
-		file << std::fixed << std::setprecision(6);
-		file << degDec << ',';
+		NumberFormat::AppendFixed(degDec, 6, line);
+		line.append(1, ',');
 
 		// Longitude, 'Lon' in CSV spec, expressed as real DDD.MMMMMM
 		pos.GetLonDegMin(deg,min);
@@ -556,46 +443,59 @@ bool CSV::Write(const std::string& fileName) {
 		if (ld==7 && fix==1) min=min-1./3000; // when MM.MM7 AND not an ARF
 		degDec=s*(deg+min/60);
 		//printf("Lon:%f E=%c S=%d Deg=%d Min=%f ld:%d\n", degDec, e, s, deg, min, ld);
-		file << degDec << ',';
+		NumberFormat::AppendFixed(degDec, 6, line);
+		line.append(1, ',');
 
 		// Altitude, 'Elev' in CSV spec, must be feet without unit to be read by LNM
-		file << std::setprecision(0) << std::round(w.GetAltitude()/0.3048) << ",";
+		NumberFormat::AppendFixed(std::round(w.GetAltitude()/0.3048), 0, line);
+		line.append(1, ',');
 
 		// Declination is ignored by CSV importers, leave empty
-		file << ',';
+		line.append(1, ',');
 
 		// Label/Tag is composed by Dir:N Len:N Freq:N to avoid lost of information
 		if (w.IsAirfield()) {
-			const Airfield& a((const Airfield&)w);
-
 			// Runway direction, miss in CSV spec
-			if (a.HasRunwayDir()) file << "Dir:" << std::setfill('0') << std::setw(3) << a.GetRunwayDir() << " ";
+			if (w.HasRunwayDir()) {
+				line.append("Dir:");
+				NumberFormat::AppendInteger(w.GetRunwayDir(), line, 3);
+				line.append(1, ' ');
+			}
 
 			// Runway length, miss in CSV spec
-			if (a.HasRunwayLength()) file << "Len:" << a.GetRunwayLength() << "m ";
+			if (w.HasRunwayLength()) {
+				line.append("Len:");
+				NumberFormat::AppendInteger(w.GetRunwayLength(), line);
+				line.append("m ");
+			}
 
 			// Radio frequency, miss in CSV spec
-			if (a.HasRadioFrequency()) {
-				file << "Freq:" << std::setprecision(3) << AirspaceConverter::FrequencyMHz(a.GetRadioFrequency()); // 3 decimals for Airports freq [MHz]
-				if (a.HasOtherFrequency()) file << '-' << AirspaceConverter::FrequencyMHz(a.GetOtherFrequency());
+			if (w.HasRadioFrequency()) {
+				line.append("Freq:");
+				NumberFormat::AppendFixed(AirspaceConverter::FrequencyMHz(w.GetRadioFrequency()), 3, line); // 3 decimals for Airports freq [MHz]
+				if (w.HasOtherFrequency()) {
+					line.append(1, '-');
+					NumberFormat::AppendFixed(AirspaceConverter::FrequencyMHz(w.GetOtherFrequency()), 3, line);
+				}
 			}
 		} else {
 			// Other frequency
 			if (w.HasOtherFrequency()) {
-				if (w.GetType() == Waypoint::WaypointType::NDB) file << "Freq:" << std::setprecision(2) << AirspaceConverter::FrequencykHz(w.GetOtherFrequency()); // 2 decimals for NDB freq [kHz]
-				else if (w.GetType() == Waypoint::WaypointType::VOR) file << "Freq:" << std::setprecision(2) << AirspaceConverter::FrequencyMHz(w.GetOtherFrequency()); // 2 decimals for VOR freq [MHz]
-				else file << "Freq:" << std::setprecision(2) << AirspaceConverter::FrequencyMHz(w.GetOtherFrequency()); // assuming all other VHF freq [MHz]
+				line.append("Freq:");
+				if (w.GetType() == Waypoint::WaypointType::NDB) NumberFormat::AppendFixed(AirspaceConverter::FrequencykHz(w.GetOtherFrequency()), 2, line); // 2 decimals for NDB freq [kHz]
+				else if (w.GetType() == Waypoint::WaypointType::VOR) NumberFormat::AppendFixed(AirspaceConverter::FrequencyMHz(w.GetOtherFrequency()), 2, line); // 2 decimals for VOR freq [MHz]
+				else NumberFormat::AppendFixed(AirspaceConverter::FrequencyMHz(w.GetOtherFrequency()), 2, line); // assuming all other VHF freq [MHz]
 			}
 		}
-		file << ',';
+		line.append(1, ',');
 
 		// Description, 'Desc' in CSV spec, redundant for VRP and IRP
 		//if (!w.GetDescription().empty() && w.GetDescription().compare("VFR")!=0 && w.GetDescription().compare("IFR")!=0) file << '"' << w.GetDescription() << '"';
-		if (!w.GetDescription().empty() && w.GetDescription().compare("VFR")!=0 && w.GetDescription().compare("IFR")!=0) file << w.GetDescription();
-		file << ',';
+		if (!w.GetDescription().empty() && w.GetDescription().compare("VFR")!=0 && w.GetDescription().compare("IFR")!=0) line.append(w.GetDescription());
+		line.append(1, ',');
 
 		// Country code
-		file << w.GetCountry() << ',';
+		line.append(w.GetCountry()).append(1, ',');
 
 		// Range is missing in source, leave empty
 		//file << ',';
@@ -605,7 +505,8 @@ bool CSV::Write(const std::string& fileName) {
 
 		// SourceFile is ignored by CSV importers, leave empty
 		//file << ',';
-		file << "\r\n";
+		line.append("\r\n");
+		file.write(line.data(), line.size());
 	}
 
 	file.close();
@@ -13,14 +13,13 @@
 
 #pragma once
 #include <string>
-#include <map>
 
-class Waypoint;
+class WaypointSet;
 
 class CSV {
 
 public:
-	CSV(std::multimap<int,Waypoint*>& waypointsMap);
+	CSV(WaypointSet& waypointsSet);
 	~CSV() {}
 	bool Read(const std::string& fileName);
 	bool Write(const std::string& fileName);
@@ -35,5 +34,5 @@ private:
 	static bool ParseAirfieldFrequencies(const std::string& text, int& mainFreqHz, int& secondaryFreqHz);
 	static bool ParseOtherFrequency(const std::string& text, const int type, int& freqHz);
 
-	std::multimap<int,Waypoint*>& waypoints;
+	WaypointSet& waypoints;
 };
@@ -0,0 +1,198 @@
+//============================================================================
+// AirspaceConverter
+// Since       : 14/6/2016
+// Author      : Alberto Realis-Luc <alberto.realisluc@gmail.com>
+// Web         : https://www.alus.it/AirspaceConverter
+// Repository  : https://github.com/alus-it/AirspaceConverter.git
+// Copyright   : (C) 2016-2021 Alberto Realis-Luc
+// License     : GNU GPL v3
+//
+// This source file is part of AirspaceConverter project
+//============================================================================
+
+#include "Conflicts.h"
+#include "AirspaceConverter.h"
+#include "Airspace.h"
+#include "Parallel.h"
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <cmath>
+#include <algorithm>
+#include <boost/geometry.hpp>
+#include <boost/geometry/geometries/point_xy.hpp>
+#include <boost/geometry/geometries/polygon.hpp>
+#include <boost/geometry/geometries/box.hpp>
+#include <boost/geometry/index/rtree.hpp>
+#include <boost/format.hpp>
+
+namespace bg = boost::geometry;
+namespace bgi = boost::geometry::index;
+
+namespace {
+
+typedef bg::model::d2::point_xy<double> PointXY; // longitude, latitude
+typedef bg::model::polygon<PointXY> Polygon;
+typedef bg::model::box<PointXY> Box;
+typedef std::pair<Box, size_t> IndexEntry;
+
+const double KM_PER_DEGREE = 111.195; // on the mean Earth radius
+
+struct Shape {
+	const Airspace* airspace;
+	Polygon polygon;
+	Box box;
+	bool acrossAntimeridian; // then unwrapped, with the longitudes beyond 180, and its copy one turn before
+	Polygon shiftedPolygon;
+	Box shiftedBox;
+};
+
+double OverlapKm2(const Polygon& a, const Polygon& b) {
+	std::vector<Polygon> overlap;
+	try {
+		bg::intersection(a, b, overlap);
+	} catch (const bg::exception&) { // not valid polygons: see the validation
+		return 0;
+	}
+	double area = 0;
+	for (const Polygon& part : overlap) {
+		if (part.outer().empty()) continue;
+		double minLat = part.outer().front().y(), maxLat = minLat;
+		for (const PointXY& p : part.outer()) {
+			minLat = std::min(minLat, p.y());
+			maxLat = std::max(maxLat, p.y());
+		}
+		area += bg::area(part) * KM_PER_DEGREE * KM_PER_DEGREE * std::cos((minLat + maxLat) * 0.5 * Geometry::DEG2RAD);
+	}
+	return area;
+}
+
+// Two airspaces both across the antimeridian are compared unwrapped, one across with another one both unwrapped and one turn before
+double OverlapKm2(const Shape& a, const Shape& b) {
+	if (a.acrossAntimeridian == b.acrossAntimeridian) return OverlapKm2(a.polygon, b.polygon);
+	const Shape& across = a.acrossAntimeridian ? a : b;
+	const Shape& other = a.acrossAntimeridian ? b : a;
+	return (bg::intersects(across.box, other.box) ? OverlapKm2(across.polygon, other.polygon) : 0)
+		+ (bg::intersects(across.shiftedBox, other.box) ? OverlapKm2(across.shiftedPolygon, other.polygon) : 0);
+}
+
+std::string QuoteCSV(const std::string& text) {
+	if (text.find_first_of(",\"\r\n") == std::string::npos) return text;
+	std::string quoted("\"");
+	for (const char c : text) {
+		if (c == '"') quoted.push_back('"');
+		quoted.push_back(c);
+	}
+	return quoted + '"';
+}
+
+} // namespace
+
+const double Conflicts::MIN_OVERLAP_KM2 = 0.01; // below this the airspaces are only sharing a border
+
+Conflicts::Conflicts(const std::multimap<int, Airspace>& airspacesMap) :
+	airspaces(airspacesMap) {
+}
+
+bool Conflicts::AreVerticallyOverlapping(const Airspace& a, const Airspace& b) {
+	return a.GetBaseAltitude() < b.GetTopAltitude() && b.GetBaseAltitude() < a.GetTopAltitude();
+}
+
+void Conflicts::Find(const bool useIndex /* = true */) {
+	conflicts.clear();
+	std::vector<Shape> shapes;
+	shapes.reserve(airspaces.size());
+	for (const std::pair<const int, Airspace>& a : airspaces) {
+		if (a.second.GetType() == Airspace::FIR || a.second.GetType() == Airspace::UIR || a.second.GetNumberOfPoints() < 4) continue;
+		shapes.push_back(Shape());
+		shapes.back().airspace = &a.second;
+	}
+	Parallel::For(shapes.size(), [&shapes](const size_t begin, const size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			Shape& shape = shapes[i];
+			const Geometry::LatLon& first = shape.airspace->GetFirstPoint();
+			double minLat = first.Lat(), maxLat = minLat, minLon = first.Lon(), maxLon = minLon;
+			for (const Geometry::LatLon& p : shape.airspace->GetPoints()) {
+				minLon = std::min(minLon, p.Lon());
+				maxLon = std::max(maxLon, p.Lon());
+			}
+			shape.acrossAntimeridian = maxLon - minLon > 180; // otherwise its box would cover all the longitudes
+			minLon = 360;
+			maxLon = -180;
+			for (const Geometry::LatLon& p : shape.airspace->GetPoints()) {
+				const double lon = shape.acrossAntimeridian && p.Lon() < 0 ? p.Lon() + 360 : p.Lon();
+				bg::append(shape.polygon.outer(), PointXY(lon, p.Lat()));
+				minLat = std::min(minLat, p.Lat());
+				maxLat = std::max(maxLat, p.Lat());
+				minLon = std::min(minLon, lon);
+				maxLon = std::max(maxLon, lon);
+			}
+			bg::correct(shape.polygon); // orientation expected by boost
+			shape.box = Box(PointXY(minLon, minLat), PointXY(maxLon, maxLat));
+			if (!shape.acrossAntimeridian) continue;
+			for (const PointXY& p : shape.polygon.outer()) bg::append(shape.shiftedPolygon.outer(), PointXY(p.x() - 360, p.y()));
+			shape.shiftedBox = Box(PointXY(minLon - 360, minLat), PointXY(maxLon - 360, maxLat));
+		}
+	}, 64);
+
+	// R-tree bulk loaded on the bounding boxes, also of the copies across the antimeridian: the candidate pairs are found in O(n log n + k)
+	std::vector<IndexEntry> entries;
+	entries.reserve(shapes.size());
+	for (size_t i = 0; i < shapes.size(); i++) {
+		entries.push_back(std::make_pair(shapes[i].box, i));
+		if (shapes[i].acrossAntimeridian) entries.push_back(std::make_pair(shapes[i].shiftedBox, i));
+	}
+	const bgi::rtree<IndexEntry, bgi::rstar<16>> index(useIndex ? entries.begin() : entries.end(), entries.end());
+
+	// Each airspace is compared with the following ones overlapping its bounding box, the results are kept in order
+	std::vector<std::vector<Conflict>> found(shapes.size());
+	Parallel::For(shapes.size(), [&](const size_t begin, const size_t end) {
+		std::vector<IndexEntry> candidates;
+		for (size_t i = begin; i < end; i++) {
+			const Shape& a = shapes[i];
+			candidates.clear();
+			for (int copy = 0; copy < (a.acrossAntimeridian ? 2 : 1); copy++) {
+				const Box& box = copy == 0 ? a.box : a.shiftedBox;
+				if (useIndex) index.query(bgi::intersects(box), std::back_inserter(candidates));
+				else for (const IndexEntry& entry : entries) if (bg::intersects(box, entry.first)) candidates.push_back(entry);
+			}
+			std::sort(candidates.begin(), candidates.end(), [](const IndexEntry& x, const IndexEntry& y) { return x.second < y.second; });
+			for (size_t c = 0; c < candidates.size(); c++) {
+				if (candidates[c].second <= i || (c > 0 && candidates[c].second == candidates[c - 1].second)) continue; // each pair once, also if found by both copies
+				const Shape& b = shapes[candidates[c].second];
+				if (!AreVerticallyOverlapping(*a.airspace, *b.airspace)) continue; // cheaper than the polygons
+				const double areaKm2 = OverlapKm2(a, b);
+				if (areaKm2 > MIN_OVERLAP_KM2) found[i].push_back({ a.airspace, b.airspace, areaKm2 });
+			}
+		}
+	}, 16);
+	for (const std::vector<Conflict>& f : found) conflicts.insert(conflicts.end(), f.begin(), f.end());
+}
+
+bool Conflicts::Write(const std::string& filename) {
+	if (airspaces.empty()) {
+		AirspaceConverter::LogMessage("Conflicts analysis: no airspaces, nothing to analyze");
+		return false;
+	}
+	std::ofstream file;
+	file.open(filename, std::ios::out | std::ios::trunc | std::ios::binary);
+	if (!file.is_open() || file.bad()) {
+		AirspaceConverter::LogError("Unable to open output file: " + filename);
+		return false;
+	}
+	AirspaceConverter::LogMessage("Writing airspace conflicts CSV file: " + filename);
+	Find();
+	file << "Name 1,Category 1,Base 1,Top 1,Name 2,Category 2,Base 2,Top 2,Same category,Overlap base,Overlap top,Overlap area [km2]\r\n";
+	file << std::fixed << std::setprecision(2);
+	for (const Conflict& c : conflicts) {
+		const Airspace &a = *c.first, &b = *c.second;
+		const Altitude& base = a.GetBaseAltitude() < b.GetBaseAltitude() ? b.GetBaseAltitude() : a.GetBaseAltitude();
+		const Altitude& top = a.GetTopAltitude() < b.GetTopAltitude() ? a.GetTopAltitude() : b.GetTopAltitude();
+		file << QuoteCSV(a.GetName()) << ',' << a.GetCategoryName() << ',' << a.GetBaseAltitude().ToString() << ',' << a.GetTopAltitude().ToString() << ','
+			<< QuoteCSV(b.GetName()) << ',' << b.GetCategoryName() << ',' << b.GetBaseAltitude().ToString() << ',' << b.GetTopAltitude().ToString() << ','
+			<< (a.GetType() == b.GetType() ? "yes" : "no") << ',' << base.ToString() << ',' << top.ToString() << ',' << c.areaKm2 << "\r\n";
+	}
+	file.close();
+	AirspaceConverter::LogMessage(boost::str(boost::format("Found %d conflicting pair(s) of airspaces.") %conflicts.size()));
+	return true;
+}
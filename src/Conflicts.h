@@ -0,0 +1,45 @@
+//============================================================================
+// AirspaceConverter
+// Since       : 14/6/2016
+// Author      : Alberto Realis-Luc <alberto.realisluc@gmail.com>
+// Web         : https://www.alus.it/AirspaceConverter
+// Repository  : https://github.com/alus-it/AirspaceConverter.git
+// Copyright   : (C) 2016-2021 Alberto Realis-Luc
+// License     : GNU GPL v3
+//
+// This source file is part of AirspaceConverter project
+//============================================================================
+
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+
+class Airspace;
+
+// Analysis of the airspaces overlapping each other both horizontally and vertically, reported in a CSV file.
+// The candidate pairs come from an R-tree on the bounding boxes, then the polygons are intersected exactly (planar in lat/lon).
+// The ones across the antimeridian are unwrapped, with the longitudes beyond 180, and compared also one turn before.
+// The FIRs and UIRs are left out: they contain all the others.
+class Conflicts {
+public:
+	struct Conflict {
+		const Airspace* first;
+		const Airspace* second;
+		double areaKm2; // of the horizontal overlap
+	};
+
+	Conflicts(const std::multimap<int, Airspace>& airspacesMap);
+	~Conflicts() {}
+	void Find(const bool useIndex = true); // without the index all the pairs are checked, only as reference
+	bool Write(const std::string& filename);
+	inline const std::vector<Conflict>& GetConflicts() const { return conflicts; }
+
+	static bool AreVerticallyOverlapping(const Airspace& a, const Airspace& b);
+
+	static const double MIN_OVERLAP_KM2;
+
+private:
+	const std::multimap<int, Airspace>& airspaces;
+	std::vector<Conflict> conflicts; // in the order of the airspaces
+};
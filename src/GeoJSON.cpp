@@ -0,0 +1,281 @@
+//============================================================================
+// AirspaceConverter
+// Since       : 14/6/2016
+// Author      : Alberto Realis-Luc <alberto.realisluc@gmail.com>
+// Web         : https://www.alus.it/AirspaceConverter
+// Repository  : https://github.com/alus-it/AirspaceConverter.git
+// Copyright   : (C) 2016-2021 Alberto Realis-Luc
+// License     : GNU GPL v3
+//
+// This source file is part of AirspaceConverter project
+//============================================================================
+
+#include "GeoJSON.h"
+#include "AirspaceConverter.h"
+#include "Airspace.h"
+#include "Waypoint.h"
+#include "Parallel.h"
+#include "NumberFormat.h"
+#include <vector>
+#include <cmath>
+#include <cassert>
+#include <boost/filesystem/path.hpp>
+#include <boost/algorithm/string.hpp>
+
+GeoJSON::GeoJSON(const std::multimap<int, Airspace>& airspacesMap, const WaypointSet& waypointsSet) :
+	airspaces(airspacesMap),
+	waypoints(waypointsSet),
+	newlineDelimited(false),
+	firstFeature(true) {
+}
+
+bool GeoJSON::IsNewlineDelimited(const std::string& filename) {
+	const std::string ext(boost::filesystem::path(filename).extension().string());
+	return boost::iequals(ext, ".ndjson") || boost::iequals(ext, ".geojsonl");
+}
+
+bool GeoJSON::Write(const std::string& filename) {
+	if (airspaces.empty() && waypoints.IsEmpty()) {
+		AirspaceConverter::LogMessage("GeoJSON output: no airspaces and no waypoints, nothing to write");
+		return false;
+	}
+	if (!OpenOutput(filename)) return false;
+
+	// Serialize the airspaces in parallel, a block at time to not keep the whole output in memory, then write them in order
+	std::vector<const Airspace*> toWrite;
+	toWrite.reserve(airspaces.size());
+	for (const std::pair<const int, Airspace>& a : airspaces) toWrite.push_back(&a.second);
+	const size_t blockSize = 4096;
+	std::vector<std::string> features(std::min(blockSize, toWrite.size()));
+	for (size_t first = 0; first < toWrite.size(); first += blockSize) {
+		const size_t count = std::min(blockSize, toWrite.size() - first);
+		Parallel::For(count, [&](const size_t begin, const size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				features[i].clear();
+				AppendFeature(*toWrite[first + i], features[i]);
+			}
+		}, 64);
+		for (size_t i = 0; i < count; i++) WriteFeature(features[i]);
+	}
+	return CloseOutput();
+}
+
+bool GeoJSON::OpenOutput(const std::string& filename) {
+	if (file.is_open()) file.close();
+	file.open(filename, std::ios::out | std::ios::trunc | std::ios::binary);
+	if (!file.is_open() || file.bad()) {
+		AirspaceConverter::LogError("Unable to open output file: " + filename);
+		return false;
+	}
+	newlineDelimited = IsNewlineDelimited(filename);
+	firstFeature = true;
+	AirspaceConverter::LogMessage(std::string(newlineDelimited ? "Writing newline-delimited GeoJSON output file: " : "Writing GeoJSON output file: ") + filename);
+	if (!newlineDelimited) file << "{\"type\":\"FeatureCollection\",\"features\":[\n";
+	return true;
+}
+
+void GeoJSON::WriteAirspace(const Airspace& airspace) {
+	assert(file.is_open());
+	std::string feature;
+	AppendFeature(airspace, feature);
+	WriteFeature(feature);
+}
+
+bool GeoJSON::CloseOutput() {
+	if (!file.is_open()) return false;
+	WriteWaypoints();
+	if (!newlineDelimited) file << (firstFeature ? "]}\n" : "\n]}\n");
+	const bool ok = !file.fail();
+	file.close();
+	if (!ok) AirspaceConverter::LogError("Failed to write GeoJSON output file.");
+	return ok;
+}
+
+void GeoJSON::WriteFeature(const std::string& feature) {
+	if (newlineDelimited) file << feature << '\n';
+	else {
+		if (!firstFeature) file << ",\n";
+		file << feature;
+	}
+	firstFeature = false;
+}
+
+void GeoJSON::WriteWaypoints() {
+	std::string feature;
+	for (const Waypoint& w : waypoints) {
+		feature.clear();
+		AppendFeature(w, feature);
+		WriteFeature(feature);
+	}
+}
+
+void GeoJSON::AppendFeature(const Airspace& airspace, std::string& json) {
+	json += "{\"type\":\"Feature\",\"properties\":{\"kind\":\"airspace\",\"name\":";
+	AppendString(airspace.GetName(), json);
+	json += ",\"category\":";
+	AppendString(airspace.GetCategoryName(), json);
+	if (airspace.GetClass() != Airspace::UNDEFINED) {
+		json += ",\"class\":";
+		AppendString(Airspace::CategoryName(airspace.GetClass()), json);
+	}
+	json += ",\"top\":";
+	AppendAltitude(airspace.GetTopAltitude(), json);
+	json += ",\"base\":";
+	AppendAltitude(airspace.GetBaseAltitude(), json);
+	if (airspace.GetNumberOfRadioFrequencies() > 0) {
+		json += ",\"frequencies\":[";
+		for (size_t i = 0; i < airspace.GetNumberOfRadioFrequencies(); i++) {
+			const std::pair<int, InternedString>& freq = airspace.GetRadioFrequencyAt(i);
+			if (i > 0) json += ',';
+			json += "{\"frequency\":";
+			AppendNumber(AirspaceConverter::FrequencyMHz(freq.first), 3, json);
+			if (!freq.second.IsEmpty()) {
+				json += ",\"description\":";
+				AppendString(freq.second.Get(), json);
+			}
+			json += '}';
+		}
+		json += ']';
+	}
+	if (airspace.HasTransponderCode()) {
+		json += ",\"transponder\":";
+		AppendString(airspace.GetTransponderCode(), json);
+	}
+	json += "},\"geometry\":";
+
+	const std::vector<Geometry::LatLon>& points = airspace.GetPoints();
+	if (points.size() < 3) {
+		json += "null}";
+		return;
+	}
+
+	// RFC 7946 wants the exterior ring counterclockwise: check the orientation with the signed area
+	double area = 0;
+	for (size_t i = 0, j = points.size() - 1; i < points.size(); j = i++) area += (points[i].Lon() - points[j].Lon()) * (points[j].Lat() + points[i].Lat());
+	const bool reversed = area > 0; // clockwise
+	json += "{\"type\":\"Polygon\",\"coordinates\":[[";
+	for (size_t i = 0; i < points.size(); i++) {
+		const Geometry::LatLon& p = points[reversed ? points.size() - 1 - i : i];
+		if (i > 0) json += ',';
+		json += '[';
+		AppendNumber(p.Lon(), 7, json);
+		json += ',';
+		AppendNumber(p.Lat(), 7, json);
+		json += ']';
+	}
+	if (points.front() != points.back()) { // the ring must be closed
+		json += ",[";
+		AppendNumber(points[reversed ? points.size() - 1 : 0].Lon(), 7, json);
+		json += ',';
+		AppendNumber(points[reversed ? points.size() - 1 : 0].Lat(), 7, json);
+		json += ']';
+	}
+	json += "]]}}";
+}
+
+void GeoJSON::AppendFeature(const Waypoint& waypoint, std::string& json) {
+	json += "{\"type\":\"Feature\",\"properties\":{\"kind\":\"waypoint\",\"name\":";
+	AppendString(waypoint.GetName(), json);
+	if (!waypoint.GetCode().empty()) {
+		json += ",\"code\":";
+		AppendString(waypoint.GetCode(), json);
+	}
+	if (!waypoint.GetCountry().empty()) {
+		json += ",\"country\":";
+		AppendString(waypoint.GetCountry(), json);
+	}
+	json += ",\"type\":";
+	AppendString(waypoint.GetTypeName(), json);
+	json += ",\"elevation\":";
+	AppendNumber(waypoint.GetAltitude(), 1, json);
+	if (waypoint.IsAirfield()) {
+		if (waypoint.HasRunwayDir()) {
+			json += ",\"runwayDirection\":";
+			NumberFormat::AppendInteger(waypoint.GetRunwayDir(), json);
+		}
+		if (waypoint.HasRunwayLength()) {
+			json += ",\"runwayLength\":";
+			NumberFormat::AppendInteger(waypoint.GetRunwayLength(), json);
+		}
+		if (waypoint.HasRadioFrequency()) {
+			json += ",\"frequency\":";
+			AppendNumber(AirspaceConverter::FrequencyMHz(waypoint.GetRadioFrequency()), 3, json);
+		}
+	}
+	if (waypoint.HasOtherFrequency()) {
+		json += ",\"otherFrequency\":";
+		AppendNumber(AirspaceConverter::FrequencyMHz(waypoint.GetOtherFrequency()), 3, json);
+	}
+	if (!waypoint.GetDescription().empty()) {
+		json += ",\"description\":";
+		AppendString(waypoint.GetDescription(), json);
+	}
+	json += "},\"geometry\":{\"type\":\"Point\",\"coordinates\":[";
+	AppendNumber(waypoint.GetLongitude(), 7, json);
+	json += ',';
+	AppendNumber(waypoint.GetLatitude(), 7, json);
+	json += ',';
+	AppendNumber(waypoint.GetAltitude(), 1, json);
+	json += "]}}";
+}
+
+void GeoJSON::AppendAltitude(const Altitude& altitude, std::string& json) {
+	json += "{\"text\":";
+	AppendString(altitude.ToString(), json);
+	if (altitude.IsUnlimited()) {
+		json += ",\"unlimited\":true}";
+		return;
+	}
+	json += ",\"feet\":";
+	NumberFormat::AppendInteger(altitude.GetAltFt(), json);
+	json += ",\"meters\":";
+	AppendNumber(altitude.GetAltMt(), 1, json);
+	json += altitude.IsAMSL() ? ",\"reference\":\"AMSL\"" : ",\"reference\":\"AGL\"";
+	if (altitude.IsFL()) {
+		json += ",\"flightLevel\":";
+		NumberFormat::AppendInteger(altitude.GetFlightLevel(), json);
+	}
+	json += '}';
+}
+
+void GeoJSON::AppendNumber(const double value, const int decimals, std::string& json) {
+	if (!std::isfinite(value)) json += "null"; // JSON has no NaN or infinity
+	else NumberFormat::AppendCompact(value, decimals, json);
+}
+
+void GeoJSON::AppendString(const std::string& text, std::string& json) {
+	static const char hex[] = "0123456789abcdef";
+	json += '"';
+	const size_t length = text.size();
+	for (size_t i = 0; i < length; i++) {
+		const unsigned char c = (unsigned char)text[i];
+		if (c >= 0x80) {
+			// Keep valid UTF-8 sequences as they are, otherwise take the byte as Latin-1 as often found in OpenAir files
+			const int len = (c & 0xE0) == 0xC0 ? 2 : (c & 0xF0) == 0xE0 ? 3 : (c & 0xF8) == 0xF0 ? 4 : 0;
+			bool valid = len > 0 && i + len <= length;
+			for (int k = 1; valid && k < len; k++) valid = ((unsigned char)text[i + k] & 0xC0) == 0x80;
+			if (valid) {
+				json.append(text, i, len);
+				i += len - 1;
+			} else {
+				json += char(0xC0 | (c >> 6));
+				json += char(0x80 | (c & 0x3F));
+			}
+			continue;
+		}
+		switch (c) {
+		case '"':  json += "\\\""; break;
+		case '\\': json += "\\\\"; break;
+		case '\n': json += "\\n"; break;
+		case '\r': json += "\\r"; break;
+		case '\t': json += "\\t"; break;
+		default:
+			if (c < 0x20) {
+				json += "\\u00";
+				json += hex[c >> 4];
+				json += hex[c & 0xF];
+			} else json += (char)c;
+		}
+	}
+	json += '"';
+}
@@ -0,0 +1,53 @@
+//============================================================================
+// AirspaceConverter
+// Since       : 14/6/2016
+// Author      : Alberto Realis-Luc <alberto.realisluc@gmail.com>
+// Web         : https://www.alus.it/AirspaceConverter
+// Repository  : https://github.com/alus-it/AirspaceConverter.git
+// Copyright   : (C) 2016-2021 Alberto Realis-Luc
+// License     : GNU GPL v3
+//
+// This source file is part of AirspaceConverter project
+//============================================================================
+
+#pragma once
+#include <string>
+#include <map>
+#include <fstream>
+
+class Altitude;
+class Airspace;
+class Waypoint;
+class WaypointSet;
+
+// GeoJSON (RFC 7946) writer: a single FeatureCollection (.geojson) or one Feature per line (.ndjson)
+class GeoJSON {
+public:
+	GeoJSON(const std::multimap<int, Airspace>& airspacesMap, const WaypointSet& waypointsSet);
+	~GeoJSON() {}
+	bool Write(const std::string& filename);
+
+	// Streaming output: the airspaces are written one at time, the waypoints are added when closing
+	bool OpenOutput(const std::string& filename);
+	void WriteAirspace(const Airspace& airspace);
+	bool CloseOutput();
+
+	// Serialize a single feature appending it to the given string, these can be called concurrently
+	static void AppendFeature(const Airspace& airspace, std::string& json);
+	static void AppendFeature(const Waypoint& waypoint, std::string& json);
+
+	static bool IsNewlineDelimited(const std::string& filename);
+
+private:
+	void WriteFeature(const std::string& feature);
+	void WriteWaypoints();
+	static void AppendString(const std::string& text, std::string& json);
+	static void AppendNumber(const double value, const int decimals, std::string& json);
+	static void AppendAltitude(const Altitude& altitude, std::string& json);
+
+	const std::multimap<int, Airspace>& airspaces;
+	const WaypointSet& waypoints;
+	std::ofstream file;
+	bool newlineDelimited;
+	bool firstFeature;
+};
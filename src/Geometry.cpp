@@ -15,11 +15,18 @@
 #include "OpenAir.h"
 #include <cmath>
 #include <cassert>
+#include <algorithm>
+#include <set>
 
 const int Geometry::LatLon::UNDEF_LAT = -91;
 const int Geometry::LatLon::UNDEF_LON = -181;
 const double Geometry::LatLon::SIXTY = 60;
 const double Geometry::LatLon::DEGTOL = 0.00005 * (1.0 / 60); //0.00005 min = 0.0926 m
+#ifdef COMPACT_POINTS
+const double Geometry::LatLon::RESOLUTION = 1e-7;
+#else
+const double Geometry::LatLon::RESOLUTION = 0;
+#endif
 const double Geometry::PI = 3.1415926535897932384626433832795;
 const double Geometry::TWO_PI = PI * 2;
 const double Geometry::PI_2 = PI / 2;
@@ -82,7 +89,7 @@ bool Geometry::LatLon::autoConvertDec2DegMinSec(const double& dec, int& deg, dou
 
 bool Geometry::LatLon::IsAlmostEqual(const LatLon& other) const {
 	if (*this == other) return true;
-	return std::fabs(lat-other.lat) < DEGTOL && std::fabs(lon-other.lon) < DEGTOL;
+	return std::fabs(Lat()-other.Lat()) < DEGTOL && std::fabs(Lon()-other.Lon()) < DEGTOL;
 }
 
 bool Geometry::Limits::Set(const LatLon& topLeftLimit, const LatLon& bottomRightLimit) {
@@ -116,7 +123,7 @@ bool Geometry::Limits::IsPositionWithinLimits(const LatLon& pos) const {
 	if (!valid) return true; // If no limit or not valid limit accept it
 	assert(pos.IsValid());
 	if (pos.Lat() > topLeft.Lat() || pos.Lat() < bottomRight.Lat()) return false;
-	if (acrossAntiGreenwich) return pos.Lon() >= 0 ? pos.Lon() <= topLeft.Lon() : pos.Lon() <= bottomRight.Lon();
+	if (acrossAntiGreenwich) return pos.Lon() >= topLeft.Lon() || pos.Lon() <= bottomRight.Lon();
 	else return pos.Lon() >= topLeft.Lon() && pos.Lon() <= bottomRight.Lon();
 }
 
@@ -124,10 +131,83 @@ bool Geometry::Limits::IsPositionWithinLimits(const double& lat, const double& l
 	if (!valid) return true; // If no limit or not valid limit accept it
 	assert(LatLon::IsValidLat(lat) && LatLon::IsValidLon(lon));
 	if (lat > topLeft.Lat() || lat < bottomRight.Lat()) return false;
-	if (acrossAntiGreenwich) return lon >= 0 ? lon <= topLeft.Lon() : lon <= bottomRight.Lon();
+	if (acrossAntiGreenwich) return lon >= topLeft.Lon() || lon <= bottomRight.Lon();
 	else return lon >= topLeft.Lon() && lon <= bottomRight.Lon();
 }
 
+const double Geometry::Limits::CLIP_TOLERANCE = 0.0001; // [deg] about 10 m, finer than the coordinates written with seconds
+
+// Sutherland-Hodgman on the four sides of the limits, planar in lat/lon. The longitudes of the polygon are made continuous
+// across the antimeridian, the right limit is moved after the left one, so the polygon is cut in a plain rectangle.
+bool Geometry::Limits::ClipPolygon(std::vector<LatLon>& polygon) const {
+	if (!valid) return true;
+	if (polygon.size() < 3) return false;
+	typedef std::pair<double, double> XY; // continuous longitude, latitude
+	std::vector<XY> ring;
+	ring.reserve(polygon.size());
+	const size_t numOfPoints = polygon.front() == polygon.back() ? polygon.size() - 1 : polygon.size();
+	double minLon = polygon.front().Lon(), maxLon = minLon;
+	for (size_t i = 0; i < numOfPoints; i++) {
+		double lon = polygon[i].Lon();
+		if (!ring.empty()) {
+			if (lon - ring.back().first > 180) lon -= 360;
+			else if (lon - ring.back().first < -180) lon += 360;
+		}
+		ring.push_back(XY(lon, polygon[i].Lat()));
+		minLon = std::min(minLon, lon);
+		maxLon = std::max(maxLon, lon);
+	}
+	const double left = topLeft.Lon(), right = acrossAntiGreenwich ? bottomRight.Lon() + 360 : bottomRight.Lon();
+
+	// Keep the points on the side of the limit, adding the intersections where the edges cross it
+	const auto clip = [&ring](const bool onLon, const double limit, const bool keepGreater) {
+		std::vector<XY> clipped;
+		clipped.reserve(ring.size() + 4);
+		for (size_t i = 0, j = ring.size() - 1; i < ring.size(); j = i++) {
+			const XY &previous = ring[j], &current = ring[i];
+			const double p = onLon ? previous.first : previous.second, c = onLon ? current.first : current.second;
+			const bool isPreviousIn = keepGreater ? p >= limit : p <= limit, isCurrentIn = keepGreater ? c >= limit : c <= limit;
+			if (isPreviousIn != isCurrentIn) {
+				const double t = (limit - p) / (c - p);
+				clipped.push_back(onLon ? XY(limit, previous.second + t * (current.second - previous.second)) : XY(previous.first + t * (current.first - previous.first), limit));
+			}
+			if (isCurrentIn) clipped.push_back(current);
+		}
+		ring.swap(clipped);
+	};
+
+	// Try the polygon also one turn before and after, to meet limits across the antimeridian
+	for (double shift = -360; shift <= 360; shift += 360) {
+		if (maxLon + shift < left || minLon + shift > right) continue;
+		const std::vector<XY> original(ring);
+		for (XY& p : ring) p.first += shift;
+		clip(true, left, true);
+		if (!ring.empty()) clip(true, right, false);
+		if (!ring.empty()) clip(false, topLeft.Lat(), false);
+		if (!ring.empty()) clip(false, bottomRight.Lat(), true);
+
+		// Keep the points inside also after the rounding of the intersections, without repeating them
+		std::vector<XY> cleaned;
+		double depth = 0; // how far the polygon goes inside the limits, to exclude what remained only along the border
+		for (const XY& p : ring) {
+			const XY q(std::min(std::max(p.first, left), right), std::min(std::max(p.second, bottomRight.Lat()), topLeft.Lat()));
+			if (!cleaned.empty() && q == cleaned.back()) continue;
+			cleaned.push_back(q);
+			depth = std::max(depth, std::min(std::min(q.first - left, right - q.first), std::min(topLeft.Lat() - q.second, q.second - bottomRight.Lat())));
+		}
+		while (cleaned.size() > 1 && cleaned.front() == cleaned.back()) cleaned.pop_back();
+		ring.swap(cleaned);
+		if (ring.size() >= 3 && depth > CLIP_TOLERANCE) {
+			polygon.clear();
+			for (const XY& p : ring) polygon.push_back(LatLon(p.second, p.first > 180 ? p.first - 360 : (p.first < -180 ? p.first + 360 : p.first)));
+			polygon.push_back(polygon.front());
+			return true;
+		}
+		ring = original;
+	}
+	return false;
+}
+
 double Geometry::AbsAngle(const double& angle) { //to put angle in the range between 0 and 2PI
 	assert(!std::isinf(angle) && !std::isnan(angle));
 	double absangle = std::fmod(angle, TWO_PI);
@@ -370,6 +450,97 @@ bool Geometry::IsInt(const double& number, int& intVal) {
 	return std::fabs(number-intVal) < TOL;
 }
 
+bool Geometry::IsInsidePolygon(const std::vector<LatLon>& polygon, const LatLon& position) {
+	if (polygon.size() < 3) return false;
+	bool inside = false; // crossing number, the polygon may be closed or not
+	for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++) if (IsCrossingRay(polygon[j], polygon[i], position)) inside = !inside;
+	return inside;
+}
+
+namespace {
+
+struct SweepSegment { // segment of a ring oriented from left to right, x is the longitude and y the latitude
+	double x1, y1, x2, y2;
+	size_t index;
+	inline double YAt(const double x) const { return x1 == x2 ? y1 : y1 + (y2 - y1) * (x - x1) / (x2 - x1); }
+};
+
+struct SweepOrder { // order from bottom to top of the segments crossing the sweep line, consistent until two of them intersect
+	bool operator()(const SweepSegment* a, const SweepSegment* b) const {
+		const double x = std::max(a->x1, b->x1);
+		const double ya = a->YAt(x), yb = b->YAt(x);
+		if (ya != yb) return ya < yb;
+		const double cross = (a->x2 - a->x1) * (b->y2 - b->y1) - (a->y2 - a->y1) * (b->x2 - b->x1); // from the same point: the steeper is above
+		if (cross != 0) return cross > 0;
+		return a->index < b->index;
+	}
+};
+
+inline int Orientation(const double ax, const double ay, const double bx, const double by, const double cx, const double cy) {
+	const double cross = (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+	return (cross > 0) - (cross < 0);
+}
+
+bool AreIntersecting(const SweepSegment& a, const SweepSegment& b, const size_t numOfSegments) {
+	const int o1 = Orientation(a.x1, a.y1, a.x2, a.y2, b.x1, b.y1), o2 = Orientation(a.x1, a.y1, a.x2, a.y2, b.x2, b.y2);
+	const size_t distance = a.index > b.index ? a.index - b.index : b.index - a.index;
+	if (distance == 1 || distance == numOfSegments - 1) { // consecutive: they share a vertex, wrong only if they go back on the same line
+		if (o1 != 0 || o2 != 0) return false;
+		if (a.x1 != a.x2 || b.x1 != b.x2) return std::max(a.x1, b.x1) < std::min(a.x2, b.x2);
+		return std::max(a.y1, b.y1) < std::min(a.y2, b.y2);
+	}
+	if (std::max(a.x1, b.x1) > std::min(a.x2, b.x2) || std::max(std::min(a.y1, a.y2), std::min(b.y1, b.y2)) > std::min(std::max(a.y1, a.y2), std::max(b.y1, b.y2))) return false;
+	return o1 * o2 <= 0 && Orientation(b.x1, b.y1, b.x2, b.y2, a.x1, a.y1) * Orientation(b.x1, b.y1, b.x2, b.y2, a.x2, a.y2) <= 0;
+}
+
+} // namespace
+
+// Shamos-Hoey sweep line: O(n log n), only the neighbours on the sweep line are compared when a segment begins or ends
+bool Geometry::FindSelfIntersection(const std::vector<LatLon>& ring, size_t& first, size_t& second) {
+	if (ring.size() < 4) return false;
+	assert(ring.front() == ring.back());
+	const size_t numOfSegments = ring.size() - 1;
+	std::vector<SweepSegment> segments(numOfSegments);
+	std::vector<std::pair<std::pair<double, double>, std::pair<bool, size_t>>> events; // (x, y) of the end, (is the end on the right, segment)
+	events.reserve(2 * numOfSegments);
+	for (size_t i = 0; i < numOfSegments; i++) {
+		const LatLon &a = ring[i], &b = ring[i + 1];
+		const bool isForward = a.Lon() < b.Lon() || (a.Lon() == b.Lon() && a.Lat() < b.Lat());
+		const LatLon &left = isForward ? a : b, &right = isForward ? b : a;
+		segments[i] = { left.Lon(), left.Lat(), right.Lon(), right.Lat(), i };
+		events.push_back(std::make_pair(std::make_pair(left.Lon(), left.Lat()), std::make_pair(false, i)));
+		events.push_back(std::make_pair(std::make_pair(right.Lon(), right.Lat()), std::make_pair(true, i)));
+	}
+	std::sort(events.begin(), events.end(), [](const std::pair<std::pair<double, double>, std::pair<bool, size_t>>& a, const std::pair<std::pair<double, double>, std::pair<bool, size_t>>& b) {
+		if (a.first.first != b.first.first) return a.first.first < b.first.first;
+		if (a.second.first != b.second.first) return b.second.first; // at the same x the segments begin before the others end
+		return a.first.second < b.first.second;
+	});
+	std::set<const SweepSegment*, SweepOrder> active;
+	std::vector<std::set<const SweepSegment*, SweepOrder>::iterator> positions(numOfSegments, active.end());
+	const auto found = [&](const SweepSegment* a, const SweepSegment* b) -> bool {
+		if (!AreIntersecting(*a, *b, numOfSegments)) return false;
+		first = std::min(a->index, b->index);
+		second = std::max(a->index, b->index);
+		return true;
+	};
+	for (const auto& event : events) {
+		const SweepSegment* segment = &segments[event.second.second];
+		if (!event.second.first) {
+			const auto above = active.lower_bound(segment);
+			if (above != active.end() && found(segment, *above)) return true;
+			if (above != active.begin() && found(segment, *std::prev(above))) return true;
+			positions[segment->index] = active.insert(above, segment);
+		} else {
+			const auto position = positions[segment->index];
+			const auto above = std::next(position);
+			if (above != active.end() && position != active.begin() && found(*std::prev(position), *above)) return true;
+			active.erase(position);
+		}
+	}
+	return false;
+}
+
 bool Geometry::CalcAirfieldPolygon(const double lat, const double lon, const int length, const int dir, std::vector<LatLon>& polygon) {
 	static const double thrtyMeters = 30.0 * M2RAD;
 	assert(polygon.empty());
@@ -409,6 +580,10 @@ bool Point::Discretize(std::vector<LatLon>& output) const {
 	return true;
 }
 
+double Point::CalcDistanceNM(const LatLon& position) const {
+	return RAD2NM * CalcAngularDist(point.LatRad(), point.LonRad(), position.LatRad(), position.LonRad());
+}
+
 void Point::WriteOpenAirGeometry(OpenAir& openAir) const {
 	openAir.WritePoint(*this);
 }
@@ -422,7 +597,8 @@ Sector::Sector(const LatLon& center, const double radiusNM, const double dir1, c
 	, angleEnd(AbsAngle(dir2 * DEG2RAD))
 	, radius(radiusNM * NM2RAD)
 	, A(CalcRadialPoint(latc, lonc, angleStart, radius))
-	, B(CalcRadialPoint(latc, lonc, angleEnd, radius)) {
+	, B(CalcRadialPoint(latc, lonc, angleEnd, radius))
+	, middle(CalcRadialPoint(latc, lonc, AbsAngle(clockwise ? angleStart + AbsAngle(angleEnd - angleStart) / 2 : angleStart - AbsAngle(angleStart - angleEnd) / 2), radius)) {
 	assert(radius > 0 && radius < PI_2);
 }
 
@@ -442,6 +618,7 @@ Sector::Sector(const LatLon& center, const LatLon& pointStart, const LatLon& poi
 	assert(std::fabs((radius * RAD2NM) - (CalcAngularDist(latc, lonc, lat2r, lon2r) * RAD2NM)) < 0.2);
 	angleStart = CalcGreatCircleCourse(latc, lonc, lat1r, lon1r);
 	angleEnd = CalcGreatCircleCourse(latc, lonc, lat2r, lon2r);
+	middle = CalcRadialPoint(latc, lonc, AbsAngle(clockwise ? angleStart + AbsAngle(angleEnd - angleStart) / 2 : angleStart - AbsAngle(angleStart - angleEnd) / 2), radius);
 }
 
 bool Sector::Discretize(std::vector<LatLon>& output) const {
@@ -461,6 +638,29 @@ bool Sector::Discretize(std::vector<LatLon>& output) const {
 	return true;
 }
 
+bool Sector::IsOnArcDirection(const double course) const {
+	return clockwise ? AbsAngle(course - angleStart) <= AbsAngle(angleEnd - angleStart) : AbsAngle(angleStart - course) <= AbsAngle(angleStart - angleEnd);
+}
+
+double Sector::CalcDistanceNM(const LatLon& position) const {
+	const double lat = position.LatRad(), lon = position.LonRad();
+	const double dist = CalcAngularDist(latc, lonc, lat, lon);
+	if (dist > 0 && IsOnArcDirection(CalcGreatCircleCourse(latc, lonc, lat, lon))) return RAD2NM * std::fabs(dist - radius);
+	return RAD2NM * std::min(CalcAngularDist(A.LatRad(), A.LonRad(), lat, lon), CalcAngularDist(B.LatRad(), B.LonRad(), lat, lon));
+}
+
+bool Sector::Contains(const LatLon& position) const {
+	const double lat = position.LatRad(), lon = position.LonRad();
+	const double dist = CalcAngularDist(latc, lonc, lat, lon);
+	return dist <= radius && (dist == 0 || IsOnArcDirection(CalcGreatCircleCourse(latc, lonc, lat, lon)));
+}
+
+bool Sector::IsInsideCurve(const LatLon& position) const {
+	// Same side of the chord of the arc and inside the circle, the chord is the same straight edge used by the polygon test
+	const double side = SideOfChord(A, B, position);
+	return (side > 0) == (SideOfChord(A, B, middle) > 0) && side != 0 && CalcAngularDist(latc, lonc, position.LatRad(), position.LonRad()) <= radius;
+}
+
 void Sector::WriteOpenAirGeometry(OpenAir& openAir) const {
 	openAir.WriteSector(*this);
 }
@@ -485,6 +685,14 @@ bool Circle::Discretize(std::vector<LatLon>& output) const {
 	return true;
 }
 
+double Circle::CalcDistanceNM(const LatLon& position) const {
+	return RAD2NM * std::fabs(CalcAngularDist(latc, lonc, position.LatRad(), position.LonRad()) - radius);
+}
+
+bool Circle::Contains(const LatLon& position) const {
+	return CalcAngularDist(latc, lonc, position.LatRad(), position.LonRad()) <= radius;
+}
+
 void Circle::WriteOpenAirGeometry(OpenAir& openAir) const {
 	openAir.WriteCircle(*this);
 }
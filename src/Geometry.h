@@ -12,6 +12,11 @@
 
 #pragma once
 #include <vector>
+#include <cstddef>
+#ifdef COMPACT_POINTS
+#include <cstdint>
+#include <cmath>
+#endif
 
 class Airspace;
 class OpenAir;
@@ -23,36 +28,48 @@ friend class OpenAir;
 public:
 	class LatLon {
 	public:
-		LatLon() : lat(UNDEF_LAT), lon(UNDEF_LON) {}
-		LatLon(const double& latitude, const double& longitude) : lat(latitude), lon(longitude) {}
+		LatLon() : lat(Store(UNDEF_LAT)), lon(Store(UNDEF_LON)) {}
+		LatLon(const double& latitude, const double& longitude) : lat(Store(latitude)), lon(Store(longitude)) {}
 		inline static LatLon CreateFromRadiants(const double& latRad, const double& lonRad) { return LatLon(latRad * RAD2DEG, -lonRad * RAD2DEG); }
-		inline double Lat() const { return lat; }
-		inline double Lon() const { return lon; }
-		inline double LatRad() const { return lat * DEG2RAD; }
-		inline double LonRad() const { return -lon * DEG2RAD; }
-		inline void GetLatLon(double& latitude, double& longitude) const { latitude = lat; longitude = lon; }
-		inline void SetLatLon(const double& latitude, const double& longitude) { lat = latitude; lon = longitude; }
-		inline void SetLat(const double& latitude) { lat = latitude; }
-		inline void SetLon(const double& longitude) { lon = longitude; }
-		inline void SetLatLonRad(const double latRad, const double lonRad) { lat = latRad * RAD2DEG; lon = -lonRad * RAD2DEG; }
+		inline double Lat() const { return Load(lat); }
+		inline double Lon() const { return Load(lon); }
+		inline double LatRad() const { return Lat() * DEG2RAD; }
+		inline double LonRad() const { return -Lon() * DEG2RAD; }
+		inline void GetLatLon(double& latitude, double& longitude) const { latitude = Lat(); longitude = Lon(); }
+		inline void SetLatLon(const double& latitude, const double& longitude) { lat = Store(latitude); lon = Store(longitude); }
+		inline void SetLat(const double& latitude) { lat = Store(latitude); }
+		inline void SetLon(const double& longitude) { lon = Store(longitude); }
+		inline void SetLatLonRad(const double latRad, const double lonRad) { lat = Store(latRad * RAD2DEG); lon = Store(-lonRad * RAD2DEG); }
 		inline bool operator==(const LatLon& other) const { return other.lat == lat && other.lon == lon; }
 		inline bool operator!=(const LatLon& other) const { return other.lat != lat || other.lon != lon; }
-		inline void GetLatDegMin(int& deg, double& min) const { return convertDec2DegMin(lat, deg, min); }
-		inline void GetLonDegMin(int& deg, double& min) const { return convertDec2DegMin(lon, deg, min); }
-		inline void GetLatDegMinSec(int& deg, int& min, int& sec) const { return convertDec2DegMinSec(lat, deg, min, sec); }
-		inline void GetLonDegMinSec(int& deg, int& min, int& sec) const { return convertDec2DegMinSec(lon, deg, min, sec); }
-		inline bool GetAutoLatDegMinSec(int& deg, double& decimalMin, int& min, int& sec) const { return autoConvertDec2DegMinSec(lat, deg, decimalMin, min, sec); }
-		inline bool GetAutoLonDegMinSec(int& deg, double& decimalMin, int& min, int& sec) const { return autoConvertDec2DegMinSec(lon, deg, decimalMin, min, sec); }
+		inline void GetLatDegMin(int& deg, double& min) const { return convertDec2DegMin(Lat(), deg, min); }
+		inline void GetLonDegMin(int& deg, double& min) const { return convertDec2DegMin(Lon(), deg, min); }
+		inline void GetLatDegMinSec(int& deg, int& min, int& sec) const { return convertDec2DegMinSec(Lat(), deg, min, sec); }
+		inline void GetLonDegMinSec(int& deg, int& min, int& sec) const { return convertDec2DegMinSec(Lon(), deg, min, sec); }
+		inline bool GetAutoLatDegMinSec(int& deg, double& decimalMin, int& min, int& sec) const { return autoConvertDec2DegMinSec(Lat(), deg, decimalMin, min, sec); }
+		inline bool GetAutoLonDegMinSec(int& deg, double& decimalMin, int& min, int& sec) const { return autoConvertDec2DegMinSec(Lon(), deg, decimalMin, min, sec); }
 		inline char GetNorS() const { return lat > 0 ? 'N' : 'S'; }
 		inline char GetEorW() const { return lon > 0 ? 'E' : 'W'; }
-		inline bool IsValid() const { return IsValidLat(lat) &&  IsValidLon(lon); }
+		inline bool IsValid() const { return IsValidLat(Lat()) &&  IsValidLon(Lon()); }
 		inline static bool IsValidLat(const double& la) { return la >= -90 && la <= 90; }
 		inline static bool IsValidLon(const double& lo) { return lo >= -180 && lo <= 180; }
 		bool IsAlmostEqual(const LatLon& other) const;
 		static const int UNDEF_LAT, UNDEF_LON;
+		static const double RESOLUTION; // smallest step stored, 0 if not compact
 
 	private:
-		double lat, lon;
+#ifdef COMPACT_POINTS
+		// Compact points: 32 bit integers of 1e-7 degrees (about 1 cm), half the memory of the bulk point arrays
+		// Printed coordinates are not affected: no writer goes beyond 7 decimals of degree or 0.001 of minute
+		typedef int32_t Coordinate;
+		static inline Coordinate Store(const double& degrees) { return (Coordinate)std::lround(degrees * 1e7); }
+		static inline double Load(const Coordinate value) { return value / 1e7; } // division: same double as parsing the decimal text
+#else
+		typedef double Coordinate;
+		static inline Coordinate Store(const double& degrees) { return degrees; }
+		static inline double Load(const Coordinate value) { return value; }
+#endif
+		Coordinate lat, lon;
 		static void convertDec2DegMin(const double& dec, int& deg, double& min);
 		static void convertDec2DegMinSec(const double& dec, int& deg, int& min, int& sec);
 		static bool autoConvertDec2DegMinSec(const double& dec, int& deg, double& decimalMin, int& min, int& sec);
@@ -77,6 +94,7 @@ public:
 		inline void Disable() { valid = false; }
 		bool IsPositionWithinLimits(const LatLon& pos) const;
 		bool IsPositionWithinLimits(const double& lat, const double& lon) const;
+		bool ClipPolygon(std::vector<LatLon>& polygon) const; // cut on the limits, false if nothing remains
 
 	private:
 		void Verify();
@@ -84,15 +102,22 @@ public:
 		LatLon bottomRight;
 		bool valid;
 		bool acrossAntiGreenwich;
+		static const double CLIP_TOLERANCE;
 	};
 
 	virtual ~Geometry() {}
+	virtual Geometry* Clone() const = 0; // copy of the same type
 	virtual bool Discretize(std::vector<LatLon>& output) const = 0;
+	virtual double CalcDistanceNM(const LatLon& position) const = 0; // distance from the point or from the line of the curve
+	static bool IsInsidePolygon(const std::vector<LatLon>& polygon, const LatLon& position);
+	static bool FindSelfIntersection(const std::vector<LatLon>& ring, size_t& first, size_t& second); // on a closed ring without consecutive repeated points, first and second are the starting points of two segments crossing, touching or overlapping
 	static inline void SetResolution(const double resolutionNM) { resolution = resolutionNM * NM2RAD; }
 	static bool CalcAirfieldPolygon(const double lat, const double lon, const int length, const int dir, std::vector<LatLon>& polygon);
 	inline const LatLon& GetCenterPoint() const { return point; }
 
 	static const double NM2M, MI2M;
+	static const double PI, DEG2RAD, M2RAD;
+	static double CalcAngularDist(const double& lat1, const double& lon1, const double& lat2, const double& lon2); // [rad] on the great circle, from radians
 
 protected:
 	Geometry(const LatLon& center) : point(center) {}
@@ -100,11 +125,9 @@ protected:
 	static double resolution; // [rad] maximun distance between points when discretizing
 	static const double TWO_PI;
 	static const double PI_2;
-	static const double DEG2RAD;
 	static const double RAD2DEG;
 	static const double NM2RAD;
 	static const double RAD2NM;
-	static const double M2RAD;
 
 	static double FindStep(const double& radius, const double& angle);
 	static double DeltaAngle(const double angle, const double reference);
@@ -112,7 +135,6 @@ protected:
 	static double AnglePi2Pi(const double& angle);
 	static double CalcGreatCircleCourse(const double& lat1, const double& lon1, const double& lat2, const double& lon2, const double& d);
 	static double CalcGreatCircleCourse(const double& lat1, const double& lon1, const double& lat2, const double& lon2);
-	static double CalcAngularDist(const double& lat1, const double& lon1, const double& lat2, const double& lon2);
 	static void CalcRadialPoint(const double& lat1, const double& lon1, const double& dir, const double& dst, double& lat, double& lon);
 	static LatLon CalcRadialPoint(const double& lat1, const double& lon1, const double& dir, const double& dst);
 	static bool CalcBisector(const double& latA, const double& lonA, const double& latB, const double& lonB, const double& latC, const double& lonC, double& bisector);
@@ -123,12 +145,20 @@ protected:
 	static double AverageRadius(const Geometry::LatLon& center, const std::vector<LatLon*>& circlePoints);
 	static double RoundDistanceInNM(const double radiusRad);
 	static bool IsInt(const double& number, int& intVal);
+	static inline bool IsCrossingRay(const LatLon& a, const LatLon& b, const LatLon& p) { // if the edge a-b crosses the ray going east from p
+		return (a.Lat() > p.Lat()) != (b.Lat() > p.Lat()) && p.Lon() < a.Lon() + (p.Lat() - a.Lat()) * (b.Lon() - a.Lon()) / (b.Lat() - a.Lat());
+	}
 
 private:
-	static const double PI;
 	static const double TOL;
 	virtual void WriteOpenAirGeometry(OpenAir& openAir) const = 0;
 	virtual bool IsPoint() const = 0;
+	virtual bool IsClosed() const = 0;
+
+	// To test if a position is inside a sequence of geometries: the edges between the vertexes plus the area between the chord and the curve
+	virtual const LatLon& GetStartVertex() const = 0;
+	virtual const LatLon& GetEndVertex() const = 0;
+	virtual bool IsInsideCurve(const LatLon& position) const = 0;
 };
 
 class Point : public Geometry {
@@ -137,11 +167,17 @@ friend class OpenAir;
 public:
 	Point(const LatLon& latlon) : Geometry(latlon) {}
 	Point(const double& lat, const double& lon) : Geometry(LatLon(lat,lon)) {}
+	inline Geometry* Clone() const { return new Point(*this); }
 	bool Discretize(std::vector<LatLon>& output) const;
+	double CalcDistanceNM(const LatLon& position) const;
 
 private:
 	void WriteOpenAirGeometry(OpenAir& openAir) const;
 	inline bool IsPoint() const { return true; }
+	inline bool IsClosed() const { return false; }
+	inline const LatLon& GetStartVertex() const { return point; }
+	inline const LatLon& GetEndVertex() const { return point; }
+	inline bool IsInsideCurve(const LatLon&) const { return false; }
 };
 
 class Sector : public Geometry {
@@ -150,6 +186,7 @@ friend class OpenAir;
 public:
 	Sector(const LatLon& center, const double radiusNM, const double dir1, const double dir2, const bool isClockwise);
 	Sector(const LatLon& center, const LatLon& pointStart, const LatLon& pointEnd, const bool isClockwise);
+	inline Geometry* Clone() const { return new Sector(*this); }
 	bool Discretize(std::vector<LatLon>& output) const;
 	inline double GetRadiusNM() const { return RAD2NM * radius; }
 	inline bool IsClockwise() const { return clockwise; }
@@ -157,16 +194,25 @@ public:
 	inline const LatLon& GetEndPoint() const { return B; }
 	inline double GetAngleStart() const { return RAD2DEG * angleStart; }
 	inline double GetAngleEnd() const { return RAD2DEG * angleEnd; }
+	double CalcDistanceNM(const LatLon& position) const;
+	bool Contains(const LatLon& position) const; // inside the circular sector between the center and the arc
 
 private:
 	void WriteOpenAirGeometry(OpenAir& openAir) const;
 	inline bool IsPoint() const { return false; }
+	inline bool IsClosed() const { return false; }
+	inline const LatLon& GetStartVertex() const { return A; }
+	inline const LatLon& GetEndVertex() const { return B; }
+	bool IsInsideCurve(const LatLon& position) const; // inside the circular segment between the chord A-B and the arc
+	bool IsOnArcDirection(const double course) const;
+	static inline double SideOfChord(const LatLon& a, const LatLon& b, const LatLon& p) { return (b.Lon() - a.Lon()) * (p.Lat() - a.Lat()) - (b.Lat() - a.Lat()) * (p.Lon() - a.Lon()); }
 
 	const bool clockwise;
 	const double latc, lonc; // [rad]
 	double angleStart, angleEnd; // [rad]
 	double radius; // [rad]
 	LatLon A, B;
+	LatLon middle; // middle point of the arc
 };
 
 class Circle : public Geometry {
@@ -174,12 +220,19 @@ friend class OpenAir;
 
 public:
 	Circle(const LatLon& center, const double& radiusNM);
+	inline Geometry* Clone() const { return new Circle(*this); }
 	bool Discretize(std::vector<LatLon>& output) const;
 	inline double GetRadiusNM() const { return RAD2NM * radius; }
+	double CalcDistanceNM(const LatLon& position) const;
+	bool Contains(const LatLon& position) const;
 
 private:
 	void WriteOpenAirGeometry(OpenAir& openAir) const;
 	inline bool IsPoint() const { return false; }
+	inline bool IsClosed() const { return true; }
+	inline const LatLon& GetStartVertex() const { return point; }
+	inline const LatLon& GetEndVertex() const { return point; }
+	inline bool IsInsideCurve(const LatLon& position) const { return Contains(position); }
 
 	const double radius; // [rad]
 	const double latc, lonc; // [rad]
@@ -0,0 +1,74 @@
+//============================================================================
+// AirspaceConverter
+// Since       : 14/6/2016
+// Author      : Alberto Realis-Luc <alberto.realisluc@gmail.com>
+// Web         : https://www.alus.it/AirspaceConverter
+// Repository  : https://github.com/alus-it/AirspaceConverter.git
+// Copyright   : (C) 2016-2021 Alberto Realis-Luc
+// License     : GNU GPL v3
+//
+// This source file is part of AirspaceConverter project
+//============================================================================
+
+#include "InternedString.h"
+#include <unordered_set>
+#include <mutex>
+#include <atomic>
+
+const std::string InternedString::EMPTY;
+
+namespace {
+	// The elements of an unordered_set are never moved, not even on rehash, so their address is a valid handle
+	// The pool is split in shards, each with its own lock, so the threads reading in parallel rarely wait for each other
+	struct Shard {
+		std::mutex mutex;
+		std::unordered_set<std::string> strings;
+	};
+	const size_t NUM_OF_SHARDS = 64;
+
+	Shard* Shards() {
+		static Shard shards[NUM_OF_SHARDS];
+		return shards;
+	}
+
+	std::atomic<unsigned long> poolGeneration(0); // incremented when the pool is cleared, to discard the caches of the threads
+
+	struct TextHash { inline size_t operator()(const std::string* s) const { return std::hash<std::string>()(*s); } };
+	struct TextEqual { inline bool operator()(const std::string* a, const std::string* b) const { return *a == *b; } };
+	typedef std::unordered_set<const std::string*, TextHash, TextEqual> CachedStrings;
+
+	// The strings already interned by this thread: found again without any lock
+	struct Cache {
+		Cache() : generation(0) {}
+		unsigned long generation;
+		CachedStrings strings;
+	};
+}
+
+const std::string* InternedString::Intern(const std::string& text) {
+	if (text.empty()) return &EMPTY;
+	static thread_local Cache cache;
+	const unsigned long generation = poolGeneration.load(std::memory_order_acquire);
+	if (cache.generation != generation) {
+		cache.strings.clear();
+		cache.generation = generation;
+	}
+	const CachedStrings::const_iterator cached = cache.strings.find(&text);
+	if (cached != cache.strings.end()) return *cached;
+	Shard& shard = Shards()[std::hash<std::string>()(text) % NUM_OF_SHARDS];
+	const std::string* interned;
+	{
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		interned = &*shard.strings.insert(text).first;
+	}
+	cache.strings.insert(interned);
+	return interned;
+}
+
+void InternedString::ClearPool() {
+	poolGeneration++;
+	for (size_t i = 0; i < NUM_OF_SHARDS; i++) {
+		std::lock_guard<std::mutex> lock(Shards()[i].mutex);
+		std::unordered_set<std::string>().swap(Shards()[i].strings);
+	}
+}
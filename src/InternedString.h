@@ -0,0 +1,42 @@
+//============================================================================
+// AirspaceConverter
+// Since       : 14/6/2016
+// Author      : Alberto Realis-Luc <alberto.realisluc@gmail.com>
+// Web         : https://www.alus.it/AirspaceConverter
+// Repository  : https://github.com/alus-it/AirspaceConverter.git
+// Copyright   : (C) 2016-2021 Alberto Realis-Luc
+// License     : GNU GPL v3
+//
+// This source file is part of AirspaceConverter project
+//============================================================================
+
+#pragma once
+#include <string>
+#include <ostream>
+#include <functional>
+
+// Handle to a string stored only once in a pool shared by all the loaded data: copy and comparison cost as a pointer
+// The library never frees the pool: the program owning all the loaded data clears it explicitly at the end of a conversion
+class InternedString {
+public:
+	InternedString() : str(&EMPTY) {}
+	InternedString(const std::string& text) : str(Intern(text)) {}
+
+	inline operator const std::string&() const { return *str; }
+	inline const std::string& Get() const { return *str; }
+	inline bool IsEmpty() const { return str->empty(); }
+	inline bool operator==(const InternedString& other) const { return str == other.str; }
+	inline bool operator!=(const InternedString& other) const { return str != other.str; }
+	inline size_t Hash() const { return std::hash<const std::string*>()(str); }
+
+	// Free all the strings: to be called only when no handle is alive anymore in the whole process
+	static void ClearPool();
+
+private:
+	static const std::string* Intern(const std::string& text);
+
+	const std::string* str;
+	static const std::string EMPTY;
+};
+
+inline std::ostream& operator<<(std::ostream& os, const InternedString& text) { return os << text.Get(); }
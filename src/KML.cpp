@@ -14,8 +14,9 @@
 #include "Airspace.h"
 #include "AirspaceConverter.h"
 #include "Waypoint.h"
-#include "Airfield.h"
 #include "Geometry.h"
+#include "Parallel.h"
+#include "Keywords.h"
 #include <zip.h>
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/path.hpp>
@@ -23,7 +24,12 @@
 #include <boost/property_tree/xml_parser.hpp>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/tokenizer.hpp>
+#include <boost/format.hpp>
 #include <cmath>
+#include <algorithm>
+#include <iomanip>
+#include <cstring>
+#include <sstream>
 
 const std::string KML::colors[][2] = {
 	{ "509900ff", "7f9900ff" }, //CLASSA
@@ -36,6 +42,8 @@ const std::string KML::colors[][2] = {
 	{ "500000FF", "7F0000FF" }, //DANGER
 	{ "500000FF", "7F0000FF" }, //PROHIBITED
 	{ "50FF0080", "7FFF0080" }, //RESTRICTED
+	{ "40000000", "7fd4d4d4" }, //OTHER
+	{ "50FF0080", "7FFF0080" }, //MATZ
 	{ "501947ff", "7f1947ff" }, //CTR
 	{ "50ffdd01", "7fffdd01" }, //TMA
 	{ "50000000", "7fd4d4d4" }, //TMZ
@@ -82,6 +90,66 @@ const std::string KML::waypointIcons[] = {
 };
 
 const std::string KML::iconsPath(DetectIconsPath());
+const int KML::TILE_MIN_LOD_PIXELS = 128; // a tile is loaded when its region is at least this size on the screen
+
+namespace {
+
+// Release the archive without writing it
+void DiscardArchive(zip* archive) {
+	// In case ZIP_FL_OVERWRITE is not defined we are using an older libzib version such as 0.10.1, so we have to use the older functions
+#ifdef ZIP_FL_OVERWRITE
+	zip_discard(archive);
+#else
+	zip_close(archive);
+#endif
+}
+
+// Add a file to the archive, otherwise discard the archive
+bool AddFileToArchive(zip* archive, const std::string& path, const std::string& name) {
+	zip_source* source = zip_source_file(archive, path.c_str(), 0, 0);
+	if (source == nullptr) { // "failed to create source buffer. " << zip_strerror(archive)
+		DiscardArchive(archive);
+		AirspaceConverter::LogError("Failed to create zip source buffer to read: " + path);
+		return false;
+	}
+#ifdef ZIP_FL_OVERWRITE
+	const int index = (int)zip_file_add(archive, name.c_str(), source, ZIP_FL_OVERWRITE);
+#else
+	const int index = (int)zip_add(archive, name.c_str(), source);
+#endif
+	if (index < 0) { // "failed to add file to archive. " << zip_strerror(archive)
+		DiscardArchive(archive);
+		zip_source_free(source); // The sorce buffer have to be freed in this case
+		AirspaceConverter::LogError("While compressing, failed to add: " + name);
+		return false;
+	}
+	return true;
+}
+
+// Extract a file from the archive directly in memory
+bool ExtractFromArchive(zip* archive, const long index, const std::string& kmzFile, std::string& content) {
+	struct zip_stat sb;
+	struct zip_file* zf = zip_stat_index(archive, index, 0, &sb) == 0 ? zip_fopen_index(archive, index, 0) : nullptr;
+	if (zf == nullptr) {
+		AirspaceConverter::LogError("while extracting, unable to open KML file from KMZ: " + kmzFile);
+		return false;
+	}
+	content.resize((size_t)sb.size);
+	unsigned long sum = 0;
+	while (sum < sb.size) {
+		const int len = (int)zip_fread(zf, &content[sum], sb.size - sum);
+		if (len <= 0) {
+			AirspaceConverter::LogError("While extracting KML file, unable read compressed data from: " + kmzFile);
+			zip_fclose(zf);
+			return false;
+		}
+		sum += len;
+	}
+	zip_fclose(zf);
+	return true;
+}
+
+} // namespace
 
 const std::string KML::DetectIconsPath() {
 	std::string 
@@ -102,12 +170,20 @@ const std::string KML::DetectIconsPath() {
 	return "./icons/";
 }
 
-KML::KML(std::multimap<int, Airspace>& airspacesMap, std::multimap<int, Waypoint*>& waypointsMap):
+KML::KML(std::multimap<int, Airspace>& airspacesMap, WaypointSet& waypointsSet):
 		airspaces(airspacesMap),
-		waypoints(waypointsMap),
+		waypoints(waypointsSet),
+		out(&outputFile),
 		allAGLaltitudesCovered(true),
 		processLineString(false),
-		folderCategory(Airspace::Type::UNDEFINED) {
+		folderCategory(Airspace::Type::UNDEFINED),
+		tileSize(0) { // by default a single document
+}
+
+KML::~KML() {
+	RemoveSpillFiles();
+	RemoveTileFiles();
+	RemoveDocumentFile();
 }
 
 std::string KML::PrepareTagText(const std::string& text) {
@@ -140,16 +216,16 @@ std::string KML::PrepareTagText(const std::string& text) {
 
 void KML::WriteHeader(const bool airspacePresent, const bool waypointsPresent) {
 	assert(airspacePresent || waypointsPresent);
-	outputFile << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+	*out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
 		<< "<!--\n";
-	for(const std::string& line: AirspaceConverter::disclaimer) outputFile << line << "\n";
-	outputFile << "\n" << AirspaceConverter::GetCreationDateString() << " -->\n"
+	for(const std::string& line: AirspaceConverter::disclaimer) *out << line << "\n";
+	*out << "\n" << AirspaceConverter::GetCreationDateString() << " -->\n"
 		<< "<kml xmlns = \"http://www.opengis.net/kml/2.2\">\n"
 		<< "<Document>\n"
 		<< "<open>true</open>\n";
 		if (airspacePresent) {
 			for (int t = Airspace::CLASSA; t <= Airspace::UNDEFINED; t++) {
-				outputFile << "<Style id = \"Style" << Airspace::CategoryName((Airspace::Type)t) << "\">\n"
+				*out << "<Style id = \"Style" << Airspace::CategoryName((Airspace::Type)t) << "\">\n"
 					<< "<LineStyle>\n"
 					<< "<color>" << colors[t][0] << "</color>\n"
 					<< "<width>1.5</width>\n"
@@ -159,7 +235,7 @@ void KML::WriteHeader(const bool airspacePresent, const bool waypointsPresent) {
 					<< "</PolyStyle>\n"
 					<< "</Style>\n";
 			}
-			outputFile << "<Schema name=\"\" id=\"AirspaceId\">\n"
+			*out << "<Schema name=\"\" id=\"AirspaceId\">\n"
 				<< "<SimpleField type=\"string\" name=\"Name\">\n"
 				<< "<displayName><![CDATA[<b>Name:</b>]]></displayName>\n"
 				<< "</SimpleField>\n"
@@ -188,23 +264,23 @@ void KML::WriteHeader(const bool airspacePresent, const bool waypointsPresent) {
 		}
 		if (waypointsPresent) {
 			for (int t = Waypoint::normal; t < Waypoint::numOfWaypointTypes; t++) {
-				outputFile << "<Style id = \"Style" << Waypoint::TypeName((Waypoint::WaypointType)t) << "\">\n"
+				*out << "<Style id = \"Style" << Waypoint::TypeName((Waypoint::WaypointType)t) << "\">\n"
 					<< "<IconStyle>\n"
 					<< "<Icon>\n"
 					<< "<href>icons/" << waypointIcons[t] <<"</href>\n"
 					<< "</Icon>\n"
 					<< "</IconStyle>\n";
 				if (Waypoint::IsTypeAirfield((Waypoint::WaypointType)t))
-					outputFile << "<LineStyle>\n"
+					*out << "<LineStyle>\n"
 						<< "<color>" << airfieldColors[t][0] << "</color>\n"
 						<< "<width>1.5</width>\n"
 						<< "</LineStyle>\n"
 						<< "<PolyStyle>\n"
 						<< "<color>" << airfieldColors[t][1] << "</color>\n"
 						<< "</PolyStyle>\n";
-				outputFile << "</Style>\n";
+				*out << "</Style>\n";
 			}
-			outputFile << "<Schema name=\"\" id=\"WaypointId\">\n"
+			*out << "<Schema name=\"\" id=\"WaypointId\">\n"
 				<< "<SimpleField type=\"string\" name=\"Name\">\n"
 				<< "<displayName><![CDATA[<b>Name:</b>]]></displayName>\n"
 				<< "</SimpleField>\n"
@@ -250,8 +326,12 @@ void KML::OpenPlacemark(const Airspace& airspace) {
 	std::string longName(name);
 	if (airspace.GetClass() != Airspace::UNDEFINED && (airspace.GetType() == Airspace::CTR || airspace.GetType() == Airspace::TMA)) longName.append(" - Class " + Airspace::CategoryName(airspace.GetClass()));
 	double area(0), perimeter(0);
-	airspace.CalculateSurface(area, perimeter);
-	outputFile << "<Placemark>\n"
+	const auto surface = surfaces.find(&airspace);
+	if (surface != surfaces.end()) {
+		area = surface->second.first;
+		perimeter = surface->second.second;
+	} else airspace.CalculateSurface(area, perimeter); // streaming
+	*out << "<Placemark>\n"
 		<< "<name>" << name << "</name>\n"
 		<< "<styleUrl>#Style" << airspace.GetCategoryName() << "</styleUrl>\n"
 		<< "<visibility>" << (airspace.IsVisibleByDefault() ? 1 : 0) << "</visibility>\n"
@@ -261,68 +341,67 @@ void KML::OpenPlacemark(const Airspace& airspace) {
 		<< "<SimpleData name=\"Category\">" << (airspace.GetType() <= Airspace::CLASSG ? ("Class " + airspace.GetCategoryName()) : airspace.GetCategoryName() ) << "</SimpleData>\n"
 		<< "<SimpleData name=\"Top\">" << airspace.GetTopAltitude().ToString() << "</SimpleData>\n"
 		<< "<SimpleData name=\"Base\">" << airspace.GetBaseAltitude().ToString() << "</SimpleData>\n";
-	outputFile << std::fixed << std::setprecision(3);
+	*out << std::fixed << std::setprecision(3);
 	for (size_t i=0; i<airspace.GetNumberOfRadioFrequencies(); i++) {
-		const std::pair<int, std::string>& f = airspace.GetRadioFrequencyAt(i);
-		outputFile << "<SimpleData name=\"Radio\">";
-		if (!f.second.empty()) outputFile << f.second << ": ";
-		outputFile << AirspaceConverter::FrequencyMHz(f.first) << "</SimpleData>\n";
+		const std::pair<int, InternedString>& f = airspace.GetRadioFrequencyAt(i);
+		*out << "<SimpleData name=\"Radio\">";
+		if (!f.second.IsEmpty()) *out << f.second << ": ";
+		*out << AirspaceConverter::FrequencyMHz(f.first) << "</SimpleData>\n";
 	}
-	if (airspace.HasTransponderCode()) outputFile << "<SimpleData name=\"Xpndr\">" << airspace.GetTransponderCode() << "</SimpleData>\n";
-	outputFile << std::setprecision(1) << "<SimpleData name=\"Area\">" << area << "</SimpleData>\n"
+	if (airspace.HasTransponderCode()) *out << "<SimpleData name=\"Xpndr\">" << airspace.GetTransponderCode() << "</SimpleData>\n";
+	*out << std::setprecision(1) << "<SimpleData name=\"Area\">" << area << "</SimpleData>\n"
 		<< "<SimpleData name=\"Perimeter\">" << perimeter << "</SimpleData>\n"
 		<< "</SchemaData>\n"
 		<< "</ExtendedData>\n";
-	outputFile.unsetf(std::ios_base::floatfield); //outputFile << std::defaultfloat; not supported by older GCC 4.9.0
+	out->unsetf(std::ios_base::floatfield); //*out << std::defaultfloat; not supported by older GCC 4.9.0
 }
 
-void KML::OpenPlacemark(const Waypoint* waypoint) {
-	const bool isAirfield = waypoint->IsAirfield();
-	const int altMt = (int)std::round(waypoint->GetAltitude());
+void KML::OpenPlacemark(const Waypoint& waypoint) {
+	const bool isAirfield = waypoint.IsAirfield();
+	const int altMt = (int)std::round(waypoint.GetAltitude());
 	const int altFt = (int)std::round(altMt / Altitude::FEET2METER);
-	outputFile << "<Placemark>\n"
-		<< "<name>" << PrepareTagText(waypoint->GetName()) << "</name>\n"
-		<< "<styleUrl>#Style" << waypoint->GetTypeName() << "</styleUrl>\n";
-	outputFile << "<visibility>" << (isAirfield ? 1 : 0) << "</visibility>\n"
+	*out << "<Placemark>\n"
+		<< "<name>" << PrepareTagText(waypoint.GetName()) << "</name>\n"
+		<< "<styleUrl>#Style" << waypoint.GetTypeName() << "</styleUrl>\n";
+	*out << "<visibility>" << (isAirfield ? 1 : 0) << "</visibility>\n"
 		<< "<ExtendedData>\n"
 		<< "<SchemaData schemaUrl=\"#WaypointId\">\n"
-		<< "<SimpleData name=\"Name\">" << PrepareTagText(waypoint->GetName()) << "</SimpleData>\n"
-		<< "<SimpleData name=\"Type\">" << waypoint->GetTypeName() << "</SimpleData>\n"
-		<< "<SimpleData name=\"Code\">" << PrepareTagText(waypoint->GetCode()) << "</SimpleData>\n"
-		<< "<SimpleData name=\"Country\">" << waypoint->GetCountry() << "</SimpleData>\n"
+		<< "<SimpleData name=\"Name\">" << PrepareTagText(waypoint.GetName()) << "</SimpleData>\n"
+		<< "<SimpleData name=\"Type\">" << waypoint.GetTypeName() << "</SimpleData>\n"
+		<< "<SimpleData name=\"Code\">" << PrepareTagText(waypoint.GetCode()) << "</SimpleData>\n"
+		<< "<SimpleData name=\"Country\">" << waypoint.GetCountry() << "</SimpleData>\n"
 		<< "<SimpleData name=\"AltMt\">" << altMt << "</SimpleData>\n"
 		<< "<SimpleData name=\"AltFt\">" << altFt << "</SimpleData>\n";
-	outputFile << std::fixed << std::setprecision(3);
+	*out << std::fixed << std::setprecision(3);
 	if(isAirfield) {
-		const Airfield* airfield = (const Airfield*)waypoint;
-		if (airfield->HasRunwayDir()) outputFile << "<SimpleData name=\"RwyDir\">" << airfield->GetRunwayDir() << "</SimpleData>\n";
-		if (airfield->HasRunwayLength()) outputFile << "<SimpleData name=\"RwyLen\">" << airfield->GetRunwayLength() << "</SimpleData>\n";
-		if (airfield->HasRadioFrequency()) outputFile << "<SimpleData name=\"Radio\">" << AirspaceConverter::FrequencyMHz(airfield->GetRadioFrequency()) << "</SimpleData>\n";
-		if (airfield->HasOtherFrequency()) outputFile << "<SimpleData name=\"Radio\">" << AirspaceConverter::FrequencyMHz(airfield->GetOtherFrequency()) << "</SimpleData>\n";
+		if (waypoint.HasRunwayDir()) *out << "<SimpleData name=\"RwyDir\">" << waypoint.GetRunwayDir() << "</SimpleData>\n";
+		if (waypoint.HasRunwayLength()) *out << "<SimpleData name=\"RwyLen\">" << waypoint.GetRunwayLength() << "</SimpleData>\n";
+		if (waypoint.HasRadioFrequency()) *out << "<SimpleData name=\"Radio\">" << AirspaceConverter::FrequencyMHz(waypoint.GetRadioFrequency()) << "</SimpleData>\n";
+		if (waypoint.HasOtherFrequency()) *out << "<SimpleData name=\"Radio\">" << AirspaceConverter::FrequencyMHz(waypoint.GetOtherFrequency()) << "</SimpleData>\n";
 	}
-	if (waypoint->HasOtherFrequency()) {
-		if (waypoint->GetType() == Waypoint::WaypointType::VOR)
-			outputFile << "<SimpleData name=\"VOR\">" << AirspaceConverter::FrequencyMHz(waypoint->GetOtherFrequency()) << "</SimpleData>\n";
-		else if (waypoint->GetType() == Waypoint::WaypointType::NDB)
-			outputFile << "<SimpleData name=\"NDB\">" << std::setprecision(1) << AirspaceConverter::FrequencykHz(waypoint->GetOtherFrequency()) << "</SimpleData>\n";
+	if (waypoint.HasOtherFrequency()) {
+		if (waypoint.GetType() == Waypoint::WaypointType::VOR)
+			*out << "<SimpleData name=\"VOR\">" << AirspaceConverter::FrequencyMHz(waypoint.GetOtherFrequency()) << "</SimpleData>\n";
+		else if (waypoint.GetType() == Waypoint::WaypointType::NDB)
+			*out << "<SimpleData name=\"NDB\">" << std::setprecision(1) << AirspaceConverter::FrequencykHz(waypoint.GetOtherFrequency()) << "</SimpleData>\n";
 	}
-	outputFile.unsetf(std::ios_base::floatfield); //outputFile << std::defaultfloat; not supported by older GCC 4.9.0
-	outputFile << "<SimpleData name=\"Desc\">" << PrepareTagText(waypoint->GetDescription()) << "</SimpleData>\n"
+	out->unsetf(std::ios_base::floatfield); //*out << std::defaultfloat; not supported by older GCC 4.9.0
+	*out << "<SimpleData name=\"Desc\">" << PrepareTagText(waypoint.GetDescription()) << "</SimpleData>\n"
 		<< "</SchemaData>\n"
 		<< "</ExtendedData>\n";
 }
 
 void KML::OpenPolygon(const bool extrude, const bool absolute) {
-	outputFile << "<Polygon>\n";
-	if (extrude) outputFile << "<extrude>1</extrude>\n";
-	outputFile << "<altitudeMode>" << (absolute ? "absolute" : "relativeToGround") << "</altitudeMode>\n"
+	*out << "<Polygon>\n";
+	if (extrude) *out << "<extrude>1</extrude>\n";
+	*out << "<altitudeMode>" << (absolute ? "absolute" : "relativeToGround") << "</altitudeMode>\n"
 		<< "<outerBoundaryIs>\n"
 		<< "<LinearRing>\n"
 		<< "<coordinates>\n";
 }
 
 void KML::ClosePolygon() {
-	outputFile << "</coordinates>\n"
+	*out << "</coordinates>\n"
 		<< "</LinearRing>\n"
 		<< "</outerBoundaryIs>\n"
 		<< "</Polygon>\n";
@@ -330,19 +409,19 @@ void KML::ClosePolygon() {
 
 void KML::WriteBaseOrTop(const Airspace& airspace, const Altitude& alt, const bool extrudeToGround /*= false*/) {
 	OpenPolygon(extrudeToGround, alt.IsAMSL());
-	outputFile << std::setprecision(6);
+	*out << std::setprecision(6);
 	double altitude = alt.GetAltMt();
-	for (const Geometry::LatLon& p : airspace.GetPoints()) outputFile << p.Lon() << "," << p.Lat() << "," << altitude << "\n";
+	for (const Geometry::LatLon& p : airspace.GetPoints()) *out << p.Lon() << "," << p.Lat() << "," << altitude << "\n";
 	ClosePolygon();
 }
 
 void KML::WriteBaseOrTop(const Airspace& airspace, const std::vector<double>& altitudesAmsl, const bool extrudeToGround /*= false*/) {
 	OpenPolygon(extrudeToGround, true);
 	assert(airspace.GetNumberOfPoints() == altitudesAmsl.size());
-	outputFile << std::setprecision(6);
+	*out << std::setprecision(6);
 	for (size_t i = 0; i < altitudesAmsl.size(); i++) {
 		const Geometry::LatLon p = airspace.GetPointAt(i);
-		outputFile << p.Lon() << "," << p.Lat() << "," << altitudesAmsl.at(i) << "\n";
+		*out << p.Lon() << "," << p.Lat() << "," << altitudesAmsl.at(i) << "\n";
 	}
 	ClosePolygon();
 }
@@ -358,7 +437,7 @@ void KML::WriteSideWalls(const Airspace& airspace) {
 		OpenPolygon(false, airspace.GetBaseAltitude().IsAMSL());
 		airspace.GetPointAt(i).GetLatLon(lat1, lon1);
 		airspace.GetPointAt(i + 1).GetLatLon(lat2, lon2);
-		outputFile << lon1 << "," << lat1 << "," << top << "\n"
+		*out << lon1 << "," << lat1 << "," << top << "\n"
 			<< lon2 << "," << lat2 << "," << top << "\n"
 			<< lon2 << "," << lat2 << "," << base << "\n"
 			<< lon1 << "," << lat1 << "," << base << "\n"
@@ -382,7 +461,7 @@ void KML::WriteSideWalls(const Airspace& airspace, const std::vector<double>& al
 		base2 = isBase ? altitudesAmsl.at(i+1) : airspace.GetBaseAltitude().GetAltMt();
 		airspace.GetPointAt(i).GetLatLon(lat1, lon1);
 		airspace.GetPointAt(i + 1).GetLatLon(lat2, lon2);
-		outputFile << lon1 << "," << lat1 << "," << top1 << "\n"
+		*out << lon1 << "," << lat1 << "," << top1 << "\n"
 			<< lon2 << "," << lat2 << "," << top2 << "\n"
 			<< lon2 << "," << lat2 << "," << base2 << "\n"
 			<< lon1 << "," << lat1 << "," << base1 << "\n"
@@ -391,24 +470,17 @@ void KML::WriteSideWalls(const Airspace& airspace, const std::vector<double>& al
 	}
 }
 
-bool KML::Write(const std::string& filename) {
-	
-	// Verify presence of waypoints and airspaces
-	const bool airspacesPresent = !airspaces.empty();
-	const bool waypointsPresent = !waypoints.empty();
-	if((!airspacesPresent && !waypointsPresent) || filename.empty()) {
-		AirspaceConverter::LogMessage("KML output: no airspace and no waypoints, nothing to write");
-		return false;
-	}
-	
+bool KML::OpenOutputFile(const std::string& filename, const bool airspacesPresent) {
+	kmzFile = filename;
+
 	// The file must be a KMZ
 	if (!boost::iequals(boost::filesystem::path(filename).extension().string(), ".kmz")) {
 		AirspaceConverter::LogError("Expected KMZ extension but found: " + boost::filesystem::path(filename).extension().string());
 		return false;
 	}
 
-	// Prepare pathname to the KML doc.kml; KMZ files should have the KML file name named as "doc.kml"
-	const std::string fileKML(boost::filesystem::path(boost::filesystem::path(filename).parent_path() / boost::filesystem::path("doc.kml")).string());
+	// Prepare pathname to the temporary KML, unique to allow writing more KMZ files in the same directory at the same time; in the KMZ it will be named "doc.kml"
+	fileKML = boost::filesystem::path(boost::filesystem::path(filename).parent_path() / boost::filesystem::unique_path("doc-%%%%-%%%%-%%%%-%%%%.kml")).string();
 
 	// Make sure the file is not already open
 	if (outputFile.is_open()) outputFile.close();
@@ -419,132 +491,240 @@ bool KML::Write(const std::string& filename) {
 		AirspaceConverter::LogError("Unable to open output file: " + filename);
 		return false;
 	}
-	AirspaceConverter::LogMessage("Writing output file: " + fileKML);
+	AirspaceConverter::LogMessage("Writing output file: " + filename);
+
+	// Write directly in the KML file, only the streamed airspaces go first in the spill files
+	out = &outputFile;
 
 	// Assume all points have AGL altitude covered (no point processed yet)
 	allAGLaltitudesCovered = true;
 
-	// Write KML header
+	// Write KML header and the waypoints if present
+	const bool waypointsPresent = !waypoints.IsEmpty();
 	WriteHeader(airspacesPresent, waypointsPresent);
+	if (waypointsPresent) WriteWaypoints(airspacesPresent);
+	return true;
+}
 
-	// If there are waypoints
-	if (waypointsPresent) {
-		
-		// If airspaces and waypoints are both present prepare a folder to group all the waypoints
-		if (airspacesPresent && waypointsPresent) 
-			outputFile << "<Folder>\n"
-				"<name>Waypoints</name>\n"
-				"<visibility>1</visibility>\n"
-				"<open>true</open>\n";
+void KML::WriteWaypoints(const bool airspacesPresent) {
 
-		// For each waypoint type
-		for (int t = Waypoint::unknown; t < Waypoint::numOfWaypointTypes; t++) {
+	// If airspaces and waypoints are both present prepare a folder to group all the waypoints
+	if (airspacesPresent) 
+		*out << "<Folder>\n"
+			"<name>Waypoints</name>\n"
+			"<visibility>1</visibility>\n"
+			"<open>true</open>\n";
 
-			// First verify if there are waypoints of that kind
-			if (waypoints.count(t) == 0) continue;
+	// For each waypoint type
+	for (int t = Waypoint::unknown; t < Waypoint::numOfWaypointTypes; t++) {
 
-			const bool isAirfield = Waypoint::IsTypeAirfield((Waypoint::WaypointType)t);
+		// First verify if there are waypoints of that kind
+		if (waypoints.Count((Waypoint::WaypointType)t) == 0) continue;
 
-			// Prepare the folder
-			outputFile << "<Folder>\n"
-				"<name>" << Waypoint::TypeName((Waypoint::WaypointType)t) << "</name>\n"
-				"<visibility>" << (isAirfield ? 1 : 0) <<"</visibility>\n"
-				"<open>false</open>\n";
-			
-			const auto filtered = waypoints.equal_range(t);
-			for (auto it = filtered.first; it != filtered.second; ++it) {
-				const Waypoint* w = it->second;
+		const bool isAirfield = Waypoint::IsTypeAirfield((Waypoint::WaypointType)t);
+
+		// Prepare the folder
+		*out << "<Folder>\n"
+			"<name>" << Waypoint::TypeName((Waypoint::WaypointType)t) << "</name>\n"
+			"<visibility>" << (isAirfield ? 1 : 0) <<"</visibility>\n"
+			"<open>false</open>\n";
+		
+		for (const Waypoint& w : waypoints.GetBucket((Waypoint::WaypointType)t)) {
 
-				// Open placemark
-				OpenPlacemark(w);
+			// Open placemark
+			OpenPlacemark(w);
 
-				// Flag to remember if the runway perimeter has been drawn
-				bool airfieldDrawn = false;
+			// Flag to remember if the runway perimeter has been drawn
+			bool airfieldDrawn = false;
 
-				int dir = -1;
+			int dir = -1;
+			
+			// If it is an airfield draw an estimation of the runway perimeter
+			if (isAirfield) {
 				
-				// If it is an airfield draw an estimation of the runway perimeter
-				if (isAirfield) {
-					
-					// Get the airfield
-					const Airfield* a = (const Airfield*)w;
-					
-					// Get its rinway length and direction
-					const int leng = a->GetRunwayLength();
-					dir = a->GetRunwayDir();
-
-					// If they are valid...
-					if (leng > 0 && dir > 0) {
-
-						// Calculate the runway perimeter
-						std::vector<Geometry::LatLon> airfieldPerimeter;
-						if (Geometry::CalcAirfieldPolygon(a->GetLatitude(), a->GetLongitude(), leng, dir, airfieldPerimeter)) {
-							
-							// Open a multigeometry with a polygon clamped onto the ground
-							outputFile << "<MultiGeometry>\n"
-								<< "<Polygon>\n"
-								//<< "<altitudeMode>clampToGround</altitudeMode>\n" //this should be the default
-								<< "<outerBoundaryIs>\n"
-								<< "<LinearRing>\n"
-								<< "<coordinates>\n";
-
-							// Add the four points
-							outputFile << std::setprecision(6);
-							for (const Geometry::LatLon& p : airfieldPerimeter)
-								outputFile << p.Lon() << "," << p.Lat() << "," << a->GetAltitude() << "\n";
-							
-							// Close the perimeter re-adding the first point 
-							outputFile << airfieldPerimeter.front().Lon() << "," << airfieldPerimeter.front().Lat() << "," << a->GetAltitude() << "\n";
-
-							// Close the polygon
-							ClosePolygon();
-
-							// The airfield perimeter has been drawn
-							airfieldDrawn = true;
-						}
+				// Get its rinway length and direction
+				const int leng = w.GetRunwayLength();
+				dir = w.GetRunwayDir();
+
+				// If they are valid...
+				if (leng > 0 && dir > 0) {
+
+					// Calculate the runway perimeter
+					std::vector<Geometry::LatLon> airfieldPerimeter;
+					if (Geometry::CalcAirfieldPolygon(w.GetLatitude(), w.GetLongitude(), leng, dir, airfieldPerimeter)) {
+						
+						// Open a multigeometry with a polygon clamped onto the ground
+						*out << "<MultiGeometry>\n"
+							<< "<Polygon>\n"
+							//<< "<altitudeMode>clampToGround</altitudeMode>\n" //this should be the default
+							<< "<outerBoundaryIs>\n"
+							<< "<LinearRing>\n"
+							<< "<coordinates>\n";
+
+						// Add the four points
+						*out << std::setprecision(6);
+						for (const Geometry::LatLon& p : airfieldPerimeter)
+							*out << p.Lon() << "," << p.Lat() << "," << w.GetAltitude() << "\n";
+						
+						// Close the perimeter re-adding the first point 
+						*out << airfieldPerimeter.front().Lon() << "," << airfieldPerimeter.front().Lat() << "," << w.GetAltitude() << "\n";
+
+						// Close the polygon
+						ClosePolygon();
+
+						// The airfield perimeter has been drawn
+						airfieldDrawn = true;
 					}
 				}
+			}
 
-				// Draw the waypoint marker
-				outputFile << "<Point>\n"
-					<< "<extrude>0</extrude>\n"
-					<< "<altitudeMode>" << (t != Waypoint::normal ? "clampToGround" : "absolute") << "</altitudeMode>\n" // Except "normal" are all objects on the ground
-					<< "<coordinates>" << std::setprecision(6) << w->GetLongitude() << "," << w->GetLatitude() << "," << (int)std::round(w->GetAltitude()) << "</coordinates>\n"
-					<< "</Point>\n";
+			// Draw the waypoint marker
+			*out << "<Point>\n"
+				<< "<extrude>0</extrude>\n"
+				<< "<altitudeMode>" << (t != Waypoint::normal ? "clampToGround" : "absolute") << "</altitudeMode>\n" // Except "normal" are all objects on the ground
+				<< "<coordinates>" << std::setprecision(6) << w.GetLongitude() << "," << w.GetLatitude() << "," << (int)std::round(w.GetAltitude()) << "</coordinates>\n"
+				<< "</Point>\n";
 
-				// If the perimeter was drawn the the multigeometry have to be closed
-				if (airfieldDrawn) outputFile << "</MultiGeometry>\n";
-				
-				// If there is a valid direction set the orientation of the airport icon as the runway
-				if (dir > 0)
-					outputFile << "<Style>\n"
-						<< "<IconStyle>\n"
-						<< "<heading>" << dir << "</heading>\n"
-						<< "</IconStyle>\n"
-						<< "</Style>\n";
-				
-				// Close the placemark
-				outputFile << "</Placemark>\n";
+			// If the perimeter was drawn the the multigeometry have to be closed
+			if (airfieldDrawn) *out << "</MultiGeometry>\n";
+			
+			// If there is a valid direction set the orientation of the airport icon as the runway
+			if (dir > 0)
+				*out << "<Style>\n"
+					<< "<IconStyle>\n"
+					<< "<heading>" << dir << "</heading>\n"
+					<< "</IconStyle>\n"
+					<< "</Style>\n";
+			
+			// Close the placemark
+			*out << "</Placemark>\n";
+		}
+
+		// Close the category
+		*out << "</Folder>\n";
+	} // for each category
+
+	// Close waypoints folder
+	if (airspacesPresent) *out << "</Folder>\n";
+}
+
+void KML::OpenCategoryFolder(const int category) {
+	*out << "<Folder>\n"
+		"<name>" << Airspace::CategoryName((Airspace::Type)category) << "</name>\n"
+		"<visibility>" << (Airspace::CategoryVisibleByDefault((Airspace::Type)category) ? 1 : 0) <<"</visibility>\n"
+		"<open>false</open>\n";
+}
+
+void KML::WriteAirspacePlacemark(const Airspace& a) {
+	assert(a.GetNumberOfPoints() > 3);
+	assert(a.GetFirstPoint()==a.GetLastPoint());
+
+	OpenPlacemark(a);
+
+	if ((a.IsMSLbased() && a.IsAMSLtopped()) || (a.IsGNDbased() && a.IsAMSLtopped())) WriteBaseOrTop(a, a.GetTopAltitude(), true); // base on the sea or on graund and AMSL top: that's easy!
+	else if ((a.IsMSLbased() && a.IsAGLtopped()) || (a.IsGNDbased() && a.IsAGLtopped())) { // in this case it's more complicated
+
+		const double altitudeAGLmt = a.GetTopAltitude().GetAltMt();
+
+		// Try to get terrein altitude then add the AGL altitude to get AMSL altitude
+		std::vector<double> amslAltitudesMt;
+		for (const Geometry::LatLon& p : a.GetPoints()) {
+			double terrainHeightMt = AirspaceConverter::GetDefaultTerrainAlt();
+			allAGLaltitudesCovered = AirspaceConverter::GetTerrainAltitudeMt(p.Lat(), p.Lon(), terrainHeightMt) && allAGLaltitudesCovered;
+			amslAltitudesMt.push_back(terrainHeightMt + altitudeAGLmt);
+		}
+
+		// Write the top points reobtained as AMSL
+		WriteBaseOrTop(a, amslAltitudesMt, true);
+
+	} else { // otherwise we have to misuse even more KML which is not properly done to draw middle air airspaces
+		*out << "<MultiGeometry>\n";
+
+		if (a.GetTopAltitude().IsAMSL() == a.GetBaseAltitude().IsAMSL()) { // same reference, still doable
+
+			// Top
+			WriteBaseOrTop(a, a.GetTopAltitude());
+
+			// Base
+			WriteBaseOrTop(a, a.GetBaseAltitude());
+
+			// Sides
+			WriteSideWalls(a);
+		}
+		else { // base and top altitudes not on the same reference: so find all absolute altitudes!
+			const double altitudeAGLmt = (a.GetBaseAltitude().IsAGL() ? a.GetBaseAltitude() : a.GetTopAltitude()).GetAltMt();
+
+			// Try to get terrein altitude then add the AGL altitude to get AMSL altitude
+			std::vector<double> amslAltitudesMt;
+			for (const Geometry::LatLon& p : a.GetPoints()) {
+				double terrainHeightMt = AirspaceConverter::GetDefaultTerrainAlt();
+				allAGLaltitudesCovered = AirspaceConverter::GetTerrainAltitudeMt(p.Lat(), p.Lon(), terrainHeightMt) && allAGLaltitudesCovered;
+				amslAltitudesMt.push_back(terrainHeightMt + altitudeAGLmt);
 			}
 
-			// Close the category
-			outputFile << "</Folder>\n";
-		} // for each category
+			// Top or base, the one that is already defined as AMSL
+			WriteBaseOrTop(a, a.GetTopAltitude().IsAMSL() ? a.GetTopAltitude() : a.GetBaseAltitude());
 
-		// Close waypoints folder
-		if (airspacesPresent && waypointsPresent) outputFile << "</Folder>\n";
-	} // if airspaces
+			// The other one where the altitude of the points has been reobtained as AMSL
+			WriteBaseOrTop(a, amslAltitudesMt);
+
+			// Sides, where the points with altitude AGL were reobtained as AMSL
+			WriteSideWalls(a, amslAltitudesMt);
+		}
+		*out << "</MultiGeometry>\n";
+	}
+	*out << "</Placemark>\n";
+}
+
+void KML::CalculateSurfaces() {
+	std::vector<const Airspace*> list;
+	list.reserve(airspaces.size());
+	for (const std::pair<const int, Airspace>& a : airspaces) list.push_back(&a.second);
+	std::vector<std::pair<double, double>> results(list.size());
+	Parallel::For(list.size(), [&list, &results](const size_t begin, const size_t end) {
+		for (size_t i = begin; i < end; i++) list[i]->CalculateSurface(results[i].first, results[i].second);
+	}, 64);
+	surfaces.clear();
+	surfaces.reserve(list.size());
+	for (size_t i = 0; i < list.size(); i++) surfaces.emplace(list[i], results[i]);
+}
+
+bool KML::Write(const std::string& filename) {
+	
+	// Verify presence of waypoints and airspaces
+	const bool airspacesPresent = !airspaces.empty();
+	const bool waypointsPresent = !waypoints.IsEmpty();
+	if((!airspacesPresent && !waypointsPresent) || filename.empty()) {
+		AirspaceConverter::LogMessage("KML output: no airspace and no waypoints, nothing to write");
+		return false;
+	}
+
+	// Open the output and write the header and the waypoints
+	if (!OpenOutputFile(filename, airspacesPresent)) return false;
 
 	// If there are airspaces
 	if(airspacesPresent) {
 
 		// If airspaces and waypoints are both present prepare a folder to group all the airspace
-		if (airspacesPresent && waypointsPresent)
-			outputFile << "<Folder>\n"
+		if (waypointsPresent)
+			*out << "<Folder>\n"
 				"<name>Airspace</name>\n"
 				"<visibility>1</visibility>\n"
 				"<open>true</open>\n";
 
+		// Or the tiles, each one in its own file
+		if (tileSize > 0) {
+			const bool tilesWritten = WriteTiles();
+			if (waypointsPresent) *out << "</Folder>\n";
+			const bool done = tilesWritten && MakeKMZ();
+			if (!tilesWritten) RemoveDocumentFile();
+			RemoveTileFiles();
+			return done;
+		}
+
+		// Area and perimeter of all the airspaces, calculated in parallel before writing
+		CalculateSurfaces();
+
 		// For each airspace category
 		for (int t = Airspace::CLASSA; t <= Airspace::UNDEFINED; t++) {
 
@@ -552,137 +732,219 @@ bool KML::Write(const std::string& filename) {
 			if (airspaces.count(t) == 0) continue;
 
 			// Prepare the folder
-			outputFile << "<Folder>\n"
-				"<name>" << Airspace::CategoryName((Airspace::Type)t) << "</name>\n"
-				"<visibility>" << (Airspace::CategoryVisibleByDefault((Airspace::Type)t) ? 1 : 0) <<"</visibility>\n"
-				"<open>false</open>\n";
+			OpenCategoryFolder(t);
 
 			const auto filtered = airspaces.equal_range(t);
-			for (auto it = filtered.first; it != filtered.second; ++it) {
-
-				const Airspace& a = it->second;
-
-				assert(a.GetNumberOfPoints() > 3);
-				assert(a.GetFirstPoint()==a.GetLastPoint());
-
-				OpenPlacemark(a);
-
-				if ((a.IsMSLbased() && a.IsAMSLtopped()) || (a.IsGNDbased() && a.IsAMSLtopped())) WriteBaseOrTop(a, a.GetTopAltitude(), true); // base on the sea or on graund and AMSL top: that's easy!
-				else if ((a.IsMSLbased() && a.IsAGLtopped()) || (a.IsGNDbased() && a.IsAGLtopped())) { // in this case it's more complicated
-
-					const double altitudeAGLmt = a.GetTopAltitude().GetAltMt();
-
-					// Try to get terrein altitude then add the AGL altitude to get AMSL altitude
-					std::vector<double> amslAltitudesMt;
-					for (const Geometry::LatLon& p : a.GetPoints()) {
-						double terrainHeightMt = AirspaceConverter::GetDefaultTerrainAlt();
-						allAGLaltitudesCovered = AirspaceConverter::GetTerrainAltitudeMt(p.Lat(), p.Lon(), terrainHeightMt) && allAGLaltitudesCovered;
-						amslAltitudesMt.push_back(terrainHeightMt + altitudeAGLmt);
-					}
+			for (auto it = filtered.first; it != filtered.second; ++it) WriteAirspacePlacemark(it->second);
 
-					// Write the top points reobtained as AMSL
-					WriteBaseOrTop(a, amslAltitudesMt, true);
-	
-				} else { // otherwise we have to misuse even more KML which is not properly done to draw middle air airspaces
-					outputFile << "<MultiGeometry>\n";
+			// Close category folder
+			*out << "</Folder>\n";
+		} // for each category
 
-					if (a.GetTopAltitude().IsAMSL() == a.GetBaseAltitude().IsAMSL()) { // same reference, still doable
+		// Close airspaces folder
+		if (waypointsPresent) *out << "</Folder>\n";
+		surfaces.clear();
+	} // if airspaces
 
-						// Top
-						WriteBaseOrTop(a, a.GetTopAltitude());
+	return MakeKMZ();
+}
 
-						// Base
-						WriteBaseOrTop(a, a.GetBaseAltitude());
+bool KML::OpenOutput(const std::string& filename) {
+	RemoveSpillFiles();
+	if (filename.empty()) return false;
+	return OpenOutputFile(filename, true);
+}
 
-						// Sides
-						WriteSideWalls(a);
-					}
-					else { // base and top altitudes not on the same reference: so find all absolute altitudes!
-						const double altitudeAGLmt = (a.GetBaseAltitude().IsAGL() ? a.GetBaseAltitude() : a.GetTopAltitude()).GetAltMt();
-
-						// Try to get terrein altitude then add the AGL altitude to get AMSL altitude
-						std::vector<double> amslAltitudesMt;
-						for (const Geometry::LatLon& p : a.GetPoints()) {
-							double terrainHeightMt = AirspaceConverter::GetDefaultTerrainAlt();
-							allAGLaltitudesCovered = AirspaceConverter::GetTerrainAltitudeMt(p.Lat(), p.Lon(), terrainHeightMt) && allAGLaltitudesCovered;
-							amslAltitudesMt.push_back(terrainHeightMt + altitudeAGLmt);
-						}
+bool KML::WriteAirspace(const Airspace& airspace) {
+	assert(outputFile.is_open());
+
+	// Each category is buffered in its own temporary file, to be grouped in its folder at the end
+	std::pair<std::string, std::unique_ptr<std::ofstream>>& spill = spillFiles[airspace.GetType()];
+	if (!spill.second) {
+		spill.first = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("airspaceconverter-%%%%-%%%%-%%%%-%%%%.kml")).string();
+		spill.second.reset(new std::ofstream(spill.first, std::ios::out | std::ios::trunc | std::ios::binary));
+		if (!spill.second->is_open() || spill.second->bad()) {
+			AirspaceConverter::LogError("Unable to open temporary file: " + spill.first);
+			spillFiles.erase(airspace.GetType());
+			return false;
+		}
+	}
+	out = spill.second.get();
+	WriteAirspacePlacemark(airspace);
+	out = &outputFile;
+	return true;
+}
 
-						// Top or base, the one that is already defined as AMSL
-						WriteBaseOrTop(a, a.GetTopAltitude().IsAMSL() ? a.GetTopAltitude() : a.GetBaseAltitude());
+bool KML::CloseOutput() {
+	assert(outputFile.is_open());
+	const bool waypointsPresent = !waypoints.IsEmpty();
+
+	// If airspaces and waypoints are both present prepare a folder to group all the airspace
+	if (!spillFiles.empty() && waypointsPresent)
+		outputFile << "<Folder>\n"
+			"<name>Airspace</name>\n"
+			"<visibility>1</visibility>\n"
+			"<open>true</open>\n";
+
+	// Copy each category from its temporary file in its folder, in the same order of the categories
+	for (std::pair<const int, std::pair<std::string, std::unique_ptr<std::ofstream>>>& category : spillFiles) {
+		category.second.second->close();
+		OpenCategoryFolder(category.first);
+		std::ifstream spill(category.second.first, std::ios::in | std::ios::binary);
+		if (spill.peek() != std::ifstream::traits_type::eof()) outputFile << spill.rdbuf();
+		spill.close();
+		outputFile << "</Folder>\n";
+	}
+	if (!spillFiles.empty() && waypointsPresent) outputFile << "</Folder>\n";
+	RemoveSpillFiles();
+	return MakeKMZ();
+}
 
-						// The other one where the altitude of the points has been reobtained as AMSL
-						WriteBaseOrTop(a, amslAltitudesMt);
+bool KML::WriteTiles() {
+	// Each airspace goes in the tile of the center of its bounding box, in the same order of the categories
+	struct Tile {
+		Tile() : north(-90), south(90), east(-180), west(180) {}
+		std::vector<const Airspace*> members;
+		double north, south, east, west; // bounding box of all its airspaces: the region where the tile is loaded, its longitudes can go beyond 180
+	};
+	std::map<std::pair<int, int>, Tile> grid; // by row and column
+	for (const std::pair<const int, Airspace>& a : airspaces) {
+		double north = -90, south = 90, east = -180, west = 180, unwrappedEast = 0, unwrappedWest = 360;
+		for (const Geometry::LatLon& p : a.second.GetPoints()) {
+			north = std::max(north, p.Lat());
+			south = std::min(south, p.Lat());
+			east = std::max(east, p.Lon());
+			west = std::min(west, p.Lon());
+			const double lon = p.Lon() < 0 ? p.Lon() + 360 : p.Lon();
+			unwrappedEast = std::max(unwrappedEast, lon);
+			unwrappedWest = std::min(unwrappedWest, lon);
+		}
+		if (east - west > 180) { // across the antimeridian: its box goes beyond 180, with the center normalized
+			east = unwrappedEast;
+			west = unwrappedWest;
+			if ((east + west) / 2 >= 180) {
+				east -= 360;
+				west -= 360;
+			}
+		}
+		Tile& tile = grid[std::make_pair((int)std::floor(((north + south) / 2 + 90) / tileSize), (int)std::floor(((east + west) / 2 + 180) / tileSize))];
+		tile.north = std::max(tile.north, north);
+		tile.south = std::min(tile.south, south);
+		tile.east = std::max(tile.east, east);
+		tile.west = std::min(tile.west, west);
+		tile.members.push_back(&a.second);
+	}
 
-						// Sides, where the points with altitude AGL were reobtained as AMSL
-						WriteSideWalls(a, amslAltitudesMt);
-					}
-					outputFile << "</MultiGeometry>\n";
-				}
-				outputFile << "</Placemark>\n";
+	// In the main document a link to each tile, with its region
+	RemoveTileFiles();
+	std::vector<const Tile*> tiles;
+	*out << std::fixed << std::setprecision(6);
+	for (const std::pair<const std::pair<int, int>, Tile>& cell : grid) {
+		const Tile& tile = cell.second;
+		const std::string name(boost::str(boost::format("tiles/%1d_%2d.kml") %cell.first.first %cell.first.second));
+		tileFiles.push_back(std::make_pair((boost::filesystem::path(kmzFile).parent_path() / boost::filesystem::unique_path("tile-%%%%-%%%%-%%%%-%%%%.kml")).string(), name));
+		tiles.push_back(&tile);
+		*out << "<NetworkLink>\n"
+			<< "<name>" << boost::str(boost::format("Airspace %1$g, %2$g") %(cell.first.first * tileSize - 90) %(cell.first.second * tileSize - 180)) << "</name>\n"
+			<< "<Region>\n"
+			<< "<LatLonAltBox>\n"
+			<< "<north>" << tile.north << "</north>\n"
+			<< "<south>" << tile.south << "</south>\n"
+			<< "<east>" << (tile.east > 180 ? tile.east - 360 : tile.east) << "</east>\n" // west greater than east across the antimeridian
+			<< "<west>" << (tile.west < -180 ? tile.west + 360 : tile.west) << "</west>\n"
+			<< "</LatLonAltBox>\n"
+			<< "<Lod>\n"
+			<< "<minLodPixels>" << TILE_MIN_LOD_PIXELS << "</minLodPixels>\n"
+			<< "</Lod>\n"
+			<< "</Region>\n"
+			<< "<Link>\n"
+			<< "<href>" << name << "</href>\n"
+			<< "<viewRefreshMode>onRegion</viewRefreshMode>\n"
+			<< "</Link>\n"
+			<< "</NetworkLink>\n";
+	}
+	out->unsetf(std::ios_base::floatfield);
+
+	// The tiles are written in parallel, each one by its own writer, with the styles and a folder for each category
+	std::vector<char> written(tiles.size(), 0), covered(tiles.size(), 0);
+	Parallel::Schedule(tiles.size(), [&](const size_t i) {
+		std::ofstream tileFile(tileFiles[i].first, std::ios::out | std::ios::trunc | std::ios::binary);
+		if (!tileFile.is_open() || tileFile.bad()) return;
+		KML writer(airspaces, waypoints);
+		writer.out = &tileFile;
+		writer.WriteHeader(true, false);
+		int category = -1;
+		for (const Airspace* airspace : tiles[i]->members) {
+			if (airspace->GetType() != category) {
+				if (category >= 0) tileFile << "</Folder>\n";
+				category = airspace->GetType();
+				writer.OpenCategoryFolder(category);
 			}
+			writer.WriteAirspacePlacemark(*airspace);
+		}
+		tileFile << "</Folder>\n"
+			<< "</Document>\n"
+			<< "</kml>\n";
+		tileFile.close();
+		written[i] = tileFile.good() ? 1 : 0;
+		covered[i] = writer.allAGLaltitudesCovered ? 1 : 0;
+	});
+	allAGLaltitudesCovered = allAGLaltitudesCovered && std::count(covered.begin(), covered.end(), 0) == 0;
+	for (size_t i = 0; i < tiles.size(); i++) if (!written[i]) {
+		AirspaceConverter::LogError("Unable to write the temporary tile file: " + tileFiles[i].first);
+		return false;
+	}
+	AirspaceConverter::LogMessage(boost::str(boost::format("Airspaces split in %1$d tile(s) of %2$g degrees") %tiles.size() %tileSize));
+	return true;
+}
 
-			// Close category folder
-			outputFile << "</Folder>\n";
-		} // for each category
+void KML::RemoveTileFiles() {
+	for (const std::pair<std::string, std::string>& tile : tileFiles) std::remove(tile.first.c_str());
+	tileFiles.clear();
+}
 
-		// Close airspaces folder
-		if (airspacesPresent && waypointsPresent) outputFile << "</Folder>\n";
-	} // if airspaces
+void KML::RemoveDocumentFile() {
+	if (outputFile.is_open()) outputFile.close();
+	if (!fileKML.empty()) std::remove(fileKML.c_str());
+	fileKML.clear();
+}
 
-	outputFile << "</Document>\n"
+void KML::RemoveSpillFiles() {
+	for (std::pair<const int, std::pair<std::string, std::unique_ptr<std::ofstream>>>& category : spillFiles) {
+		if (category.second.second->is_open()) category.second.second->close();
+		std::remove(category.second.first.c_str());
+	}
+	spillFiles.clear();
+}
+
+bool KML::MakeKMZ() {
+	*out << "</Document>\n"
 		<< "</kml>\n";
 	outputFile.close();
 
 	// Compress (ZIP) and do make the KMZ file
-	AirspaceConverter::LogMessage("Compressing into KMZ: " + filename);
+	AirspaceConverter::LogMessage("Compressing into KMZ: " + kmzFile);
 
 	// To avoid problems it is better to delete the KMZ file if already existing, user has already been warned
-	if (boost::filesystem::exists(filename)) std::remove(filename.c_str()); // Delete KMZ file
+	if (boost::filesystem::exists(kmzFile)) std::remove(kmzFile.c_str()); // Delete KMZ file
 
 	// Open the ZIP file
 	int error = 0;
-	zip* archive = zip_open(filename.c_str(), ZIP_CREATE, &error);
+	zip* archive = zip_open(kmzFile.c_str(), ZIP_CREATE, &error);
 	if (error) {
-		AirspaceConverter::LogError("Could not open or create archive: " + filename);
+		AirspaceConverter::LogError("Could not open or create archive: " + kmzFile);
+		RemoveDocumentFile();
 		return false;
 	}
 
-	// Create source buffer from KML file
-	assert(boost::filesystem::path(fileKML).filename().string() == "doc.kml");
-	zip_source* source = zip_source_file(archive, fileKML.c_str(), 0, 0);
-	if (source == nullptr) { // "failed to create source buffer. " << zip_strerror(archive)
-		// Discard zip file. In case ZIP_FL_OVERWRITE is not defined we are using an older libzib version such as 0.10.1, so we have to use the older functions
-#ifdef ZIP_FL_OVERWRITE
-		zip_discard(archive);
-#else
-		zip_close(archive);
-#endif
-		AirspaceConverter::LogError("Failed to create zip source buffer to read: " + fileKML);
-		return false;
-	}
-
-	// Add the buffer as KLM file in the ZIP
-#ifdef ZIP_FL_OVERWRITE
-	int index = (int)zip_file_add(archive, "doc.kml", source, ZIP_FL_OVERWRITE);
-#else
-	int index = (int)zip_add(archive, "doc.kml", source);
-#endif
-	if (index < 0) { // "failed to add file to archive. " << zip_strerror(archive)
-#ifdef ZIP_FL_OVERWRITE
-		zip_discard(archive);
-#else
-		zip_close(archive);
-#endif
-		zip_source_free(source); // The sorce buffer have to be freed in this case
-		AirspaceConverter::LogError("While compressing, failed to add: doc.kml");
-		return false;
-	}
+	// Add the KML file, then the tiles if any; if one fails the archive is already discarded
+	bool added = AddFileToArchive(archive, fileKML, "doc.kml");
+	for (size_t i = 0; added && i < tileFiles.size(); i++) added = AddFileToArchive(archive, tileFiles[i].first, tileFiles[i].second);
 
 	// If it is necessary to add also the icons
-	if (!waypoints.empty()) {
-		for (int i = Waypoint::unknown; i < Waypoint::numOfWaypointTypes; i++) {
-			// Get the icon PNG filename and prepare the path in the ZIP and the path from current dir
+	if (added && !waypoints.IsEmpty()) {
+		for (int i = Waypoint::unknown; added && i < Waypoint::numOfWaypointTypes; i++) {
+			// Get the icon PNG kmzFile and prepare the path in the ZIP and the path from current dir
 			const std::string iconPath = iconsPath + waypointIcons[i];
 
 			// Check if we can get that PNG file
@@ -690,46 +952,28 @@ bool KML::Write(const std::string& filename) {
 				AirspaceConverter::LogError("Unable to find icon PNG file: " + iconPath);
 				continue;
 			}
-
-			// Create source buffer from KML file
-			source = zip_source_file(archive, iconPath.c_str(), 0, 0);
-			if (source == nullptr) { // "failed to create source buffer. " << zip_strerror(archive)
-#ifdef ZIP_FL_OVERWRITE
-				zip_discard(archive);
-#else
-				zip_close(archive);
-#endif
-				AirspaceConverter::LogError("Failed to create zip source buffer to read: " + iconPath);
-				return false;
-			}
-
-			// Add the buffer as PNG file in the ZIP
-			const std::string iconFile = "icons/" + waypointIcons[i];
-#ifdef ZIP_FL_OVERWRITE
-			index = (int)zip_file_add(archive, iconFile.c_str(), source, ZIP_FL_OVERWRITE);
-#else
-			index = (int)zip_add(archive, iconFile.c_str(), source);
-#endif
-			if (index < 0) { // "failed to add file to archive. " << zip_strerror(archive)
-#ifdef ZIP_FL_OVERWRITE
-				zip_discard(archive);
-#else
-				zip_close(archive);
-#endif
-				zip_source_free(source); // The sorce buffer have to be freed in this case
-				AirspaceConverter::LogError("While compressing, failed to add: " + iconFile);
-				return false;
-			}
+			added = AddFileToArchive(archive, iconPath, "icons/" + waypointIcons[i]);
 		}
 	}
 
-	// Close the zip
-	if (zip_close(archive) == 0) {
-		std::remove(fileKML.c_str()); // Delete KML file
-		return true;
+	// Close the zip, in any case the temporary KML is not needed anymore
+	bool done = false;
+	if (added) {
+		done = zip_close(archive) == 0;
+		if (!done) {
+			AirspaceConverter::LogError("While finalizing the archive.");
+			DiscardArchive(archive);
+		}
 	}
-	AirspaceConverter::LogError("While finalizing the archive.");
-	return false;
+	RemoveDocumentFile();
+	return done;
+}
+
+void KML::StoreAirspace(Airspace& airspace) {
+	if (airspaceHandler) {
+		airspaceHandler(airspace);
+		airspace.Clear();
+	} else airspaces.insert(std::pair<int, Airspace>(airspace.GetType(), std::move(airspace)));
 }
 
 bool KML::ReadKMZ(const std::string& filename) {
@@ -751,134 +995,96 @@ bool KML::ReadKMZ(const std::string& filename) {
 
 	AirspaceConverter::LogMessage("Opened KMZ file: " + filename);
 
-	std::string extractedKmlFile;
+	// Iterate trough the contents: look for all the KML files, also the ones in the directories as the tiles
+	std::vector<std::pair<long, std::string>> entries; // index and name in the ZIP
 	struct zip_stat sb;
-
-	// Iterate trough the contents: look for the first KML file in the root of the ZIP file
 	for (long i=0; i<nFiles; i++) {
 		if (zip_stat_index(archive, i, 0, &sb) != 0) {
 			AirspaceConverter::LogError("while reading KMZ, unable to get details of a file in the ZIP.");
 			continue;
 		}
-		int len = (int)strlen(sb.name);
+		const int len = (int)strlen(sb.name);
 
 		// Skip dirs
-		if (sb.name[len - 1] == '/') continue;
+		if (len == 0 || sb.name[len - 1] == '/') continue;
 
 		// Skip empty files
 		if(sb.size == 0) continue;
 
-		boost::filesystem::path zippedFilePath(sb.name);
-
-		// Skip files not in the root of the ZIP
-		if (!zippedFilePath.parent_path().string().empty()) continue;
-
 		// Skip non KML files
-		if (!boost::iequals(zippedFilePath.extension().string(),".kml")) continue;
-
-		struct zip_file* zf = zip_fopen_index(archive, i, 0);
-		if (zf == nullptr) {
-			AirspaceConverter::LogError("while extracting, unable to open KML file from KMZ: " + filename);
-			continue;
-		}
-
-		// Prepare path and name of the kml file
-		extractedKmlFile = boost::filesystem::path(boost::filesystem::path(filename).parent_path() / boost::filesystem::path(sb.name)).string();
+		if (!boost::iequals(boost::filesystem::path(sb.name).extension().string(),".kml")) continue;
 
-		// To avoid problems it is better to delete the KML file if already existing, user has already been warned
-		if (boost::filesystem::exists(extractedKmlFile)) std::remove(extractedKmlFile.c_str()); // Delete KML file
+		entries.push_back(std::make_pair(i, std::string(sb.name)));
+	}
 
-		// Open the file to be extracted: open new file
-		std::ofstream kmlFile;
-		kmlFile.open(extractedKmlFile, std::ios::out | std::ios::trunc | std::ios::binary);
-		if (!kmlFile.is_open() || kmlFile.bad()) {
-			AirspaceConverter::LogError("While extracting KML file, unable to write: " + extractedKmlFile);
-			zip_fclose(zf);
-			zip_close(archive);
-			return false;
-		}
+	// No KML... no party...
+	if (entries.empty()) {
+		AirspaceConverter::LogError("No KML file found in KMZ: " + filename);
+		zip_close(archive);
+		return false;
+	}
 
-		// Read from the ZIP and write to the extracted file
-		char buf[8000]; // 8000, the size of this read buffer, is just quite big number which I like
-		unsigned long sum = 0;
-		while (sum < sb.size) {
-			len = (int)zip_fread(zf, buf, 8000);
-			if (len < 0) {
-				AirspaceConverter::LogError("While extracting KML file, unable read compressed data from: " + filename);
-				kmlFile.close();
-				zip_fclose(zf);
-				zip_close(archive);
-				return false;
+	// When streaming each KML is read in order, passing its airspaces directly to the handler
+	size_t failed = 0;
+	if (airspaceHandler) {
+		for (const std::pair<long, std::string>& entry : entries) {
+			std::string content;
+			std::istringstream input;
+			if (ExtractFromArchive(archive, entry.first, filename, content)) {
+				input.str(content);
+				std::string().swap(content); // the stream has its own copy
+				if (ParseKML(input, entry.second)) continue;
 			}
-			kmlFile.write(buf, len);
-			sum += len;
+			failed++;
 		}
-
-		// Close all
-		kmlFile.close();
-		zip_fclose(zf);
-
-		AirspaceConverter::LogMessage("Extracted KML file: " + std::string(sb.name));
-
-		// If we arrived at this point we assume that we just found and correctly extracted the KML file and so we don't need to go further in the KMZ
-		break;
+		zip_close(archive);
+		return failed < entries.size();
 	}
 
-	// Close the ZIP archive
+	// Otherwise the KML files are extracted, in memory, and parsed in parallel, each one by its own reader in its own container, then all are merged in the same order
+	std::vector<std::multimap<int, Airspace>> parsed(entries.size());
+	std::vector<char> read(entries.size(), 0);
+	{
+		AirspaceConverter::SerializedLog serializedLog; // meanwhile the readers log from different threads
+		Parallel::For(entries.size(), [&](const size_t begin, const size_t end) {
+			int openError = 0;
+			zip* workerArchive = begin == 0 ? archive : zip_open(filename.c_str(), 0, &openError); // the first chunk is done by this thread, the others with their own handle to decompress at the same time
+			if (openError) {
+				AirspaceConverter::LogError("Could not open KMZ file: " + filename);
+				return;
+			}
+			for (size_t e = begin; e < end; e++) {
+				std::string content;
+				if (!ExtractFromArchive(workerArchive, entries[e].first, filename, content)) continue;
+				std::istringstream input(content);
+				std::string().swap(content); // the stream has its own copy
+				WaypointSet noWaypoints;
+				KML reader(parsed[e], noWaypoints);
+				reader.processLineString = processLineString;
+				read[e] = reader.ParseKML(input, entries[e].second) ? 1 : 0;
+			}
+			if (workerArchive != archive) zip_close(workerArchive);
+		});
+	}
 	zip_close(archive);
-
-	// No KML... no party...
-	if(extractedKmlFile.empty()) return false;
-
-	// So then ... let's try to read the KML file
-	bool retValue = ReadKML(extractedKmlFile);
-
-	// Delete the, probably huge, KML file because it already compressed inside the KMZ
-	std::remove(extractedKmlFile.c_str());
-
-	return retValue;
+	for (size_t e = 0; e < entries.size(); e++) {
+		if (!read[e]) failed++;
+		for (std::pair<const int, Airspace>& a : parsed[e]) airspaces.insert(std::pair<int, Airspace>(a.first, std::move(a.second)));
+		parsed[e].clear();
+	}
+	if (entries.size() > 1) AirspaceConverter::LogMessage(boost::str(boost::format("Read %1d KML file(s) from KMZ: %2s") %(entries.size() - failed) %filename));
+	return failed < entries.size();
 }
 
 bool KML::ProcessFolder(const boost::property_tree::ptree& folder, const int upperCategory) {
 	const std::string categoryName = folder.get<std::string>("name"); // Try to guess the category from the name of folder
-	int thisCategory = Airspace::Type::UNDEFINED;
-	const std::string::size_type first = categoryName.find('(');
-	if (first != std::string::npos) {
-		const std::string::size_type last = categoryName.find(')');
-		if (last != std::string::npos && first < last) {
-			const std::string shortCategory = categoryName.substr(first+1, last-first-1);
-			if (shortCategory.length() == 1) {
-				switch (shortCategory.at(0)) {
-				case 'A': thisCategory = Airspace::Type::CLASSA; break;
-				case 'B': thisCategory = Airspace::Type::CLASSB; break;
-				case 'C': thisCategory = Airspace::Type::CLASSC; break;
-				case 'D': thisCategory = (categoryName == "Danger areas (D)") ? Airspace::Type::DANGER : Airspace::Type::CLASSD; break;
-				case 'E': thisCategory = Airspace::Type::CLASSE; break;
-				case 'F': thisCategory = Airspace::Type::CLASSF; break;
-				case 'G': thisCategory = Airspace::Type::CLASSG; break;
-				case 'P': thisCategory = Airspace::Type::PROHIBITED; break;
-				case 'R': thisCategory = Airspace::Type::RESTRICTED; break;					
-				default: break;
-				}
-			} else {
-				if (shortCategory == "TMA") thisCategory = Airspace::Type::TMA; //Terminal control areas
-				else if (shortCategory == "CTR") thisCategory = Airspace::Type::CTR; //Control zones
-				else if (shortCategory == "RMZ") thisCategory = Airspace::Type::RMZ; //Radio mandatory zones
-				else if (shortCategory == "TMZ") thisCategory = Airspace::Type::TMZ; //Transponder mandatory zones
-				else if (shortCategory == "TRA") thisCategory = Airspace::Type::RESTRICTED; //Temporary reserved airspaces
-				else if (shortCategory == "MTMA") thisCategory = Airspace::Type::TMA; // Military terminal control areas
-				else if (shortCategory == "MCTR") thisCategory = Airspace::Type::CTR; // Military control zones
-				else if (shortCategory == "MATZ") thisCategory = Airspace::Type::CTR; // Military aerodrome traffic zones
-				else if (shortCategory == "MTRA") thisCategory = Airspace::Type::RESTRICTED; // Military temporary reserved areas
-				else if (shortCategory == "MTA") thisCategory = Airspace::Type::DANGER;  // Military training areas
-				//else if (shortCategory == "CTA") thisCategory = Airspace::Type::UNDEFINED; //Control areas: will be converted to normal classes
-			}
-		}
-	}
+	int thisCategory = Keywords::FindKMLFolderCategory(categoryName);
 	if (thisCategory == Airspace::Type::UNDEFINED) {
-		if (categoryName == "Gliding areas") thisCategory = Airspace::Type::GLIDING;
-		else if (categoryName == "Hang gliding and para gliding areas") thisCategory = Airspace::Type::GLIDING;
-		else if (categoryName == "Parachute jumping areas") thisCategory = Airspace::Type::DANGER;
+		const std::string::size_type first = categoryName.find('(');
+		if (first != std::string::npos) {
+			const std::string::size_type last = categoryName.find(')');
+			if (last != std::string::npos && first < last) thisCategory = Keywords::FindKMLShortCategory(categoryName.substr(first + 1, last - first - 1));
+		}
 	}
 	if (thisCategory == Airspace::Type::UNDEFINED) thisCategory = upperCategory;
 	folderCategory = thisCategory;
@@ -1041,27 +1247,8 @@ bool KML::ProcessPlacemark(const boost::property_tree::ptree& placemark) {
 				else if (str == "NAM" || str == "name" || str == "Name") labelName = simpleData.second.data();
 				else if (str == "IDENT") ident = simpleData.second.data();
 				else if (str == "Category") {
-					if (simpleData.second.data() == "Class A") category = Airspace::Type::CLASSA;
-					else if (simpleData.second.data() == "Class B") category = Airspace::Type::CLASSB;
-					else if (simpleData.second.data() == "Class C") category = Airspace::Type::CLASSC;
-					else if (simpleData.second.data() == "Class D") category = Airspace::Type::CLASSD;
-					else if (simpleData.second.data() == "Class E") category = Airspace::Type::CLASSE;
-					else if (simpleData.second.data() == "Class F") category = Airspace::Type::CLASSF;
-					else if (simpleData.second.data() == "Class G") category = Airspace::Type::CLASSG;
-					else if (simpleData.second.data() == "Danger") category = Airspace::Type::DANGER;
-					else if (simpleData.second.data() == "Prohibited") category = Airspace::Type::PROHIBITED;
-					else if (simpleData.second.data() == "Restricted") category = Airspace::Type::RESTRICTED;
-					else if (simpleData.second.data() == "CTR") category = Airspace::Type::CTR;
-					else if (simpleData.second.data() == "TMA") category = Airspace::Type::TMA;
-					else if (simpleData.second.data() == "TMZ") category = Airspace::Type::TMZ;
-					else if (simpleData.second.data() == "RMZ") category = Airspace::Type::RMZ;
-					else if (simpleData.second.data() == "FIR") category = Airspace::Type::FIR;
-					else if (simpleData.second.data() == "UIR") category = Airspace::Type::UIR;
-					else if (simpleData.second.data() == "OTH") category = Airspace::Type::OTH;
-					else if (simpleData.second.data() == "Gliding area") category = Airspace::Type::GLIDING;
-					else if (simpleData.second.data() == "No glider") category = Airspace::Type::NOGLIDER;
-					else if (simpleData.second.data() == "Wave window") category = Airspace::Type::WAVE;
-					else if (simpleData.second.data() == "Unknown") category = Airspace::Type::UNKNOWN;
+					const Airspace::Type labelCategory = Keywords::FindKMLCategory(simpleData.second.data());
+					if (labelCategory != Airspace::Type::UNDEFINED) category = labelCategory;
 					else AirspaceConverter::LogError("Unable to parse airspace category in the label: " + simpleData.second.data());
 				}
 			}
@@ -1211,7 +1398,7 @@ bool KML::ProcessPlacemark(const boost::property_tree::ptree& placemark) {
 		if (pointsFound) {
 			// Check if the altitudes make sense
 			if (airspace.GetBaseAltitude() < airspace.GetTopAltitude()) {
-				airspaces.insert(std::pair<int, Airspace>(airspace.GetType(), std::move(airspace)));
+				StoreAirspace(airspace);
 				return true;
 			} else AirspaceConverter::LogWarning("skipping Placemark with invalid altitudes: " + airspace.GetName());
 		}
@@ -1226,18 +1413,21 @@ bool KML::ReadKML(const std::string& filename) {
 		AirspaceConverter::LogError("Unable to open KML file: " + filename);
 		return false;
 	}
-	AirspaceConverter::LogMessage("Reading KML file: " + filename);
+	return ParseKML(input, filename);
+}
+
+bool KML::ParseKML(std::istream& input, const std::string& name) {
+	AirspaceConverter::LogMessage("Reading KML file: " + name);
 	boost::property_tree::ptree root;
-	boost::property_tree::read_xml(input, root);
-	input.close();
 	try {
+		boost::property_tree::read_xml(input, root);
 		boost::property_tree::ptree doc = root.get_child("kml").get_child("Document");
 		for (boost::property_tree::ptree::value_type const& element : doc) {
 			if (element.first == "Folder") ProcessFolder(element.second, Airspace::Type::UNDEFINED);
 			else if (element.first == "Placemark") ProcessPlacemark(element.second);
 		}
 	} catch (...) {
-		AirspaceConverter::LogError("Exception while parsing basic elements of KML file.");
+		AirspaceConverter::LogError("Exception while parsing basic elements of KML file: " + name);
 		return false;
 	}
 	return true;
@@ -14,28 +14,54 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <functional>
 #include <fstream>
+#include <istream>
+#include <memory>
 #include <boost/property_tree/ptree_fwd.hpp>
 
 class Altitude;
 class Airspace;
 class Waypoint;
-class Airfield;
+class WaypointSet;
 
 class KML {
 public:
-	KML(std::multimap<int, Airspace>& airspacesMap, std::multimap<int, Waypoint*>& waypointsMap);
+	KML(std::multimap<int, Airspace>& airspacesMap, WaypointSet& waypointsSet);
+	~KML();
 	bool Write(const std::string& filename);
+
+	// Tiled output: the airspaces split in square tiles of the given size in degrees, each one in its own KML inside the KMZ and loaded by the viewer only when its region is visible; 0 for a single document
+	inline static bool IsValidTileSize(const double degrees) { return degrees >= 0 && degrees <= 90; }
+	inline bool SetTileSize(const double degrees) { if (!IsValidTileSize(degrees)) return false; tileSize = degrees; return true; }
+
+	// Streaming output: the airspaces are written one at time, without being stored, but grouped by category anyway
+	bool OpenOutput(const std::string& filename);
+	bool WriteAirspace(const Airspace& airspace);
+	bool CloseOutput();
+
 	inline bool WereAllAGLaltitudesCovered() const { return allAGLaltitudesCovered; }
 	inline void ProcessLineStrings(bool LineStringAsAirspaces = true) { processLineString = LineStringAsAirspaces; }
-	bool ReadKMZ(const std::string& filename);
+	bool ReadKMZ(const std::string& filename); // all the KML files inside, parsed in parallel and merged in the same order of the KMZ
 	bool ReadKML(const std::string& filename);
+	inline void StreamAirspaces(const std::function<void(Airspace&)>& handler) { airspaceHandler = handler; } // pass each airspace read to the handler instead of storing it
 
 private:
 	static std::string PrepareTagText(const std::string& text);
+	bool OpenOutputFile(const std::string& filename, const bool airspacesPresent);
+	bool MakeKMZ();
+	void RemoveSpillFiles();
+	void RemoveDocumentFile();
+	bool WriteTiles();
+	void RemoveTileFiles();
+	void CalculateSurfaces();
+	void WriteWaypoints(const bool airspacesPresent);
+	void OpenCategoryFolder(const int category);
+	void WriteAirspacePlacemark(const Airspace& airspace);
 	void WriteHeader(const bool airspacePresent, const bool waypointsPresent);
 	void OpenPlacemark(const Airspace& airspace);
-	void OpenPlacemark(const Waypoint* waypoint);
+	void OpenPlacemark(const Waypoint& waypoint);
 	void OpenPolygon(const bool extrude, const bool absolute);
 	void ClosePolygon();
 	void WriteSideWalls(const Airspace& airspace);
@@ -43,6 +69,8 @@ private:
 	void WriteBaseOrTop(const Airspace& airspace, const Altitude& alt, const bool extrudeToGround = false);
 	void WriteBaseOrTop(const Airspace& airspace, const std::vector<double>& altitudesAmsl, const bool extrudeToGround = false);
 
+	void StoreAirspace(Airspace& airspace);
+	bool ParseKML(std::istream& input, const std::string& name);
 	bool ProcessFolder(const boost::property_tree::ptree& folder, const int upperCategory);
 	bool ProcessPlacemark(const boost::property_tree::ptree& placemark);
 	static bool ProcessPolygon(const boost::property_tree::ptree& polygon, Airspace& airspace, bool& isExtruded, Altitude& avgAltitude);
@@ -53,10 +81,18 @@ private:
 	static const std::string airfieldColors[][2];
 	static const std::string waypointIcons[];
 	static const std::string iconsPath;
+	static const int TILE_MIN_LOD_PIXELS;
 	std::multimap<int, Airspace>& airspaces;
-	std::multimap<int, Waypoint*>& waypoints;
+	WaypointSet& waypoints;
+	std::function<void(Airspace&)> airspaceHandler;
 	std::ofstream outputFile;
+	std::ostream* out; // where the KML is being written: the output file or the spill file of a category
+	std::map<int, std::pair<std::string, std::unique_ptr<std::ofstream>>> spillFiles; // temporary file name and stream for each category
+	std::vector<std::pair<std::string, std::string>> tileFiles; // temporary file and name inside the KMZ of each tile
+	std::unordered_map<const Airspace*, std::pair<double, double>> surfaces; // area [Km2] and perimeter [Km] calculated in advance
+	std::string kmzFile, fileKML;
 	bool allAGLaltitudesCovered;
 	bool processLineString;
 	int folderCategory;
+	double tileSize; // [deg]
 };
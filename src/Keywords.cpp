@@ -0,0 +1,222 @@
+//============================================================================
+// AirspaceConverter
+// Since       : 14/6/2016
+// Author      : Alberto Realis-Luc <alberto.realisluc@gmail.com>
+// Web         : https://www.alus.it/AirspaceConverter
+// Repository  : https://github.com/alus-it/AirspaceConverter.git
+// Copyright   : (C) 2016-2021 Alberto Realis-Luc
+// License     : GNU GPL v3
+//
+// This source file is part of AirspaceConverter project
+//============================================================================
+
+#include "Keywords.h"
+#include "Waypoint.h"
+
+// Case of the switch on the hash: the keyword must be also equal to return the value
+#define KEYWORD(word, value) case Hash(word): if (Equals(begin, end, word)) return value; break
+#define KEYWORD_UPPER_CASE(word, value) case Hash(word): if (EqualsUpperCase(begin, end, word)) return value; break
+
+uint32_t Keywords::HashUpperCase(const char* begin, const char* end) {
+	const size_t length = end - begin;
+	if (length == 0) return 0;
+	const char text[] = { ToUpper(begin[0]), ToUpper(begin[length > 1 ? 1 : 0]), ToUpper(begin[length / 2]), ToUpper(begin[length - 1]) };
+	return ((uint32_t)(length & 0xFF) | (uint32_t)(unsigned char)text[0] << 8 | (uint32_t)(unsigned char)text[1] << 16 | (uint32_t)(unsigned char)text[2] << 24)
+		^ (uint32_t)(unsigned char)text[3] * 2654435761u;
+}
+
+bool Keywords::Equals(const char* begin, const char* end, const char* keyword) {
+	for (const char* c = begin; c < end; c++, keyword++) if (*keyword == '\0' || *c != *keyword) return false;
+	return *keyword == '\0';
+}
+
+bool Keywords::EqualsUpperCase(const char* begin, const char* end, const char* keyword) {
+	for (const char* c = begin; c < end; c++, keyword++) if (*keyword == '\0' || ToUpper(*c) != *keyword) return false;
+	return *keyword == '\0';
+}
+
+Keywords::AltitudeKeyword Keywords::FindAltitudeKeyword(const char* begin, const char* end) {
+	switch (HashUpperCase(begin, end)) {
+		KEYWORD_UPPER_CASE("FT", FEET);
+		KEYWORD_UPPER_CASE("F", FEET);
+		KEYWORD_UPPER_CASE("M", METERS);
+		KEYWORD_UPPER_CASE("MT", METERS);
+		KEYWORD_UPPER_CASE("FL", FLIGHT_LEVEL);
+		KEYWORD_UPPER_CASE("MSL", MEAN_SEA_LEVEL);
+		KEYWORD_UPPER_CASE("AMSL", MEAN_SEA_LEVEL);
+		KEYWORD_UPPER_CASE("ALT", ALTITUDE);
+		KEYWORD_UPPER_CASE("GND", GROUND);
+		KEYWORD_UPPER_CASE("SFC", GROUND);
+		KEYWORD_UPPER_CASE("AGL", ABOVE_GROUND);
+		KEYWORD_UPPER_CASE("AGND", ABOVE_GROUND);
+		KEYWORD_UPPER_CASE("ASFC", ABOVE_GROUND);
+		KEYWORD_UPPER_CASE("UNLIM", UNLIMITED);
+		KEYWORD_UPPER_CASE("UNLIMITED", UNLIMITED);
+		KEYWORD_UPPER_CASE("UNL", UNLIMITED);
+		default: break;
+	}
+	return NOT_ALTITUDE_KEYWORD;
+}
+
+Airspace::Type Keywords::FindOpenAirCategory(const char* begin, const char* end) {
+	switch (Hash(begin, end)) {
+		KEYWORD("R", Airspace::RESTRICTED);
+		KEYWORD("Q", Airspace::DANGER);
+		KEYWORD("P", Airspace::PROHIBITED);
+		KEYWORD("A", Airspace::CLASSA);
+		KEYWORD("B", Airspace::CLASSB);
+		KEYWORD("C", Airspace::CLASSC);
+		KEYWORD("D", Airspace::CLASSD);
+		KEYWORD("E", Airspace::CLASSE);
+		KEYWORD("F", Airspace::CLASSF);
+		KEYWORD("G", Airspace::CLASSG);
+		KEYWORD("W", Airspace::WAVE); // Wave window
+		KEYWORD("CTR", Airspace::CTR);
+		KEYWORD("TMZ", Airspace::TMZ);
+		KEYWORD("RMZ", Airspace::RMZ);
+		KEYWORD("GP", Airspace::NOGLIDER); // Glider prohibited
+		KEYWORD("GSEC", Airspace::GLIDING); // Glider sector
+		KEYWORD("NOTAM", Airspace::NOTAM);
+		KEYWORD("UKN", Airspace::UNKNOWN);
+		KEYWORD("UNKNOWN", Airspace::UNKNOWN);
+		default: break;
+	}
+	return Airspace::UNDEFINED;
+}
+
+Airspace::Type Keywords::FindOpenAIPCategory(const std::string& text) {
+	const char* const begin = text.c_str();
+	const char* const end = begin + text.length();
+	switch (Hash(begin, end)) {
+		KEYWORD("A", Airspace::CLASSA);
+		KEYWORD("B", Airspace::CLASSB);
+		KEYWORD("C", Airspace::CLASSC);
+		KEYWORD("D", Airspace::CLASSD);
+		KEYWORD("E", Airspace::CLASSE);
+		KEYWORD("F", Airspace::CLASSF);
+		KEYWORD("G", Airspace::CLASSG);
+		KEYWORD("CTR", Airspace::CTR);
+		KEYWORD("TMA", Airspace::TMA);
+		KEYWORD("TMZ", Airspace::TMZ);
+		KEYWORD("RMZ", Airspace::RMZ);
+		KEYWORD("DANGER", Airspace::DANGER);
+		KEYWORD("PROHIBITED", Airspace::PROHIBITED);
+		KEYWORD("RESTRICTED", Airspace::RESTRICTED);
+		KEYWORD("GLIDING", Airspace::GLIDING);
+		KEYWORD("WAVE", Airspace::WAVE);
+		KEYWORD("FIR", Airspace::FIR);
+		KEYWORD("UIR", Airspace::UIR);
+		KEYWORD("OTH", Airspace::OTH);
+		default: break;
+	}
+	return Airspace::UNDEFINED;
+}
+
+Airspace::Type Keywords::FindKMLCategory(const std::string& text) {
+	const char* const begin = text.c_str();
+	const char* const end = begin + text.length();
+	switch (Hash(begin, end)) {
+		KEYWORD("Class A", Airspace::CLASSA);
+		KEYWORD("Class B", Airspace::CLASSB);
+		KEYWORD("Class C", Airspace::CLASSC);
+		KEYWORD("Class D", Airspace::CLASSD);
+		KEYWORD("Class E", Airspace::CLASSE);
+		KEYWORD("Class F", Airspace::CLASSF);
+		KEYWORD("Class G", Airspace::CLASSG);
+		KEYWORD("Danger", Airspace::DANGER);
+		KEYWORD("Prohibited", Airspace::PROHIBITED);
+		KEYWORD("Restricted", Airspace::RESTRICTED);
+		KEYWORD("CTR", Airspace::CTR);
+		KEYWORD("TMA", Airspace::TMA);
+		KEYWORD("TMZ", Airspace::TMZ);
+		KEYWORD("RMZ", Airspace::RMZ);
+		KEYWORD("FIR", Airspace::FIR);
+		KEYWORD("UIR", Airspace::UIR);
+		KEYWORD("OTH", Airspace::OTH);
+		KEYWORD("Gliding area", Airspace::GLIDING);
+		KEYWORD("No glider", Airspace::NOGLIDER);
+		KEYWORD("Wave window", Airspace::WAVE);
+		KEYWORD("Unknown", Airspace::UNKNOWN);
+		default: break;
+	}
+	return Airspace::UNDEFINED;
+}
+
+Airspace::Type Keywords::FindKMLFolderCategory(const std::string& folderName) {
+	const char* const begin = folderName.c_str();
+	const char* const end = begin + folderName.length();
+	switch (Hash(begin, end)) {
+		KEYWORD("Danger areas (D)", Airspace::DANGER);
+		KEYWORD("Gliding areas", Airspace::GLIDING);
+		KEYWORD("Hang gliding and para gliding areas", Airspace::GLIDING);
+		KEYWORD("Parachute jumping areas", Airspace::DANGER);
+		default: break;
+	}
+	return Airspace::UNDEFINED;
+}
+
+Airspace::Type Keywords::FindKMLShortCategory(const std::string& text) {
+	const char* const begin = text.c_str();
+	const char* const end = begin + text.length();
+	switch (Hash(begin, end)) {
+		KEYWORD("A", Airspace::CLASSA);
+		KEYWORD("B", Airspace::CLASSB);
+		KEYWORD("C", Airspace::CLASSC);
+		KEYWORD("D", Airspace::CLASSD);
+		KEYWORD("E", Airspace::CLASSE);
+		KEYWORD("F", Airspace::CLASSF);
+		KEYWORD("G", Airspace::CLASSG);
+		KEYWORD("P", Airspace::PROHIBITED);
+		KEYWORD("R", Airspace::RESTRICTED);
+		KEYWORD("TMA", Airspace::TMA); // Terminal control areas
+		KEYWORD("CTR", Airspace::CTR); // Control zones
+		KEYWORD("RMZ", Airspace::RMZ); // Radio mandatory zones
+		KEYWORD("TMZ", Airspace::TMZ); // Transponder mandatory zones
+		KEYWORD("TRA", Airspace::RESTRICTED); // Temporary reserved airspaces
+		KEYWORD("MTMA", Airspace::TMA); // Military terminal control areas
+		KEYWORD("MCTR", Airspace::CTR); // Military control zones
+		KEYWORD("MATZ", Airspace::CTR); // Military aerodrome traffic zones
+		KEYWORD("MTRA", Airspace::RESTRICTED); // Military temporary reserved areas
+		KEYWORD("MTA", Airspace::DANGER); // Military training areas
+		default: break; // CTA, control areas, will be converted to normal classes
+	}
+	return Airspace::UNDEFINED;
+}
+
+int Keywords::FindCSVStyle(const std::string& text) {
+	const char* const begin = text.c_str();
+	const char* const end = begin + text.length();
+	switch (Hash(begin, end)) {
+		KEYWORD("Airport", Waypoint::airfieldSolid);
+		KEYWORD("Airstrip", Waypoint::airfieldGrass);
+		KEYWORD("NDB", Waypoint::NDB);
+		KEYWORD("VOR", Waypoint::VOR);
+		KEYWORD("VORDME", Waypoint::VOR);
+		KEYWORD("VORTAC", Waypoint::VOR);
+		KEYWORD("TACAN", Waypoint::VOR);
+		KEYWORD("VRP", Waypoint::intersection);
+		KEYWORD("Waypoint", Waypoint::castle);
+		KEYWORD("Bookmark", Waypoint::unknown);
+		KEYWORD("Cabin", Waypoint::unknown);
+		KEYWORD("Closed", Waypoint::unknown);
+		KEYWORD("DME", Waypoint::unknown);
+		KEYWORD("Error", Waypoint::unknown);
+		KEYWORD("Flag", Waypoint::unknown);
+		KEYWORD("Helipad", Waypoint::unknown);
+		KEYWORD("Lighthouse", Waypoint::unknown);
+		KEYWORD("Location", Waypoint::unknown);
+		KEYWORD("Logbook", Waypoint::unknown);
+		KEYWORD("Marker", Waypoint::unknown);
+		KEYWORD("Mountain", Waypoint::unknown);
+		KEYWORD("Obstacle", Waypoint::unknown);
+		KEYWORD("POI", Waypoint::unknown);
+		KEYWORD("Pin", Waypoint::unknown);
+		KEYWORD("Seaport", Waypoint::unknown);
+		KEYWORD("Unknown", Waypoint::unknown);
+		default: break;
+	}
+	return -1;
+}
+
+#undef KEYWORD
+#undef KEYWORD_UPPER_CASE
@@ -0,0 +1,47 @@
+//============================================================================
+// AirspaceConverter
+// Since       : 14/6/2016
+// Author      : Alberto Realis-Luc <alberto.realisluc@gmail.com>
+// Web         : https://www.alus.it/AirspaceConverter
+// Repository  : https://github.com/alus-it/AirspaceConverter.git
+// Copyright   : (C) 2016-2021 Alberto Realis-Luc
+// License     : GNU GPL v3
+//
+// This source file is part of AirspaceConverter project
+//============================================================================
+
+#pragma once
+#include "Airspace.h"
+#include <string>
+#include <cstdint>
+
+// Keywords used by the readers to decode airspace categories, waypoint styles and altitude units.
+// Each table is a switch on the hash of the keyword, calculated at compile time: the compiler rejects duplicated
+// case labels, so the hash is verified to be perfect on each table, then one compare excludes the other words.
+// The hash, like in gperf, takes only the length and the first, second, middle and last characters.
+class Keywords {
+public:
+	static constexpr uint32_t Hash(const char* keyword) { return Mix(Length(keyword), keyword); }
+	static inline uint32_t Hash(const char* begin, const char* end) { return Mix(end - begin, begin); }
+	static uint32_t HashUpperCase(const char* begin, const char* end);
+
+	enum AltitudeKeyword { ABOVE_GROUND, GROUND, MEAN_SEA_LEVEL, ALTITUDE, FEET, METERS, FLIGHT_LEVEL, UNLIMITED, NOT_ALTITUDE_KEYWORD };
+
+	static AltitudeKeyword FindAltitudeKeyword(const char* begin, const char* end); // case insensitive
+	static Airspace::Type FindOpenAirCategory(const char* begin, const char* end); // AC record
+	static Airspace::Type FindOpenAIPCategory(const std::string& text); // CATEGORY attribute
+	static Airspace::Type FindKMLCategory(const std::string& text); // Category in the extended data, as written by KML
+	static Airspace::Type FindKMLFolderCategory(const std::string& folderName); // whole name of the folder
+	static Airspace::Type FindKMLShortCategory(const std::string& text); // between brackets in the name of the folder
+	static int FindCSVStyle(const std::string& text); // waypoint type, -1 if unknown
+
+private:
+	static constexpr size_t Length(const char* text) { return *text == '\0' ? 0 : 1 + Length(text + 1); }
+	static constexpr uint32_t Mix(const size_t length, const char* text) {
+		return length == 0 ? 0 : ((uint32_t)(length & 0xFF) | (uint32_t)(unsigned char)text[0] << 8 | (uint32_t)(unsigned char)text[length > 1 ? 1 : 0] << 16
+			| (uint32_t)(unsigned char)text[length / 2] << 24) ^ (uint32_t)(unsigned char)text[length - 1] * 2654435761u;
+	}
+	static bool Equals(const char* begin, const char* end, const char* keyword);
+	static bool EqualsUpperCase(const char* begin, const char* end, const char* keyword);
+	static inline char ToUpper(const char c) { return c >= 'a' && c <= 'z' ? c - ('a' - 'A') : c; }
+};
@@ -0,0 +1,75 @@
+//============================================================================
+// AirspaceConverter
+// Since       : 14/6/2016
+// Author      : Alberto Realis-Luc <alberto.realisluc@gmail.com>
+// Web         : https://www.alus.it/AirspaceConverter
+// Repository  : https://github.com/alus-it/AirspaceConverter.git
+// Copyright   : (C) 2016-2021 Alberto Realis-Luc
+// License     : GNU GPL v3
+//
+// This source file is part of AirspaceConverter project
+//============================================================================
+
+#include "NumberFormat.h"
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+#include <cassert>
+
+const long long NumberFormat::SCALES[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000 };
+const double NumberFormat::MAX_SCALED = 4e9; // half ULP still well below the tie tolerance
+const double NumberFormat::TIE_TOLERANCE = 1e-6;
+
+void NumberFormat::AppendInteger(const long long value, std::string& text, const int width /* = 0 */) {
+	char buffer[24];
+	char* p = buffer + sizeof(buffer);
+	unsigned long long n = value < 0 ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+	do {
+		*--p = char('0' + n % 10);
+		n /= 10;
+	} while (n > 0);
+	if (value < 0) text += '-';
+	for (int digits = int(buffer + sizeof(buffer) - p) + (value < 0 ? 1 : 0); digits < width; digits++) text += '0';
+	text.append(p, buffer + sizeof(buffer));
+}
+
+void NumberFormat::AppendFixed(const double value, const int decimals, std::string& text, const int width /* = 0 */) {
+	assert(decimals >= 0 && decimals <= 9);
+	const double scaledValue = std::fabs(value) * SCALES[decimals];
+	if (!(scaledValue < MAX_SCALED) || std::fabs(scaledValue - std::floor(scaledValue) - 0.5) < TIE_TOLERANCE) {
+		char buffer[512];
+		const int length = snprintf(buffer, sizeof(buffer), "%0*.*f", width, decimals, value);
+		if (length > 0) text.append(buffer, std::min(length, (int)sizeof(buffer) - 1));
+		return;
+	}
+	AppendScaled(std::signbit(value), std::llround(scaledValue), decimals, width, false, text);
+}
+
+void NumberFormat::AppendCompact(const double value, const int decimals, std::string& text) {
+	assert(decimals >= 0 && decimals <= 9);
+	const long long scaled = std::llround(std::fabs(value) * SCALES[decimals]);
+	AppendScaled(scaled != 0 && value < 0, scaled, decimals, 0, true, text);
+}
+
+void NumberFormat::AppendScaled(const bool negative, const long long scaled, const int decimals, const int width, const bool trimZeros, std::string& text) {
+	// Fixed point: integer and fractional parts are printed with integer arithmetic
+	if (negative) text += '-';
+	AppendInteger(scaled / SCALES[decimals], text, width - (negative ? 1 : 0) - (decimals > 0 ? decimals + 1 : 0));
+	long long fraction = scaled % SCALES[decimals];
+	int digits = decimals;
+	if (trimZeros) {
+		if (fraction == 0) return;
+		while (fraction % 10 == 0) {
+			fraction /= 10;
+			digits--;
+		}
+	}
+	if (digits == 0) return;
+	char buffer[10];
+	buffer[0] = '.';
+	for (int i = digits; i > 0; i--) {
+		buffer[i] = char('0' + fraction % 10);
+		fraction /= 10;
+	}
+	text.append(buffer, digits + 1);
+}
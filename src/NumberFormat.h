@@ -0,0 +1,29 @@
+//============================================================================
+// AirspaceConverter
+// Since       : 14/6/2016
+// Author      : Alberto Realis-Luc <alberto.realisluc@gmail.com>
+// Web         : https://www.alus.it/AirspaceConverter
+// Repository  : https://github.com/alus-it/AirspaceConverter.git
+// Copyright   : (C) 2016-2021 Alberto Realis-Luc
+// License     : GNU GPL v3
+//
+// This source file is part of AirspaceConverter project
+//============================================================================
+
+#pragma once
+#include <string>
+
+// Numbers appended to a text buffer for the writers: integer arithmetic, explicit decimals, no locale.
+// AppendFixed gives the same of printf (and of the streams with std::fixed): the few values too close to a tie, too big or not finite are left to snprintf.
+class NumberFormat {
+public:
+	static void AppendInteger(const long long value, std::string& text, const int width = 0); // zero padded up to width characters, as "%0*lld"
+	static void AppendFixed(const double value, const int decimals, std::string& text, const int width = 0); // as "%0*.*f", with decimals from 0 to 9
+	static void AppendCompact(const double value, const int decimals, std::string& text); // without trailing zeros and without the sign of a zero, rounded half away from zero on the scaled value
+
+private:
+	static void AppendScaled(const bool negative, const long long scaled, const int decimals, const int width, const bool trimZeros, std::string& text);
+	static const long long SCALES[];
+	static const double MAX_SCALED; // above it the rounding may be not exact
+	static const double TIE_TOLERANCE;
+};
@@ -14,7 +14,7 @@
 #include "Airspace.h"
 #include "AirspaceConverter.h"
 #include "Waypoint.h"
-#include "Airfield.h"
+#include "Keywords.h"
 #include <cmath>
 #include <fstream>
 #include <boost/property_tree/xml_parser.hpp>
@@ -24,9 +24,9 @@
 
 using boost::property_tree::ptree;
 
-OpenAIP::OpenAIP(std::multimap<int, Airspace>& airspacesMap, std::multimap<int,Waypoint*>& waypointsMap):
+OpenAIP::OpenAIP(std::multimap<int, Airspace>& airspacesMap, WaypointSet& waypointsSet):
 	airspaces(airspacesMap),
-	waypoints(waypointsMap) {
+	waypoints(waypointsSet) {
 }
 
 bool OpenAIP::ParseAltitude(const ptree& node, Altitude& altitude) {
@@ -104,152 +104,101 @@ bool OpenAIP::ReadAirspaces(const std::string& fileName) {
 			
 			// Airspace category
 			std::string str = asp.second.get_child("<xmlattr>").get<std::string>("CATEGORY");
-			Airspace::Type type = Airspace::UNDEFINED;
-			int len = (int)str.length();
-			if (len>0) switch (str.at(0)) {
-				case 'A':
-					if (len == 1) type = Airspace::CLASSA; // A class airspace
-					break;
-				case 'B':
-					if (len == 1) type = Airspace::CLASSB; // B class airspace
-					break;
-				case 'C':
-					if (len == 1) type = Airspace::CLASSC; // C class airspace
-					else if (str == "CTR") type = Airspace::CTR; // CTR airspace
-					break;
-				case 'D':
-					if (len == 1) type = Airspace::CLASSD; // D class airspace
-					else if (str == "DANGER") type = Airspace::DANGER; // Dangerous area
-					break;
-				case 'E':
-					if (len == 1) type = Airspace::CLASSE; // E class airspace
-					break;
-				case 'F':
-					if (len == 1) type = Airspace::CLASSF; // F class airspace
-					else if (str == "FIR") type = Airspace::FIR; //FIR
-					break;
-				case 'G':
-					if (len == 1) type = Airspace::CLASSG; // G class airspace
-					else if (str == "GLIDING") type = Airspace::GLIDING;
-					break;
-				case 'O':
-					if (str == "OTH") type = Airspace::OTH;
-					break;
-				case 'P':
-					if (str == "PROHIBITED") type = Airspace::PROHIBITED; // Prohibited area
-					break;
-				case 'R':
-					if (str == "RESTRICTED") type = Airspace::RESTRICTED; // Restricted area
-					else if (str == "RMZ") type = Airspace::RMZ; //RMZ
-					break;
-				case 'T':
-					if (len == 3 && str.at(1) == 'M') {
-						if (str.at(2) == 'A') type = Airspace::TMA;
-						else if (str.at(2) == 'Z') type = Airspace::TMZ;
-					}
-					break;
-				case 'W':
-					if (str == "WAVE") type = Airspace::WAVE; //WAVE
-					break;
-				case 'U':
-					if (str == "UIR") type = Airspace::UIR; //UIR
-					break;
-				default:
-					break;
-				} else continue;
-				if (type == Airspace::UNDEFINED) {
-					AirspaceConverter::LogWarning("skipping ASP with unknown/undefined CATEGORY attribute: " + str);
-					continue;
-				}
-				Airspace airspace(type);
-
-				// Airspace name
-				str = asp.second.get<std::string>("NAME");
-				airspace.SetName(str);
-
-				// Airspace top altitude
-				ptree node = asp.second.get_child("ALTLIMIT_TOP");
-				Altitude alt;
-				if (ParseAltitude(node, alt)) airspace.SetTopAltitude(alt);
-				else {
-					AirspaceConverter::LogWarning("skipping airspace with invalid or missing ALTLIMIT_TOP attribute: " + airspace.GetName());
-					continue;
-				}
+			if (str.empty()) continue;
+			const Airspace::Type type = Keywords::FindOpenAIPCategory(str);
+			if (type == Airspace::UNDEFINED) {
+				AirspaceConverter::LogWarning("skipping ASP with unknown/undefined CATEGORY attribute: " + str);
+				continue;
+			}
+			Airspace airspace(type);
+
+			// Airspace name
+			str = asp.second.get<std::string>("NAME");
+			airspace.SetName(str);
+
+			// Airspace top altitude
+			ptree node = asp.second.get_child("ALTLIMIT_TOP");
+			Altitude alt;
+			if (ParseAltitude(node, alt)) airspace.SetTopAltitude(alt);
+			else {
+				AirspaceConverter::LogWarning("skipping airspace with invalid or missing ALTLIMIT_TOP attribute: " + airspace.GetName());
+				continue;
+			}
 
-				// Airspace bottom altitude
-				node = asp.second.get_child("ALTLIMIT_BOTTOM");
-				if (ParseAltitude(node, alt)) airspace.SetBaseAltitude(alt);
-				else {
-					AirspaceConverter::LogWarning("skipping airspace with invalid or missing ALTLIMIT_BOTTOM attribute: " + airspace.GetName());
-					continue;
-				}
+			// Airspace bottom altitude
+			node = asp.second.get_child("ALTLIMIT_BOTTOM");
+			if (ParseAltitude(node, alt)) airspace.SetBaseAltitude(alt);
+			else {
+				AirspaceConverter::LogWarning("skipping airspace with invalid or missing ALTLIMIT_BOTTOM attribute: " + airspace.GetName());
+				continue;
+			}
 
-				// Extra check on consistency of altitude levels
-				if (airspace.GetTopAltitude() <= airspace.GetBaseAltitude())
-					AirspaceConverter::LogWarning("detected airspace with top and base equal or inverted: " + airspace.GetName());
-
-				//Geometry
-				node = asp.second.get_child("GEOMETRY");
-
-				// Polygon (the only one supported for now)
-				str = node.get<std::string>("POLYGON");
-				double lat = Geometry::LatLon::UNDEF_LAT, lon = Geometry::LatLon::UNDEF_LON;
-				boost::char_separator<char> sep(", ");
-				boost::tokenizer<boost::char_separator<char> > tokens(str, sep);
-				bool expectedLon(true), error(false);
-				try {
-					for (const std::string& c : tokens) {
-						if (expectedLon) { // Beware that here the longitude comes first!
-							lon = std::stod(c);
-							if (!Geometry::LatLon::IsValidLon(lon)) {
-								error = true;
-								break;
-							}
-							expectedLon = false;
-						} else {
-							lat = std::stod(c);
-							if (!Geometry::LatLon::IsValidLat(lat)) {
-								error = true;
-								break;
-							}
-							expectedLon = true;
-							airspace.AddPointLatLonOnly(lat, lon);
+			// Extra check on consistency of altitude levels
+			if (airspace.GetTopAltitude() <= airspace.GetBaseAltitude())
+				AirspaceConverter::LogWarning("detected airspace with top and base equal or inverted: " + airspace.GetName());
+
+			//Geometry
+			node = asp.second.get_child("GEOMETRY");
+
+			// Polygon (the only one supported for now)
+			str = node.get<std::string>("POLYGON");
+			double lat = Geometry::LatLon::UNDEF_LAT, lon = Geometry::LatLon::UNDEF_LON;
+			boost::char_separator<char> sep(", ");
+			boost::tokenizer<boost::char_separator<char> > tokens(str, sep);
+			bool expectedLon(true), error(false);
+			try {
+				for (const std::string& c : tokens) {
+					if (expectedLon) { // Beware that here the longitude comes first!
+						lon = std::stod(c);
+						if (!Geometry::LatLon::IsValidLon(lon)) {
+							error = true;
+							break;
 						}
+						expectedLon = false;
+					} else {
+						lat = std::stod(c);
+						if (!Geometry::LatLon::IsValidLat(lat)) {
+							error = true;
+							break;
+						}
+						expectedLon = true;
+						airspace.AddPointLatLonOnly(lat, lon);
 					}
-				} catch (...) {
-					error = true;
-				}
-				if (error || !expectedLon) {
-					AirspaceConverter::LogWarning("skipping airspace with invalid coordinates: " + airspace.GetName());
-					continue;
 				}
+			} catch (...) {
+				error = true;
+			}
+			if (error || !expectedLon) {
+				AirspaceConverter::LogWarning("skipping airspace with invalid coordinates: " + airspace.GetName());
+				continue;
+			}
 
-				// Ensure that the polygon is closed (it should be already, but can still happen).....
-				if (!airspace.ClosePoints()) {
-					AirspaceConverter::LogWarning("skipping airspace with less than 3 points: : " + airspace.GetName());
-					continue;
-				}
+			// Ensure that the polygon is closed (it should be already, but can still happen).....
+			if (!airspace.ClosePoints()) {
+				AirspaceConverter::LogWarning("skipping airspace with less than 3 points: : " + airspace.GetName());
+				continue;
+			}
 
-				// The number of points must be at least 3+1 (plus the closing one)
-				assert(airspace.GetNumberOfPoints() > 3);
+			// The number of points must be at least 3+1 (plus the closing one)
+			assert(airspace.GetNumberOfPoints() > 3);
 
-				// Verify that the current airspace it not already existing in our collection (apparently this happens in in the same openAIP file)
-				bool found(false);
+			// Verify that the current airspace it not already existing in our collection (apparently this happens in in the same openAIP file)
+			bool found(false);
 
-				// Filter only on airspaces of the same type
-				const auto filtered = airspaces.equal_range(airspace.GetType());
-				for (auto it = filtered.first; it != filtered.second && !found; ++it) {
-					if (it->second == airspace) {
-						found = true;
-						AirspaceConverter::LogWarning("Skipping existing airspace: " + airspace.GetName() + " already known as: " + it->second.GetName());
-					}
+			// Filter only on airspaces of the same type
+			const auto filtered = airspaces.equal_range(airspace.GetType());
+			for (auto it = filtered.first; it != filtered.second && !found; ++it) {
+				if (it->second == airspace) {
+					found = true;
+					AirspaceConverter::LogWarning("Skipping existing airspace: " + airspace.GetName() + " already known as: " + it->second.GetName());
 				}
+			}
 
-				// If it is not already present in our collection add the new airspace
-				if (!found) airspaces.insert(std::pair<int, Airspace>(airspace.GetType(), std::move(airspace)));
+			// If it is not already present in our collection add the new airspace
+			if (!found) StoreAirspace(airspace);
 
-			} // for each ASP
-			return true;
+		} // for each ASP
+		return true;
 	} catch (...) {
 		AirspaceConverter::LogError("Exception while parsing openAIP file.");
 		assert(false);
@@ -257,6 +206,13 @@ bool OpenAIP::ReadAirspaces(const std::string& fileName) {
 	return false;
 }
 
+void OpenAIP::StoreAirspace(Airspace& airspace) {
+	if (airspaceHandler) {
+		airspaceHandler(airspace);
+		airspace.Clear();
+	} else airspaces.insert(std::pair<int, Airspace>(airspace.GetType(), std::move(airspace)));
+}
+
 bool OpenAIP::ReadWaypoints(const std::string& fileName) {
 	std::ifstream input(fileName);
 	if (!input.is_open() || input.bad()) {
@@ -438,9 +394,9 @@ bool OpenAIP::ParseAirports(const ptree& airportsNode) {
 			}
 
 			// Build and store the airfield
-			Airfield* airfield = new Airfield(longName, shortName, countryCode, lat, lon, (float)alt, style, rwyDir, rwyLen, freqHz, comments.str());
-			if (secondaryFreqHz != 0) airfield->SetOtherFrequency(secondaryFreqHz);
-			waypoints.insert(std::pair<int, Waypoint*>(style, (Waypoint*)airfield));
+			Waypoint airfield(longName, shortName, countryCode, lat, lon, (float)alt, style, rwyDir, rwyLen, freqHz, comments.str());
+			if (secondaryFreqHz != 0) airfield.SetOtherFrequency(secondaryFreqHz);
+			waypoints.Add(std::move(airfield));
 		} catch(...) {
 			AirspaceConverter::LogError("Exception while reading openAIP airports: airfield skipped");
 		}
@@ -531,9 +487,9 @@ bool OpenAIP::ParseNavAids(const ptree& navAidsNode) {
 			}
 
 			// Build and store the waypoint
-			Waypoint* waypoint = new Waypoint(longName, shortName, countryCode, lat, lon, (float)alt, style, comments.str());
-			if (freqHz > 0) waypoint->SetOtherFrequency(freqHz);
-			waypoints.insert(std::pair<int, Waypoint*>(style, waypoint));
+			Waypoint waypoint(longName, shortName, countryCode, lat, lon, (float)alt, style, comments.str());
+			if (freqHz > 0) waypoint.SetOtherFrequency(freqHz);
+			waypoints.Add(std::move(waypoint));
 		} catch(...) {
 			AirspaceConverter::LogError("Exception while reading openAIP navaids: waypoint skipped");
 		}
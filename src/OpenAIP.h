@@ -13,19 +13,21 @@
 #pragma once
 #include <string>
 #include <map>
+#include <functional>
 #include <boost/property_tree/ptree_fwd.hpp>
 
 class Airspace;
-class Waypoint;
+class WaypointSet;
 class Altitude;
 
 class OpenAIP {
 
 public:
-	OpenAIP(std::multimap<int, Airspace>& airspacesMap, std::multimap<int,Waypoint*>& waypointsMap);
+	OpenAIP(std::multimap<int, Airspace>& airspacesMap, WaypointSet& waypointsSet);
 	~OpenAIP() {}
 	bool ReadAirspaces(const std::string& fileName);
 	bool ReadWaypoints(const std::string& fileName);
+	inline void StreamAirspaces(const std::function<void(Airspace&)>& handler) { airspaceHandler = handler; } // pass each airspace read to the handler instead of storing it
 
 private:
 	static bool ParseAltitude(const boost::property_tree::ptree& node, Altitude& altitude);
@@ -35,10 +37,12 @@ private:
 	static bool ParseValue(const boost::property_tree::ptree& parentNode, const std::string& tagName, double &value);
 	static bool ParseMeasurement(const boost::property_tree::ptree& parentNode, const std::string&  tagName, char expectedUnit, double &value);
 
+	void StoreAirspace(Airspace& airspace);
 	bool ParseAirports(const boost::property_tree::ptree& airportsNode);
 	bool ParseNavAids(const boost::property_tree::ptree& navAidsNode);
 	//bool ParseHotSpots(const boost::property_tree::ptree& hotSpotsNode);
 
 	std::multimap<int,Airspace>& airspaces;
-	std::multimap<int,Waypoint*>& waypoints;
+	std::function<void(Airspace&)> airspaceHandler;
+	WaypointSet& waypoints;
 };
@@ -13,6 +13,7 @@
 #include "OpenAir.h"
 #include "AirspaceConverter.h"
 #include "Airspace.h"
+#include "Keywords.h"
 #include <iomanip>
 #include <boost/algorithm/string.hpp>
 #include <boost/tokenizer.hpp>
@@ -278,31 +279,7 @@ bool OpenAir::ParseAC(const std::string & line, Airspace& airspace) {
 	varRotationClockwise = true; // Reset var to default at beginning of new airspace segment
 	InsertAirspace(airspace); // If new airspace first store the actual one
 	assert(airspace.GetType() == Airspace::UNDEFINED);
-	Airspace::Type type = Airspace::UNDEFINED;
-	size_t length(line.size());
-	if (length == 4) switch (line.at(3)) {
-		case 'R': type = Airspace::RESTRICTED; break; // restricted
-		case 'Q': type = Airspace::DANGER; break; // danger
-		case 'P': type = Airspace::PROHIBITED; break; // prohibited
-		case 'A': type = Airspace::CLASSA; break; // Class A
-		case 'B': type = Airspace::CLASSB; break; // Class B
-		case 'C': type = Airspace::CLASSC; break; // Class C
-		case 'D': type = Airspace::CLASSD; break; // Class D
-		case 'E': type = Airspace::CLASSE; break; // Class E
-		case 'F': type = Airspace::CLASSF; break; // Class F
-		case 'G': type = Airspace::CLASSG; break; // Class G
-		case 'W': type = Airspace::WAVE; break; // Wave Window
-	} else if (length == 6) {
-		if (line.at(3) == 'C' && line.at(4) == 'T' && line.at(5) == 'R') type = Airspace::CTR;
-		else if (line.at(3) == 'U' && line.at(4) == 'K' && line.at(5) == 'N') type = Airspace::UNKNOWN; // UKNOWN can be used in OpneAir
-		else if (line.at(4) == 'M' && line.at(5) == 'Z') {
-			if (line.at(3) == 'T') type = Airspace::TMZ;
-			else if (line.at(3) == 'R') type = Airspace::RMZ;
-		}
-	} else if (length == 5 && line.at(3)=='G' && line.at(4) == 'P') type = Airspace::NOGLIDER; //GP glider prohibited
-	else if (length == 7 && line.substr(3) == "GSEC") type = Airspace::GLIDING; //GSEC glider sector
-	else if (length == 8 && line.substr(3) == "NOTAM") type = Airspace::NOTAM;
-	else if (length == 10 && line.substr(3) == "UNKNOWN") type = Airspace::UNKNOWN; // UKNOWN can be used in OpneAir
+	const Airspace::Type type = line.length() > 3 ? Keywords::FindOpenAirCategory(line.c_str() + 3, line.c_str() + line.length()) : Airspace::UNDEFINED;
 	if (type == Airspace::UNDEFINED) return false;
 	airspace.SetType(type);
 	return true;
@@ -497,7 +474,7 @@ bool OpenAir::InsertAirspace(Airspace& airspace) {
 		// This should be just a warning
 		if (airspace.GetName().empty()) AirspaceConverter::LogWarning(boost::str(boost::format("at line %1d: airspace without name.") % lastACline));
 		
-		airspaces.insert(std::pair<int, Airspace>(airspace.GetType(), std::move(airspace)));
+		StoreAirspace(airspace);
 	}
 
 	// Otherwise discard it
@@ -506,11 +483,26 @@ bool OpenAir::InsertAirspace(Airspace& airspace) {
 	return validAirspace;	
 }
 
+void OpenAir::StoreAirspace(Airspace& airspace) {
+	if (airspaceHandler) {
+		airspaceHandler(airspace);
+		airspace.Clear();
+	} else airspaces.insert(std::pair<int, Airspace>(airspace.GetType(), std::move(airspace)));
+}
+
 bool OpenAir::Write(const std::string& fileName) {
 	if (airspaces.empty()) {
 		AirspaceConverter::LogMessage("OpenAir output: no airspace, nothing to write");
 		return false;
 	}
+	if (!OpenOutput(fileName)) return false;
+
+	// Go trough all airspace
+	for (std::pair<const int,Airspace>& pair : airspaces) WriteAirspace(pair.second);
+	return CloseOutput();
+}
+
+bool OpenAir::OpenOutput(const std::string& fileName) {
 	if (file.is_open()) file.close();
 	file.open(fileName, std::ios::out | std::ios::trunc | std::ios::binary);
 	if (!file.is_open() || file.bad()) {
@@ -518,77 +510,77 @@ bool OpenAir::Write(const std::string& fileName) {
 		return false;
 	}
 	AirspaceConverter::LogMessage("Writing OpenAir output file: " + fileName);
-
 	WriteHeader();
+	return true;
+}
 
-	// Go trough all airspace
-	for (std::pair<const int,Airspace>& pair : airspaces)
-	{
-		// Get the airspace
-		Airspace& a = pair.second;
-
-		// Just a couple if assertions
-		assert(a.GetNumberOfPoints() > 3);
-		assert(a.GetFirstPoint()==a.GetLastPoint());
+bool OpenAir::WriteAirspace(Airspace& a) {
+	// Just a couple if assertions
+	assert(a.GetNumberOfPoints() > 3);
+	assert(a.GetFirstPoint()==a.GetLastPoint());
 
-		// Reset var
-		varRotationClockwise = true;
+	// Reset var
+	varRotationClockwise = true;
 
-		// Skip OpenAir not supported categories
-		if (!WriteCategory(a)) continue;
+	// Skip OpenAir not supported categories
+	if (!WriteCategory(a)) return false;
 
-		// Write the name
-		file << "AN " << boost::locale::conv::between(a.GetName(),"ISO8859-1","utf-8") << "\r\n";
-		
-		// Write base and ceiling altitudes
-		file << "AL " << a.GetBaseAltitude().ToString() << "\r\n";
-		file << "AH " << a.GetTopAltitude().ToString() << "\r\n";
-
-		// Write frequencies
-		if (a.GetNumberOfRadioFrequencies() > 0) {
-			file << std::fixed << std::setprecision(3);
-			for (size_t i=0; i<a.GetNumberOfRadioFrequencies(); i++) {
-				const std::pair<int, std::string>& f = a.GetRadioFrequencyAt(i);
-				file << "AF " << AirspaceConverter::FrequencyMHz(f.first);
-				if (!f.second.empty()) file << ' ' << boost::locale::conv::between(f.second,"ISO8859-1","utf-8");
-				file << "\r\n";
-			}
-			file.unsetf(std::ios_base::floatfield); //file << std::defaultfloat; not supported by older GCC 4.9.0
+	// Write the name
+	file << "AN " << boost::locale::conv::between(a.GetName(),"ISO8859-1","utf-8") << "\r\n";
+	
+	// Write base and ceiling altitudes
+	file << "AL " << a.GetBaseAltitude().ToString() << "\r\n";
+	file << "AH " << a.GetTopAltitude().ToString() << "\r\n";
+
+	// Write frequencies
+	if (a.GetNumberOfRadioFrequencies() > 0) {
+		file << std::fixed << std::setprecision(3);
+		for (size_t i=0; i<a.GetNumberOfRadioFrequencies(); i++) {
+			const std::pair<int, InternedString>& f = a.GetRadioFrequencyAt(i);
+			file << "AF " << AirspaceConverter::FrequencyMHz(f.first);
+			if (!f.second.IsEmpty()) file << ' ' << boost::locale::conv::between(f.second.Get(),"ISO8859-1","utf-8");
+			file << "\r\n";
 		}
+		file.unsetf(std::ios_base::floatfield); //file << std::defaultfloat; not supported by older GCC 4.9.0
+	}
 
-		// Write transponder code
-		if (a.HasTransponderCode()) file << "AX " << a.GetTransponderCode() << "\r\n";
+	// Write transponder code
+	if (a.HasTransponderCode()) file << "AX " << a.GetTransponderCode() << "\r\n";
 
-		// Set the stream
-		file << std::setfill('0');
+	// Set the stream
+	file << std::setfill('0');
 
-		// Write the geometries
-		if (calculateArcs) {
+	// Write the geometries
+	if (calculateArcs) {
 
-			// Get number of geometries
-			size_t numOfGeometries = a.GetNumberOfGeometries();
+		// Get number of geometries
+		size_t numOfGeometries = a.GetNumberOfGeometries();
 
-			// If no geometries are defined we have to calculate them
-			if (numOfGeometries == 0) {
-				a.Undiscretize();
-				numOfGeometries = a.GetNumberOfGeometries();
-			}
-			assert(numOfGeometries > 0);
-
-			// Write each geometry
-			for (size_t i = 0; i < numOfGeometries; i++) a.GetGeometryAt(i)->WriteOpenAirGeometry(*this);
+		// If no geometries are defined we have to calculate them
+		if (numOfGeometries == 0) {
+			a.Undiscretize();
+			numOfGeometries = a.GetNumberOfGeometries();
 		}
+		assert(numOfGeometries > 0);
 
-		// Otherwise write every single point (except the last one which is the same)
-		else for (size_t i = 0; i < a.GetNumberOfPoints() - 1; i++) WritePoint(a.GetPointAt(i));
-
-		// Add an empty line at the end of the airspace
-		file << "\r\n";
+		// Write each geometry
+		for (size_t i = 0; i < numOfGeometries; i++) a.GetGeometryAt(i)->WriteOpenAirGeometry(*this);
 	}
-	file.close();
+
+	// Otherwise write every single point (except the last one which is the same)
+	else for (size_t i = 0; i < a.GetNumberOfPoints() - 1; i++) WritePoint(a.GetPointAt(i));
+
+	// Add an empty line at the end of the airspace
+	file << "\r\n";
 	return true;
 }
 
+bool OpenAir::CloseOutput() {
+	const bool ok = file.good();
+	file.close();
+	return ok;
+}
+
 void OpenAir::WriteHeader() {
 	for(const std::string& line: AirspaceConverter::disclaimer) file << "* " << line << "\r\n";
 	file << "\r\n* " << AirspaceConverter::GetCreationDateString() << "\r\n\r\n";
@@ -13,6 +13,7 @@
 #pragma once
 #include <string>
 #include <map>
+#include <functional>
 #include <fstream>
 #include "Geometry.h"
 
@@ -34,6 +35,13 @@ public:
 	~OpenAir() {}
 	bool Read(const std::string& fileName);
 	bool Write(const std::string& fileName);
+
+	// Streaming output: write one airspace at time
+	bool OpenOutput(const std::string& fileName);
+	bool WriteAirspace(Airspace& airspace);
+	bool CloseOutput();
+
+	inline void StreamAirspaces(const std::function<void(Airspace&)>& handler) { airspaceHandler = handler; } // pass each airspace read to the handler instead of storing it
 	inline static void CalculateArcsAndCirconferences(const bool calcArcs = true) { calculateArcs = calcArcs; }
 	inline static void SetCoordinateType(CoordinateType type) { coordinateType = type; }
 
@@ -56,6 +64,7 @@ private:
 
 	//bool ParseDY(const std::string& line, Airspace& airspace); // Airway not yet supported
 	bool InsertAirspace(Airspace& airspace);
+	void StoreAirspace(Airspace& airspace);
 	void WriteHeader();
 	bool WriteCategory(const Airspace& airsapce);
 	void WritePoint(const Geometry::LatLon& point, bool isCenterPoint = false, bool addPrefix = true);
@@ -66,6 +75,7 @@ private:
 	static bool calculateArcs;
 	static CoordinateType coordinateType;
 	std::multimap<int, Airspace>& airspaces;
+	std::function<void(Airspace&)> airspaceHandler;
 	bool varRotationClockwise;
 	Geometry::LatLon varPoint;
 	//double varWidth;
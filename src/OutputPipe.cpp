@@ -0,0 +1,55 @@
+//============================================================================
+// AirspaceConverter
+// Since       : 14/6/2016
+// Author      : Alberto Realis-Luc <alberto.realisluc@gmail.com>
+// Web         : https://www.alus.it/AirspaceConverter
+// Repository  : https://github.com/alus-it/AirspaceConverter.git
+// Copyright   : (C) 2016-2021 Alberto Realis-Luc
+// License     : GNU GPL v3
+//
+// This source file is part of AirspaceConverter project
+//============================================================================
+
+
+#include "OutputPipe.h"
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#define PIPE_WRITE_MODE "wb"
+#else
+#include <sys/wait.h>
+#define PIPE_WRITE_MODE "w"
+#endif
+
+bool OutputPipe::Open(const std::string& command) {
+	if (pipe != nullptr) Close();
+	pipe = popen(command.c_str(), PIPE_WRITE_MODE);
+	return pipe != nullptr;
+}
+
+bool OutputPipe::Close() {
+	if (pipe == nullptr) return false;
+	const bool flushed = fflush(pipe) == 0;
+	const int status = pclose(pipe);
+	pipe = nullptr;
+#ifdef _WIN32
+	exitCode = status;
+#else
+	exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+#endif
+	return flushed && status == 0;
+}
+
+OutputPipe::int_type OutputPipe::overflow(int_type c) {
+	if (pipe == nullptr) return traits_type::eof();
+	if (traits_type::eq_int_type(c, traits_type::eof())) return traits_type::not_eof(c);
+	return fputc(traits_type::to_char_type(c), pipe) == EOF ? traits_type::eof() : c;
+}
+
+std::streamsize OutputPipe::xsputn(const char* s, std::streamsize n) {
+	return pipe == nullptr ? 0 : (std::streamsize)fwrite(s, 1, (size_t)n, pipe);
+}
+
+int OutputPipe::sync() {
+	return pipe != nullptr && fflush(pipe) == 0 ? 0 : -1;
+}
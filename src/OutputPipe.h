@@ -0,0 +1,39 @@
+//============================================================================
+// AirspaceConverter
+// Since       : 14/6/2016
+// Author      : Alberto Realis-Luc <alberto.realisluc@gmail.com>
+// Web         : https://www.alus.it/AirspaceConverter
+// Repository  : https://github.com/alus-it/AirspaceConverter.git
+// Copyright   : (C) 2016-2021 Alberto Realis-Luc
+// License     : GNU GPL v3
+//
+// This source file is part of AirspaceConverter project
+//============================================================================
+
+
+#pragma once
+#include <string>
+#include <streambuf>
+#include <cstdio>
+
+// Stream buffer writing into the standard input of a command started by the shell, as with popen()
+// Used to feed a compiler directly while the output is generated, without any intermediate file.
+// If the command ends before reading everything SIGPIPE is raised: the program should ignore it, then the writes just fail.
+class OutputPipe : public std::streambuf {
+public:
+	OutputPipe() : pipe(nullptr), exitCode(0) {}
+	~OutputPipe() { Close(); }
+	bool Open(const std::string& command);
+	inline bool IsOpen() const { return pipe != nullptr; }
+	bool Close(); // close the pipe and wait for the command: true if it exited successfully
+	inline int GetExitCode() const { return exitCode; } // of the last command closed, -1 if terminated by a signal
+
+protected:
+	int_type overflow(int_type c);
+	std::streamsize xsputn(const char* s, std::streamsize n);
+	int sync();
+
+private:
+	FILE* pipe; // already buffered by the C library
+	int exitCode;
+};
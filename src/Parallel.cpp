@@ -0,0 +1,23 @@
+//============================================================================
+// AirspaceConverter
+// Since       : 14/6/2016
+// Author      : Alberto Realis-Luc <alberto.realisluc@gmail.com>
+// Web         : https://www.alus.it/AirspaceConverter
+// Repository  : https://github.com/alus-it/AirspaceConverter.git
+// Copyright   : (C) 2016-2021 Alberto Realis-Luc
+// License     : GNU GPL v3
+//
+// This source file is part of AirspaceConverter project
+//============================================================================
+
+#include "Parallel.h"
+
+unsigned int Parallel::numOfThreads = 0;
+thread_local unsigned int Parallel::threadsOfWorker = 0;
+
+unsigned int Parallel::GetNumOfThreads() {
+	if (threadsOfWorker > 0) return threadsOfWorker;
+	if (numOfThreads > 0) return numOfThreads;
+	const unsigned int hardwareThreads = std::thread::hardware_concurrency(); // it may return 0 if not computable
+	return hardwareThreads > 0 ? hardwareThreads : 1;
+}
@@ -0,0 +1,101 @@
+//============================================================================
+// AirspaceConverter
+// Since       : 14/6/2016
+// Author      : Alberto Realis-Luc <alberto.realisluc@gmail.com>
+// Web         : https://www.alus.it/AirspaceConverter
+// Repository  : https://github.com/alus-it/AirspaceConverter.git
+// Copyright   : (C) 2016-2021 Alberto Realis-Luc
+// License     : GNU GPL v3
+//
+// This source file is part of AirspaceConverter project
+//============================================================================
+
+#pragma once
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <exception>
+#include <algorithm>
+#include <cstddef>
+
+class Parallel {
+public:
+	// Number of worker threads to use: the one set or, by default, what the hardware supports
+	// Inside a worker of For or Schedule it is its share of them, so the nested work does not start more threads than available
+	static unsigned int GetNumOfThreads();
+	inline static void SetNumOfThreads(const unsigned int threads) { numOfThreads = threads; } // 0 means automatic
+
+	// Split the range [0, count) in contiguous chunks and call function(begin, end) on each one of them from a different thread
+	template <typename Function> static void For(const size_t count, Function function, const size_t minChunkSize = 1) {
+		if (count == 0) return;
+		const unsigned int threads = GetNumOfThreads();
+		const size_t chunkSize = std::max(minChunkSize, (count + threads - 1) / threads);
+		if (chunkSize >= count) { // Not worth to start any thread
+			function((size_t)0, count);
+			return;
+		}
+		const size_t numOfChunks = (count + chunkSize - 1) / chunkSize;
+		const unsigned int threadsPerWorker = std::max(1U, (unsigned int)(threads / numOfChunks));
+		std::vector<std::exception_ptr> errors(numOfChunks);
+		std::vector<std::thread> workers;
+		workers.reserve(numOfChunks - 1);
+		for (size_t chunk = 1; chunk < numOfChunks; chunk++) {
+			workers.push_back(std::thread([&function, &errors, chunk, chunkSize, count, threadsPerWorker]() {
+				const WorkerScope scope(threadsPerWorker);
+				try {
+					function(chunk * chunkSize, std::min(count, (chunk + 1) * chunkSize));
+				} catch (...) {
+					errors[chunk] = std::current_exception();
+				}
+			}));
+		}
+		try { // The first chunk is done by the calling thread
+			const WorkerScope scope(threadsPerWorker);
+			function((size_t)0, chunkSize);
+		} catch (...) {
+			errors[0] = std::current_exception();
+		}
+		for (std::thread& worker : workers) worker.join();
+		for (const std::exception_ptr& error : errors) if (error) std::rethrow_exception(error);
+	}
+
+	// Call function(index) for each index in [0, count), each worker takes the next one as soon as it is free, at most maxWorkers at the same time (0 for GetNumOfThreads())
+	// Better than For with few jobs of very different duration, as the ones waiting for external programs
+	template <typename Function> static void Schedule(const size_t count, Function function, const unsigned int maxWorkers = 0) {
+		if (count == 0) return;
+		const unsigned int threads = GetNumOfThreads();
+		const size_t numOfWorkers = std::min(count, (size_t)(maxWorkers > 0 ? maxWorkers : threads));
+		const unsigned int threadsPerWorker = std::max(1U, (unsigned int)(threads / numOfWorkers));
+		std::atomic<size_t> next(0);
+		std::vector<std::exception_ptr> errors(count);
+		const auto work = [&function, &errors, &next, count, threadsPerWorker]() {
+			const WorkerScope scope(threadsPerWorker);
+			for (size_t index = next++; index < count; index = next++) {
+				try {
+					function(index);
+				} catch (...) {
+					errors[index] = std::current_exception();
+				}
+			}
+		};
+		std::vector<std::thread> workers;
+		workers.reserve(numOfWorkers - 1);
+		for (size_t i = 1; i < numOfWorkers; i++) workers.push_back(std::thread(work));
+		work(); // The calling thread is one of the workers
+		for (std::thread& worker : workers) worker.join();
+		for (const std::exception_ptr& error : errors) if (error) std::rethrow_exception(error);
+	}
+
+private:
+	// While alive the current thread is a worker, with the given share of the threads for the work nested in it
+	class WorkerScope {
+	public:
+		explicit WorkerScope(const unsigned int threads) : previous(threadsOfWorker) { threadsOfWorker = threads; }
+		~WorkerScope() { threadsOfWorker = previous; }
+	private:
+		const unsigned int previous;
+	};
+
+	static unsigned int numOfThreads;
+	static thread_local unsigned int threadsOfWorker; // 0 outside the workers
+};
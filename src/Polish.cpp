@@ -13,9 +13,12 @@
 #include "Polish.h"
 #include "AirspaceConverter.h"
 #include "Airspace.h"
+#include "Parallel.h"
+#include "NumberFormat.h"
 #include <sstream>
 #include <boost/filesystem/path.hpp>
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/format.hpp>
 #include <cassert>
 
 /* TODO: customized types
@@ -45,6 +48,75 @@ const int PFMwriter::types[] = {
 };
 */
 
+static const double METERS_PER_DEGREE = 60 * 1852.0; // one NM each minute of latitude
+
+// By default about the size of the grid of the levels 1, 2 and 3 (21, 18 and 15 bits)
+const std::vector<double> Polish::DEFAULT_LEVEL_TOLERANCES = { 20, 150, 1200 };
+const size_t Polish::MAX_SIMPLIFIED_LEVELS = 3; // the objects end at level 3, the last level 4 stays empty
+const int Polish::COORDINATE_DECIMALS = 5; // 1.1 m, finer than the grid of the level 0 (24 bits, 2.4 m)
+
+bool Polish::AreValidLevelTolerances(const std::vector<double>& tolerancesMt) {
+	if (tolerancesMt.size() > MAX_SIMPLIFIED_LEVELS) return false;
+	for (size_t i = 0; i < tolerancesMt.size(); i++) if (tolerancesMt[i] <= 0 || (i > 0 && tolerancesMt[i] <= tolerancesMt[i - 1])) return false;
+	return true;
+}
+
+bool Polish::SetLevelTolerances(const std::vector<double>& tolerancesMt) {
+	if (!AreValidLevelTolerances(tolerancesMt)) return false;
+	levelTolerances.clear();
+	for (const double& tolerance : tolerancesMt) levelTolerances.push_back(tolerance / METERS_PER_DEGREE);
+	return true;
+}
+
+void Polish::SimplifyLevels(const std::vector<Geometry::LatLon>& points, std::vector<std::vector<Geometry::LatLon>>& levels) const {
+	// Each level is simplified from the previous one, with less points at each step; stop when too few points remain
+	levels.clear();
+	for (const double& tolerance : levelTolerances) {
+		std::vector<Geometry::LatLon> simplified;
+		Simplify(levels.empty() ? points : levels.back(), tolerance, simplified);
+		if (simplified.size() < 4) break;
+		levels.push_back(std::move(simplified));
+	}
+}
+
+void Polish::Simplify(const std::vector<Geometry::LatLon>& points, const double tolerance, std::vector<Geometry::LatLon>& simplified) {
+	// Douglas-Peucker, without recursion, in degrees as the grid of the Garmin maps
+	simplified.clear();
+	if (points.size() < 4) return;
+	std::vector<bool> keep(points.size(), false);
+	keep.front() = keep.back() = true;
+	const double tolerance2 = tolerance * tolerance;
+	std::vector<std::pair<size_t, size_t>> stack(1, std::make_pair((size_t)0, points.size() - 1));
+	while (!stack.empty()) {
+		const size_t first = stack.back().first, last = stack.back().second;
+		stack.pop_back();
+		const double ax = points[first].Lon(), ay = points[first].Lat();
+		const double dx = points[last].Lon() - ax, dy = points[last].Lat() - ay, length2 = dx * dx + dy * dy;
+		double maxDist2 = 0;
+		size_t farthest = first;
+		for (size_t i = first + 1; i < last; i++) {
+			// Squared distance from the segment, or from the first point if the segment is degenerated as for a closed ring
+			double px = points[i].Lon() - ax, py = points[i].Lat() - ay;
+			if (length2 > 0) {
+				const double t = std::max(0.0, std::min(1.0, (px * dx + py * dy) / length2));
+				px -= t * dx;
+				py -= t * dy;
+			}
+			const double dist2 = px * px + py * py;
+			if (dist2 > maxDist2) {
+				maxDist2 = dist2;
+				farthest = i;
+			}
+		}
+		if (maxDist2 > tolerance2) {
+			keep[farthest] = true;
+			stack.push_back(std::make_pair(first, farthest));
+			stack.push_back(std::make_pair(farthest, last));
+		}
+	}
+	for (size_t i = 0; i < points.size(); i++) if (keep[i]) simplified.push_back(points[i]);
+}
+
 const std::string Polish::MakeLabel(const Airspace& airspace) {
 	std::stringstream ss;
 	ss << airspace.GetCategoryName() << " "
@@ -57,8 +129,8 @@ const std::string Polish::MakeLabel(const Airspace& airspace) {
 }
 
 void Polish::WriteHeader(const std::string& filename) {
-	for(const std::string& line: AirspaceConverter::disclaimer) file << ";" << line << "\n";
-	file << "\n;" << AirspaceConverter::GetCreationDateString() << "\n\n"
+	for(const std::string& line: AirspaceConverter::disclaimer) output << ";" << line << "\n";
+	output << "\n;" << AirspaceConverter::GetCreationDateString() << "\n\n"
 		<< "[IMG ID]\n" //section identifier
 		<< "ID=62831853\n" // unique identifier: 2 PI
 		<< "Name=" << boost::filesystem::path(filename).stem().string() << "\n" // map name
@@ -96,63 +168,119 @@ bool Polish::Write(const std::string& filename, const std::multimap<int, Airspac
 		AirspaceConverter::LogMessage("Polish output: no airspace, nothing to write");
 		return false;
 	}
+	return OpenOutput(filename) && WriteAll(airspaces);
+}
+
+bool Polish::Pipe(const std::string& command, const std::string& mapName, const std::multimap<int, Airspace>& airspaces) {
+	if (airspaces.empty()) {
+		AirspaceConverter::LogMessage("Polish output: no airspace, nothing to write");
+		return false;
+	}
+	return OpenPipe(command, mapName) && WriteAll(airspaces);
+}
 
+bool Polish::WriteAll(const std::multimap<int, Airspace>& airspaces) {
+	// Simplify the geometries for the higher levels in parallel, then go trough all airspaces
+	std::vector<const Airspace*> toWrite;
+	toWrite.reserve(airspaces.size());
+	for (const std::pair<const int,Airspace>& pair : airspaces) toWrite.push_back(&pair.second);
+	std::vector<std::vector<std::vector<Geometry::LatLon>>> levels(toWrite.size());
+	Parallel::For(toWrite.size(), [&](const size_t begin, const size_t end) {
+		for (size_t i = begin; i < end; i++) SimplifyLevels(toWrite[i]->GetPoints(), levels[i]);
+	}, 64);
+	for (size_t i = 0; i < toWrite.size(); i++) WriteAirspace(*toWrite[i], levels[i]);
+	return CloseOutput();
+}
+
+bool Polish::OpenOutput(const std::string& filename) {
 	// Check if has the right extension
 	if (!boost::iequals(boost::filesystem::path(filename).extension().string(), ".mp")) {
 		AirspaceConverter::LogError("expected MP extension but found: " + boost::filesystem::path(filename).extension().string());
 		return false;
 	}
 
-	if (file.is_open()) file.close();
-	file.open(filename, std::ios::out | std::ios::trunc | std::ios::binary);
-	if (!file.is_open() || file.bad()) {
+	if (file.is_open() || pipe.IsOpen()) CloseOutput();
+	if (file.open(filename, std::ios::out | std::ios::trunc | std::ios::binary) == nullptr) {
 		AirspaceConverter::LogError("Unable to open output file: " + filename);
 		return false;
 	}
 	AirspaceConverter::LogMessage("Writing Polish output file: " + filename);
-
+	output.rdbuf(&file);
 	WriteHeader(filename);
+	return true;
+}
 
-	// Go trough all airspaces
-	for (const std::pair<const int,Airspace>& pair : airspaces)
-	{
-		// Get the airspace
-		const Airspace& a = pair.second;
-
-		// Just a couple if assertions
-		assert(a.GetNumberOfPoints() > 3);
-		assert(a.GetFirstPoint()==a.GetLastPoint());
-
-		// Determine if it's a POLYGON or a POLYLINE
-		if (a.GetType() == Airspace::PROHIBITED || a.GetType() == Airspace::CTR || a.GetType() == Airspace::DANGER) {
-			file << "[POLYGON]\n"
-				//<< "Type="<< types[a.GetType()] <<"\n"; //TODO...
-				<< "Type=0x18" <<"\n";
-		} else {
-			file << "[POLYLINE]\n"
-				<< "Type=0x07\n"; //TODO....
-		}
+bool Polish::OpenPipe(const std::string& command, const std::string& mapName) {
+	if (file.is_open() || pipe.IsOpen()) CloseOutput();
+	AirspaceConverter::LogMessage("Piping Polish output into: " + command);
+	if (!pipe.Open(command)) {
+		AirspaceConverter::LogError("Unable to start: " + command);
+		return false;
+	}
+	output.rdbuf(&pipe);
+	WriteHeader(mapName);
+	return true;
+}
+
+void Polish::WriteAirspace(const Airspace& airspace) {
+	std::vector<std::vector<Geometry::LatLon>> levels;
+	SimplifyLevels(airspace.GetPoints(), levels);
+	WriteAirspace(airspace, levels);
+}
 
-		// Add the label
-		file << "Label="<<MakeLabel(a)<<"\n";
+void Polish::WriteAirspace(const Airspace& a, const std::vector<std::vector<Geometry::LatLon>>& levels) {
+	// Just a couple if assertions
+	assert(a.GetNumberOfPoints() > 3);
+	assert(a.GetFirstPoint()==a.GetLastPoint());
 
-		file << "Levels=3\n";
+	// Determine if it's a POLYGON or a POLYLINE
+	if (a.GetType() == Airspace::PROHIBITED || a.GetType() == Airspace::CTR || a.GetType() == Airspace::DANGER) {
+		output << "[POLYGON]\n"
+			//<< "Type="<< types[a.GetType()] <<"\n"; //TODO...
+			<< "Type=0x18" <<"\n";
+	} else {
+		output << "[POLYLINE]\n"
+			<< "Type=0x07\n"; //TODO....
+	}
 
-		// Insert all the points
-		file << "Data0=";
-		double lat,lon;
-		for (size_t i=0; i<a.GetNumberOfPoints()-1; i++) {
-			a.GetPointAt(i).GetLatLon(lat,lon);
-			file << "(" << lat << "," << lon << "),";
-		}
-		a.GetLastPoint().GetLatLon(lat,lon);
-		file << "(" << lat << "," << lon << ")\n";
+	// Add the label
+	output << "Label="<<MakeLabel(a)<<"\n";
 
-		//file<< "EndLevel=4\n";
+	output << "Levels=3\n";
 
-		// Close the element
-		file << "[END]\n\n";
+	// Insert all the points, then the simplified ones for the higher levels
+	WritePoints(0, a.GetPoints());
+	for (size_t i = 0; i < levels.size(); i++) WritePoints(i + 1, levels[i]);
+
+	//file<< "EndLevel=4\n";
+
+	// Close the element
+	output << "[END]\n\n";
+}
+
+void Polish::WritePoints(const size_t level, const std::vector<Geometry::LatLon>& points) {
+	line.assign("Data");
+	NumberFormat::AppendInteger((long long)level, line);
+	line.append(1, '=');
+	for (size_t i = 0; i < points.size(); i++) {
+		line.append(i == 0 ? "(" : ",(");
+		NumberFormat::AppendFixed(points[i].Lat(), COORDINATE_DECIMALS, line);
+		line.append(1, ',');
+		NumberFormat::AppendFixed(points[i].Lon(), COORDINATE_DECIMALS, line);
+		line.append(1, ')');
 	}
-	file.close();
-	return true;
+	line.append(1, '\n');
+	output.write(line.data(), line.size());
+}
+
+bool Polish::CloseOutput() {
+	bool ok = output.good() && output.rdbuf() != nullptr;
+	if (file.is_open()) ok = file.close() != nullptr && ok;
+	if (pipe.IsOpen() && !pipe.Close()) {
+		AirspaceConverter::LogError(boost::str(boost::format("returned by the command reading the Polish output, exit code %1d") %pipe.GetExitCode()));
+		ok = false;
+	}
+	output.rdbuf(nullptr);
+	output.clear();
+	return ok;
 }
@@ -12,21 +12,47 @@
 
 #pragma once
 #include <string>
+#include <vector>
 #include <map>
 #include <fstream>
+#include "Geometry.h"
+#include "OutputPipe.h"
 
 class Airspace;
 
 class Polish {
 public:
-	Polish() {}
+	Polish() : output(nullptr) { SetLevelTolerances(DEFAULT_LEVEL_TOLERANCES); }
 	~Polish() {}
 	bool Write(const std::string& filename, const std::multimap<int, Airspace>& airspaces);
+	bool Pipe(const std::string& command, const std::string& mapName, const std::multimap<int, Airspace>& airspaces); // into the standard input of the command, true only if it succeeded
+
+	// Streaming output: write one airspace at time
+	bool OpenOutput(const std::string& filename);
+	bool OpenPipe(const std::string& command, const std::string& mapName); // the map is named after the stem of mapName
+	void WriteAirspace(const Airspace& airspace);
+	bool CloseOutput();
+
+	// Tolerances in meters of the simplified geometries Data1, Data2... written for the higher levels, at most MAX_SIMPLIFIED_LEVELS increasing values, none for only Data0
+	static bool AreValidLevelTolerances(const std::vector<double>& tolerancesMt);
+	bool SetLevelTolerances(const std::vector<double>& tolerancesMt);
+	void SimplifyLevels(const std::vector<Geometry::LatLon>& points, std::vector<std::vector<Geometry::LatLon>>& levels) const;
+	static const size_t MAX_SIMPLIFIED_LEVELS;
+	static const std::vector<double> DEFAULT_LEVEL_TOLERANCES; // [m]
 
 private:
+	bool WriteAll(const std::multimap<int, Airspace>& airspaces);
 	void WriteHeader(const std::string& filename);
+	void WriteAirspace(const Airspace& airspace, const std::vector<std::vector<Geometry::LatLon>>& levels);
+	void WritePoints(const size_t level, const std::vector<Geometry::LatLon>& points);
+	static void Simplify(const std::vector<Geometry::LatLon>& points, const double tolerance, std::vector<Geometry::LatLon>& simplified);
 
 	const static std::string MakeLabel(const Airspace& airspace);
 	//static const int types[];
-	std::ofstream file;
+	static const int COORDINATE_DECIMALS;
+	std::vector<double> levelTolerances; // [deg]
+	std::filebuf file;
+	OutputPipe pipe;
+	std::ostream output; // on the file or on the pipe
+	std::string line; // buffer reused for each line of points
 };
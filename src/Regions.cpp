@@ -0,0 +1,260 @@
+//============================================================================
+// AirspaceConverter
+// Since       : 14/6/2016
+// Author      : Alberto Realis-Luc <alberto.realisluc@gmail.com>
+// Web         : https://www.alus.it/AirspaceConverter
+// Repository  : https://github.com/alus-it/AirspaceConverter.git
+// Copyright   : (C) 2016-2021 Alberto Realis-Luc
+// License     : GNU GPL v3
+//
+// This source file is part of AirspaceConverter project
+//============================================================================
+
+#include "Regions.h"
+#include "AirspaceConverter.h"
+#include "Airspace.h"
+#include "Waypoint.h"
+#include "Parallel.h"
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <boost/algorithm/string.hpp>
+#include <boost/geometry.hpp>
+#include <boost/geometry/geometries/point_xy.hpp>
+#include <boost/geometry/geometries/box.hpp>
+#include <boost/geometry/geometries/polygon.hpp>
+#include <boost/geometry/geometries/multi_polygon.hpp>
+#include <boost/geometry/index/rtree.hpp>
+#include <boost/format.hpp>
+
+namespace bg = boost::geometry;
+namespace bgi = boost::geometry::index;
+
+namespace {
+
+typedef bg::model::d2::point_xy<double> PointXY; // longitude, latitude
+typedef bg::model::box<PointXY> Box;
+typedef std::pair<Box, size_t> IndexEntry;
+typedef bg::model::polygon<PointXY> PolygonXY;
+typedef bg::model::multi_polygon<PolygonXY> MultiPolygonXY;
+
+// Bounding box of the points, all the longitudes if they go across the antimeridian
+Box BoundingBox(const std::vector<Geometry::LatLon>& points) {
+	double minLat = 90, maxLat = -90, minLon = 180, maxLon = -180;
+	for (const Geometry::LatLon& p : points) {
+		minLat = std::min(minLat, p.Lat());
+		maxLat = std::max(maxLat, p.Lat());
+		minLon = std::min(minLon, p.Lon());
+		maxLon = std::max(maxLon, p.Lon());
+	}
+	if (maxLon - minLon > 180) {
+		minLon = -180;
+		maxLon = 180;
+	}
+	return Box(PointXY(minLon, minLat), PointXY(maxLon, maxLat));
+}
+
+// Polygon of the points with continuous longitudes, so beyond 180 if they go across the antimeridian
+PolygonXY MakePolygon(const std::vector<Geometry::LatLon>& points) {
+	PolygonXY polygon;
+	for (const Geometry::LatLon& p : points) {
+		double lon = p.Lon();
+		if (!polygon.outer().empty()) {
+			if (lon - polygon.outer().back().x() > 180) lon -= 360;
+			else if (lon - polygon.outer().back().x() < -180) lon += 360;
+		}
+		polygon.outer().push_back(PointXY(lon, p.Lat()));
+	}
+	bg::correct(polygon);
+	return polygon;
+}
+
+// Cut the airspace on the polygon of a region: each part remaining is a new airspace, without its holes if any
+void ClipOnPolygon(const Airspace& airspace, const PolygonXY& region, std::vector<Airspace>& parts) {
+	const PolygonXY shape(MakePolygon(airspace.GetPoints()));
+	if (bg::covered_by(shape, region)) { // nothing to cut, the polygon may be concave so checking the points is not enough
+		parts.push_back(airspace);
+		return;
+	}
+	const Box regionBox(bg::return_envelope<Box>(region));
+	const Box shapeBox(bg::return_envelope<Box>(shape));
+
+	// Try the airspace also one turn before and after, to meet the regions beyond the antimeridian
+	for (double shift = -360; shift <= 360; shift += 360) {
+		if (shapeBox.max_corner().x() + shift < regionBox.min_corner().x() || shapeBox.min_corner().x() + shift > regionBox.max_corner().x()) continue;
+		PolygonXY shifted(shape);
+		for (PointXY& p : shifted.outer()) p.x(p.x() + shift);
+		MultiPolygonXY intersection;
+		bg::intersection(shifted, region, intersection);
+		for (const PolygonXY& piece : intersection) {
+			if (bg::area(piece) <= 0) continue;
+			std::vector<Geometry::LatLon> points;
+			points.reserve(piece.outer().size());
+			for (const PointXY& p : piece.outer()) points.push_back(Geometry::LatLon(p.y(), p.x()));
+			Airspace part(airspace);
+			part.SetPoints(std::move(points)); // the arcs and circles are not valid anymore
+			if (part.ClosePoints()) parts.push_back(std::move(part));
+		}
+	}
+}
+
+} // namespace
+
+bool Regions::Region::Contains(const Geometry::LatLon& position) const {
+	return limits.IsPositionWithinLimits(position) && (polygon.empty() || Geometry::IsInsidePolygon(polygon, position));
+}
+
+bool Regions::Read(const std::string& filename) {
+	std::ifstream input(filename, std::ios::binary);
+	if (!input.is_open() || input.bad()) {
+		AirspaceConverter::LogError("Unable to open regions file: " + filename);
+		return false;
+	}
+	AirspaceConverter::LogMessage("Reading regions file: " + filename);
+	int linecount = 0;
+	std::string sLine;
+	bool isCRLF = false;
+	const size_t initialRegions = regions.size();
+	while (!input.eof() && input.good()) {
+		AirspaceConverter::SafeGetline(input, sLine, isCRLF);
+		linecount++;
+		boost::trim(sLine);
+		if (sLine.empty() || sLine.front() == '#') continue;
+		std::vector<std::string> fields;
+		boost::split(fields, sLine, boost::is_any_of(","));
+		for (std::string& field : fields) boost::trim(field);
+		std::vector<double> values;
+		try {
+			for (size_t i = 1; i < fields.size(); i++) values.push_back(std::stod(fields[i]));
+		} catch (...) {
+			AirspaceConverter::LogError(boost::str(boost::format("at line %1d: unable to parse the coordinates of region %2s") %linecount %fields.front()));
+			continue;
+		}
+		bool added = false;
+		if (values.size() == 4) added = AddBox(fields.front(), values[0], values[1], values[2], values[3]);
+		else if (values.size() >= 6 && values.size() % 2 == 0) {
+			std::vector<Geometry::LatLon> polygon;
+			for (size_t i = 0; i < values.size(); i += 2) polygon.push_back(Geometry::LatLon(values[i], values[i + 1]));
+			added = AddPolygon(fields.front(), polygon);
+		}
+		if (!added) AirspaceConverter::LogError(boost::str(boost::format("at line %1d: skip region %2s, expected a new name followed by northLat,southLat,westLon,eastLon or by at least 3 points lat,lon") %linecount %fields.front()));
+	}
+	AirspaceConverter::LogMessage(boost::str(boost::format("Read %1d region(s) from: %2s") %(regions.size() - initialRegions) %filename));
+	return regions.size() > initialRegions;
+}
+
+bool Regions::IsNameValid(const std::string& name) const {
+	if (name.empty() || name.find_first_of("/\\:*?\"<>|") != std::string::npos) return false; // it will be part of a file name
+	for (const Region& r : regions) if (r.name == name) return false;
+	return true;
+}
+
+bool Regions::AddBox(const std::string& name, const double topLat, const double bottomLat, const double leftLon, const double rightLon) {
+	if (!IsNameValid(name)) return false;
+	Region region;
+	region.name = name;
+	if (!region.limits.Set(topLat, bottomLat, leftLon, rightLon)) return false;
+	regions.push_back(std::move(region));
+	return true;
+}
+
+bool Regions::AddPolygon(const std::string& name, const std::vector<Geometry::LatLon>& polygon) {
+	if (!IsNameValid(name) || polygon.size() < 3) return false;
+	double minLat = 90, maxLat = -90, minLon = 180, maxLon = -180;
+	for (const Geometry::LatLon& p : polygon) {
+		if (!Geometry::LatLon::IsValidLat(p.Lat()) || !Geometry::LatLon::IsValidLon(p.Lon())) return false;
+		minLat = std::min(minLat, p.Lat());
+		maxLat = std::max(maxLat, p.Lat());
+		minLon = std::min(minLon, p.Lon());
+		maxLon = std::max(maxLon, p.Lon());
+	}
+	if (maxLon - minLon > 180) return false; // polygons across the antimeridian not supported
+	Region region;
+	region.name = name;
+	if (!region.limits.Set(maxLat, minLat, minLon, maxLon)) return false;
+	region.polygon = polygon;
+	if (region.polygon.front() != region.polygon.back()) region.polygon.push_back(region.polygon.front());
+	regions.push_back(std::move(region));
+	return true;
+}
+
+void Regions::Assign(const std::multimap<int, Airspace>& airspaces, const WaypointSet& waypoints, const bool clip, const bool useIndex /* = true */) {
+	airspacesOfRegion.assign(regions.size(), std::vector<const Airspace*>());
+	waypointsOfRegion.assign(regions.size(), std::vector<const Waypoint*>());
+	if (regions.empty()) return;
+
+	// R-tree on the boxes of the regions, the ones across the antimeridian are split in two
+	std::vector<IndexEntry> entries;
+	for (size_t r = 0; r < regions.size(); r++) {
+		const Geometry::Limits& l = regions[r].limits;
+		if (l.GetLeftLongitudeLimit() <= l.GetRightLongitudeLimit()) entries.push_back(std::make_pair(Box(PointXY(l.GetLeftLongitudeLimit(), l.GetBottomLatitudeLimit()), PointXY(l.GetRightLongitudeLimit(), l.GetTopLatitudeLimit())), r));
+		else {
+			entries.push_back(std::make_pair(Box(PointXY(l.GetLeftLongitudeLimit(), l.GetBottomLatitudeLimit()), PointXY(180, l.GetTopLatitudeLimit())), r));
+			entries.push_back(std::make_pair(Box(PointXY(-180, l.GetBottomLatitudeLimit()), PointXY(l.GetRightLongitudeLimit(), l.GetTopLatitudeLimit())), r));
+		}
+	}
+	const bgi::rtree<IndexEntry, bgi::rstar<16>> index(useIndex ? entries.begin() : entries.end(), entries.end());
+	const auto findCandidates = [&](const Box& box, std::vector<size_t>& candidates) {
+		std::vector<IndexEntry> found;
+		if (useIndex) index.query(bgi::intersects(box), std::back_inserter(found));
+		else for (const IndexEntry& entry : entries) if (bg::intersects(box, entry.first)) found.push_back(entry);
+		candidates.clear();
+		for (const IndexEntry& entry : found) candidates.push_back(entry.second);
+		std::sort(candidates.begin(), candidates.end());
+		candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+	};
+
+	// The regions of each airspace, in parallel, then collected in the original order
+	std::vector<const Airspace*> airspacesList;
+	airspacesList.reserve(airspaces.size());
+	for (const std::pair<const int, Airspace>& a : airspaces) airspacesList.push_back(&a.second);
+	std::vector<std::vector<size_t>> airspaceRegions(airspacesList.size());
+	Parallel::For(airspacesList.size(), [&](const size_t begin, const size_t end) {
+		std::vector<size_t> candidates;
+		for (size_t i = begin; i < end; i++) {
+			const Airspace& airspace = *airspacesList[i];
+			if (airspace.GetPoints().empty()) continue;
+			findCandidates(BoundingBox(airspace.GetPoints()), candidates);
+			for (const size_t r : candidates) {
+				const Region& region = regions[r];
+				if (clip || std::any_of(airspace.GetPoints().begin(), airspace.GetPoints().end(), [&region](const Geometry::LatLon& p) { return region.Contains(p); }))
+					airspaceRegions[i].push_back(r);
+			}
+		}
+	}, 64);
+	for (size_t i = 0; i < airspacesList.size(); i++) for (const size_t r : airspaceRegions[i]) airspacesOfRegion[r].push_back(airspacesList[i]);
+
+	// The same for the waypoints
+	std::vector<const Waypoint*> waypointsList;
+	waypointsList.reserve(waypoints.Size());
+	for (const Waypoint& w : waypoints) waypointsList.push_back(&w);
+	std::vector<std::vector<size_t>> waypointRegions(waypointsList.size());
+	Parallel::For(waypointsList.size(), [&](const size_t begin, const size_t end) {
+		std::vector<size_t> candidates;
+		for (size_t i = begin; i < end; i++) {
+			const Geometry::LatLon position(waypointsList[i]->GetPosition());
+			findCandidates(Box(PointXY(position.Lon(), position.Lat()), PointXY(position.Lon(), position.Lat())), candidates);
+			for (const size_t r : candidates) if (regions[r].Contains(position)) waypointRegions[i].push_back(r);
+		}
+	}, 1024);
+	for (size_t i = 0; i < waypointsList.size(); i++) for (const size_t r : waypointRegions[i]) waypointsOfRegion[r].push_back(waypointsList[i]);
+}
+
+void Regions::Extract(const size_t region, const bool clip, std::multimap<int, Airspace>& airspaces, WaypointSet& waypoints) const {
+	const Region& r = regions[region];
+	const bool clipOnPolygon = clip && !r.polygon.empty();
+	const PolygonXY area(clipOnPolygon ? MakePolygon(r.polygon) : PolygonXY());
+	std::vector<Airspace> parts;
+	for (const Airspace* a : airspacesOfRegion[region]) {
+		if (clipOnPolygon) {
+			parts.clear();
+			ClipOnPolygon(*a, area, parts);
+			for (Airspace& part : parts) airspaces.insert(std::pair<int, Airspace>(part.GetType(), std::move(part)));
+			continue;
+		}
+		Airspace airspace(*a);
+		if (clip && !clipOnPolygon && !airspace.ClipToLimits(r.limits)) continue;
+		airspaces.insert(std::pair<int, Airspace>(airspace.GetType(), std::move(airspace)));
+	}
+	for (const Waypoint* w : waypointsOfRegion[region]) waypoints.Add(Waypoint(*w));
+}
@@ -0,0 +1,59 @@
+//============================================================================
+// AirspaceConverter
+// Since       : 14/6/2016
+// Author      : Alberto Realis-Luc <alberto.realisluc@gmail.com>
+// Web         : https://www.alus.it/AirspaceConverter
+// Repository  : https://github.com/alus-it/AirspaceConverter.git
+// Copyright   : (C) 2016-2021 Alberto Realis-Luc
+// License     : GNU GPL v3
+//
+// This source file is part of AirspaceConverter project
+//============================================================================
+
+#pragma once
+#include "Geometry.h"
+#include <string>
+#include <vector>
+#include <map>
+
+class Airspace;
+class Waypoint;
+class WaypointSet;
+
+// Named regions to extract many subsets from the same loaded airspaces and waypoints, in one pass.
+// The regions file has one region for each line: the name followed by the 4 limits northLat,southLat,westLon,eastLon
+// or by the points lat,lon of a polygon (at least 3), all comma separated; the empty lines and the ones starting with # are skipped.
+// An airspace or a waypoint belongs to a region as with the limits: if at least one of its points is inside it.
+// The candidates come from an R-tree on the bounding boxes of the regions.
+class Regions {
+public:
+	struct Region {
+		std::string name;
+		Geometry::Limits limits; // bounding box of the region
+		std::vector<Geometry::LatLon> polygon; // closed, empty if the region is just the box
+		bool Contains(const Geometry::LatLon& position) const;
+	};
+
+	Regions() {}
+	~Regions() {}
+	bool Read(const std::string& filename);
+	bool AddBox(const std::string& name, const double topLat, const double bottomLat, const double leftLon, const double rightLon);
+	bool AddPolygon(const std::string& name, const std::vector<Geometry::LatLon>& polygon);
+	inline size_t GetNumOfRegions() const { return regions.size(); }
+	inline const Region& GetRegion(const size_t index) const { return regions[index]; }
+
+	// Find the airspaces and waypoints of each region, with clip also the airspaces crossing the limits without points inside them
+	void Assign(const std::multimap<int, Airspace>& airspaces, const WaypointSet& waypoints, const bool clip, const bool useIndex = true); // without the index all the regions are checked, only as reference
+	inline const std::vector<const Airspace*>& GetAirspaces(const size_t region) const { return airspacesOfRegion[region]; } // in the original order
+	inline const std::vector<const Waypoint*>& GetWaypoints(const size_t region) const { return waypointsOfRegion[region]; }
+
+	// Copy the content of a region, with clip the airspaces are cut on its limits or on its polygon, where they may split in more parts
+	void Extract(const size_t region, const bool clip, std::multimap<int, Airspace>& airspaces, WaypointSet& waypoints) const;
+
+private:
+	bool IsNameValid(const std::string& name) const;
+
+	std::vector<Region> regions;
+	std::vector<std::vector<const Airspace*>> airspacesOfRegion;
+	std::vector<std::vector<const Waypoint*>> waypointsOfRegion;
+};
@@ -13,11 +13,10 @@
 #include "SeeYou.h"
 #include "AirspaceConverter.h"
 #include "Waypoint.h"
-#include "Airfield.h"
 #include "Airspace.h"
 #include "Geometry.h"
+#include "NumberFormat.h"
 #include <fstream>
-#include <iomanip>
 #include <boost/algorithm/string.hpp>
 #include <boost/tokenizer.hpp>
 #include <boost/format.hpp>
@@ -26,8 +25,8 @@
 
 const std::string SeeYou::defaultHeader = "name,code,country,lat,lon,elev,style,rwdir,rwlen,freq,desc";
 
-SeeYou::SeeYou(std::multimap<int,Waypoint*>& waypointsMap):
-	waypoints(waypointsMap) {
+SeeYou::SeeYou(WaypointSet& waypointsSet):
+	waypoints(waypointsSet) {
 }
 
 bool SeeYou::ParseLatitude(const std::string& text, double& lat) {
@@ -273,36 +272,12 @@ bool SeeYou::Read(const std::string& fileName) {
 		if (blankAltitude) altitude = 0;
 		if (!altitudePresent && !blankAltitude && !terrainMapsPresent)
 			AirspaceConverter::LogWarning(boost::str(boost::format("on line %1d: invalid elevation: %2s, assuming AMSL") %linecount %elevationText));
+		const Waypoint::ElevationStatus elevationStatus = altitudePresent ? Waypoint::elevationRead : (blankAltitude ? Waypoint::elevationBlank : Waypoint::elevationInvalid);
 
 		// Waypoint style
 		if (!ParseStyle(boost::trim_copy(*(++token)),type))
 			AirspaceConverter::LogWarning(boost::str(boost::format("on line %1d: invalid waypoint style: %2s, assuming unknown") %linecount %(*token)));
 
-		// Altitude verification against terrain raster map
-		if (terrainMapsPresent && type > Waypoint::WaypointType::normal) { // Unknown and normal waypoints skipped
-			double terrainAlt;
-			if (AirspaceConverter::GetTerrainAltitudeMt(latitude, longitude, terrainAlt)) {
-				if (altitudePresent) {
-					const double delta = fabs(altitude - terrainAlt);
-					if (terrainAlt > 5 ? delta > 10 : delta > 15) { // Consider bigger threshold if delta > 5 m (maybe it was really intended AMSL)
-						AirspaceConverter::LogWarning(boost::str(boost::format("on line %1d: detected altitude difference of: %2g m respect ground, using terrain altitude: %3g m") %linecount %delta %terrainAlt));
-						altitude = (float)terrainAlt;
-					}
-				} else {
-					if (blankAltitude)
-						AirspaceConverter::LogWarning(boost::str(boost::format("on line %1d: blank elevation, using terrain altitude: %2g m") %linecount %terrainAlt));
-					else
-						AirspaceConverter::LogWarning(boost::str(boost::format("on line %1d: invalid elevation: %2s, using terrain altitude: %2g m") %linecount %elevationText %terrainAlt));
-					altitude = (float)terrainAlt;
-				}
-			} else {
-				if (blankAltitude)
-					AirspaceConverter::LogWarning(boost::str(boost::format("on line %1d: blank elevation, waypoint out of loaded terrain maps: assuming AMSL") %linecount));
-				else if (!altitudePresent)
-					AirspaceConverter::LogWarning(boost::str(boost::format("on line %1d: invalid elevation: %2s, waypoint out of loaded terrain maps: assuming AMSL") %linecount %elevationText));
-			}
-		}
-
 		// If it's an airfield...
 		if(Waypoint::IsTypeAirfield((Waypoint::WaypointType)type)) {
 			// Runway direction
@@ -322,15 +297,16 @@ bool SeeYou::Read(const std::string& fileName) {
 			assert(token != tokens.end());
 
 			// Build the airfield
-			Airfield* airfield = new Airfield(name, code, country, latitude, longitude, altitude, type, runwayDir, runwayLength, radioFreq, description);
+			Waypoint airfield(name, code, country, latitude, longitude, altitude, type, runwayDir, runwayLength, radioFreq, description);
 			if (altRadioFreq > 0) {
 				assert(radioFreq > 0);
 				if (altRadioFreq == radioFreq) AirspaceConverter::LogWarning(boost::str(boost::format("on line %1d: skipping repeated secondary radio frequency for airfield.") %linecount));
-				else airfield->SetOtherFrequency(altRadioFreq);
+				else airfield.SetOtherFrequency(altRadioFreq);
 			}
+			airfield.SetElevationStatus(elevationStatus);
 
-			// Add it to the multimap
-			waypoints.insert(std::pair<int, Waypoint*>(type, (Waypoint*)airfield));
+			// Add it to the waypoints
+			waypoints.Add(std::move(airfield));
 		} else {
 			// Skip runway length and direction
 			token++;
@@ -345,18 +321,19 @@ bool SeeYou::Read(const std::string& fileName) {
 			assert(token != tokens.end());
 
 			// Build the waypoint
-			Waypoint* waypoint = new Waypoint(name, code, country, latitude, longitude, altitude, type, description);
-			if (radioFreq > 0) waypoint->SetOtherFrequency(radioFreq);
+			Waypoint waypoint(name, code, country, latitude, longitude, altitude, type, description);
+			if (radioFreq > 0) waypoint.SetOtherFrequency(radioFreq);
+			waypoint.SetElevationStatus(elevationStatus);
 
-			// Add it to the multimap
-			waypoints.insert(std::pair<int, Waypoint*>(type, waypoint));
+			// Add it to the waypoints
+			waypoints.Add(std::move(waypoint));
 		}
 	}
 	return true;
 }
 
 bool SeeYou::Write(const std::string& fileName) {
-	if (waypoints.empty()) {
+	if (waypoints.IsEmpty()) {
 		AirspaceConverter::LogMessage("SeeYou output: no waypoints, nothing to write");
 		return false;
 	}
@@ -371,10 +348,9 @@ bool SeeYou::Write(const std::string& fileName) {
 	// Write default CUP header on first line, and for compatibilty with "Strepla" do not write any disclaimer or comments 
 	file << "name,code,country,lat,lon,elev,style,rwdir,rwlen,freq,desc\r\n";
 
-	// Go trough all waypoints
-	for (const std::pair<int,Waypoint*>& pair : waypoints) {
-		assert(pair.second != nullptr);
-		const Waypoint& w(*pair.second);
+	// Go trough all waypoints, each line is made in the same buffer
+	std::string line;
+	for (const Waypoint& w : waypoints) {
 
 		// Name is mandatory according to SeeYou specs
 		if (w.GetName().empty()) {
@@ -383,64 +359,75 @@ bool SeeYou::Write(const std::string& fileName) {
 		}
 
 		// Long name
-		file << '"' << w.GetName() << "\",";
+		line.assign(1, '"').append(w.GetName()).append("\",");
 
 		// Code "short name"
-		if (!w.GetCode().empty()) file << '"' << w.GetCode() << '"';
+		if (!w.GetCode().empty()) line.append(1, '"').append(w.GetCode()).append(1, '"');
 
 		// Country code
-		file << ',' << w.GetCountry() << ',';
+		line.append(1, ',').append(w.GetCountry()).append(1, ',');
 
 		// Latitude
 		int deg;
 		double min; // the minutes must be expressed with 3 decimals so they have to be rounded on three decimals
 		const Geometry::LatLon& pos(w.GetPosition());
 		pos.GetLatDegMin(deg,min);
-		file << std::setfill('0') << std::fixed << std::setprecision(3);
-		file << std::setw(2) << deg << std::setw(6) << std::round(min*1000)/1000 << pos.GetNorS() << ',';
+		NumberFormat::AppendInteger(deg, line, 2);
+		NumberFormat::AppendFixed(std::round(min*1000)/1000, 3, line, 6);
+		line.append(1, pos.GetNorS()).append(1, ',');
 
 		// Longitude
 		pos.GetLonDegMin(deg,min);
-		file << std::setw(3) << deg << std::setw(6) << std::round(min*1000)/1000 << pos.GetEorW() << ',';
+		NumberFormat::AppendInteger(deg, line, 3);
+		NumberFormat::AppendFixed(std::round(min*1000)/1000, 3, line, 6);
+		line.append(1, pos.GetEorW()).append(1, ',');
 
 		// Altitude
-		if (w.GetAltitude() != 0) file << std::setprecision(1) << std::round(w.GetAltitude()*10)/10 << "m,"; // round altitude in meters on one decimal
-		else file << "0,";
+		if (w.GetAltitude() != 0) { // round altitude in meters on one decimal
+			NumberFormat::AppendFixed(std::round(w.GetAltitude()*10)/10, 1, line);
+			line.append("m,");
+		} else line.append("0,");
 
 		// Waypoint style
-		file << (int)w.GetType() << ',';
+		NumberFormat::AppendInteger((int)w.GetType(), line);
+		line.append(1, ',');
 
 		if (w.IsAirfield()) {
-			const Airfield& a((const Airfield&)w);
-
 			// Runway direction
-			if (a.HasRunwayDir()) file << std::setw(3) << a.GetRunwayDir();
-			file << ',';
+			if (w.HasRunwayDir()) NumberFormat::AppendInteger(w.GetRunwayDir(), line, 3);
+			line.append(1, ',');
 
 			// Runway length
-			if (a.HasRunwayLength()) file << a.GetRunwayLength() << 'm';
-			file << ',';
+			if (w.HasRunwayLength()) {
+				NumberFormat::AppendInteger(w.GetRunwayLength(), line);
+				line.append(1, 'm');
+			}
+			line.append(1, ',');
 
 			// Radio frequency
-			if (a.HasRadioFrequency()) {
-				file << std::setprecision(3) << AirspaceConverter::FrequencyMHz(a.GetRadioFrequency());
-				if (a.HasOtherFrequency()) file << '-' << AirspaceConverter::FrequencyMHz(a.GetOtherFrequency());
+			if (w.HasRadioFrequency()) {
+				NumberFormat::AppendFixed(AirspaceConverter::FrequencyMHz(w.GetRadioFrequency()), 3, line);
+				if (w.HasOtherFrequency()) {
+					line.append(1, '-');
+					NumberFormat::AppendFixed(AirspaceConverter::FrequencyMHz(w.GetOtherFrequency()), 3, line);
+				}
 			}
 		} else {
-			file << ",,"; // Skip runway length and direction
+			line.append(",,"); // Skip runway length and direction
 
 			// Other frequency
 			if (w.HasOtherFrequency()) {
-				if (w.GetType() == Waypoint::WaypointType::NDB) file << std::setprecision(1) << AirspaceConverter::FrequencykHz(w.GetOtherFrequency()); // 1 decimal for NDB freq [kHz]
-				else if (w.GetType() == Waypoint::WaypointType::VOR) file << std::setprecision(2) << AirspaceConverter::FrequencyMHz(w.GetOtherFrequency()); // 2 decimals for VOR freq [MHz]
-				else file << std::setprecision(3) << AirspaceConverter::FrequencyMHz(w.GetOtherFrequency()); // assuming all other VHF freq [MHz]
+				if (w.GetType() == Waypoint::WaypointType::NDB) NumberFormat::AppendFixed(AirspaceConverter::FrequencykHz(w.GetOtherFrequency()), 1, line); // 1 decimal for NDB freq [kHz]
+				else if (w.GetType() == Waypoint::WaypointType::VOR) NumberFormat::AppendFixed(AirspaceConverter::FrequencyMHz(w.GetOtherFrequency()), 2, line); // 2 decimals for VOR freq [MHz]
+				else NumberFormat::AppendFixed(AirspaceConverter::FrequencyMHz(w.GetOtherFrequency()), 3, line); // assuming all other VHF freq [MHz]
 			}
 		}
-		file << ',';
+		line.append(1, ',');
 
 		// Description
-		if (!w.GetDescription().empty()) file << '"' << w.GetDescription() << '"';
-		file << "\r\n";
+		if (!w.GetDescription().empty()) line.append(1, '"').append(w.GetDescription()).append(1, '"');
+		line.append("\r\n");
+		file.write(line.data(), line.size());
 	}
 
 	file.close();
@@ -12,14 +12,13 @@
 
 #pragma once
 #include <string>
-#include <map>
 
-class Waypoint;
+class WaypointSet;
 
 class SeeYou {
 
 public:
-	SeeYou(std::multimap<int,Waypoint*>& waypointsMap);
+	SeeYou(WaypointSet& waypointsSet);
 	~SeeYou() {}
 	bool Read(const std::string& fileName);
 	bool Write(const std::string& fileName);
@@ -35,5 +34,5 @@ private:
 	static bool ParseOtherFrequency(const std::string& text, const int type, int& freqHz);
 
 	static const std::string defaultHeader;
-	std::multimap<int,Waypoint*>& waypoints;
+	WaypointSet& waypoints;
 };
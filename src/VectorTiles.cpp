@@ -0,0 +1,447 @@
+//============================================================================
+// AirspaceConverter
+// Since       : 14/6/2016
+// Author      : Alberto Realis-Luc <alberto.realisluc@gmail.com>
+// Web         : https://www.alus.it/AirspaceConverter
+// Repository  : https://github.com/alus-it/AirspaceConverter.git
+// Copyright   : (C) 2016-2021 Alberto Realis-Luc
+// License     : GNU GPL v3
+//
+// This source file is part of AirspaceConverter project
+//============================================================================
+
+#include "VectorTiles.h"
+#include "AirspaceConverter.h"
+#include "Airspace.h"
+#include "Parallel.h"
+#include <fstream>
+#include <atomic>
+#include <cmath>
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <boost/format.hpp>
+
+const int VectorTiles::MAX_ZOOM = 16;
+const int VectorTiles::EXTENT = 4096;
+const int VectorTiles::BUFFER = 64;
+const double VectorTiles::SIMPLIFICATION = 2;
+const std::string VectorTiles::LAYER_NAME = "airspaces";
+const size_t VectorTiles::MAX_TILES_PER_AIRSPACE = 1 << 18;
+
+namespace {
+	// Longitude span of the points, with the east beyond 180 if they go across the antimeridian
+	std::pair<double, double> LongitudeSpan(const std::vector<Geometry::LatLon>& points) {
+		double west = 180, east = -180, unwrappedWest = 360, unwrappedEast = 0;
+		for (const Geometry::LatLon& p : points) {
+			west = std::min(west, p.Lon());
+			east = std::max(east, p.Lon());
+			const double lon = p.Lon() < 0 ? p.Lon() + 360 : p.Lon();
+			unwrappedWest = std::min(unwrappedWest, lon);
+			unwrappedEast = std::max(unwrappedEast, lon);
+		}
+		if (east - west <= 180) return std::make_pair(west, east);
+		return unwrappedWest > 180 ? std::make_pair(unwrappedWest - 360, unwrappedEast - 360) : std::make_pair(unwrappedWest, unwrappedEast);
+	}
+}
+
+VectorTiles::VectorTiles(const std::multimap<int, Airspace>& airspacesMap) :
+	airspaces(airspacesMap) {
+}
+
+bool VectorTiles::Write(const std::string& directory, const int minZoom, const int maxZoom) {
+	if (minZoom < 0 || maxZoom > MAX_ZOOM || minZoom > maxZoom) {
+		AirspaceConverter::LogError(boost::str(boost::format("invalid zoom range for vector tiles: %1d-%2d, the zoom levels must be between 0 and %3d") %minZoom %maxZoom %MAX_ZOOM));
+		return false;
+	}
+	if (airspaces.empty()) {
+		AirspaceConverter::LogMessage("Vector tiles output: no airspaces, nothing to write");
+		return false;
+	}
+	boost::system::error_code error;
+	boost::filesystem::create_directories(directory, error);
+	if (error) {
+		AirspaceConverter::LogError("Unable to create vector tiles directory: " + directory);
+		return false;
+	}
+	AirspaceConverter::LogMessage(boost::str(boost::format("Writing vector tiles from zoom %1d to %2d in: %3s") %minZoom %maxZoom %directory));
+
+	// The points are already the discretization of arcs and circles: just project them
+	toWrite.clear();
+	toWrite.reserve(airspaces.size());
+	for (const std::pair<const int, Airspace>& a : airspaces) toWrite.push_back(&a.second);
+	std::vector<std::vector<Point>> projected(toWrite.size());
+	Parallel::For(toWrite.size(), [&](const size_t begin, const size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			const std::vector<Geometry::LatLon>& points = toWrite[i]->GetPoints();
+			if (points.size() < 3) continue;
+			projected[i].reserve(points.size());
+			const bool acrossAntimeridian = LongitudeSpan(points).second > 180; // unwrapped east of it, the tiles on the west of the map get a copy
+			for (const Geometry::LatLon& p : points) projected[i].push_back(Project(p.Lat(), acrossAntimeridian && p.Lon() < 0 ? p.Lon() + 360 : p.Lon()));
+		}
+	}, 64);
+
+	// Each zoom level has its own simplification, then the tiles are clipped and encoded in parallel
+	unsigned long tilesWritten = 0;
+	std::vector<Ring> rings(toWrite.size());
+	std::vector<char> tooLarge(toWrite.size(), 0);
+	for (int zoom = minZoom; zoom <= maxZoom; zoom++) {
+		const double tolerance = SIMPLIFICATION / (EXTENT * std::ldexp(1.0, zoom));
+		Parallel::For(toWrite.size(), [&](const size_t begin, const size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				Ring& ring = rings[i];
+				Simplify(projected[i], tolerance, ring.points);
+				ring.minX = ring.minY = 2;
+				ring.maxX = ring.maxY = 0;
+				for (const Point& p : ring.points) {
+					ring.minX = std::min(ring.minX, p.x);
+					ring.maxX = std::max(ring.maxX, p.x);
+					ring.minY = std::min(ring.minY, p.y);
+					ring.maxY = std::max(ring.maxY, p.y);
+				}
+			}
+		}, 64);
+		if (!WriteZoomLevel(directory, zoom, rings, tooLarge, tilesWritten)) return false;
+	}
+	if (!WriteMetadata(directory, minZoom, maxZoom)) return false;
+	AirspaceConverter::LogMessage(boost::str(boost::format("Written %1d vector tile(s).") %tilesWritten));
+	return true;
+}
+
+bool VectorTiles::WriteZoomLevel(const std::string& directory, const int zoom, const std::vector<Ring>& rings, std::vector<char>& tooLarge, unsigned long& tilesWritten) const {
+	// Find the tiles really touched by each airspace descending the quadtree from the whole map, the columns past the antimeridian are the ones on the west of the map
+	const unsigned int numOfTiles = 1U << zoom;
+	std::map<std::pair<unsigned int, unsigned int>, std::vector<std::pair<size_t, int>>> tilesMap;
+	std::vector<std::pair<unsigned int, unsigned int>> found;
+	std::vector<Point> polygon;
+	for (size_t i = 0; i < rings.size(); i++) {
+		const Ring& ring = rings[i];
+		if (ring.points.size() < 3 || tooLarge[i]) continue;
+		found.clear();
+		bool fits = true;
+		for (unsigned int world = 0; fits && world <= (ring.maxX > 1 ? 1U : 0U); world++) {
+			polygon.clear();
+			for (const Point& p : ring.points) {
+				const Point q = { (p.x - world) * EXTENT, p.y * EXTENT };
+				polygon.push_back(q);
+			}
+			fits = FindTiles(polygon, zoom, 0, world, 0, found);
+		}
+		if (!fits) {
+			tooLarge[i] = 1;
+			AirspaceConverter::LogWarning(boost::str(boost::format("airspace %1s too large for vector tiles from zoom %2d, it would be in more than %3d tiles") %toWrite[i]->GetName() %zoom %MAX_TILES_PER_AIRSPACE));
+			continue;
+		}
+		for (const std::pair<unsigned int, unsigned int>& t : found) tilesMap[std::make_pair(t.first % numOfTiles, t.second)].push_back(std::make_pair(i, (int)(t.first / numOfTiles)));
+	}
+	std::vector<Tile> tiles;
+	tiles.reserve(tilesMap.size());
+	for (std::pair<const std::pair<unsigned int, unsigned int>, std::vector<std::pair<size_t, int>>>& t : tilesMap) {
+		Tile tile;
+		tile.x = t.first.first;
+		tile.y = t.first.second;
+		tile.airspaces.swap(t.second);
+		tiles.push_back(std::move(tile));
+	}
+	tilesMap.clear();
+
+	// Prepare the directories, one for each column
+	const boost::filesystem::path zoomPath(boost::filesystem::path(directory) / std::to_string(zoom));
+	boost::system::error_code error;
+	for (size_t i = 0; i < tiles.size() && !error; i++) if (i == 0 || tiles[i].x != tiles[i - 1].x) boost::filesystem::create_directories(zoomPath / std::to_string(tiles[i].x), error);
+	if (error) {
+		AirspaceConverter::LogError("Unable to create vector tiles directory in: " + zoomPath.string());
+		return false;
+	}
+
+	// Encode and write each tile
+	std::atomic<unsigned long> written(0);
+	std::atomic<bool> failed(false);
+	Parallel::For(tiles.size(), [&](const size_t begin, const size_t end) {
+		std::string data;
+		for (size_t i = begin; i < end && !failed; i++) {
+			if (!EncodeTile(zoom, tiles[i], rings, data)) continue; // nothing really inside this tile
+			std::ofstream file((zoomPath / std::to_string(tiles[i].x) / (std::to_string(tiles[i].y) + ".pbf")).string(), std::ios::out | std::ios::trunc | std::ios::binary);
+			if (!file.is_open() || !file.write(data.data(), data.size())) failed = true;
+			else written++;
+		}
+	}, 16);
+	if (failed) {
+		AirspaceConverter::LogError("Unable to write vector tiles in: " + zoomPath.string());
+		return false;
+	}
+	tilesWritten += written;
+	return true;
+}
+
+bool VectorTiles::EncodeTile(const int zoom, const Tile& tile, const std::vector<Ring>& rings, std::string& data) const {
+	static const char* const keys[] = { "name", "category", "class", "top", "base", "top_m", "base_m" };
+	const double scale = std::ldexp(1.0, zoom);
+	std::vector<std::string> values;
+	std::map<std::string, unsigned int> valuesIndex;
+	std::string features, feature, tags, geometry, value;
+	std::vector<Point> polygon;
+	std::vector<std::pair<int, int>> coords;
+	std::pair<int, int> cursor(0, 0);
+
+	for (size_t e = 0; e < tile.airspaces.size(); e++) {
+		// Move to the tile coordinates, clip on the tile with its buffer and round to the tile grid
+		const size_t i = tile.airspaces[e].first;
+		const int world = tile.airspaces[e].second;
+		polygon.clear();
+		for (const Point& p : rings[i].points) {
+			const Point q = { ((p.x - world) * scale - tile.x) * EXTENT, (p.y * scale - tile.y) * EXTENT };
+			polygon.push_back(q);
+		}
+		ClipToBox(polygon, -BUFFER, EXTENT + BUFFER);
+		coords.clear();
+		for (const Point& p : polygon) {
+			const std::pair<int, int> c((int)std::lround(p.x), (int)std::lround(p.y));
+			if (coords.empty() || coords.back() != c) coords.push_back(c);
+		}
+		while (coords.size() > 1 && coords.back() == coords.front()) coords.pop_back(); // the ring is closed by the ClosePath command
+
+		// The exterior ring must have a positive area in the tile coordinates (clockwise with the Y axis going down)
+		long long area = 0;
+		if (coords.size() >= 3) for (size_t j = 0, k = coords.size() - 1; j < coords.size(); k = j++) area += (long long)coords[k].first * coords[j].second - (long long)coords[j].first * coords[k].second;
+		if (area != 0) {
+			if (area < 0) std::reverse(coords.begin(), coords.end());
+
+			// Geometry commands: MoveTo, LineTo for all the other points, ClosePath, relative to the cursor left by the previous ring
+			AppendVarint((1 << 3) | 1, geometry);
+			AppendVarint(ZigZag(coords[0].first - cursor.first), geometry);
+			AppendVarint(ZigZag(coords[0].second - cursor.second), geometry);
+			AppendVarint(((coords.size() - 1) << 3) | 2, geometry);
+			for (size_t j = 1; j < coords.size(); j++) {
+				AppendVarint(ZigZag(coords[j].first - coords[j - 1].first), geometry);
+				AppendVarint(ZigZag(coords[j].second - coords[j - 1].second), geometry);
+			}
+			AppendVarint((1 << 3) | 7, geometry);
+			cursor = coords.back();
+		}
+
+		// The copies on both sides of the antimeridian are the polygons of the same feature
+		if (e + 1 < tile.airspaces.size() && tile.airspaces[e + 1].first == i) continue;
+		if (geometry.empty()) continue;
+
+		// Attributes as pairs of key and value indexes, the values are shared in the layer
+		const Airspace& airspace = *toWrite[i];
+		tags.clear();
+		for (unsigned int key = 0; key < sizeof(keys) / sizeof(keys[0]); key++) {
+			value.clear();
+			switch (key) {
+			case 0: AppendBytes(1, airspace.GetName(), value); break;
+			case 1: AppendBytes(1, airspace.GetCategoryName(), value); break;
+			case 2: if (airspace.GetClass() != Airspace::UNDEFINED) AppendBytes(1, Airspace::CategoryName(airspace.GetClass()), value); break;
+			case 3: AppendBytes(1, airspace.GetTopAltitude().ToString(), value); break;
+			case 4: AppendBytes(1, airspace.GetBaseAltitude().ToString(), value); break;
+			case 5:
+			case 6:
+				{
+					const Altitude& alt = key == 5 ? airspace.GetTopAltitude() : airspace.GetBaseAltitude();
+					if (alt.IsUnlimited()) break;
+					AppendTag(6, 0, value); // sint_value
+					AppendVarint(ZigZag((int)std::lround(alt.GetAltMt())), value);
+				}
+				break;
+			}
+			if (value.empty()) continue;
+			const std::map<std::string, unsigned int>::const_iterator it = valuesIndex.find(value);
+			unsigned int index;
+			if (it == valuesIndex.end()) {
+				index = (unsigned int)values.size();
+				valuesIndex.insert(std::make_pair(value, index));
+				values.push_back(value);
+			} else index = it->second;
+			AppendVarint(key, tags);
+			AppendVarint(index, tags);
+		}
+
+		feature.clear();
+		AppendTag(1, 0, feature); // id
+		AppendVarint(i + 1, feature);
+		AppendBytes(2, tags, feature);
+		AppendTag(3, 0, feature); // type
+		AppendVarint(3, feature); // POLYGON
+		AppendBytes(4, geometry, feature);
+		AppendBytes(2, feature, features);
+		geometry.clear();
+		cursor = std::make_pair(0, 0);
+	}
+	if (features.empty()) return false;
+
+	std::string layer;
+	AppendTag(15, 0, layer); // version
+	AppendVarint(2, layer);
+	AppendBytes(1, LAYER_NAME, layer);
+	layer += features;
+	for (const char* key : keys) AppendBytes(3, key, layer);
+	for (const std::string& v : values) AppendBytes(4, v, layer);
+	AppendTag(5, 0, layer); // extent
+	AppendVarint(EXTENT, layer);
+	data.clear();
+	AppendBytes(3, layer, data);
+	return true;
+}
+
+bool VectorTiles::WriteMetadata(const std::string& directory, const int minZoom, const int maxZoom) const {
+	// The bounds in longitude are all around but the largest gap between the airspaces, the west greater than the east if across the antimeridian
+	double minLat = 90, maxLat = -90;
+	std::vector<std::pair<double, double>> spans;
+	spans.reserve(toWrite.size());
+	for (const Airspace* a : toWrite) {
+		if (a->GetPoints().empty()) continue;
+		for (const Geometry::LatLon& p : a->GetPoints()) {
+			minLat = std::min(minLat, p.Lat());
+			maxLat = std::max(maxLat, p.Lat());
+		}
+		spans.push_back(LongitudeSpan(a->GetPoints()));
+	}
+	std::sort(spans.begin(), spans.end());
+	double minLon = spans.empty() ? -180 : spans.front().first, maxLon = minLon, east = minLon, gap = 0;
+	for (const std::pair<double, double>& span : spans) {
+		if (span.first - east > gap) {
+			gap = span.first - east;
+			minLon = span.first;
+			maxLon = east;
+		}
+		east = std::max(east, span.second);
+	}
+	if (spans.empty() || spans.front().first + 360 - east >= gap) { // the largest gap is the one around the back of the world
+		minLon = spans.empty() ? -180 : spans.front().first;
+		maxLon = spans.empty() ? 180 : std::min(east, minLon + 360);
+	}
+	if (maxLon > 180) maxLon -= 360;
+	const std::string filename((boost::filesystem::path(directory) / "metadata.json").string());
+	std::ofstream file(filename, std::ios::out | std::ios::trunc | std::ios::binary);
+	if (!file.is_open() || file.bad()) {
+		AirspaceConverter::LogError("Unable to open output file: " + filename);
+		return false;
+	}
+	file << boost::format("{\"name\":\"Airspaces\",\"format\":\"pbf\",\"scheme\":\"xyz\",\"minzoom\":%1$d,\"maxzoom\":%2$d,\"bounds\":[%3$.6f,%4$.6f,%5$.6f,%6$.6f],")
+		%minZoom %maxZoom %minLon %minLat %maxLon %maxLat;
+	file << boost::format("\"vector_layers\":[{\"id\":\"%1$s\",\"minzoom\":%2$d,\"maxzoom\":%3$d,\"fields\":{\"name\":\"String\",\"category\":\"String\",\"class\":\"String\",\"top\":\"String\",\"base\":\"String\",\"top_m\":\"Number\",\"base_m\":\"Number\"}}]}\n")
+		%LAYER_NAME %minZoom %maxZoom;
+	return !file.fail();
+}
+
+VectorTiles::Point VectorTiles::Project(const double lat, const double lon) {
+	static const double MAX_LAT = 85.0511287798066; // limit of the Web Mercator square
+	const double sinLat = std::sin(std::max(-MAX_LAT, std::min(MAX_LAT, lat)) * Geometry::DEG2RAD);
+	const Point p = { (lon + 180) / 360, 0.5 - std::log((1 + sinLat) / (1 - sinLat)) / (4 * Geometry::PI) };
+	return p;
+}
+
+void VectorTiles::Simplify(const std::vector<Point>& points, const double tolerance, std::vector<Point>& simplified) {
+	// Douglas-Peucker, without recursion
+	simplified.clear();
+	if (points.size() < 3) return;
+	std::vector<bool> keep(points.size(), false);
+	keep.front() = keep.back() = true;
+	const double tolerance2 = tolerance * tolerance;
+	std::vector<std::pair<size_t, size_t>> stack(1, std::make_pair((size_t)0, points.size() - 1));
+	while (!stack.empty()) {
+		const size_t first = stack.back().first, last = stack.back().second;
+		stack.pop_back();
+		const Point& a = points[first];
+		const double dx = points[last].x - a.x, dy = points[last].y - a.y, length2 = dx * dx + dy * dy;
+		double maxDist2 = 0;
+		size_t farthest = first;
+		for (size_t i = first + 1; i < last; i++) {
+			// Squared distance from the segment, or from the first point if the segment is degenerated as for a closed ring
+			double px = points[i].x - a.x, py = points[i].y - a.y;
+			if (length2 > 0) {
+				const double t = std::max(0.0, std::min(1.0, (px * dx + py * dy) / length2));
+				px -= t * dx;
+				py -= t * dy;
+			}
+			const double dist2 = px * px + py * py;
+			if (dist2 > maxDist2) {
+				maxDist2 = dist2;
+				farthest = i;
+			}
+		}
+		if (maxDist2 > tolerance2) {
+			keep[farthest] = true;
+			stack.push_back(std::make_pair(first, farthest));
+			stack.push_back(std::make_pair(farthest, last));
+		}
+	}
+	for (size_t i = 0; i < points.size(); i++) if (keep[i]) simplified.push_back(points[i]);
+	if (simplified.size() < 3) simplified.clear(); // too small at this zoom
+}
+
+bool VectorTiles::FindTiles(std::vector<Point>& polygon, const int zoom, const int depth, const unsigned int x, const unsigned int y, std::vector<std::pair<unsigned int, unsigned int>>& found) {
+	// The polygon is in the coordinates of the tile x, y at this depth: keep only its part inside the tile, with the buffer of the tiles of the zoom
+	const double buffer = std::ldexp((double)BUFFER, depth - zoom);
+	ClipToBox(polygon, -buffer, EXTENT + buffer);
+	double area = 0;
+	if (polygon.size() >= 3) for (size_t j = 0, k = polygon.size() - 1; j < polygon.size(); k = j++) area += polygon[k].x * polygon[j].y - polygon[j].x * polygon[k].y;
+	area = std::fabs(area) / 2;
+	if (area == 0) return true; // not touched
+
+	// At the zoom the tile is found, the same for all the tiles inside this one if it is completely covered
+	const double side = EXTENT + 2 * buffer;
+	if (depth == zoom || area >= side * side * (1 - 1e-9)) {
+		const unsigned int tilesPerSide = 1U << (zoom - depth);
+		if (found.size() + (size_t)tilesPerSide * tilesPerSide > MAX_TILES_PER_AIRSPACE) return false;
+		for (unsigned int i = 0; i < tilesPerSide; i++) for (unsigned int j = 0; j < tilesPerSide; j++) found.push_back(std::make_pair(x * tilesPerSide + i, y * tilesPerSide + j));
+		return true;
+	}
+
+	// Otherwise each quadrant with its own part of the polygon
+	std::vector<Point> quadrant;
+	for (unsigned int q = 0; q < 4; q++) {
+		const unsigned int qx = q & 1, qy = q >> 1;
+		quadrant.clear();
+		quadrant.reserve(polygon.size());
+		for (const Point& p : polygon) {
+			const Point c = { p.x * 2 - qx * EXTENT, p.y * 2 - qy * EXTENT };
+			quadrant.push_back(c);
+		}
+		if (!FindTiles(quadrant, zoom, depth + 1, x * 2 + qx, y * 2 + qy, found)) return false;
+	}
+	return true;
+}
+
+void VectorTiles::ClipToBox(std::vector<Point>& polygon, const double min, const double max) {
+	// Sutherland-Hodgman on the four sides of the square box
+	std::vector<Point> input;
+	for (int side = 0; side < 4 && !polygon.empty(); side++) {
+		input.swap(polygon);
+		polygon.clear();
+		const bool onX = side < 2;
+		const double limit = side % 2 == 0 ? min : max;
+		const double sign = side % 2 == 0 ? 1 : -1;
+		Point previous = input.back();
+		bool previousInside = sign * ((onX ? previous.x : previous.y) - limit) >= 0;
+		for (const Point& current : input) {
+			const bool currentInside = sign * ((onX ? current.x : current.y) - limit) >= 0;
+			if (currentInside != previousInside) {
+				const double t = ((onX ? previous.x : previous.y) - limit) / ((onX ? previous.x - current.x : previous.y - current.y));
+				const Point cut = { previous.x + t * (current.x - previous.x), previous.y + t * (current.y - previous.y) };
+				polygon.push_back(cut);
+			}
+			if (currentInside) polygon.push_back(current);
+			previous = current;
+			previousInside = currentInside;
+		}
+	}
+}
+
+void VectorTiles::AppendVarint(unsigned long long value, std::string& data) {
+	while (value >= 0x80) {
+		data += (char)((value & 0x7F) | 0x80);
+		value >>= 7;
+	}
+	data += (char)value;
+}
+
+void VectorTiles::AppendTag(const int field, const int wireType, std::string& data) {
+	AppendVarint(((unsigned long long)field << 3) | wireType, data);
+}
+
+void VectorTiles::AppendBytes(const int field, const std::string& bytes, std::string& data) {
+	AppendTag(field, 2, data);
+	AppendVarint(bytes.size(), data);
+	data += bytes;
+}
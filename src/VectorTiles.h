@@ -0,0 +1,66 @@
+//============================================================================
+// AirspaceConverter
+// Since       : 14/6/2016
+// Author      : Alberto Realis-Luc <alberto.realisluc@gmail.com>
+// Web         : https://www.alus.it/AirspaceConverter
+// Repository  : https://github.com/alus-it/AirspaceConverter.git
+// Copyright   : (C) 2016-2021 Alberto Realis-Luc
+// License     : GNU GPL v3
+//
+// This source file is part of AirspaceConverter project
+//============================================================================
+
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+
+class Airspace;
+
+// Mapbox Vector Tiles (MVT 2.1) pyramid of the airspaces, written as directory tree: <directory>/<z>/<x>/<y>.pbf
+class VectorTiles {
+public:
+	VectorTiles(const std::multimap<int, Airspace>& airspacesMap);
+	~VectorTiles() {}
+	bool Write(const std::string& directory, const int minZoom, const int maxZoom);
+
+	static const int MAX_ZOOM;
+
+private:
+	struct Point {
+		double x, y; // Web Mercator, normalized in [0, 1], y from north, x up to 1.5 for the airspaces across the antimeridian
+	};
+
+	struct Ring {
+		std::vector<Point> points;
+		double minX, minY, maxX, maxY;
+	};
+
+	struct Tile {
+		unsigned int x, y;
+		std::vector<std::pair<size_t, int>> airspaces; // index of the airspaces touching this tile, with the world where they are: 1 east of the antimeridian
+	};
+
+	bool WriteZoomLevel(const std::string& directory, const int zoom, const std::vector<Ring>& rings, std::vector<char>& tooLarge, unsigned long& tilesWritten) const;
+	static bool FindTiles(std::vector<Point>& polygon, const int zoom, const int depth, const unsigned int x, const unsigned int y, std::vector<std::pair<unsigned int, unsigned int>>& found);
+	bool EncodeTile(const int zoom, const Tile& tile, const std::vector<Ring>& rings, std::string& data) const;
+	bool WriteMetadata(const std::string& directory, const int minZoom, const int maxZoom) const;
+	static Point Project(const double lat, const double lon);
+	static void Simplify(const std::vector<Point>& points, const double tolerance, std::vector<Point>& simplified);
+	static void ClipToBox(std::vector<Point>& polygon, const double min, const double max);
+
+	// Protocol buffers encoding
+	static void AppendVarint(unsigned long long value, std::string& data);
+	static void AppendTag(const int field, const int wireType, std::string& data);
+	static void AppendBytes(const int field, const std::string& bytes, std::string& data);
+	static inline unsigned int ZigZag(const int value) { return ((unsigned int)value << 1) ^ (unsigned int)(value >> 31); }
+
+	static const int EXTENT; // tile units
+	static const int BUFFER; // tile units around the tile where the geometries are still kept
+	static const double SIMPLIFICATION; // tile units
+	static const std::string LAYER_NAME;
+	static const size_t MAX_TILES_PER_AIRSPACE; // at each zoom level, the larger airspaces are left out from that zoom on
+
+	const std::multimap<int, Airspace>& airspaces;
+	std::vector<const Airspace*> toWrite;
+};
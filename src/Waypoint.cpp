@@ -11,6 +11,10 @@
 //============================================================================
 
 #include "Waypoint.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <cmath>
 #include <cassert>
 
 const std::string Waypoint::TYPE_NAMES[] = {
@@ -41,7 +45,135 @@ Waypoint::Waypoint(const std::string& longName, const std::string& shortName, co
 	, country(countryCode)
 	, altitude(alt)
 	, type((WaypointType)style)
+	, elevationStatus(elevationRead)
+	, elevationUnverifiable(false)
 	, otherFreq(0)
+	, runwayDir(-1)
+	, runwayLength(-1)
+	, radioFreq(-1)
 	, description(descr) {
 	assert(pos.IsValid());
 }
+
+Waypoint::Waypoint(const std::string& longName, const std::string& shortName, const std::string& countryCode, const double lat, const double lon, const float alt, const int style, const int rwyDir, const int rwyLen, const int freq, const std::string& descr)
+	: pos(lat,lon)
+	, name(longName)
+	, code(shortName)
+	, country(countryCode)
+	, altitude(alt)
+	, type((WaypointType)style)
+	, elevationStatus(elevationRead)
+	, elevationUnverifiable(false)
+	, otherFreq(0)
+	, runwayDir(rwyDir)
+	, runwayLength(rwyLen)
+	, radioFreq(freq)
+	, description(descr) {
+	assert(pos.IsValid());
+	assert(IsAirfield());
+}
+
+void WaypointSet::Clear() {
+	for (std::vector<Waypoint>& bucket : buckets) std::vector<Waypoint>().swap(bucket); // release also the memory
+	count = 0;
+}
+
+WaypointSet::Mark WaypointSet::GetMark() const {
+	Mark mark;
+	for (int t = 0; t < Waypoint::numOfWaypointTypes; t++) mark.sizes[t] = buckets[t].size();
+	return mark;
+}
+
+void Waypoint::Merge(const Waypoint& other) {
+	assert(this != &other);
+	if (code.IsEmpty()) code = other.code;
+	if (country.IsEmpty()) country = other.country;
+	if (description.IsEmpty()) description = other.description;
+	if ((elevationStatus == elevationBlank || elevationStatus == elevationInvalid) && (other.elevationStatus == elevationRead || other.elevationStatus == elevationVerified)) {
+		altitude = other.altitude;
+		elevationStatus = other.elevationStatus;
+		elevationUnverifiable = other.elevationUnverifiable;
+	}
+	if (!HasOtherFrequency() && other.HasOtherFrequency()) otherFreq = other.otherFreq;
+	if (IsAirfield() && other.IsAirfield()) {
+		if (!HasRunwayDir() && other.HasRunwayDir()) runwayDir = other.runwayDir;
+		if (!HasRunwayLength() && other.HasRunwayLength()) runwayLength = other.runwayLength;
+		if (!HasRadioFrequency() && other.HasRadioFrequency()) radioFreq = other.radioFreq;
+	}
+}
+
+namespace {
+
+// Keep only letters in upper case, digits and non ASCII bytes, so that for example "St. Gallen" and "ST GALLEN" match
+std::string NormalizeKey(const std::string& text) {
+	std::string key;
+	key.reserve(text.size());
+	for (const char c : text) {
+		if (c >= 'a' && c <= 'z') key.push_back(c - 'a' + 'A');
+		else if ((c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || (c & 0x80)) key.push_back(c);
+	}
+	return key;
+}
+
+} // namespace
+
+size_t WaypointSet::MergeDuplicates(const double toleranceMt, const std::vector<Mark>& sources) {
+	if (count < 2 || toleranceMt <= 0 || sources.size() < 2) return 0;
+
+	// Spatial hashing on the unit vectors of the positions: cells as big as the tolerance, so duplicates can be only in the 27 cells around
+	const double cellSize = 2 * std::sin(std::min(toleranceMt * Geometry::M2RAD, Geometry::PI) / 2); // chord of the tolerance
+	const double maxDist2 = cellSize * cellSize;
+	struct Entry {
+		Waypoint* waypoint;
+		size_t source;
+		double coord[3];
+		std::string code, name;
+	};
+	std::vector<Entry> entries;
+	entries.reserve(count);
+	for (size_t s = 0; s < sources.size(); s++) { // in the order of the sources, so the first one found is the one of the first source
+		for (int t = 0; t < Waypoint::numOfWaypointTypes; t++) {
+			const size_t end = std::min(s + 1 < sources.size() ? sources[s + 1].sizes[t] : buckets[t].size(), buckets[t].size());
+			for (size_t i = std::min(sources[s].sizes[t], end); i < end; i++) {
+				Waypoint& w = buckets[t][i];
+				const double latRad = w.GetLatitude() * Geometry::DEG2RAD, lonRad = w.GetLongitude() * Geometry::DEG2RAD;
+				const Entry entry = { &w, s, { std::cos(latRad) * std::cos(lonRad), std::cos(latRad) * std::sin(lonRad), std::sin(latRad) }, NormalizeKey(w.GetCode()), NormalizeKey(w.GetName()) };
+				entries.push_back(entry);
+			}
+		}
+	}
+	const auto cellKey = [](const long long x, const long long y, const long long z) { // cells out of the 21 bits range just share the key
+		return (((unsigned long long)x & 0x1FFFFF) << 42) | (((unsigned long long)y & 0x1FFFFF) << 21) | ((unsigned long long)z & 0x1FFFFF);
+	};
+	std::unordered_map<unsigned long long, std::vector<size_t>> grid; // cell key to the indexes of the entries kept
+	grid.reserve(count);
+	std::unordered_set<const Waypoint*> duplicates;
+	for (size_t i = 0; i < entries.size(); i++) {
+		const Entry& entry = entries[i];
+		long long cell[3];
+		for (int a = 0; a < 3; a++) cell[a] = (long long)std::floor(entry.coord[a] / cellSize);
+		Entry* original = nullptr;
+		for (long long dx = -1; dx <= 1 && original == nullptr; dx++) for (long long dy = -1; dy <= 1 && original == nullptr; dy++) for (long long dz = -1; dz <= 1 && original == nullptr; dz++) {
+			const auto found = grid.find(cellKey(cell[0] + dx, cell[1] + dy, cell[2] + dz));
+			if (found == grid.end()) continue;
+			for (const size_t j : found->second) {
+				Entry& other = entries[j];
+				if (other.source == entry.source) continue; // the same file may have more waypoints with the same name nearby
+				const Waypoint& w1 = *entry.waypoint;
+				const Waypoint& w2 = *other.waypoint;
+				if (w1.GetType() != w2.GetType() && !(w1.IsAirfield() && w2.IsAirfield())) continue; // an airfield and a VOR may have the same name
+				if ((entry.code.empty() || entry.code != other.code) && (entry.name.empty() || entry.name != other.name)) continue;
+				const double d0 = entry.coord[0] - other.coord[0], d1 = entry.coord[1] - other.coord[1], d2 = entry.coord[2] - other.coord[2];
+				if (d0 * d0 + d1 * d1 + d2 * d2 > maxDist2) continue;
+				original = &other;
+				break;
+			}
+		}
+		if (original != nullptr) {
+			original->waypoint->Merge(*entry.waypoint);
+			duplicates.insert(entry.waypoint);
+		} else grid[cellKey(cell[0], cell[1], cell[2])].push_back(i);
+	}
+	if (duplicates.empty()) return 0;
+	return RemoveIf([&duplicates](const Waypoint& w) { return duplicates.count(&w) > 0; }); // remove_if tests each waypoint where it is, before moving it
+}
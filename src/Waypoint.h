@@ -12,7 +12,12 @@
 
 #pragma once
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <cstddef>
 #include "Geometry.h"
+#include "InternedString.h"
 
 class Waypoint {
 
@@ -39,38 +44,134 @@ public:
 		numOfWaypointTypes
 	};
 
-	Waypoint(const std::string& longName, const std::string& shortName, const std::string& countryCode, const double lat, const double lon, const float alt, const int style, const std::string& descr);
+	// How the elevation was found in the input, to decide if and how to correct it with the terrain maps
+	enum ElevationStatus {
+		elevationRead = 0,
+		elevationBlank,
+		elevationInvalid,
+		elevationVerified // already checked against terrain
+	};
 
-	virtual ~Waypoint() {}
+	Waypoint(const std::string& longName, const std::string& shortName, const std::string& countryCode, const double lat, const double lon, const float alt, const int style, const std::string& descr);
+	Waypoint(const std::string& longName, const std::string& shortName, const std::string& countryCode, const double lat, const double lon, const float alt, const int style, const int rwyDir, const int rwyLen, const int freq, const std::string& descr);
 
 	inline static bool IsTypeAirfield(const Waypoint::WaypointType& kind) { return kind >= airfieldGrass && kind <= airfieldSolid; }
 
-	inline const std::string& GetName() const { return name; }
-	inline const std::string& GetCode() const { return code; }
-	inline const std::string& GetCountry() const { return country; }
+	inline const std::string& GetName() const { return name.Get(); }
+	inline const std::string& GetCode() const { return code.Get(); }
+	inline const std::string& GetCountry() const { return country.Get(); }
 	inline const Geometry::LatLon& GetPosition() const { return pos; }
 	inline double GetLatitude() const { return pos.Lat(); }
 	inline double GetLongitude() const { return pos.Lon(); }
 	inline float GetAltitude() const { return altitude; }
+	inline void SetAltitude(const float alt) { altitude = alt; }
+	inline ElevationStatus GetElevationStatus() const { return elevationStatus; }
+	inline void SetElevationStatus(const ElevationStatus status) { elevationStatus = status; }
+	inline bool IsElevationUnverifiable() const { return elevationUnverifiable; }
+	inline void SetElevationUnverifiable(const bool unverifiable = true) { elevationUnverifiable = unverifiable; }
 	inline WaypointType GetType() const { return type; }
 	inline const std::string& GetTypeName() const { return TypeName(type); }
-	inline const std::string& GetDescription() const { return description; }
+	inline const std::string& GetDescription() const { return description.Get(); }
 	inline bool IsAirfield() const { return IsTypeAirfield(type); }
 	inline void SetOtherFrequency(const int freq) { otherFreq = freq; }
 	inline bool HasOtherFrequency() const { return otherFreq > 0; }
 	inline int GetOtherFrequency() const { return otherFreq; }
 
+	// Airfield only attributes
+	inline int GetRunwayDir() const { return runwayDir; }
+	inline int GetRunwayLength() const { return runwayLength; }
+	inline int GetRadioFrequency() const { return radioFreq; }
+	inline bool HasRunwayDir() const { return runwayDir > 0; }
+	inline bool HasRunwayLength() const { return runwayLength > 0; }
+	inline bool HasRadioFrequency() const { return radioFreq > 0; }
+
 	inline static const std::string& TypeName(const WaypointType& type) { return TYPE_NAMES[type]; }
 
+	// Complete the missing attributes of this waypoint with the ones of a duplicate of it
+	void Merge(const Waypoint& other);
+
 private:
 	Geometry::LatLon pos;
-	std::string name;
-	std::string code;
-	std::string country;
+	InternedString name;
+	InternedString code;
+	InternedString country;
 	float altitude; // [m]
 	WaypointType type;
+	ElevationStatus elevationStatus;
+	bool elevationUnverifiable; // not found in the terrain maps loaded when it was checked
 	int otherFreq; // [Hz] frequency for VOR NDB or secondary radio frequency for airports
-	std::string description;
+	int runwayDir; // [deg]
+	int runwayLength; // [m]
+	int radioFreq; // [Hz]
+	InternedString description;
 	static const std::string TYPE_NAMES[];
 };
 
+// Waypoints stored by value in one contiguous bucket per waypoint type, iterated in type order as the old multimap keyed on the type
+class WaypointSet {
+
+public:
+	class const_iterator {
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef const Waypoint value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const Waypoint* pointer;
+		typedef const Waypoint& reference;
+
+		const_iterator(const WaypointSet& set, const int bucketIndex, const size_t index) : buckets(set.buckets), bucket(bucketIndex), pos(index) { SkipEmpty(); }
+		inline const Waypoint& operator*() const { return buckets[bucket][pos]; }
+		inline const Waypoint* operator->() const { return &buckets[bucket][pos]; }
+		inline const_iterator& operator++() { ++pos; SkipEmpty(); return *this; }
+		inline const_iterator operator++(int) { const_iterator old(*this); ++(*this); return old; }
+		inline bool operator==(const const_iterator& other) const { return bucket == other.bucket && pos == other.pos; }
+		inline bool operator!=(const const_iterator& other) const { return !(*this == other); }
+
+	private:
+		inline void SkipEmpty() { while (bucket < Waypoint::numOfWaypointTypes && pos >= buckets[bucket].size()) { ++bucket; pos = 0; } }
+		const std::vector<Waypoint>* buckets;
+		int bucket;
+		size_t pos;
+	};
+
+	// Size of each bucket: the position where the waypoints added afterwards start
+	struct Mark {
+		Mark() { std::fill(sizes, sizes + Waypoint::numOfWaypointTypes, 0); }
+		size_t sizes[Waypoint::numOfWaypointTypes];
+	};
+
+	WaypointSet() : count(0) {}
+
+	inline void Add(Waypoint&& waypoint) { buckets[waypoint.GetType()].push_back(std::move(waypoint)); ++count; }
+	inline size_t Size() const { return count; }
+	inline bool IsEmpty() const { return count == 0; }
+	inline size_t Count(const Waypoint::WaypointType type) const { return buckets[type].size(); }
+	inline const std::vector<Waypoint>& GetBucket(const Waypoint::WaypointType type) const { return buckets[type]; }
+	inline std::vector<Waypoint>& GetBucket(const Waypoint::WaypointType type) { return buckets[type]; }
+	void Clear();
+	Mark GetMark() const;
+
+	// Compact all buckets in place removing the waypoints matching the predicate, returns how many were removed
+	template <typename Predicate> size_t RemoveIf(Predicate pred) {
+		size_t removed = 0;
+		for (std::vector<Waypoint>& bucket : buckets) {
+			const std::vector<Waypoint>::iterator newEnd = std::remove_if(bucket.begin(), bucket.end(), pred);
+			removed += std::distance(newEnd, bucket.end());
+			bucket.erase(newEnd, bucket.end());
+		}
+		count -= removed;
+		return removed;
+	}
+
+	// Detect the same waypoint coming from different sources: position within tolerance [m] and same normalized code or name
+	// The sources are the marks where each one starts, in the order they were loaded: the waypoints of the same source are never merged
+	// Duplicates are merged in the one of the first source, returns how many were removed
+	size_t MergeDuplicates(const double toleranceMt, const std::vector<Mark>& sources);
+
+	inline const_iterator begin() const { return const_iterator(*this, 0, 0); }
+	inline const_iterator end() const { return const_iterator(*this, Waypoint::numOfWaypointTypes, 0); }
+
+private:
+	std::vector<Waypoint> buckets[Waypoint::numOfWaypointTypes];
+	size_t count;
+};
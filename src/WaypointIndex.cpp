@@ -0,0 +1,147 @@
+//============================================================================
+// AirspaceConverter
+// Since       : 14/6/2016
+// Author      : Alberto Realis-Luc <alberto.realisluc@gmail.com>
+// Web         : https://www.alus.it/AirspaceConverter
+// Repository  : https://github.com/alus-it/AirspaceConverter.git
+// Copyright   : (C) 2016-2021 Alberto Realis-Luc
+// License     : GNU GPL v3
+//
+// This source file is part of AirspaceConverter project
+//============================================================================
+
+#include "WaypointIndex.h"
+#include "Waypoint.h"
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+
+void WaypointIndex::Build(const WaypointSet& waypoints) {
+	nodes.clear();
+	nodes.reserve(waypoints.Size());
+	for (const Waypoint& w : waypoints) {
+		Node node;
+		ToUnitVector(w.GetLatitude(), w.GetLongitude(), node.coord);
+		node.waypoint = &w;
+		node.axis = 0;
+		nodes.push_back(node);
+	}
+	BuildSubtree(0, nodes.size());
+}
+
+void WaypointIndex::Clear() {
+	std::vector<Node>().swap(nodes);
+}
+
+void WaypointIndex::BuildSubtree(const size_t begin, const size_t end) {
+	if (end - begin <= 1) return;
+
+	// Split on the axis with the widest spread
+	double min[3] = { 2, 2, 2 }, max[3] = { -2, -2, -2 };
+	for (size_t i = begin; i < end; i++) {
+		for (int a = 0; a < 3; a++) {
+			min[a] = std::min(min[a], nodes[i].coord[a]);
+			max[a] = std::max(max[a], nodes[i].coord[a]);
+		}
+	}
+	int axis = 0;
+	for (int a = 1; a < 3; a++) if (max[a] - min[a] > max[axis] - min[axis]) axis = a;
+
+	const size_t mid = begin + (end - begin) / 2;
+	std::nth_element(nodes.begin() + begin, nodes.begin() + mid, nodes.begin() + end, [axis](const Node& a, const Node& b) { return a.coord[axis] < b.coord[axis]; });
+	nodes[mid].axis = axis;
+	BuildSubtree(begin, mid);
+	BuildSubtree(mid + 1, end);
+}
+
+void WaypointIndex::FindNearest(const double lat, const double lon, const size_t k, std::vector<Result>& results, const Filter& filter) const {
+	results.clear();
+	if (k == 0 || nodes.empty()) return;
+	double target[3];
+	ToUnitVector(lat, lon, target);
+	std::vector<Candidate> heap; // max heap on the distance: the worst of the best k found so far is on top
+	heap.reserve(k + 1);
+	SearchNearest(0, nodes.size(), target, k, heap, filter);
+	MakeResults(lat, lon, heap, results);
+}
+
+void WaypointIndex::FindWithinRadius(const double lat, const double lon, const double radius, std::vector<Result>& results, const Filter& filter) const {
+	results.clear();
+	if (radius < 0 || nodes.empty()) return;
+	double target[3];
+	ToUnitVector(lat, lon, target);
+
+	// Search on the chord corresponding to the radius, a bit larger to not miss points on the edge due to rounding
+	const double angle = radius * Geometry::M2RAD;
+	const double chord = angle >= Geometry::PI ? 2 : 2 * std::sin(angle / 2);
+	std::vector<Candidate> found;
+	SearchRadius(0, nodes.size(), target, chord * chord * (1 + 1e-9) + 1e-18, found, filter);
+	MakeResults(lat, lon, found, results);
+
+	// Then keep only what it is really within the radius
+	while (!results.empty() && results.back().distance > radius) results.pop_back();
+}
+
+void WaypointIndex::SearchNearest(const size_t begin, const size_t end, const double* target, const size_t k, std::vector<Candidate>& heap, const Filter& filter) const {
+	if (begin >= end) return;
+	const size_t mid = begin + (end - begin) / 2;
+	const Node& node = nodes[mid];
+	if (!filter || filter(*node.waypoint)) {
+		const double dist2 = SquaredChord(target, node.coord);
+		if (heap.size() < k) {
+			heap.push_back(Candidate(dist2, mid));
+			std::push_heap(heap.begin(), heap.end());
+		} else if (dist2 < heap.front().first) {
+			std::pop_heap(heap.begin(), heap.end());
+			heap.back() = Candidate(dist2, mid);
+			std::push_heap(heap.begin(), heap.end());
+		}
+	}
+	if (end - begin == 1) return;
+
+	// Descend first on the side of the target, then on the other only if it can still contain something closer
+	const double diff = target[node.axis] - node.coord[node.axis];
+	if (diff < 0) SearchNearest(begin, mid, target, k, heap, filter);
+	else SearchNearest(mid + 1, end, target, k, heap, filter);
+	if (heap.size() < k || diff * diff < heap.front().first) {
+		if (diff < 0) SearchNearest(mid + 1, end, target, k, heap, filter);
+		else SearchNearest(begin, mid, target, k, heap, filter);
+	}
+}
+
+void WaypointIndex::SearchRadius(const size_t begin, const size_t end, const double* target, const double maxChord2, std::vector<Candidate>& found, const Filter& filter) const {
+	if (begin >= end) return;
+	const size_t mid = begin + (end - begin) / 2;
+	const Node& node = nodes[mid];
+	const double dist2 = SquaredChord(target, node.coord);
+	if (dist2 <= maxChord2 && (!filter || filter(*node.waypoint))) found.push_back(Candidate(dist2, mid));
+	if (end - begin == 1) return;
+	const double diff = target[node.axis] - node.coord[node.axis];
+	if (diff < 0 || diff * diff <= maxChord2) SearchRadius(begin, mid, target, maxChord2, found, filter);
+	if (diff >= 0 || diff * diff <= maxChord2) SearchRadius(mid + 1, end, target, maxChord2, found, filter);
+}
+
+void WaypointIndex::MakeResults(const double lat, const double lon, std::vector<Candidate>& candidates, std::vector<Result>& results) const {
+	std::sort(candidates.begin(), candidates.end());
+	results.reserve(candidates.size());
+	const double latRad = lat * Geometry::DEG2RAD, lonRad = lon * Geometry::DEG2RAD;
+	for (const Candidate& candidate : candidates) {
+		const Waypoint* w = nodes[candidate.second].waypoint;
+		const Result result = { w, Geometry::CalcAngularDist(latRad, lonRad, w->GetLatitude() * Geometry::DEG2RAD, w->GetLongitude() * Geometry::DEG2RAD) / Geometry::M2RAD };
+		results.push_back(result);
+	}
+}
+
+void WaypointIndex::ToUnitVector(const double lat, const double lon, double* coord) {
+	assert(Geometry::LatLon::IsValidLat(lat) && Geometry::LatLon::IsValidLon(lon));
+	const double latRad = lat * Geometry::DEG2RAD, lonRad = lon * Geometry::DEG2RAD;
+	const double cosLat = std::cos(latRad);
+	coord[0] = cosLat * std::cos(lonRad);
+	coord[1] = cosLat * std::sin(lonRad);
+	coord[2] = std::sin(latRad);
+}
+
+double WaypointIndex::SquaredChord(const double* a, const double* b) {
+	const double dx = a[0] - b[0], dy = a[1] - b[1], dz = a[2] - b[2];
+	return dx * dx + dy * dy + dz * dz;
+}
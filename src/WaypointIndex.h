@@ -0,0 +1,63 @@
+//============================================================================
+// AirspaceConverter
+// Since       : 14/6/2016
+// Author      : Alberto Realis-Luc <alberto.realisluc@gmail.com>
+// Web         : https://www.alus.it/AirspaceConverter
+// Repository  : https://github.com/alus-it/AirspaceConverter.git
+// Copyright   : (C) 2016-2021 Alberto Realis-Luc
+// License     : GNU GPL v3
+//
+// This source file is part of AirspaceConverter project
+//============================================================================
+
+#pragma once
+#include <vector>
+#include <functional>
+#include <cstddef>
+
+class Waypoint;
+class WaypointSet;
+
+// Static k-d tree over the waypoint positions, as unit vectors on the sphere so it works also across the poles and the anti-meridian
+class WaypointIndex {
+
+public:
+	struct Result {
+		const Waypoint* waypoint;
+		double distance; // [m] great circle distance from the query point
+	};
+
+	typedef std::function<bool(const Waypoint&)> Filter;
+
+	WaypointIndex() {}
+
+	// The index keeps pointers to the waypoints so it must be built again after any change to the set
+	void Build(const WaypointSet& waypoints);
+	void Clear();
+	inline size_t Size() const { return nodes.size(); }
+	inline bool IsEmpty() const { return nodes.empty(); }
+
+	// Find the k waypoints nearest to the given point, optionally only the ones accepted by the filter, sorted by distance
+	void FindNearest(const double lat, const double lon, const size_t k, std::vector<Result>& results, const Filter& filter = nullptr) const;
+
+	// Find all the waypoints within the given radius [m] from the given point, optionally only the ones accepted by the filter, sorted by distance
+	void FindWithinRadius(const double lat, const double lon, const double radius, std::vector<Result>& results, const Filter& filter = nullptr) const;
+
+private:
+	struct Node {
+		double coord[3]; // unit vector of the position
+		const Waypoint* waypoint;
+		int axis; // splitting axis of the subtree rooted here
+	};
+
+	typedef std::pair<double, size_t> Candidate; // squared chord distance and node index
+
+	void BuildSubtree(const size_t begin, const size_t end);
+	void SearchNearest(const size_t begin, const size_t end, const double* target, const size_t k, std::vector<Candidate>& heap, const Filter& filter) const;
+	void SearchRadius(const size_t begin, const size_t end, const double* target, const double maxChord2, std::vector<Candidate>& found, const Filter& filter) const;
+	void MakeResults(const double lat, const double lon, std::vector<Candidate>& candidates, std::vector<Result>& results) const;
+	static void ToUnitVector(const double lat, const double lon, double* coord);
+	static double SquaredChord(const double* a, const double* b);
+
+	std::vector<Node> nodes; // balanced tree stored in place: the median of each range is the root of its subtree
+};
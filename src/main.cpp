@@ -14,25 +14,43 @@
 #include <iostream>
 #include <cstring>
 #include <chrono>
+#include <stdexcept>
 #include <boost/tokenizer.hpp>
+#ifndef _WIN32
+#include <csignal>
+#endif
 
 void printHelp() {
 	std::cout << "Example usage: airspaceconverter -q 1013 -a 35 -i inputFileOpenAir.txt -i openAIP_asp.aip -w waypoints.cup -w openAIP_wpt.aip -m terrainMap.dem -o outputFile.kmz" << std::endl << std::endl;
 	std::cout << "Possible options:" << std::endl;
 	std::cout << "-q: optional, specify the QNH in hPa used to calculate height of flight levels" << std::endl;
 	std::cout << "-a: optional, specify a default terrain altitude in meters to calculate AGL heights of points not covered by loaded terrain map(s)" << std::endl;
-	std::cout << "-i: multiple, input airspace file(s) can be OpenAir (.txt), openAIP (.aip), Google Earth (.kmz, .kml)" << std::endl;
+	std::cout << "-i: multiple, input airspace file(s) can be OpenAir (.txt), openAIP (.aip), Google Earth (.kmz, .kml) or ACB binary (.acb), or a directory containing them" << std::endl;
 	std::cout << "-w: multiple, input waypoint file(s) can be SeeYou (.cup), LittleNavMap (.csv) or openAIP (.aip)" << std::endl;
 	std::cout << "-m: optional, multiple, terrain map file(s) (.dem) used to lookup terrain heights" << std::endl;
 	std::cout << "-l: optional, set filter limits in latitude and longitude for the output, followed by the 4 limit values: northLat,southLat,westLon,eastLon" << std::endl;
 	std::cout << "    where the limits are comma separated, expressed in degrees, without spaces, negative for west longitudes and south latitudes" << std::endl;
+	std::cout << "-c: optional, with -l cut the airspaces on the limits, instead of keeping whole the ones with at least one point inside" << std::endl;
 	std::cout << "-o: optional, output file .kmz, .txt (OpenAir), .cup (SeeYou), .csv (LittleNavMap)";
 	if (AirspaceConverter::Is_cGPSmapperAvailable()) std::cout << ", .img (Garmin)";
-	std::cout << " or .mp (Polish). If not specified will be used the name of first input file as KMZ" << std::endl;
+	std::cout << ", .mp (Polish), .geojson or .ndjson (GeoJSON), .acb (ACB binary). If not specified will be used the name of first input file as KMZ" << std::endl;
 	std::cout << "-p: optional, when writing in OpenAir avoid to use arcs and circles but only points (DP)" << std::endl;
 	std::cout << "-s: optional, when writing in OpenAir use coordinates always with seconds (DD:MM:SS)" << std::endl;
 	std::cout << "-d: optional, when writing in OpenAir use coordinates always with decimal minutes (DD:MM.MMM)" << std::endl;
+	std::cout << "-L: optional, when writing in Polish the tolerances in meters of the simplified geometries for the higher levels: up to 3 increasing values, comma separated (default: 20,150,1200), 0 for none" << std::endl;
+	std::cout << "-K: optional, when writing KMZ split the airspaces in tiles of the given size in degrees, each one loaded by the viewer only when visible (default: 0, a single document)" << std::endl;
+	std::cout << "-G: optional, when writing to Garmin IMG pipe the Polish into the given command instead of making a temporary Polish file for cGPSmapper" << std::endl;
+	std::cout << "    the command must read the Polish from its standard input and it is followed by the quoted IMG file name, e.g.: -G \"cgpsmapper /dev/stdin -o\"" << std::endl;
 	std::cout << "-t: optional, when reading KML/KMZ files treat also tracks as airspaces" << std::endl;
+	std::cout << "-S: optional, streaming conversion: write each airspace as soon as it is read, without loading all of them in memory (output to .kmz, .txt, .mp, .img, .geojson or .ndjson)" << std::endl;
+	std::cout << "-T: optional, write the airspaces as vector tiles (.pbf) in the given directory, instead of the output file" << std::endl;
+	std::cout << "-z: optional, zoom levels of the vector tiles: minZoom,maxZoom (default: 4,10)" << std::endl;
+	std::cout << "-V: optional, validate the airspaces reporting the self intersecting ones; if an output file is specified they will be repaired or, if not possible, left out" << std::endl;
+	std::cout << "-R: optional, extract the regions listed in the given file, each one in its own output file named as the output file followed by _ and the name of the region" << std::endl;
+	std::cout << "    where each line of the file is the name of the region followed by northLat,southLat,westLon,eastLon or by the points lat,lon of a polygon, comma separated" << std::endl;
+	std::cout << "-j: optional, with -R how many regions to write at the same time, each one with its own cGPSmapper for Garmin IMG (default: 0, one for each processor)" << std::endl;
+	std::cout << "-C: optional, analyze the airspaces overlapping both horizontally and vertically and report them in the given CSV file, instead of the output file" << std::endl;
+	std::cout << "-M: optional, merge duplicated waypoints: the same waypoint found in different input files is loaded only once, the first file wins" << std::endl;
 	std::cout << "-v: print version number" << std::endl;
 	std::cout << "-h: print this guide" << std::endl << std::endl;
 	std::cout << "At least one input airspace or waypoint file must be present." << std::endl;
@@ -47,10 +65,15 @@ int main(int argc, char *argv[]) {
 		return EXIT_FAILURE;
 	}
 
+#ifndef _WIN32
+	signal(SIGPIPE, SIG_IGN); // if the command of the Polish output pipe ends before reading everything the write fails, instead of terminating the program
+#endif
+
 	AirspaceConverter ac;
-	bool limitsAreSet(false);
+	bool limitsAreSet(false), streaming(false), validate(false);
 	double topLat(90), bottomLat(-90), leftLon(-180), rightLon(180);
-	std::string openAIPdir;
+	std::string openAIPdir, tilesDir, conflictsFile, regionsFile;
+	int minZoom(4), maxZoom(10);
 
 	for(int i=1; i<argc; i++) {
 		size_t len=strlen(argv[i]);
@@ -126,6 +149,9 @@ int main(int argc, char *argv[]) {
 				}
 			}
 			break;
+		case 'c':
+			ac.ClipAirspacesOnLimits();
+			break;
 		case 'p':
 			ac.DoNotCalculateArcsAndCirconferences();
 			break;
@@ -135,6 +161,35 @@ int main(int argc, char *argv[]) {
 		case 'd':
 			ac.SetOpenAirCoodinatesInDecimalMinutes();
 			break;
+		case 'L':
+			if (!hasValueAfter) std::cerr << "ERROR: Polish level tolerances not found." << std::endl;
+			else {
+				const std::string tolerances(argv[++i]);
+				boost::tokenizer<boost::char_separator<char>> tokens(tolerances, boost::char_separator<char>(","));
+				std::vector<double> tolerancesMt;
+				try {
+					for (const std::string& token : tokens) tolerancesMt.push_back(std::stod(token));
+					if (tolerancesMt.size() == 1 && tolerancesMt.front() == 0) tolerancesMt.clear();
+					if (!ac.SetPolishLevelTolerances(tolerancesMt)) std::cerr << "ERROR: expected up to 3 increasing Polish level tolerances." << std::endl;
+				} catch (...) {
+					std::cerr << "ERROR: unable to parse Polish level tolerances." << std::endl;
+				}
+			}
+			break;
+		case 'K':
+			if (!hasValueAfter) std::cerr << "ERROR: KMZ tile size not found." << std::endl;
+			else {
+				try {
+					if (!ac.SetKMZTileSize(std::stod(argv[++i]))) std::cerr << "ERROR: expected a KMZ tile size from 0 to 90 degrees." << std::endl;
+				} catch (...) {
+					std::cerr << "ERROR: unable to parse the KMZ tile size." << std::endl;
+				}
+			}
+			break;
+		case 'G':
+			if(hasValueAfter) AirspaceConverter::Set_cGPSmapperPipeCommand(argv[++i]);
+			else std::cerr << "ERROR: command to pipe the Polish into not found."<< std::endl;
+			break;
 		case 'h':
 			printHelp();
 			if (argc == 2) return EXIT_SUCCESS;
@@ -142,6 +197,15 @@ int main(int argc, char *argv[]) {
 		case 't':
 			ac.ProcessTracksAsAirspaces();
 			break;
+		case 'M':
+			ac.MergeDuplicatedWaypoints();
+			break;
+		case 'S':
+			streaming = true;
+			break;
+		case 'V':
+			validate = true;
+			break;
 		case 'v':
 			std::cout << "AirspaceConverter version: " << VERSION << std::endl;
 			std::cout << "Compiled on " << __DATE__ << " at " << __TIME__ << std::endl;
@@ -149,6 +213,46 @@ int main(int argc, char *argv[]) {
 			std::cout << "https://www.alus.it/AirspaceConverter" << std::endl << std::endl;
 			if (argc == 2) return EXIT_SUCCESS;
 			break;
+		case 'T':
+			if(hasValueAfter) tilesDir = argv[++i];
+			else std::cerr << "ERROR: vector tiles directory path not found."<< std::endl;
+			break;
+		case 'R':
+			if(hasValueAfter) regionsFile = argv[++i];
+			else std::cerr << "ERROR: regions file path not found."<< std::endl;
+			break;
+		case 'j':
+			if (!hasValueAfter) std::cerr << "ERROR: number of jobs not found." << std::endl;
+			else {
+				try {
+					const int jobs = std::stoi(argv[++i]);
+					if (jobs < 0) throw std::out_of_range(argv[i]);
+					ac.SetNumOfJobs((unsigned int)jobs);
+				} catch (...) {
+					std::cerr << "ERROR: unable to parse the number of jobs." << std::endl;
+				}
+			}
+			break;
+		case 'C':
+			if(hasValueAfter) conflictsFile = argv[++i];
+			else std::cerr << "ERROR: conflicts report file path not found."<< std::endl;
+			break;
+		case 'z':
+			if (!hasValueAfter) std::cerr << "ERROR: zoom levels not found." << std::endl;
+			else {
+				const std::string zooms(argv[++i]);
+				const size_t comma = zooms.find(',');
+				try {
+					if (comma == std::string::npos) throw std::invalid_argument(zooms);
+					const int minZ = std::stoi(zooms.substr(0, comma));
+					const int maxZ = std::stoi(zooms.substr(comma + 1));
+					minZoom = minZ;
+					maxZoom = maxZ;
+				} catch (...) {
+					std::cerr << "ERROR: unable to parse zoom levels, expected: minZoom,maxZoom" << std::endl;
+				}
+			}
+			break;
 		case 'D':
 			if(hasValueAfter) openAIPdir = argv[++i];
 			else std::cerr << "ERROR: input openAIP airspace directory path not found."<< std::endl;
@@ -164,6 +268,21 @@ int main(int argc, char *argv[]) {
 		return EXIT_FAILURE;
 	}
 
+	// Only one of the special conversions at a time, each one replacing the normal one
+	const int specialConversions = !openAIPdir.empty() + !tilesDir.empty() + !conflictsFile.empty() + !regionsFile.empty();
+	if (specialConversions > 1) {
+		std::cerr << "ERROR: only one of the options -D, -T, -C and -R can be used at a time." << std::endl << std::endl;
+		return EXIT_FAILURE;
+	}
+	if (streaming && specialConversions > 0) {
+		std::cerr << "ERROR: the streaming conversion (-S) can't be used together with -D, -T, -C or -R." << std::endl << std::endl;
+		return EXIT_FAILURE;
+	}
+	if (!ac.GetOutputFile().empty() && (!openAIPdir.empty() || !tilesDir.empty() || !conflictsFile.empty())) {
+		std::cerr << "ERROR: no output file (-o) can be specified with -D, -T or -C, which make their own output." << std::endl << std::endl;
+		return EXIT_FAILURE;
+	}
+
 	// Start the timer
 	const auto startTime = std::chrono::high_resolution_clock::now();
 
@@ -172,7 +291,29 @@ int main(int argc, char *argv[]) {
 
 	bool result(false);
 
-	if (openAIPdir.empty()) {
+	if (streaming) {
+		if (validate) std::cerr << "Warning: the airspaces can't be validated in a streaming conversion." << std::endl;
+
+		// Load only the waypoints, the airspaces will go directly from the input to the output
+		ac.LoadWaypoints();
+
+		// Apply filter if required
+		Geometry::Limits limits;
+		if (limitsAreSet && (!limits.Set(topLat, bottomLat, leftLon, rightLon) || !ac.FilterOnLatLonLimits(topLat, bottomLat, leftLon, rightLon))) std::cerr << "ERROR: filter limit bounds are not valid." << std::endl;
+
+		// Convert!
+		result = ac.ConvertStreaming(limits);
+
+	} else if (openAIPdir.empty() && validate && ac.GetOutputFile().empty() && tilesDir.empty() && conflictsFile.empty() && regionsFile.empty()) {
+		// Only validate, without any output
+		ac.LoadAirspaces();
+		if (ac.GetNumOfAirspaces() == 0) {
+			std::cerr << "ERROR: no airspaces found in the input files specified." << std::endl << std::endl;
+			return EXIT_FAILURE;
+		}
+		result = ac.ValidateAirspaces(false) == 0;
+
+	} else if (openAIPdir.empty()) {
 		// Load airspaces and waypoints
 		ac.LoadAirspaces();
 		ac.LoadWaypoints();
@@ -186,8 +327,13 @@ int main(int argc, char *argv[]) {
 		// Apply filter if required
 		if (limitsAreSet && !ac.FilterOnLatLonLimits(topLat, bottomLat, leftLon, rightLon)) std::cerr << "ERROR: filter limit bounds are not valid." << std::endl;
 
+		// Repair or leave out the invalid airspaces if required
+		if (validate) ac.ValidateAirspaces(true);
+
 		// Convert!
-		result = ac.Convert();
+		if (!conflictsFile.empty()) result = ac.FindConflicts(conflictsFile);
+		else if (!regionsFile.empty()) result = ac.ConvertRegions(regionsFile);
+		else result = tilesDir.empty() ? ac.Convert() : ac.MakeVectorTiles(tilesDir, minZoom, maxZoom);
 
 	} else result = ac.ConvertOpenAIPdir(openAIPdir);
 
@@ -195,6 +341,11 @@ int main(int argc, char *argv[]) {
 	const double elapsedTimeSec = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - startTime).count() / 1e6;
 	std::cout << "Total execution time: " << elapsedTimeSec << " sec." << std::endl << std::endl;
 
+	// Nothing loaded is used anymore: free the strings of this conversion
+	ac.UnloadAirspaces();
+	ac.UnloadWaypoints();
+	InternedString::ClearPool();
+
 	// The End
 	return result ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,1012 @@
+//============================================================================
+// AirspaceConverter
+// Since       : 14/6/2016
+// Author      : Alberto Realis-Luc <alberto.realisluc@gmail.com>
+// Web         : https://www.alus.it/AirspaceConverter
+// Repository  : https://github.com/alus-it/AirspaceConverter.git
+// Copyright   : (C) 2016-2021 Alberto Realis-Luc
+// License     : GNU GPL v3
+//
+// This source file is part of AirspaceConverter project
+//============================================================================
+// Benchmark of the library internals: build with 'make benchmark' and run
+// Release/benchmark [waypoints.cup] (random worldwide waypoints if no file)
+// Also the area and perimeter of random polygons are compared with boost geometry
+// and the analytic containment test of circles and sectors with the polygon one
+// Then the altitude grammar is verified on its corpus and the keyword tables are timed
+// Finally the sweep line search of self intersections is compared with checking all the pairs of sides
+// and the conflicts found with the spatial index with the ones found checking all the pairs of airspaces
+// Each test prints its timings and reports its checks to the shared fixture: only the failed ones are printed
+
+#include "AirspaceConverter.h"
+#include "Airspace.h"
+#include "Geometry.h"
+#include "Keywords.h"
+#include "Conflicts.h"
+#include "Regions.h"
+#include "SeeYou.h"
+#include "CSV.h"
+#include "NumberFormat.h"
+#include "OpenAir.h"
+#include "Polish.h"
+#include "KML.h"
+#include "VectorTiles.h"
+#include "WaypointIndex.h"
+#include "Parallel.h"
+#include <zip.h>
+#include <boost/geometry.hpp>
+#include <boost/geometry/geometries/point.hpp>
+#include <boost/geometry/geometries/polygon.hpp>
+#include <boost/geometry/geometries/point_xy.hpp>
+#include <boost/geometry/geometries/box.hpp>
+#include <boost/filesystem.hpp>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <set>
+#include <iterator>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#ifndef _WIN32
+#include <csignal>
+#endif
+
+namespace {
+
+std::chrono::high_resolution_clock::time_point startTime;
+
+void StartTimer() {
+	startTime = std::chrono::high_resolution_clock::now();
+}
+
+double StopTimer() { // [ms]
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - startTime).count() / 1e3;
+}
+
+double Distance(const double lat1, const double lon1, const double lat2, const double lon2) { // [m] haversine on the same sphere used by Geometry
+	const double dLat = (lat1 - lat2) * Geometry::DEG2RAD, dLon = (lon1 - lon2) * Geometry::DEG2RAD;
+	const double a = std::pow(std::sin(dLat / 2), 2) + std::cos(lat1 * Geometry::DEG2RAD) * std::cos(lat2 * Geometry::DEG2RAD) * std::pow(std::sin(dLon / 2), 2);
+	return 2 * std::asin(std::sqrt(a)) / Geometry::M2RAD;
+}
+
+bool CheckSameDistances(const std::vector<WaypointIndex::Result>& results, std::vector<double>& expected, const size_t count) {
+	if (results.size() != count) return false;
+	for (size_t i = 0; i < count; i++) if (std::fabs(results[i].distance - expected[i]) > 0.01) return false;
+	return true;
+}
+
+void BoostSurface(const Airspace& airspace, double& area, double& perimeter) { // reference with boost geometry on the WGS84 ellipsoid, the default area strategy is not accurate enough for small polygons
+	typedef boost::geometry::model::point<double, 2, boost::geometry::cs::geographic<boost::geometry::degree>> Point;
+	boost::geometry::model::polygon<Point, false, false> polygon;
+	for (const Geometry::LatLon& p : airspace.GetPoints()) boost::geometry::append(polygon.outer(), Point(p.Lon(), p.Lat()));
+	const boost::geometry::strategy::area::geographic<boost::geometry::strategy::thomas, 5> strategy(boost::geometry::srs::spheroid<double>(6378.137, 6356.7523142451793));
+	area = std::fabs(boost::geometry::area(polygon, strategy));
+	perimeter = boost::geometry::perimeter(polygon) / 1000;
+}
+
+std::vector<std::pair<double, double>> Unwrapped(const std::vector<Geometry::LatLon>& ring) { // longitude made continuous across the antimeridian, latitude
+	std::vector<std::pair<double, double>> unwrapped;
+	for (const Geometry::LatLon& p : ring) {
+		double lon = p.Lon();
+		if (!unwrapped.empty()) lon += 360 * std::round((unwrapped.back().first - lon) / 360);
+		unwrapped.push_back(std::make_pair(lon, p.Lat()));
+	}
+	return unwrapped;
+}
+
+double PlanarArea(const std::vector<Geometry::LatLon>& ring) { // [deg^2] in lat/lon
+	const std::vector<std::pair<double, double>> points(Unwrapped(ring));
+	double area = 0;
+	for (size_t i = 0, j = points.size() - 1; i < points.size(); j = i++) area += (points[j].first - points[i].first) * (points[j].second + points[i].second);
+	return std::fabs(area) / 2;
+}
+
+double PlanarPerimeter(const std::vector<Geometry::LatLon>& ring) { // [deg] in lat/lon
+	const std::vector<std::pair<double, double>> points(Unwrapped(ring));
+	double perimeter = 0;
+	for (size_t i = 0, j = points.size() - 1; i < points.size(); j = i++) perimeter += std::hypot(points[j].first - points[i].first, points[j].second - points[i].second);
+	return perimeter;
+}
+
+double PlanarClippedArea(const std::vector<Geometry::LatLon>& ring, const double top, const double bottom, const double left, const double right) { // [deg^2] reference with boost geometry
+	typedef boost::geometry::model::d2::point_xy<double> Point;
+	boost::geometry::model::polygon<Point, false, false> polygon;
+	for (const std::pair<double, double>& p : Unwrapped(ring)) boost::geometry::append(polygon.outer(), Point(p.first, p.second));
+	boost::geometry::correct(polygon);
+	double area = 0;
+	for (double shift = -360; shift <= 360; shift += 360) {
+		const boost::geometry::model::box<Point> box(Point(left + shift, bottom), Point((right < left ? right + 360 : right) + shift, top));
+		std::vector<boost::geometry::model::polygon<Point, false, false>> output;
+		boost::geometry::intersection(polygon, box, output);
+		for (const auto& part : output) area += boost::geometry::area(part);
+	}
+	return std::fabs(area);
+}
+
+// Altitude grammar corpus: text and the resulting altitude as Altitude::ToString(), empty if the text must be rejected
+const std::pair<const char*, const char*> ALTITUDE_CORPUS[] = {
+	{ "GND", "GND" }, { "gnd", "GND" }, { "SFC", "GND" }, { "Sfc", "GND" }, { "MSL", "MSL" }, { "AMSL", "MSL" }, { "amsl", "MSL" },
+	{ "UNLIM", "UNLIMITED" }, { "UNLIMITED", "UNLIMITED" }, { "UNL", "UNLIMITED" }, { "unl", "UNLIMITED" }, { "UNLIM 100", "UNLIMITED" },
+	{ "GND 100", "GND" }, { "MSL=", "MSL" }, { "FL100", "FL100" }, { "FL 100", "FL100" }, { "fl95", "FL95" }, { "FL=65", "FL65" },
+	{ "FL 100 FT", "FL100" }, { "FL", "" }, { "FL ", "" }, { "1000", "1000 FT AMSL" }, { "0", "MSL" }, { "5", "5 FT AMSL" },
+	{ "1000 FT", "1000 FT AMSL" }, { "1000FT", "1000 FT AMSL" }, { "1000ft", "1000 FT AMSL" }, { "1000 F", "1000 FT AMSL" },
+	{ "1000F", "1000 FT AMSL" }, { "1000 M", "3280 FT AMSL" }, { "1000m", "3280 FT AMSL" }, { "1000 MT", "3280 FT AMSL" },
+	{ "1000mt", "3280 FT AMSL" }, { "1500 ft AMSL", "1500 FT AMSL" }, { "1500ft MSL", "1500 FT AMSL" }, { "1500 FT ALT", "1500 FT AMSL" },
+	{ "1500 MSL", "1500 FT AMSL" }, { "1500 m MSL", "4921 FT AMSL" }, { "1500 ft AGL", "1500 FT AGL" }, { "1500AGL", "1500 FT AGL" },
+	{ "1500 AGND", "1500 FT AGL" }, { "1500 ASFC", "1500 FT AGL" }, { "1500 GND", "1500 FT AGL" }, { "3000 ft SFC", "3000 FT AGL" },
+	{ "1500M AGL", "4921 FT AGL" }, { "1000 M FT", "3280 FT AMSL" }, { "1000 AMSL M", "1000 FT AMSL" }, { "1000  AGL", "1000 FT AGL" },
+	{ " 1000 FT", "1000 FT AMSL" }, { "4500=FT", "4500 FT AMSL" }, { "FT 1000", "1000 FT AMSL" }, { "AGL 1000", "1000 FT AMSL" },
+	{ "1000 FTAMSL", "1000 FT AMSL" }, { "100 FT AMSL 200", "100 FT AMSL" }, { "1000 2000", "" }, { "1500 AGL 200", "" },
+	{ "1000.5 M", "" }, { "123456789012", "" }, { "abc", "" }, { "", "" }
+};
+
+// Reference for the keyword tables: chain of string compares, as the KML reader was doing for the category
+Airspace::Type CategoryFromChain(const std::string& text) {
+	static const std::vector<std::pair<std::string, Airspace::Type>> categories = {
+		{ "Class A", Airspace::CLASSA }, { "Class B", Airspace::CLASSB }, { "Class C", Airspace::CLASSC }, { "Class D", Airspace::CLASSD },
+		{ "Class E", Airspace::CLASSE }, { "Class F", Airspace::CLASSF }, { "Class G", Airspace::CLASSG }, { "Danger", Airspace::DANGER },
+		{ "Prohibited", Airspace::PROHIBITED }, { "Restricted", Airspace::RESTRICTED }, { "CTR", Airspace::CTR }, { "TMA", Airspace::TMA },
+		{ "TMZ", Airspace::TMZ }, { "RMZ", Airspace::RMZ }, { "FIR", Airspace::FIR }, { "UIR", Airspace::UIR }, { "OTH", Airspace::OTH },
+		{ "Gliding area", Airspace::GLIDING }, { "No glider", Airspace::NOGLIDER }, { "Wave window", Airspace::WAVE }, { "Unknown", Airspace::UNKNOWN }
+	};
+	for (const std::pair<std::string, Airspace::Type>& category : categories) if (text == category.first) return category.second;
+	return Airspace::UNDEFINED;
+}
+
+struct Side { // side of a ring oriented from left to right, as in the sweep line
+	double x1, y1, x2, y2;
+};
+
+int Orientation(const Side& s, const double x, const double y) {
+	const double cross = (s.x2 - s.x1) * (y - s.y1) - (s.y2 - s.y1) * (x - s.x1);
+	return (cross > 0) - (cross < 0);
+}
+
+// Reference for the sweep line: all the pairs of sides, with the same rules: consecutive sides must not overlap, the others must not touch
+bool BruteForceSelfIntersection(const std::vector<Geometry::LatLon>& ring) {
+	const size_t n = ring.size() - 1;
+	std::vector<Side> sides(n);
+	for (size_t i = 0; i < n; i++) {
+		const Geometry::LatLon &a = ring[i], &b = ring[i + 1];
+		const bool isForward = a.Lon() < b.Lon() || (a.Lon() == b.Lon() && a.Lat() < b.Lat());
+		const Geometry::LatLon &left = isForward ? a : b, &right = isForward ? b : a;
+		sides[i] = { left.Lon(), left.Lat(), right.Lon(), right.Lat() };
+	}
+	for (size_t i = 0; i < n; i++) for (size_t j = i + 1; j < n; j++) {
+		const Side &a = sides[i], &b = sides[j];
+		const int o1 = Orientation(a, b.x1, b.y1), o2 = Orientation(a, b.x2, b.y2);
+		if (j == i + 1 || (i == 0 && j == n - 1)) {
+			if (o1 != 0 || o2 != 0) continue;
+			if ((a.x1 != a.x2 || b.x1 != b.x2) ? std::max(a.x1, b.x1) < std::min(a.x2, b.x2) : std::max(a.y1, b.y1) < std::min(a.y2, b.y2)) return true;
+			continue;
+		}
+		if (std::max(a.x1, b.x1) > std::min(a.x2, b.x2) || std::max(std::min(a.y1, a.y2), std::min(b.y1, b.y2)) > std::min(std::max(a.y1, a.y2), std::max(b.y1, b.y2))) continue;
+		if (o1 * o2 <= 0 && Orientation(b, a.x1, a.y1) * Orientation(b, a.x2, a.y2) <= 0) return true;
+	}
+	return false;
+}
+
+// Points around the center at the given radius [deg of latitude], each one multiplied by shape(), the longitudes widened with the latitude unless planar
+std::vector<Geometry::LatLon> RoundRing(const double lat, const double lon, const double radius, const size_t numOfPoints, const std::function<double()>& shape, const bool planar = false) {
+	const double lonFactor = planar ? 1 : 1 / std::cos(lat * Geometry::DEG2RAD);
+	std::vector<Geometry::LatLon> ring;
+	ring.reserve(numOfPoints + 1);
+	for (size_t j = 0; j < numOfPoints; j++) {
+		const double angle = 2 * Geometry::PI * j / numOfPoints, r = radius * shape();
+		ring.push_back(Geometry::LatLon(lat + r * std::sin(angle), lon + r * std::cos(angle) * lonFactor));
+	}
+	return ring;
+}
+
+// Closed airspace on the points, from baseFt to topFt
+Airspace MakeAirspace(const Airspace::Type type, const std::string& name, const std::vector<Geometry::LatLon>& points, const int baseFt = 0, const int topFt = 5000) {
+	Airspace airspace(type);
+	airspace.SetName(name);
+	for (const Geometry::LatLon& p : points) airspace.AddPointLatLonOnly(p.Lat(), p.Lon());
+	airspace.ClosePoints();
+	Altitude base, top;
+	base.SetAltFt(baseFt);
+	top.SetAltFt(topFt);
+	airspace.SetBaseAltitude(base);
+	airspace.SetTopAltitude(top);
+	return airspace;
+}
+
+void Insert(std::multimap<int, Airspace>& airspaces, Airspace&& airspace) {
+	const int type = airspace.GetType();
+	airspaces.insert(std::make_pair(type, std::move(airspace)));
+}
+
+// A CTR across the antimeridian, south of Fiji
+std::multimap<int, Airspace> AntimeridianAirspaces() {
+	std::vector<Geometry::LatLon> ring(RoundRing(-17, 179.9, 0.2, 16, []() { return 1.0; }, true));
+	for (Geometry::LatLon& p : ring) if (p.Lon() > 180) p.SetLatLon(p.Lat(), p.Lon() - 360);
+	std::multimap<int, Airspace> airspaces;
+	Insert(airspaces, MakeAirspace(Airspace::CTR, "Across the antimeridian", ring));
+	return airspaces;
+}
+
+std::string TemporaryPath(const std::string& extension) {
+	return (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("benchmark-%%%%-%%%%" + extension)).string();
+}
+
+// The errors logged while it exists are expected, so not shown
+class ErrorsExpected {
+public:
+	ErrorsExpected() : logError(AirspaceConverter::LogError) { AirspaceConverter::SetLogErrorFunction([](const std::string&) {}); }
+	~ErrorsExpected() { AirspaceConverter::SetLogErrorFunction(logError); }
+
+private:
+	const std::function<void(const std::string&)> logError;
+};
+
+// Data shared by the tests and the outcome of their checks, reported apart from the timings
+struct Fixture {
+	Fixture() : random(42), randomLat(-80, 80), randomLon(-180, 180), randomCenterLon(-170, 170), randomRadius(1, 200), checks(0), failures(0) {}
+
+	void Check(const bool passed, const std::string& error) {
+		checks++;
+		if (passed) return;
+		failures++;
+		std::cout << "ERROR: " << error << std::endl;
+	}
+
+	// Random regular polygons of 1 to 30 km over Europe with random vertical limits
+	void AddRandomAirspaces(const size_t count) {
+		std::uniform_real_distribution<double> lat(36, 60), lon(-10, 30), size(1, 30);
+		std::uniform_int_distribution<int> feet(0, 20000), type(Airspace::CLASSA, Airspace::RMZ);
+		for (size_t i = 0; i < count; i++) {
+			const Airspace::Type t = (Airspace::Type)type(random);
+			const double centerLat = lat(random), centerLon = lon(random), radius = size(random) / 111.2;
+			const std::vector<Geometry::LatLon> ring(RoundRing(centerLat, centerLon, radius, 16, []() { return 1.0; }));
+			const int feet1 = feet(random), feet2 = feet(random);
+			Insert(randomAirspaces, MakeAirspace(t, "Random " + std::to_string(randomAirspaces.size()), ring, std::min(feet1, feet2), std::max(feet1, feet2) + 500));
+		}
+	}
+
+	std::mt19937 random;
+	std::uniform_real_distribution<double> randomLat, randomLon, randomCenterLon, randomRadius;
+	WaypointSet waypoints; // loaded or random worldwide
+	std::vector<Airspace> polygons; // random irregular ones, also across the antimeridian
+	std::multimap<int, Airspace> randomAirspaces; // over Europe, made by the conflicts test
+	size_t checks, failures;
+};
+
+bool LoadWaypoints(Fixture& f, const char* cupFile) {
+	StartTimer();
+	if (cupFile != nullptr) {
+		SeeYou cu(f.waypoints);
+		if (!cu.Read(cupFile)) return false;
+	} else for (int i = 0; i < 200000; i++) {
+		f.waypoints.Add(Waypoint("WP" + std::to_string(i), "", "", f.randomLat(f.random), f.randomLon(f.random), 0, 1 + i % 17, ""));
+	}
+	std::cout << "Waypoints: " << f.waypoints.Size() << " loaded in " << StopTimer() << " ms" << std::endl;
+	return !f.waypoints.IsEmpty();
+}
+
+void TestWaypointIndex(Fixture& f) {
+	WaypointIndex index;
+	StartTimer();
+	index.Build(f.waypoints);
+	std::cout << "Spatial index built in " << StopTimer() << " ms" << std::endl;
+
+	const int numOfQueries = 1000, numOfChecks = 100;
+	const size_t k = 10;
+	const double radius = 50000; // [m]
+	std::vector<std::pair<double, double>> queries;
+	for (int i = 0; i < numOfQueries; i++) queries.push_back(std::make_pair(f.randomLat(f.random), f.randomLon(f.random)));
+
+	// Brute force as reference on the first queries
+	std::vector<std::vector<double>> expectedNearest(numOfChecks), expectedWithin(numOfChecks);
+	StartTimer();
+	for (int i = 0; i < numOfChecks; i++) {
+		std::vector<double>& distances = expectedNearest[i];
+		distances.reserve(f.waypoints.Size());
+		for (const Waypoint& w : f.waypoints) distances.push_back(Distance(queries[i].first, queries[i].second, w.GetLatitude(), w.GetLongitude()));
+		std::sort(distances.begin(), distances.end());
+		for (const double& d : distances) if (d <= radius) expectedWithin[i].push_back(d); else break;
+	}
+	std::cout << "Brute force: " << StopTimer() / numOfChecks << " ms per query" << std::endl;
+
+	bool sameNearest = true, sameWithin = true;
+	std::vector<WaypointIndex::Result> results;
+	StartTimer();
+	for (int i = 0; i < numOfQueries; i++) {
+		index.FindNearest(queries[i].first, queries[i].second, k, results);
+		if (i < numOfChecks) sameNearest &= CheckSameDistances(results, expectedNearest[i], std::min(k, f.waypoints.Size()));
+	}
+	std::cout << "Nearest " << k << ": " << StopTimer() * 1e3 / numOfQueries << " us per query" << std::endl;
+
+	StartTimer();
+	size_t found = 0;
+	for (int i = 0; i < numOfQueries; i++) {
+		index.FindWithinRadius(queries[i].first, queries[i].second, radius, results);
+		found += results.size();
+		if (i < numOfChecks) sameWithin &= CheckSameDistances(results, expectedWithin[i], expectedWithin[i].size());
+	}
+	std::cout << "Within " << radius / 1000 << " km: " << StopTimer() * 1e3 / numOfQueries << " us per query, " << (double)found / numOfQueries << " waypoints found on average" << std::endl;
+
+	StartTimer();
+	for (int i = 0; i < numOfQueries; i++) index.FindNearest(queries[i].first, queries[i].second, k, results, [](const Waypoint& w) { return w.IsAirfield() || w.GetType() == Waypoint::outlanding; });
+	std::cout << "Nearest " << k << " landables: " << StopTimer() * 1e3 / numOfQueries << " us per query" << std::endl;
+
+	f.Check(sameNearest, "nearest waypoints differ from brute force!");
+	f.Check(sameWithin, "waypoints within the radius differ from brute force!");
+}
+
+// Duplicated waypoints: merged only across the files, in the one of the file loaded first, whatever its type
+void TestMergeWaypoints(Fixture& f) {
+	WaypointSet toMerge;
+	std::vector<WaypointSet::Mark> sources(1, toMerge.GetMark());
+	toMerge.Add(Waypoint("Alpha", "", "", 46, 8, 500, Waypoint::airfieldGrass, -1, -1, -1, ""));
+	toMerge.Add(Waypoint("Alpha", "", "", 46.001, 8, 500, Waypoint::airfieldGrass, -1, -1, -1, "")); // kept: in the same file
+	toMerge.Add(Waypoint("Gamma", "", "", 45, 7, 300, Waypoint::airfieldSolid, -1, -1, -1, ""));
+	sources.push_back(toMerge.GetMark());
+	toMerge.Add(Waypoint("ALPHA", "", "", 46.002, 8, 500, Waypoint::airfieldSolid, 90, 800, -1, ""));
+	toMerge.Add(Waypoint("Gamma", "", "", 45.001, 7, 300, Waypoint::airfieldGrass, -1, -1, -1, ""));
+	const size_t merged = toMerge.MergeDuplicates(500, sources);
+	const std::vector<Waypoint>& grass = toMerge.GetBucket(Waypoint::airfieldGrass);
+	const std::vector<Waypoint>& solid = toMerge.GetBucket(Waypoint::airfieldSolid);
+	std::cout << "Duplicated waypoints: " << merged << " merged, " << toMerge.Size() << " remaining" << std::endl;
+	f.Check(merged == 2 && grass.size() == 2 && solid.size() == 1 && solid.front().GetName() == "Gamma" && grass.front().GetRunwayDir() == 90 && !grass.back().HasRunwayDir(),
+		"wrong duplicated waypoints merged!");
+}
+
+// Area and perimeter of random irregular polygons, compared with boost geometry
+void TestSurface(Fixture& f) {
+	std::uniform_real_distribution<double> randomNoise(0.7, 1.3);
+	const std::function<double()> noise = [&]() { return randomNoise(f.random); };
+	f.polygons.clear();
+	for (size_t i = 0; i < 2000; i++) {
+		const double lat = f.randomLat(f.random), lon = f.randomLon(f.random), radius = f.randomRadius(f.random) / 111.2;
+		f.polygons.push_back(MakeAirspace(Airspace::UNDEFINED, "", RoundRing(lat, lon, radius, 8 + i % 250, noise)));
+	}
+	const std::vector<Airspace>& polygons = f.polygons;
+	std::vector<std::pair<double, double>> surfaces(polygons.size()), expectedSurfaces(polygons.size());
+	StartTimer();
+	for (size_t i = 0; i < polygons.size(); i++) polygons[i].CalculateSurface(surfaces[i].first, surfaces[i].second);
+	std::cout << "Area and perimeter: " << StopTimer() * 1e3 / polygons.size() << " us per polygon" << std::endl;
+	StartTimer();
+	for (size_t i = 0; i < polygons.size(); i++) BoostSurface(polygons[i], expectedSurfaces[i].first, expectedSurfaces[i].second);
+	std::cout << "Area and perimeter with boost geometry: " << StopTimer() * 1e3 / polygons.size() << " us per polygon" << std::endl;
+	double maxAreaError = 0, maxPerimeterError = 0;
+	for (size_t i = 0; i < polygons.size(); i++) {
+		maxAreaError = std::max(maxAreaError, std::fabs(surfaces[i].first - expectedSurfaces[i].first) / expectedSurfaces[i].first);
+		maxPerimeterError = std::max(maxPerimeterError, std::fabs(surfaces[i].second - expectedSurfaces[i].second) / expectedSurfaces[i].second);
+	}
+	std::cout << "Max relative difference from boost geometry: area " << maxAreaError << ", perimeter " << maxPerimeterError << std::endl;
+	f.Check(maxAreaError <= 1e-4 && maxPerimeterError <= 1e-6, "area or perimeter differ from boost geometry!");
+}
+
+// Clipping on limits crossing the polygons, across the antimeridian for the ones near it, compared with boost geometry
+void TestClipOnLimits(Fixture& f) {
+	const std::vector<Airspace>& polygons = f.polygons;
+	std::vector<std::vector<Geometry::LatLon>> toClip(polygons.size()), clipped(polygons.size());
+	std::vector<Geometry::Limits> clipLimits(polygons.size());
+	std::uniform_real_distribution<double> randomOffset(-0.5, 0.5);
+	for (size_t i = 0; i < polygons.size(); i++) {
+		for (const Geometry::LatLon& p : polygons[i].GetPoints()) toClip[i].push_back(Geometry::LatLon(p.Lat(), p.Lon() < -180 ? p.Lon() + 360 : (p.Lon() > 180 ? p.Lon() - 360 : p.Lon())));
+		clipped[i] = toClip[i];
+		const Geometry::LatLon& p = clipped[i][clipped[i].size() / 2];
+		const double halfSize = 1 + randomOffset(f.random), left = p.Lon() - halfSize + randomOffset(f.random), right = p.Lon() + halfSize;
+		clipLimits[i].Set(p.Lat() + halfSize, p.Lat() - halfSize + randomOffset(f.random), left < -180 ? left + 360 : left, right > 180 ? right - 360 : right);
+	}
+	StartTimer();
+	size_t remained = 0;
+	for (size_t i = 0; i < clipped.size(); i++) if (clipLimits[i].ClipPolygon(clipped[i])) remained++; else clipped[i].clear();
+	std::cout << "Clipping on limits: " << StopTimer() * 1e3 / clipped.size() << " us per polygon, " << remained << " of " << clipped.size() << " not empty" << std::endl;
+	size_t clipMismatches = 0, acrossAntimeridian = 0;
+	for (size_t i = 0; i < clipped.size(); i++) {
+		const Geometry::Limits& l = clipLimits[i];
+		if (l.GetLeftLongitudeLimit() > l.GetRightLongitudeLimit()) acrossAntimeridian++;
+		const double expected = PlanarClippedArea(toClip[i], l.GetTopLatitudeLimit(), l.GetBottomLatitudeLimit(), l.GetLeftLongitudeLimit(), l.GetRightLongitudeLimit());
+		const double area = clipped[i].empty() ? 0 : PlanarArea(clipped[i]);
+		const double tolerance = 1e-9 * std::max(1.0, expected) + (clipped[i].empty() ? 0 : PlanarPerimeter(clipped[i]) * Geometry::LatLon::RESOLUTION); // the intersections are rounded when compact
+		bool isInside = true;
+		for (const Geometry::LatLon& p : clipped[i]) isInside &= l.IsPositionWithinLimits(p);
+		if (!isInside || std::fabs(area - expected) > tolerance) clipMismatches++;
+	}
+	std::cout << "Clipping on limits: " << acrossAntimeridian << " limits across the antimeridian, " << clipMismatches << " differ from boost geometry" << std::endl;
+	f.Check(clipMismatches == 0, "clipped polygons differ from boost geometry or are outside the limits!");
+}
+
+// Random circles, pies and arcs with a vertex, positions inside or around them (not across the antimeridian, as both tests are planar in lat/lon)
+void TestContainment(Fixture& f) {
+	std::vector<Airspace> curved(1000);
+	std::uniform_real_distribution<double> randomRadiusNM(2, 30), randomDirection(0, 360);
+	std::vector<std::pair<size_t, Geometry::LatLon>> positions;
+	for (size_t i = 0; i < curved.size(); i++) {
+		const Geometry::LatLon center(f.randomLat(f.random), f.randomCenterLon(f.random));
+		const double radiusNM = randomRadiusNM(f.random);
+		switch (i % 3) {
+		case 0:
+			curved[i].AddGeometry(new Circle(center, radiusNM));
+			break;
+		case 1:
+			curved[i].AddGeometry(new Point(center));
+			curved[i].AddGeometry(new Sector(center, radiusNM, randomDirection(f.random), randomDirection(f.random), i % 2 == 0));
+			break;
+		default:
+			curved[i].AddGeometry(new Point(Geometry::LatLon(center.Lat() + radiusNM / 60 * 1.5, center.Lon())));
+			curved[i].AddGeometry(new Sector(center, radiusNM, 100, 260, i % 2 == 0));
+		}
+		curved[i].ClosePoints();
+		std::uniform_real_distribution<double> randomOffset(-radiusNM / 40, radiusNM / 40);
+		for (int j = 0; j < 200; j++) positions.push_back(std::make_pair(i, Geometry::LatLon(center.Lat() + randomOffset(f.random), center.Lon() + randomOffset(f.random) / std::cos(center.Lat() * Geometry::DEG2RAD))));
+	}
+	std::vector<bool> analytic(positions.size()), polygon(positions.size());
+	StartTimer();
+	for (size_t i = 0; i < positions.size(); i++) analytic[i] = curved[positions[i].first].IsPositionInside(positions[i].second);
+	std::cout << "Analytic containment: " << StopTimer() * 1e3 / positions.size() << " us per test" << std::endl;
+	StartTimer();
+	for (size_t i = 0; i < positions.size(); i++) polygon[i] = Geometry::IsInsidePolygon(curved[positions[i].first].GetPoints(), positions[i].second);
+	std::cout << "Polygon containment: " << StopTimer() * 1e3 / positions.size() << " us per test" << std::endl;
+	size_t mismatches = 0, inside = 0;
+	for (size_t i = 0; i < positions.size(); i++) {
+		if (analytic[i]) inside++;
+		if (analytic[i] == polygon[i]) continue;
+		Airspace& a = curved[positions[i].first];
+		double borderDistance = 1;
+		for (size_t g = 0; g < a.GetNumberOfGeometries(); g++) borderDistance = std::min(borderDistance, a.GetGeometryAt(g)->CalcDistanceNM(positions[i].second));
+		if (borderDistance > 0.01) mismatches++; // discretization can differ from the exact curve only very close to it
+	}
+	std::cout << "Containment: " << inside << " of " << positions.size() << " positions inside, " << mismatches << " mismatches away from the borders" << std::endl;
+	f.Check(mismatches == 0, "analytic containment differs from polygon containment!");
+}
+
+void TestAltitudeGrammar(Fixture& f) {
+	size_t altitudeErrors = 0, parsed = 0;
+	for (const std::pair<const char*, const char*>& test : ALTITUDE_CORPUS) {
+		Airspace airspace;
+		const bool accepted = AirspaceConverter::ParseAltitude(test.first, true, airspace);
+		const std::string result(accepted ? airspace.GetTopAltitude().ToString() : "");
+		if (result != test.second) altitudeErrors++;
+		f.Check(result == test.second, "altitude \"" + std::string(test.first) + "\" parsed as \"" + result + "\" instead of \"" + test.second + "\"");
+	}
+	const std::vector<std::string> altitudes = { "FL100", "GND", "1500 ft AMSL", "2500FT AGL", "UNLIM", "1000 m MSL", "SFC", "FL 65" };
+	Airspace airspace;
+	StartTimer();
+	for (int i = 0; i < 100000; i++) for (const std::string& text : altitudes) parsed += AirspaceConverter::ParseAltitude(text, i % 2 == 0, airspace);
+	std::cout << "Altitude parsing: " << StopTimer() * 1e6 / (100000 * altitudes.size()) << " ns per altitude, " << altitudeErrors << " errors on the corpus" << std::endl;
+	f.Check(parsed == 100000 * altitudes.size(), "altitudes of the timing not all parsed!");
+}
+
+// Keyword tables: every word must be found, the others not
+void TestKeywords(Fixture& f) {
+	const std::vector<std::string> kmlCategories = { "Class A", "Class B", "Class C", "Class D", "Class E", "Class F", "Class G", "Danger", "Prohibited",
+		"Restricted", "CTR", "TMA", "TMZ", "RMZ", "FIR", "UIR", "OTH", "Gliding area", "No glider", "Wave window", "Unknown" };
+	const std::vector<std::string> openAIPCategories = { "A", "B", "C", "D", "E", "F", "G", "CTR", "TMA", "TMZ", "RMZ", "DANGER", "PROHIBITED",
+		"RESTRICTED", "GLIDING", "WAVE", "FIR", "UIR", "OTH" };
+	const std::vector<std::string> openAirCategories = { "R", "Q", "P", "A", "B", "C", "D", "E", "F", "G", "W", "CTR", "TMZ", "RMZ", "GP", "GSEC", "NOTAM", "UKN", "UNKNOWN" };
+	const std::vector<std::string> csvStyles = { "Airport", "Airstrip", "NDB", "VOR", "VORDME", "VORTAC", "TACAN", "VRP", "Waypoint", "Bookmark", "Cabin",
+		"Closed", "DME", "Error", "Flag", "Helipad", "Lighthouse", "Location", "Logbook", "Marker", "Mountain", "Obstacle", "POI", "Pin", "Seaport", "Unknown" };
+	const std::vector<std::string> notKeywords = { "", "Class H", "class A", "CTA", "TM", "TMAX", "Airports", "VORDM", "X" };
+	bool keywordsOK = true;
+	for (const std::string& k : kmlCategories) keywordsOK &= Keywords::FindKMLCategory(k) != Airspace::UNDEFINED && Keywords::FindKMLCategory(k) == CategoryFromChain(k);
+	for (const std::string& k : openAIPCategories) keywordsOK &= Keywords::FindOpenAIPCategory(k) != Airspace::UNDEFINED;
+	for (const std::string& k : openAirCategories) keywordsOK &= Keywords::FindOpenAirCategory(k.c_str(), k.c_str() + k.length()) != Airspace::UNDEFINED;
+	for (const std::string& k : csvStyles) keywordsOK &= Keywords::FindCSVStyle(k) >= 0;
+	for (const std::string& k : notKeywords) keywordsOK &= Keywords::FindKMLCategory(k) == Airspace::UNDEFINED && Keywords::FindOpenAIPCategory(k) == Airspace::UNDEFINED
+		&& Keywords::FindOpenAirCategory(k.c_str(), k.c_str() + k.length()) == Airspace::UNDEFINED && Keywords::FindCSVStyle(k) < 0;
+	f.Check(keywordsOK, "keyword tables not consistent!");
+
+	const int keywordLoops = 200000;
+	size_t keywordsFound = 0;
+	StartTimer();
+	for (int i = 0; i < keywordLoops; i++) for (const std::string& k : kmlCategories) keywordsFound += Keywords::FindKMLCategory(k);
+	const double tableTime = StopTimer() * 1e6 / (keywordLoops * kmlCategories.size());
+	StartTimer();
+	for (int i = 0; i < keywordLoops; i++) for (const std::string& k : kmlCategories) keywordsFound += CategoryFromChain(k);
+	const double chainTime = StopTimer() * 1e6 / (keywordLoops * kmlCategories.size());
+	StartTimer();
+	for (int i = 0; i < keywordLoops; i++) for (const std::string& k : csvStyles) keywordsFound += Keywords::FindCSVStyle(k);
+	std::cout << "Keyword lookup: " << tableTime << " ns per KML category (" << chainTime << " ns with compare chain), "
+		<< StopTimer() * 1e6 / (keywordLoops * csvStyles.size()) << " ns per CSV style" << std::endl;
+	f.Check(keywordsFound > 0, "no keywords found in the timing!");
+}
+
+// Self intersections: random star shaped polygons, simple unless two vertices are swapped or one is repeated
+void TestSelfIntersections(Fixture& f) {
+	std::vector<std::vector<Geometry::LatLon>> rings(1000);
+	std::uniform_real_distribution<double> randomShape(0.2, 1);
+	const std::function<double()> shape = [&]() { return randomShape(f.random); };
+	for (size_t i = 0; i < rings.size(); i++) {
+		const double lat = f.randomLat(f.random), lon = f.randomCenterLon(f.random), radius = f.randomRadius(f.random) / 111.2;
+		const size_t numOfPoints = 10 + (i * 7) % 1000;
+		rings[i] = RoundRing(lat, lon, radius, numOfPoints, shape, true);
+		std::uniform_int_distribution<size_t> randomVertex(1, numOfPoints - 2);
+		if (i % 3 == 1) std::swap(rings[i][randomVertex(f.random)], rings[i][randomVertex(f.random)]);
+		else if (i % 3 == 2) rings[i].insert(rings[i].begin() + numOfPoints / 2, rings[i][randomVertex(f.random) / 3]); // touching itself
+		rings[i].push_back(rings[i].front());
+	}
+	std::vector<bool> sweep(rings.size()), allPairs(rings.size());
+	size_t first, second;
+	StartTimer();
+	for (size_t i = 0; i < rings.size(); i++) sweep[i] = Geometry::FindSelfIntersection(rings[i], first, second);
+	const double sweepTime = StopTimer() * 1e3 / rings.size();
+	StartTimer();
+	for (size_t i = 0; i < rings.size(); i++) allPairs[i] = BruteForceSelfIntersection(rings[i]);
+	std::cout << "Self intersections: " << sweepTime << " us per polygon with sweep line, " << StopTimer() * 1e3 / rings.size() << " us checking all the pairs of sides" << std::endl;
+	size_t intersecting = 0, intersectionMismatches = 0, notRepaired = 0;
+	for (size_t i = 0; i < rings.size(); i++) {
+		if (sweep[i] != allPairs[i]) intersectionMismatches++;
+		if (!allPairs[i]) continue;
+		intersecting++;
+		Airspace repaired;
+		for (const Geometry::LatLon& point : rings[i]) repaired.AddPointLatLonOnly(point.Lat(), point.Lon());
+		if (!repaired.ClosePoints() || !repaired.RepairSelfIntersections() || BruteForceSelfIntersection(repaired.GetPoints())) notRepaired++;
+	}
+	std::cout << "Self intersections: " << intersecting << " of " << rings.size() << " polygons, " << intersectionMismatches << " mismatches, " << notRepaired << " not repaired" << std::endl;
+	f.Check(intersectionMismatches == 0, "self intersections not found!");
+	f.Check(notRepaired == 0, "self intersections not repaired!");
+}
+
+// Conflicts: the spatial index must find the same overlapping airspaces of checking all the pairs
+void TestConflicts(Fixture& f) {
+	f.AddRandomAirspaces(5000);
+	Conflicts withIndex(f.randomAirspaces), allPairsConflicts(f.randomAirspaces);
+	StartTimer();
+	withIndex.Find();
+	const double indexTime = StopTimer();
+	StartTimer();
+	allPairsConflicts.Find(false);
+	std::cout << "Conflicts of " << f.randomAirspaces.size() << " airspaces: " << indexTime << " ms with spatial index, " << StopTimer() << " ms checking all the pairs" << std::endl;
+	bool sameConflicts = withIndex.GetConflicts().size() == allPairsConflicts.GetConflicts().size();
+	for (size_t i = 0; sameConflicts && i < withIndex.GetConflicts().size(); i++) {
+		const Conflicts::Conflict &a = withIndex.GetConflicts()[i], &b = allPairsConflicts.GetConflicts()[i];
+		sameConflicts = a.first == b.first && a.second == b.second && a.areaKm2 == b.areaKm2;
+	}
+	f.Check(sameConflicts && !withIndex.GetConflicts().empty(), "conflicts found with the spatial index differ from checking all the pairs!");
+
+	// Then more airspaces, also for the tests after this one
+	f.AddRandomAirspaces(45000);
+	Conflicts manyConflicts(f.randomAirspaces);
+	StartTimer();
+	manyConflicts.Find();
+	std::cout << "Conflicts of " << f.randomAirspaces.size() << " airspaces: " << StopTimer() << " ms with spatial index, " << withIndex.GetConflicts().size() << " and "
+		<< manyConflicts.GetConflicts().size() << " conflicts found" << std::endl;
+}
+
+// Conflicts across the antimeridian: only with the airspaces really overlapping on either side, not with the ones around Greenwich
+void TestConflictsAcrossAntimeridian(Fixture& f) {
+	std::multimap<int, Airspace> airspaces;
+	const auto addBox = [&airspaces](const std::string& name, const double west, const double east) {
+		Insert(airspaces, MakeAirspace(Airspace::CTR, name, { Geometry::LatLon(-17, west), Geometry::LatLon(-17, east), Geometry::LatLon(-18, east), Geometry::LatLon(-18, west) }));
+	};
+	addBox("Across", 179, -179);
+	addBox("Greenwich", -0.5, 0.5);
+	addBox("East", -179.5, -178);
+	addBox("Also across", 179.5, -179.5);
+	Conflicts withIndex(airspaces), allPairs(airspaces);
+	withIndex.Find();
+	allPairs.Find(false);
+	double acrossArea = 0;
+	for (const Conflicts::Conflict& c : withIndex.GetConflicts()) {
+		if (c.first->GetName() == "Greenwich" || c.second->GetName() == "Greenwich") acrossArea = -1;
+		else if (acrossArea >= 0) acrossArea += c.areaKm2;
+	}
+	const double expectedArea = 1.5 * 111.195 * 111.195 * std::cos(17.5 * Geometry::DEG2RAD); // half degree with East, one with Also across
+	std::cout << "Conflicts across the antimeridian: " << withIndex.GetConflicts().size() << " found, overlap of " << acrossArea << " km2" << std::endl;
+	f.Check(withIndex.GetConflicts().size() == 2 && allPairs.GetConflicts().size() == 2 && std::fabs(acrossArea - expectedArea) <= 1e-6 * expectedArea, "wrong conflicts across the antimeridian!");
+}
+
+// Regions: the spatial index must assign the same airspaces and waypoints of checking all the regions
+void TestRegions(Fixture& f) {
+	Regions regions, regionsAllChecked;
+	std::uniform_real_distribution<double> randomRegionSize(2, 20);
+	for (int i = 0; i < 30; i++) {
+		const double lat = f.randomLat(f.random), lon = f.randomLon(f.random), size = randomRegionSize(f.random);
+		const std::string name("R" + std::to_string(i));
+		if (i % 3 == 2) {
+			const std::vector<Geometry::LatLon> triangle = { Geometry::LatLon(lat + size / 2, lon), Geometry::LatLon(lat - size / 2, std::min(180.0, lon + size)), Geometry::LatLon(lat - size / 2, std::max(-180.0, lon - size)) };
+			regions.AddPolygon(name, triangle);
+			regionsAllChecked.AddPolygon(name, triangle);
+		} else {
+			const double left = lon - size, right = lon + size; // also across the antimeridian
+			regions.AddBox(name, std::min(90.0, lat + size / 2), std::max(-90.0, lat - size / 2), left < -180 ? left + 360 : left, right > 180 ? right - 360 : right);
+			regionsAllChecked.AddBox(name, std::min(90.0, lat + size / 2), std::max(-90.0, lat - size / 2), left < -180 ? left + 360 : left, right > 180 ? right - 360 : right);
+		}
+	}
+	StartTimer();
+	regions.Assign(f.randomAirspaces, f.waypoints, false);
+	const double regionsIndexTime = StopTimer();
+	StartTimer();
+	regionsAllChecked.Assign(f.randomAirspaces, f.waypoints, false, false);
+	std::cout << "Regions: " << regions.GetNumOfRegions() << " regions assigned in " << regionsIndexTime << " ms with spatial index, " << StopTimer() << " ms checking all the regions" << std::endl;
+	bool sameRegions = regions.GetNumOfRegions() == regionsAllChecked.GetNumOfRegions() && regions.GetNumOfRegions() == 30;
+	size_t assignedAirspaces = 0, assignedWaypoints = 0;
+	for (size_t r = 0; sameRegions && r < regions.GetNumOfRegions(); r++) {
+		sameRegions = regions.GetAirspaces(r) == regionsAllChecked.GetAirspaces(r) && regions.GetWaypoints(r) == regionsAllChecked.GetWaypoints(r);
+		assignedAirspaces += regions.GetAirspaces(r).size();
+		assignedWaypoints += regions.GetWaypoints(r).size();
+	}
+	std::multimap<int, Airspace> extracted;
+	WaypointSet extractedWaypoints;
+	StartTimer();
+	for (size_t r = 0; r < regions.GetNumOfRegions(); r++) {
+		extracted.clear();
+		extractedWaypoints.Clear();
+		regions.Extract(r, true, extracted, extractedWaypoints);
+	}
+	std::cout << "Regions: " << assignedAirspaces << " airspaces and " << assignedWaypoints << " waypoints assigned, extracted and clipped in " << StopTimer() << " ms" << std::endl;
+	f.Check(sameRegions && assignedAirspaces > 0 && assignedWaypoints > 0, "regions assigned with the spatial index differ from checking all the regions!");
+}
+
+// Jobs scheduling: each job done once, the ones waiting as for an external compiler overlapped up to the limit
+void TestJobs(Fixture& f) {
+	const size_t numOfJobs = 12;
+	std::vector<int> jobsDone(numOfJobs, 0);
+	StartTimer();
+	Parallel::Schedule(numOfJobs, [&jobsDone](const size_t job) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(job % 3 == 0 ? 90 : 30)); // of different duration
+		jobsDone[job]++;
+	}, 4);
+	const double scheduledTime = StopTimer();
+	std::cout << "Jobs: " << numOfJobs << " jobs of 30 or 90 ms scheduled up to 4 at the same time in " << scheduledTime << " ms (600 ms one after the other)" << std::endl;
+	f.Check(std::count(jobsDone.begin(), jobsDone.end(), 1) == (long)numOfJobs && scheduledTime <= 400, "the jobs were not all done once or not at the same time!");
+}
+
+// Nested parallel work: the loops inside the jobs share the threads, without starting more of them than set
+void TestNestedParallel(Fixture& f) {
+	Parallel::SetNumOfThreads(8);
+	std::atomic<int> active(0), maxActive(0);
+	std::atomic<size_t> nestedDone(0);
+	Parallel::Schedule(4, [&](const size_t) {
+		Parallel::For(64, [&](const size_t begin, const size_t end) {
+			const int now = ++active;
+			for (int seen = maxActive; now > seen && !maxActive.compare_exchange_weak(seen, now);) {}
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			nestedDone += end - begin;
+			active--;
+		});
+	});
+	Parallel::SetNumOfThreads(0);
+	std::cout << "Jobs: up to " << maxActive << " threads at the same time for 4 jobs with a parallel loop each, on 8 threads" << std::endl;
+	f.Check(nestedDone == 4 * 64 && maxActive <= 8, "the nested parallel loops started more threads than set!");
+}
+
+// Airspaces layout: passes on the geometry and the altitudes, then writing all the data
+void TestAirspacesLayout(Fixture& f) {
+	const Geometry::Limits filterLimits(50, 40, 0, 10);
+	Altitude filterTop;
+	filterTop.SetAltFt(10000);
+	size_t filtered = 0;
+	StartTimer();
+	for (int i = 0; i < 20; i++) for (const std::pair<const int, Airspace>& a : f.randomAirspaces)
+		if (a.second.GetBaseAltitude() <= filterTop && a.second.IsWithinLimits(filterLimits)) filtered++;
+	const double filterTime = StopTimer() / 20;
+	const std::string openAirFile(TemporaryPath(".txt"));
+	OpenAir openAir(f.randomAirspaces);
+	StartTimer();
+	const bool written = openAir.Write(openAirFile);
+	const double writeTime = StopTimer();
+	boost::filesystem::remove(openAirFile);
+	std::cout << "Airspaces: " << sizeof(Airspace) << " bytes each, " << sizeof(Altitude) << " bytes per altitude, " << f.randomAirspaces.size() << " airspaces filtered in " << filterTime
+		<< " ms (" << filtered / 20 << " kept), written as OpenAir in " << writeTime << " ms" << std::endl;
+	f.Check(written && filtered > 0, "unable to filter or write the airspaces!");
+}
+
+// Polish levels: each simplified level closed and with less points than the previous one
+void TestPolishLevels(Fixture& f) {
+	size_t levelPoints[4] = { 0, 0, 0, 0 };
+	bool levelsOK = true;
+	std::vector<std::vector<Geometry::LatLon>> levels;
+	const Polish polish;
+	StartTimer();
+	for (const std::pair<const int, Airspace>& a : f.randomAirspaces) {
+		polish.SimplifyLevels(a.second.GetPoints(), levels);
+		levelPoints[0] += a.second.GetNumberOfPoints();
+		for (size_t l = 0; l < levels.size(); l++) {
+			levelPoints[l + 1] += levels[l].size();
+			levelsOK &= levels[l].size() >= 4 && levels[l].front() == levels[l].back() && levels[l].size() <= (l == 0 ? a.second.GetNumberOfPoints() : levels[l - 1].size());
+		}
+	}
+	std::cout << "Polish levels: " << f.randomAirspaces.size() << " airspaces simplified in " << StopTimer() << " ms, points per level: "
+		<< levelPoints[0] << ", " << levelPoints[1] << ", " << levelPoints[2] << ", " << levelPoints[3] << std::endl;
+	f.Check(levelsOK && levelPoints[3] > 0 && levelPoints[3] < levelPoints[0], "wrong simplified geometries for the Polish levels!");
+
+	// Tolerances of each writer: none for this one, the others keep the default
+	Polish onlyData0;
+	onlyData0.SetLevelTolerances(std::vector<double>());
+	onlyData0.SimplifyLevels(f.randomAirspaces.begin()->second.GetPoints(), levels);
+	bool ownTolerances = levels.empty();
+	polish.SimplifyLevels(f.randomAirspaces.begin()->second.GetPoints(), levels);
+	ownTolerances &= !levels.empty();
+	f.Check(ownTolerances, "the Polish level tolerances are not the ones of each writer!");
+}
+
+// Polish piped into a command: the same content of the file, without writing it, and the failure of the command reported
+void TestPolishPipe(Fixture& f) {
+	const std::string polishFile(TemporaryPath(".mp")), pipedFile(TemporaryPath(".mp"));
+	StartTimer();
+	bool polishOK = Polish().Write(polishFile, f.randomAirspaces);
+	const double polishTime = StopTimer();
+	StartTimer();
+	polishOK &= Polish().Pipe("cat > \"" + pipedFile + "\"", polishFile, f.randomAirspaces);
+	const double pipeTime = StopTimer();
+	bool failureReported;
+	{
+		const ErrorsExpected errorsExpected; // of the failing command
+		failureReported = !Polish().Pipe("exit 3", polishFile, f.randomAirspaces);
+	}
+	const auto readPolish = [](const std::string& filename) { // without the comments, with the creation date
+		std::ifstream input(filename);
+		std::string content, line;
+		while (std::getline(input, line)) if (line.empty() || line.front() != ';') content += line + '\n';
+		return content;
+	};
+	polishOK &= !readPolish(polishFile).empty() && readPolish(polishFile) == readPolish(pipedFile);
+	boost::filesystem::remove(polishFile);
+	boost::filesystem::remove(pipedFile);
+	std::cout << "Polish output: written in " << polishTime << " ms, piped into a command in " << pipeTime << " ms" << std::endl;
+	f.Check(polishOK, "the Polish piped differs from the one written!");
+	f.Check(failureReported, "the failure of the command the Polish is piped into is not reported!");
+}
+
+// Content by name of each file inside the KMZ
+std::map<std::string, std::string> ReadKMZ(const std::string& kmzFile) {
+	std::map<std::string, std::string> files;
+	int zipError = 0;
+	zip* archive = zip_open(kmzFile.c_str(), 0, &zipError);
+	if (archive == nullptr) return files;
+	for (zip_int64_t i = 0; i < zip_get_num_entries(archive, 0); i++) {
+		struct zip_stat entry;
+		if (zip_stat_index(archive, i, 0, &entry) != 0) continue;
+		std::string content((size_t)entry.size, '\0');
+		struct zip_file* file = zip_fopen_index(archive, i, 0);
+		if (file == nullptr) continue;
+		zip_fread(file, &content[0], entry.size);
+		zip_fclose(file);
+		files[entry.name] = content;
+	}
+	zip_close(archive);
+	return files;
+}
+
+// KMZ tiles: all the airspaces written in the tiles, each tile linked from the main document, then read back as the single document
+void TestKMZTiles(Fixture& f) {
+	const std::string singleKMZ(TemporaryPath(".kmz")), tiledKMZ(TemporaryPath(".kmz"));
+	WaypointSet noWaypoints;
+	StartTimer();
+	bool written = KML(f.randomAirspaces, noWaypoints).Write(singleKMZ);
+	const double singleTime = StopTimer();
+	KML tiledWriter(f.randomAirspaces, noWaypoints);
+	tiledWriter.SetTileSize(5);
+	StartTimer();
+	written &= tiledWriter.Write(tiledKMZ);
+	const double tiledTime = StopTimer();
+	size_t tiles = 0, links = 0, placemarks = 0;
+	for (const std::pair<const std::string, std::string>& file : ReadKMZ(tiledKMZ)) {
+		const bool isMain = file.first == "doc.kml";
+		if (!isMain) tiles++;
+		for (size_t pos = file.second.find(isMain ? "<NetworkLink>" : "<Placemark>"); pos != std::string::npos; pos = file.second.find(isMain ? "<NetworkLink>" : "<Placemark>", pos + 1)) (isMain ? links : placemarks)++;
+	}
+	std::cout << "KMZ: " << f.randomAirspaces.size() << " airspaces written in " << singleTime << " ms in a single document, in " << tiledTime << " ms in " << tiles << " tiles of 5 degrees" << std::endl;
+	f.Check(written && tiles > 0 && links == tiles && placemarks == f.randomAirspaces.size(), "the tiles of the KMZ do not contain all the airspaces!");
+
+	// Reading: all the KML files inside
+	std::multimap<int, Airspace> singleRead, tiledRead;
+	bool read;
+	double singleReadTime, tiledReadTime;
+	{
+		const ErrorsExpected errorsExpected; // the category Other, written for OTH, is not read back
+		StartTimer();
+		read = KML(singleRead, noWaypoints).ReadKMZ(singleKMZ);
+		singleReadTime = StopTimer();
+		StartTimer();
+		read &= KML(tiledRead, noWaypoints).ReadKMZ(tiledKMZ);
+		tiledReadTime = StopTimer();
+	}
+	boost::filesystem::remove(singleKMZ);
+	boost::filesystem::remove(tiledKMZ);
+	std::cout << "KMZ: " << tiledRead.size() << " airspaces read in " << tiledReadTime << " ms from " << tiles << " tiles, in " << singleReadTime << " ms from a single document" << std::endl;
+	bool sameRead = read && !tiledRead.empty() && tiledRead.size() == singleRead.size();
+	for (int t = Airspace::CLASSA; sameRead && t <= Airspace::UNDEFINED; t++) sameRead = singleRead.count(t) == tiledRead.count(t);
+	f.Check(sameRead, "the airspaces read from the tiles differ from the single document!");
+}
+
+// KMZ tiles across the antimeridian: the airspace in the tile west of it, with the region of its size around it
+void TestKMZAcrossAntimeridian(Fixture& f) {
+	std::multimap<int, Airspace> airspaces(AntimeridianAirspaces());
+	WaypointSet noWaypoints;
+	const std::string kmzFile(TemporaryPath(".kmz"));
+	KML writer(airspaces, noWaypoints);
+	writer.SetTileSize(5);
+	const bool written = writer.Write(kmzFile);
+	const std::string doc(ReadKMZ(kmzFile)["doc.kml"]);
+	boost::filesystem::remove(kmzFile);
+	const auto valueOf = [&doc](const std::string& tag) {
+		const size_t pos = doc.find("<" + tag + ">");
+		return pos == std::string::npos ? 0 : std::atof(doc.c_str() + pos + tag.size() + 2);
+	};
+	std::cout << "KMZ: tile across the antimeridian with region from west " << valueOf("west") << " to east " << valueOf("east") << std::endl;
+	f.Check(written && doc.find("<name>Airspace -20, 175</name>") != std::string::npos && valueOf("west") >= 179 && valueOf("east") <= -179, "wrong tile or region across the antimeridian!");
+}
+
+// KMZ not possible to write: no temporary files left
+void TestKMZCleanup(Fixture& f) {
+	std::multimap<int, Airspace> airspaces(AntimeridianAirspaces());
+	WaypointSet noWaypoints;
+	const boost::filesystem::path failingDir(TemporaryPath(""));
+	boost::filesystem::create_directories(failingDir / "output.kmz" / "busy"); // a directory in place of the KMZ
+	KML writer(airspaces, noWaypoints);
+	writer.SetTileSize(5);
+	bool written;
+	{
+		const ErrorsExpected errorsExpected;
+		written = writer.Write((failingDir / "output.kmz").string());
+	}
+	size_t leftFiles = 0;
+	for (boost::filesystem::directory_iterator it(failingDir), end; it != end; ++it) if (it->path().filename() != "output.kmz") leftFiles++;
+	boost::filesystem::remove_all(failingDir);
+	std::cout << "KMZ: " << leftFiles << " temporary file(s) left after failing to write" << std::endl;
+	f.Check(!written, "the KMZ in place of a directory was written!");
+	f.Check(leftFiles == 0, "the temporary files of a KMZ not written are left!");
+}
+
+// Vector tiles across the antimeridian: only the columns at the two edges of the map, the bounds from west to east of it
+void TestVectorTilesAcrossAntimeridian(Fixture& f) {
+	const boost::filesystem::path tilesDir(TemporaryPath(""));
+	const bool written = VectorTiles(AntimeridianAirspaces()).Write(tilesDir.string(), 3, 3);
+	std::set<std::string> columns;
+	for (boost::filesystem::directory_iterator it(tilesDir / "3"), end; written && it != end; ++it) columns.insert(it->path().filename().string());
+	std::ifstream metadata((tilesDir / "metadata.json").string());
+	const std::string bounds((std::istreambuf_iterator<char>(metadata)), std::istreambuf_iterator<char>());
+	metadata.close();
+	boost::filesystem::remove_all(tilesDir);
+	std::cout << "Vector tiles: " << columns.size() << " column(s) across the antimeridian at zoom 3" << std::endl;
+	f.Check(written && columns == std::set<std::string>({ "0", "7" }) && bounds.find("\"bounds\":[179.7") != std::string::npos, "wrong vector tiles or bounds across the antimeridian!");
+}
+
+// Vector tiles of a large airspace: only the tiles really touched by it, and none at the zoom levels where it would be in too many tiles
+void TestVectorTilesOfLargeAirspace(Fixture& f) {
+	std::multimap<int, Airspace> airspaces;
+	Insert(airspaces, MakeAirspace(Airspace::CTR, "Large diamond", { Geometry::LatLon(51, 10), Geometry::LatLon(45, 16), Geometry::LatLon(39, 10), Geometry::LatLon(45, 4) }));
+	const boost::filesystem::path tilesDir(TemporaryPath(""));
+	StartTimer();
+	const bool written = VectorTiles(airspaces).Write(tilesDir.string(), 8, 8) && VectorTiles(airspaces).Write(tilesDir.string(), 16, 16);
+	const double largeTime = StopTimer();
+	size_t tiles = 0;
+	for (boost::filesystem::recursive_directory_iterator it(tilesDir), end; written && it != end; ++it) if (it->path().extension() == ".pbf") tiles++;
+	boost::filesystem::remove_all(tilesDir);
+	std::cout << "Vector tiles: large airspace in " << tiles << " tiles at zoom 8, of the 130 of its bounding box, left out at zoom 16, in " << largeTime << " ms" << std::endl;
+	f.Check(written && tiles > 0 && tiles < 130, "wrong vector tiles of the large airspace!");
+}
+
+// Fixed point formatting: the same of printf, also on ties and with the padding used by the writers
+void TestNumberFormat(Fixture& f) {
+	std::uniform_real_distribution<double> randomValue(-200, 200);
+	std::uniform_int_distribution<int> randomDecimals(0, 9), randomMillis(-200000, 200000);
+	std::vector<std::pair<double, int>> numbers;
+	for (int i = 0; i < 200000; i++) numbers.push_back(std::make_pair(randomValue(f.random), randomDecimals(f.random)));
+	for (int i = 0; i < 100000; i++) numbers.push_back(std::make_pair((randomMillis(f.random) + 0.5) / 1000, 3)); // ties
+	numbers.push_back(std::make_pair(-0.0, 6));
+	numbers.push_back(std::make_pair(-0.0000001, 6));
+	numbers.push_back(std::make_pair(1e300, 2));
+	size_t formatMismatches = 0;
+	std::string formatted;
+	char printfBuffer[512];
+	for (const std::pair<double, int>& n : numbers) {
+		const int width = n.second + 3;
+		snprintf(printfBuffer, sizeof(printfBuffer), "%0*.*f", width, n.second, n.first);
+		formatted.clear();
+		NumberFormat::AppendFixed(n.first, n.second, formatted, width);
+		if (formatted != printfBuffer) formatMismatches++;
+	}
+	formatted.clear();
+	StartTimer();
+	for (const std::pair<double, int>& n : numbers) NumberFormat::AppendFixed(n.first, 6, formatted);
+	const double formatTime = StopTimer() * 1e6 / numbers.size();
+	std::ostringstream stream;
+	stream << std::fixed << std::setprecision(6);
+	StartTimer();
+	for (const std::pair<double, int>& n : numbers) stream << n.first;
+	std::cout << "Fixed point format: " << formatTime << " ns per number (" << StopTimer() * 1e6 / numbers.size() << " ns with stream), "
+		<< formatMismatches << " different from printf out of " << numbers.size() << std::endl;
+	f.Check(formatMismatches == 0 && formatted.size() == stream.str().size(), "the fixed point format differs from printf!");
+}
+
+void TestWaypointWriters(Fixture& f) {
+	const std::string cupFile(TemporaryPath(".cup")), csvFile(TemporaryPath(".csv"));
+	StartTimer();
+	bool written = SeeYou(f.waypoints).Write(cupFile);
+	const double cupTime = StopTimer();
+	StartTimer();
+	written &= CSV(f.waypoints).Write(csvFile);
+	std::cout << "Waypoints: " << f.waypoints.Size() << " written as SeeYou in " << cupTime << " ms, as CSV in " << StopTimer() << " ms" << std::endl;
+	boost::filesystem::remove(cupFile);
+	boost::filesystem::remove(csvFile);
+	f.Check(written, "unable to write the waypoints!");
+}
+
+// Points: with the compact storage the coordinates read from the usual formats must print the same at the precision of the writers
+void TestPoints(Fixture& f) {
+	size_t numOfPoints = 0;
+	for (const std::pair<const int, Airspace>& a : f.randomAirspaces) numOfPoints += a.second.GetNumberOfPoints();
+	double minLat = 90, maxLat = -90, minLon = 180, maxLon = -180;
+	StartTimer();
+	for (const std::pair<const int, Airspace>& a : f.randomAirspaces) for (const Geometry::LatLon& p : a.second.GetPoints()) {
+		minLat = std::min(minLat, p.Lat());
+		maxLat = std::max(maxLat, p.Lat());
+		minLon = std::min(minLon, p.Lon());
+		maxLon = std::max(maxLon, p.Lon());
+	}
+	std::cout << "Points: " << sizeof(Geometry::LatLon) << " bytes each (" << (Geometry::LatLon::RESOLUTION > 0 ? "compact" : "double") << "), bounding box of " << numOfPoints << " points in " << StopTimer() << " ms" << std::endl;
+	f.Check(minLat <= maxLat && minLon <= maxLon, "no bounding box of the points!");
+	std::uniform_int_distribution<int> randomSeconds(0, 3600 * 90 - 1), randomTenMillionths(0, 900000000);
+	size_t printMismatches = 0;
+	char expected[32], printed[32];
+	const auto comparePrinted = [&](const double value, const double stored) {
+		snprintf(expected, sizeof(expected), "%.7f", value); // GeoJSON, ACB has 1e-7 degrees too
+		snprintf(printed, sizeof(printed), "%.7f", stored);
+		if (strcmp(expected, printed) != 0) printMismatches++;
+		snprintf(expected, sizeof(expected), "%.3f", (value - std::floor(value)) * 60); // decimal minutes of OpenAir and SeeYou
+		snprintf(printed, sizeof(printed), "%.3f", (stored - std::floor(stored)) * 60);
+		if (strcmp(expected, printed) != 0) printMismatches++;
+		if (std::fabs(value - stored) > Geometry::LatLon::RESOLUTION / 2 + 1e-12) printMismatches++;
+	};
+	for (int i = 0; i < 1000000; i++) {
+		const int seconds = randomSeconds(f.random);
+		const double fromSeconds = seconds / 3600 + (seconds / 60 % 60) / 60.0 + (seconds % 60) / 3600.0, fromDecimals = randomTenMillionths(f.random) / 1e7;
+		const Geometry::LatLon point(fromSeconds, fromDecimals);
+		comparePrinted(fromSeconds, point.Lat());
+		comparePrinted(fromDecimals, point.Lon());
+		int deg, min, sec;
+		point.GetLatDegMinSec(deg, min, sec);
+		if (deg * 3600 + min * 60 + sec != seconds) printMismatches++;
+	}
+	std::cout << "Points: " << printMismatches << " coordinates printed differently out of 2000000" << std::endl;
+	f.Check(printMismatches == 0, "the stored coordinates do not print as the original ones!");
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+	AirspaceConverter::SetLogMessageFunction([](const std::string&) {});
+	AirspaceConverter::SetLogWarningFunction([](const std::string&) {});
+#ifndef _WIN32
+	signal(SIGPIPE, SIG_IGN); // as the program does: the commands piped, also the failing one, may end before reading everything
+#endif
+
+	Fixture f;
+	if (!LoadWaypoints(f, argc > 1 ? argv[1] : nullptr)) return EXIT_FAILURE;
+
+	// In this order: the polygons are made by the surface test, the random airspaces by the conflicts one
+	TestWaypointIndex(f);
+	TestMergeWaypoints(f);
+	TestSurface(f);
+	TestClipOnLimits(f);
+	TestContainment(f);
+	TestAltitudeGrammar(f);
+	TestKeywords(f);
+	TestSelfIntersections(f);
+	TestConflicts(f);
+	TestConflictsAcrossAntimeridian(f);
+	TestRegions(f);
+	TestJobs(f);
+	TestNestedParallel(f);
+	TestAirspacesLayout(f);
+	TestPolishLevels(f);
+#ifndef _WIN32
+	TestPolishPipe(f);
+#endif
+	TestKMZTiles(f);
+	TestKMZAcrossAntimeridian(f);
+	TestKMZCleanup(f);
+	TestVectorTilesAcrossAntimeridian(f);
+	TestVectorTilesOfLargeAirspace(f);
+	TestNumberFormat(f);
+	TestWaypointWriters(f);
+	TestPoints(f);
+
+	std::cout << "Checks: " << f.checks - f.failures << " passed out of " << f.checks << std::endl;
+	return f.failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}